@@ -17,6 +17,11 @@
           for the multiple documents
         * With "--single" command line option to support opening a single
           document only
+        * With "--batch" command line option to convert, render or summarize
+          the documents given on the command line without initializing the
+          GUI at all, e.g. "--batch --png --stats --output=out *.csv"
+        * With "--benchmarks" command line option to add the "Benchmarks"
+          submenus measuring the speed of the program to the edit menus
 
     Notice that doing it like this somewhat complicates the code, you could
     make things much simpler in your own programs by using either
@@ -48,8 +53,13 @@
 #include "wx/docmdi.h"
 
 #include "corrolinx.h"
+#include "corrolinx_batch.h"
+#include "corrolinx_bench.h"
+#include "corrolinx_compare.h"
 #include "corrolinx_doc.h"
+#include "corrolinx_log.h"
 #include "corrolinx_view.h"
+#include "corrolinx_workers.h"
 
 #include "wx/cmdline.h"
 #include "wx/config.h"
@@ -68,10 +78,14 @@
 // MyApp implementation
 // ----------------------------------------------------------------------------
 
-IMPLEMENT_APP(MyApp)
+IMPLEMENT_WX_THEME_SUPPORT
+IMPLEMENT_APP_NO_MAIN(MyApp)
 
 wxBEGIN_EVENT_TABLE(MyApp, wxApp)
     EVT_MENU(wxID_ABOUT, MyApp::OnAbout)
+    EVT_MENU_RANGE(ID_BENCHMARK_FIRST, ID_BENCHMARK_LAST, MyApp::OnBenchmark)
+    EVT_UPDATE_UI_RANGE(ID_BENCHMARK_FIRST, ID_BENCHMARK_LAST,
+                        MyApp::OnUpdateBenchmark)
 wxEND_EVENT_TABLE()
 
 MyApp::MyApp()
@@ -84,6 +98,7 @@ MyApp::MyApp()
 
     m_canvas = NULL;
     m_menuEdit = NULL;
+    m_benchmarks = false;
 }
 
 // constants for the command line options names
@@ -92,9 +107,82 @@ namespace CmdLineOption
 
 const char * const MDI = "mdi";
 const char * const SDI = "sdi";
+const char * const BENCHMARKS = "benchmarks";
+
+const char * const BATCH = "batch";
+const char * const CONVERT = "convert";
+const char * const PNG = "png";
+const char * const STATS = "stats";
+const char * const OUTPUT = "output";
+const char * const JOBS = "jobs";
 
 } // namespace CmdLineOption
 
+namespace
+{
+
+// create the templates of all the documents supported by the application,
+// which are also used in the batch mode to find the types of the files
+void CreateDocTemplates(wxDocManager *docManager)
+{
+    //// Create a template relating drawing documents to their views
+    new wxDocTemplate(docManager, "Drawing", "*.drw", "", "drw",
+                      "Drawing Doc", "Drawing View",
+                      CLASSINFO(DrawingDocument), CLASSINFO(DrawingView));
+#if defined( __WXMAC__ )  && wxOSX_USE_CARBON
+    wxFileName::MacRegisterDefaultTypeAndCreator("drw" , 'WXMB' , 'WXMA');
+#endif
+
+    //// And another one relating Cor-Map surveys to their views
+    new wxDocTemplate(docManager, "Survey", "*.csv", "", "csv",
+                      "Survey Doc", "Survey View",
+                      CLASSINFO(SurveyDocument), CLASSINFO(SurveyView));
+
+    //// And one more relating comparisons of several surveys to their views
+    new wxDocTemplate(docManager, "Survey comparison", "*.cmp", "", "cmp",
+                      "Comparison Doc", "Comparison View",
+                      CLASSINFO(ComparisonDocument),
+                      CLASSINFO(ComparisonView));
+
+//    else // multiple documents mode: allow documents of different types
+    {
+        // Create a template relating text documents to their views
+        // the big ones, including the reading logs, are opened read-only
+        new TextDocTemplate(docManager, "Text", "*.txt;*.text;*.log", "",
+                            "txt;text;log", "Text Doc", "Text View");
+#if defined( __WXMAC__ ) && wxOSX_USE_CARBON
+        wxFileName::MacRegisterDefaultTypeAndCreator("txt" , 'TEXT' , 'WXMA');
+#endif
+
+    }
+}
+
+} // anonymous namespace
+
+void MyApp::OnInitCmdLine(wxCmdLineParser& parser)
+{
+    wxApp::OnInitCmdLine(parser);
+
+    parser.AddSwitch("", CmdLineOption::BENCHMARKS,
+                     "add the benchmarks to the edit menus");
+    parser.AddParam("document",
+                    wxCMD_LINE_VAL_STRING,
+                    wxCMD_LINE_PARAM_OPTIONAL | wxCMD_LINE_PARAM_MULTIPLE);
+}
+
+bool MyApp::OnCmdLineParsed(wxCmdLineParser& parser)
+{
+    if ( !wxApp::OnCmdLineParsed(parser) )
+        return false;
+
+    m_benchmarks = parser.Found(CmdLineOption::BENCHMARKS);
+
+    for ( size_t n = 0; n < parser.GetParamCount(); n++ )
+        m_filesToOpen.push_back(parser.GetParam(n));
+
+    return true;
+}
+
 bool MyApp::OnInit()
 {
 #if wxUSE_MDI_ARCHITECTURE && _WINDOWS_
@@ -116,25 +204,7 @@ bool MyApp::OnInit()
     //// Create a document manager
     wxDocManager *docManager = new wxDocManager;
 
-    //// Create a template relating drawing documents to their views
-    new wxDocTemplate(docManager, "Drawing", "*.drw", "", "drw",
-                      "Drawing Doc", "Drawing View",
-                      CLASSINFO(DrawingDocument), CLASSINFO(DrawingView));
-#if defined( __WXMAC__ )  && wxOSX_USE_CARBON
-    wxFileName::MacRegisterDefaultTypeAndCreator("drw" , 'WXMB' , 'WXMA');
-#endif
-
-//    else // multiple documents mode: allow documents of different types
-    {
-        // Create a template relating text documents to their views
-        new wxDocTemplate(docManager, "Text", "*.txt;*.text", "", "txt;text",
-                          "Text Doc", "Text View",
-                          CLASSINFO(TextEditDocument), CLASSINFO(TextEditView));
-#if defined( __WXMAC__ ) && wxOSX_USE_CARBON
-        wxFileName::MacRegisterDefaultTypeAndCreator("txt" , 'TEXT' , 'WXMA');
-#endif
-
-    }
+    CreateDocTemplates(docManager);
 
     // create the main frame window
     wxFrame *frame;
@@ -176,11 +246,16 @@ bool MyApp::OnInit()
     frame->Centre();
     frame->Show();
 
+    for ( size_t n = 0; n < m_filesToOpen.size(); n++ )
+        docManager->CreateDocument(m_filesToOpen[n], wxDOC_SILENT);
+
     return true;
 }
 
 int MyApp::OnExit()
 {
+    WorkerPool::Cleanup();
+
     wxDocManager * const manager = wxDocManager::GetDocumentManager();
 #if wxUSE_CONFIG
     manager->FileHistorySave(*wxConfig::Get());
@@ -213,6 +288,97 @@ wxMenu *MyApp::CreateDrawingEditMenu()
     menu->Append(wxID_REDO);
     menu->AppendSeparator();
     menu->Append(wxID_CUT, "&Cut last segment");
+    menu->Append(wxID_DELETE, "&Delete selected segments\tDel",
+                 "Delete the segments selected with Ctrl+click");
+    menu->Append(ID_DRAWING_CANCEL_LOAD, "&Stop loading\tEsc",
+                 "Stop loading the document and keep its loaded part");
+    menu->AppendSeparator();
+    menu->Append(wxID_ZOOM_IN);
+    menu->Append(wxID_ZOOM_OUT);
+    menu->Append(wxID_ZOOM_100);
+    menu->Append(wxID_ZOOM_FIT);
+
+    if ( m_benchmarks )
+    {
+        menu->AppendSeparator();
+        menu->AppendSubMenu(CreateDrawingBenchmarksMenu(), "&Benchmarks");
+    }
+
+    return menu;
+}
+
+wxMenu *MyApp::CreateSurveyEditMenu()
+{
+    wxMenu * const menu = new wxMenu;
+    menu->Append(wxID_UNDO);
+    menu->Append(wxID_REDO);
+    menu->AppendSeparator();
+    menu->Append(wxID_ZOOM_IN);
+    menu->Append(wxID_ZOOM_OUT);
+    menu->Append(wxID_ZOOM_100);
+    menu->Append(wxID_ZOOM_FIT);
+    menu->AppendSeparator();
+    menu->AppendRadioItem(ID_SURVEY_COLOURS_BANDS, "Corrosion &bands",
+                          "Colour the readings by ASTM C876 bands");
+    menu->AppendRadioItem(ID_SURVEY_COLOURS_CONTINUOUS, "&Continuous colours",
+                          "Colour the readings using a smooth gradient");
+    menu->AppendSeparator();
+    menu->AppendRadioItem(ID_SURVEY_INTERPOLATION_NONE, "&No interpolation",
+                          "Show the readings as they are");
+    menu->AppendRadioItem(ID_SURVEY_INTERPOLATION_BILINEAR, "B&ilinear",
+                          "Interpolate linearly between the readings");
+    menu->AppendRadioItem(ID_SURVEY_INTERPOLATION_BICUBIC, "Bic&ubic",
+                          "Interpolate smoothly between the readings");
+    menu->AppendRadioItem(ID_SURVEY_INTERPOLATION_IDW, "Inverse &distance",
+                          "Interpolate using inverse distance weighting");
+    menu->AppendSeparator();
+    menu->AppendCheckItem(ID_SURVEY_SHOW_CONTOURS, "Show c&ontours",
+                          "Show the equipotential lines every 50mV");
+
+    if ( m_benchmarks )
+    {
+        menu->AppendSeparator();
+        menu->AppendSubMenu(CreateSurveyBenchmarksMenu(), "&Benchmarks");
+    }
+
+    return menu;
+}
+
+wxMenu *MyApp::CreateComparisonEditMenu()
+{
+    wxMenu * const menu = new wxMenu;
+    menu->Append(ID_COMPARISON_ADD_SURVEY, "&Add survey...",
+                 "Add another survey to the comparison");
+    menu->AppendSeparator();
+    menu->Append(ID_COMPARISON_PREVIOUS, "&Previous survey\tCtrl+PgUp",
+                 "Show the survey taken before this one");
+    menu->Append(ID_COMPARISON_NEXT, "&Next survey\tCtrl+PgDn",
+                 "Show the survey taken after this one");
+    menu->AppendSeparator();
+    menu->Append(wxID_ZOOM_IN);
+    menu->Append(wxID_ZOOM_OUT);
+    menu->Append(wxID_ZOOM_100);
+    menu->Append(wxID_ZOOM_FIT);
+    menu->AppendSeparator();
+    menu->AppendRadioItem(ID_COMPARISON_READINGS, "&Readings",
+                          "Show the readings of the survey");
+    menu->AppendRadioItem(ID_COMPARISON_SINCE_FIRST,
+                          "Change since the &first survey",
+                          "Show the change of the readings since the first "
+                          "survey, decreases in red");
+    menu->AppendRadioItem(ID_COMPARISON_SINCE_PREVIOUS,
+                          "Change since the pre&vious survey",
+                          "Show the change of the readings since the "
+                          "previous survey, decreases in red");
+    menu->AppendRadioItem(ID_COMPARISON_TREND, "&Trend of all surveys",
+                          "Show the change of the readings over 5 years at "
+                          "the rate fitted to all surveys");
+
+    if ( m_benchmarks )
+    {
+        menu->AppendSeparator();
+        menu->AppendSubMenu(CreateComparisonBenchmarksMenu(), "&Benchmarks");
+    }
 
     return menu;
 }
@@ -233,8 +399,11 @@ void MyApp::CreateMenuBarForFrame(wxFrame *frame, wxMenu *file, wxMenu *edit)
     frame->SetMenuBar(menubar);
 }
 
-wxFrame *MyApp::CreateChildFrame(wxView *view, bool isCanvas)
+wxFrame *MyApp::CreateChildFrame(wxView *view, ChildFrameKind kind)
 {
+    // the graphical documents can be printed while text ones can't
+    const bool isCanvas = kind != ChildFrame_Text && kind != ChildFrame_Log;
+
     // create a child frame of appropriate class for the current mode
     wxFrame *subframe;
     wxDocument *doc = view->GetDocument();
@@ -274,23 +443,58 @@ wxFrame *MyApp::CreateChildFrame(wxView *view, bool isCanvas)
     menuFile->Append(wxID_NEW);
     menuFile->Append(wxID_OPEN);
     AppendDocumentFileCommands(menuFile, isCanvas);
+    if ( kind == ChildFrame_Drawing )
+    {
+        menuFile->AppendSeparator();
+        menuFile->Append(ID_DRAWING_CONVERT, "Con&vert...",
+                         "Save a copy of the drawing in another format");
+    }
+    else if ( kind == ChildFrame_Survey )
+    {
+        menuFile->AppendSeparator();
+        menuFile->Append(ID_SURVEY_EXPORT_CONTOURS, "Export con&tours",
+                         "Create a new drawing with the survey contours");
+        menuFile->Append(ID_SURVEY_EXPORT_IMAGE, "Export &image...",
+                         "Save the colour map as a PNG or TIFF image for "
+                         "printing");
+    }
     menuFile->AppendSeparator();
     menuFile->Append(wxID_EXIT);
 
     wxMenu *menuEdit;
-    if ( isCanvas )
+    switch ( kind )
     {
-        menuEdit = CreateDrawingEditMenu();
+        case ChildFrame_Drawing:
+            menuEdit = CreateDrawingEditMenu();
 
-        doc->GetCommandProcessor()->SetEditMenu(menuEdit);
-        doc->GetCommandProcessor()->Initialize();
-    }
-    else // text frame
-    {
-        menuEdit = new wxMenu;
-        menuEdit->Append(wxID_COPY);
-        menuEdit->Append(wxID_PASTE);
-        menuEdit->Append(wxID_SELECTALL);
+            doc->GetCommandProcessor()->SetEditMenu(menuEdit);
+            doc->GetCommandProcessor()->Initialize();
+            break;
+
+        case ChildFrame_Survey:
+            menuEdit = CreateSurveyEditMenu();
+
+            doc->GetCommandProcessor()->SetEditMenu(menuEdit);
+            doc->GetCommandProcessor()->Initialize();
+            break;
+
+        case ChildFrame_Comparison:
+            menuEdit = CreateComparisonEditMenu();
+            break;
+
+        case ChildFrame_Log:
+            menuEdit = new wxMenu;
+            menuEdit->Append(ID_LOG_GO_TO_LINE, "&Go to line...\tCtrl+G",
+                             "Scroll the log to the given line");
+            break;
+
+        case ChildFrame_Text:
+        default:
+            menuEdit = new wxMenu;
+            menuEdit->Append(wxID_COPY);
+            menuEdit->Append(wxID_PASTE);
+            menuEdit->Append(wxID_SELECTALL);
+            break;
     }
 
     CreateMenuBarForFrame(subframe, menuFile, menuEdit);
@@ -340,3 +544,206 @@ void MyApp::OnAbout(wxCommandEvent& WXUNUSED(event))
         docsCount
     );
 }
+
+void MyApp::OnBenchmark(wxCommandEvent& event)
+{
+    RunBenchmark(event.GetId(),
+                 wxDocManager::GetDocumentManager()->GetCurrentView());
+}
+
+void MyApp::OnUpdateBenchmark(wxUpdateUIEvent& event)
+{
+    event.Enable(CanRunBenchmark(event.GetId(),
+                 wxDocManager::GetDocumentManager()->GetCurrentView()));
+}
+
+// ----------------------------------------------------------------------------
+// BatchApp implementation
+// ----------------------------------------------------------------------------
+
+BatchApp::BatchApp()
+{
+    m_batch = NULL;
+}
+
+void BatchApp::OnInitCmdLine(wxCmdLineParser& parser)
+{
+    wxAppConsole::OnInitCmdLine(parser);
+
+    parser.AddSwitch("", CmdLineOption::BATCH,
+                     "process the files without showing any windows");
+    parser.AddOption("", CmdLineOption::CONVERT,
+                     "convert the drawings to \"text\", \"binary\" or "
+                     "\"packed\" format");
+    parser.AddSwitch("", CmdLineOption::PNG,
+                     "render the documents to PNG images");
+    parser.AddSwitch("", CmdLineOption::STATS,
+                     "write the statistics of the documents");
+    parser.AddOption("", CmdLineOption::OUTPUT,
+                     "directory for the output files");
+    parser.AddOption("", CmdLineOption::JOBS,
+                     "number of files to process in parallel",
+                     wxCMD_LINE_VAL_NUMBER);
+
+    parser.AddParam("document",
+                    wxCMD_LINE_VAL_STRING,
+                    wxCMD_LINE_PARAM_OPTIONAL | wxCMD_LINE_PARAM_MULTIPLE);
+}
+
+bool BatchApp::OnCmdLineParsed(wxCmdLineParser& parser)
+{
+    if ( !wxAppConsole::OnCmdLineParsed(parser) )
+        return false;
+
+    BatchOptions options;
+
+    wxString format;
+    if ( parser.Found(CmdLineOption::CONVERT, &format) )
+    {
+        if ( format == "text" )
+            options.format = DrawingFormat_Text;
+        else if ( format == "binary" )
+            options.format = DrawingFormat_Binary;
+        else if ( format == "packed" )
+            options.format = DrawingFormat_Packed;
+        else
+        {
+            wxLogError("Unknown drawing format \"%s\".", format);
+            return false;
+        }
+
+        options.convert = true;
+    }
+
+    options.png = parser.Found(CmdLineOption::PNG);
+    options.stats = parser.Found(CmdLineOption::STATS);
+    parser.Found(CmdLineOption::OUTPUT, &options.outputDir);
+
+    long jobs;
+    if ( parser.Found(CmdLineOption::JOBS, &jobs) )
+    {
+        if ( jobs < 1 )
+        {
+            wxLogError("The number of jobs must be positive.");
+            return false;
+        }
+
+        options.jobs = jobs;
+    }
+
+    if ( !options.convert && !options.png && !options.stats )
+    {
+        wxLogError("Nothing to do, use --%s, --%s or --%s.",
+                   CmdLineOption::CONVERT,
+                   CmdLineOption::PNG,
+                   CmdLineOption::STATS);
+        return false;
+    }
+
+    if ( !parser.GetParamCount() )
+    {
+        wxLogError("No documents to process.");
+        return false;
+    }
+
+    m_batch = new BatchProcessor(options);
+    for ( size_t n = 0; n < parser.GetParamCount(); n++ )
+        m_batch->AddFile(parser.GetParam(n));
+
+    return true;
+}
+
+bool BatchApp::OnInit()
+{
+    if ( !wxAppConsole::OnInit() )
+        return false;
+
+    // the images are rendered into wxImage, which doesn't need the GUI
+    ::wxInitAllImageHandlers();
+
+    SetVendorName("James Instruments Inc.");
+    SetAppName("Corrolinx");
+
+    // the document manager is only used to find the types of the files
+    CreateDocTemplates(new wxDocManager);
+
+    return true;
+}
+
+int BatchApp::OnRun()
+{
+    // there is no need for the event loop without any windows
+    return m_batch->Run() ? 0 : 1;
+}
+
+int BatchApp::OnExit()
+{
+    WorkerPool::Cleanup();
+
+    delete wxDocManager::GetDocumentManager();
+
+    delete m_batch;
+
+    return wxAppConsole::OnExit();
+}
+
+// ----------------------------------------------------------------------------
+// the program entry point
+// ----------------------------------------------------------------------------
+
+// The GUI can't be initialized without a display, e.g. on the build servers,
+// so the batch mode must be detected before wxWidgets initialization to use
+// BatchApp instead of MyApp, and the command line has to be checked directly.
+
+namespace
+{
+
+bool IsBatchSwitch(const wxString& arg)
+{
+    return arg == wxString("--") + CmdLineOption::BATCH;
+}
+
+} // anonymous namespace
+
+#ifdef __WINDOWS__
+
+extern "C" int WINAPI WinMain(HINSTANCE hInstance,
+                              HINSTANCE hPrevInstance,
+                              wxCmdLineArgType lpCmdLine,
+                              int nCmdShow)
+{
+    wxDISABLE_DEBUG_SUPPORT();
+
+    const wxArrayString
+        args = wxCmdLineParser::ConvertStringToArgs(lpCmdLine);
+    for ( size_t n = 0; n < args.size(); n++ )
+    {
+        if ( IsBatchSwitch(args[n]) )
+        {
+            wxApp::SetInstance(new BatchApp);
+            break;
+        }
+    }
+
+    return wxEntry(hInstance, hPrevInstance, lpCmdLine, nCmdShow);
+}
+
+#else // !__WINDOWS__
+
+int main(int argc, char **argv)
+{
+    wxDISABLE_DEBUG_SUPPORT();
+
+    for ( int n = 1; n < argc; n++ )
+    {
+        if ( IsBatchSwitch(argv[n]) )
+        {
+            wxApp::SetInstance(new BatchApp);
+            break;
+        }
+    }
+
+    return wxEntry(argc, argv);
+}
+
+#endif // __WINDOWS__/!__WINDOWS__
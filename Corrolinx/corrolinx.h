@@ -12,8 +12,56 @@
 
 #include "wx/docview.h"
 
+class BatchProcessor;
 class MyCanvas;
 
+// ids of the menu commands specific to this application
+enum
+{
+    ID_DRAWING_CONVERT = wxID_HIGHEST + 1,
+    ID_DRAWING_CANCEL_LOAD,
+    ID_SURVEY_COLOURS_BANDS,
+    ID_SURVEY_COLOURS_CONTINUOUS,
+
+    // these ids must be in the same order as SurveyInterpolation elements
+    ID_SURVEY_INTERPOLATION_NONE,
+    ID_SURVEY_INTERPOLATION_BILINEAR,
+    ID_SURVEY_INTERPOLATION_BICUBIC,
+    ID_SURVEY_INTERPOLATION_IDW,
+
+    ID_SURVEY_SHOW_CONTOURS,
+    ID_SURVEY_EXPORT_CONTOURS,
+    ID_SURVEY_EXPORT_IMAGE,
+    ID_COMPARISON_ADD_SURVEY,
+    ID_COMPARISON_PREVIOUS,
+    ID_COMPARISON_NEXT,
+    ID_COMPARISON_READINGS,
+    ID_COMPARISON_SINCE_FIRST,
+    ID_COMPARISON_SINCE_PREVIOUS,
+    ID_COMPARISON_TREND,
+    ID_LOG_GO_TO_LINE,
+
+    // the commands of the benchmarks menus, see corrolinx_bench.h
+    ID_BENCHMARK_FIRST,
+    ID_DRAWING_MEASURE_FPS = ID_BENCHMARK_FIRST,
+    ID_DRAWING_MEASURE_UNDO,
+    ID_DRAWING_MEASURE_LATENCY,
+    ID_DRAWING_MEASURE_PACKING,
+    ID_DRAWING_MEASURE_SAVING,
+    ID_DRAWING_MEASURE_EDITING,
+    ID_DRAWING_MEASURE_LOADING,
+    ID_DRAWING_MEASURE_STORAGE,
+    ID_DRAWING_MEASURE_ALLOCATIONS,
+    ID_SURVEY_MEASURE_SPEED,
+    ID_SURVEY_MEASURE_SCALING,
+    ID_SURVEY_MEASURE_CONTOURS,
+    ID_SURVEY_MEASURE_STATISTICS,
+    ID_SURVEY_MEASURE_PARSING,
+    ID_SURVEY_MEASURE_EXPORT,
+    ID_COMPARISON_MEASURE_PAGING,
+    ID_BENCHMARK_LAST = ID_COMPARISON_MEASURE_PAGING
+};
+
 // Define a new application
 class MyApp : public wxApp
 {
@@ -28,18 +76,28 @@ public:
 //        Mode_Single // single document mode (and hence single top level window)
     };
 
+    // the kinds of documents shown in the child frames
+    enum ChildFrameKind
+    {
+        ChildFrame_Drawing,
+        ChildFrame_Text,
+        ChildFrame_Survey,
+        ChildFrame_Comparison,
+        ChildFrame_Log
+    };
+
     MyApp();
 
     // override some wxApp virtual methods
     virtual bool OnInit();
     virtual int OnExit();
 
-//    virtual void OnInitCmdLine(wxCmdLineParser& parser);
-//    virtual bool OnCmdLineParsed(wxCmdLineParser& parser);
+    virtual void OnInitCmdLine(wxCmdLineParser& parser);
+    virtual bool OnCmdLineParsed(wxCmdLineParser& parser);
 
     // our specific methods
     Mode GetMode() const { return m_mode; }
-    wxFrame *CreateChildFrame(wxView *view, bool isCanvas);
+    wxFrame *CreateChildFrame(wxView *view, ChildFrameKind kind);
 
     // these accessors should only be called in single document mode, otherwise
     // the pointers are NULL and an assert is triggered
@@ -55,6 +113,12 @@ private:
     // create the edit menu for drawing documents
     wxMenu *CreateDrawingEditMenu();
 
+    // create the edit menu for survey documents
+    wxMenu *CreateSurveyEditMenu();
+
+    // create the edit menu for survey comparison documents
+    wxMenu *CreateComparisonEditMenu();
+
     // create and associate with the given frame the menu bar containing the
     // given file and edit (possibly NULL) menus as well as the standard help
     // one
@@ -66,6 +130,11 @@ private:
     // application object itself
     void OnAbout(wxCommandEvent& event);
 
+    // run the benchmarks for the active view, the commands of their menus
+    // are handled here to keep the views free of them
+    void OnBenchmark(wxCommandEvent& event);
+    void OnUpdateBenchmark(wxUpdateUIEvent& event);
+
 
     // the currently used mode
     Mode m_mode;
@@ -74,10 +143,39 @@ private:
     MyCanvas *m_canvas;
     wxMenu *m_menuEdit;
 
+    // the files given on the command line to open
+    wxArrayString m_filesToOpen;
+
+    // true if the benchmarks menus should be shown
+    bool m_benchmarks;
+
     wxDECLARE_EVENT_TABLE();
     wxDECLARE_NO_COPY_CLASS(MyApp);
 };
 
 DECLARE_APP(MyApp)
 
+// The application used instead of MyApp when "--batch" is given on the command
+// line: it's a console application which never initializes the GUI, so that
+// the documents can be processed on the machines without any display
+class BatchApp : public wxAppConsole
+{
+public:
+    BatchApp();
+
+    // override some wxAppConsole virtual methods
+    virtual bool OnInit();
+    virtual int OnRun();
+    virtual int OnExit();
+
+    virtual void OnInitCmdLine(wxCmdLineParser& parser);
+    virtual bool OnCmdLineParsed(wxCmdLineParser& parser);
+
+private:
+    // processes the files given on the command line
+    BatchProcessor *m_batch;
+
+    wxDECLARE_NO_COPY_CLASS(BatchApp);
+};
+
 #endif // _CORROLINX_CORROLINX_H_
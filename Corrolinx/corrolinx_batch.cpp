@@ -0,0 +1,473 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_batch.cpp
+// Purpose:     Implements processing of documents without any windows
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "wx/ffile.h"
+#include "wx/filename.h"
+#include "wx/hashmap.h"
+
+#include "corrolinx_batch.h"
+#include "corrolinx_colormap.h"
+#include "corrolinx_interp.h"
+#include "corrolinx_workers.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+namespace
+{
+
+// the drawings are rendered at their natural size unless it's bigger than
+// this, in which case they're scaled down to fit
+const int MAX_DRAWING_IMAGE_SIZE = 4096;
+
+// the empty space around the drawing in its image
+const int DRAWING_IMAGE_MARGIN = 10;
+
+// the surveys are rendered with this many pixels per reading, interpolated
+// between them, as long as the image doesn't have more than the given number
+// of pixels
+const int SURVEY_IMAGE_FACTOR = 8;
+const size_t MAX_SURVEY_IMAGE_PIXELS = 16*1024*1024;
+
+// draw a black line into the RGB data of an image, ignoring its parts
+// outside of it
+void DrawImageLine(unsigned char *rgb, int width, int height,
+                   int x1, int y1, int x2, int y2)
+{
+    const int dx = abs(x2 - x1),
+              dy = -abs(y2 - y1);
+    const int sx = x1 < x2 ? 1 : -1,
+              sy = y1 < y2 ? 1 : -1;
+
+    // Bresenham's algorithm
+    int err = dx + dy;
+    for ( ;; )
+    {
+        if ( x1 >= 0 && x1 < width && y1 >= 0 && y1 < height )
+        {
+            unsigned char * const
+                p = rgb + 3*(static_cast<size_t>(y1)*width + x1);
+            p[0] =
+            p[1] =
+            p[2] = 0;
+        }
+
+        if ( x1 == x2 && y1 == y2 )
+            break;
+
+        const int e2 = 2*err;
+        if ( e2 >= dy )
+        {
+            err += dy;
+            x1 += sx;
+        }
+        if ( e2 <= dx )
+        {
+            err += dx;
+            y1 += sy;
+        }
+    }
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// BatchProcessor::FileTask: processes the files in the worker threads
+// ----------------------------------------------------------------------------
+
+class BatchProcessor::FileTask : public ParallelTask
+{
+public:
+    FileTask(const BatchProcessor& processor,
+             const wxArrayString& files,
+             const wxVector<wxClassInfo *>& classes)
+        : m_processor(processor),
+          m_files(files),
+          m_classes(classes),
+          m_results(files.size(), 0)
+    {
+    }
+
+    virtual void Process(size_t n)
+    {
+        m_results[n] = m_processor.ProcessFile(m_files[n], m_classes[n]);
+    }
+
+    size_t GetFailedCount() const
+    {
+        size_t count = 0;
+        for ( size_t n = 0; n < m_results.size(); n++ )
+        {
+            if ( !m_results[n] )
+                count++;
+        }
+
+        return count;
+    }
+
+private:
+    const BatchProcessor& m_processor;
+    const wxArrayString& m_files;
+    const wxVector<wxClassInfo *>& m_classes;
+
+    // the result of each file, not using bool to ensure that the threads
+    // never write to the same memory location
+    wxVector<int> m_results;
+
+    wxDECLARE_NO_COPY_CLASS(FileTask);
+};
+
+// ----------------------------------------------------------------------------
+// BatchProcessor implementation
+// ----------------------------------------------------------------------------
+
+BatchProcessor::BatchProcessor(const BatchOptions& options)
+    : m_options(options)
+{
+}
+
+bool BatchProcessor::Run()
+{
+    // wxDocManager is not thread-safe, so find the type of all files here
+    wxDocManager * const manager = wxDocManager::GetDocumentManager();
+
+    wxArrayString files;
+    wxVector<wxClassInfo *> classes;
+    size_t failed = 0;
+
+    // the inputs indexed by the common part of the paths of their outputs
+    wxStringToStringHashMap outputs;
+
+    for ( size_t n = 0; n < m_files.size(); n++ )
+    {
+        wxDocTemplate * const
+            templ = manager ? manager->FindTemplateForPath(m_files[n]) : NULL;
+        wxClassInfo * const docClass = templ ? templ->GetDocClassInfo()
+                                             : NULL;
+        if ( docClass != CLASSINFO(DrawingDocument) &&
+                docClass != CLASSINFO(SurveyDocument) )
+        {
+            wxLogError("Only drawings and surveys can be processed, "
+                       "skipping \"%s\".", m_files[n]);
+            failed++;
+            continue;
+        }
+
+        // the files with the same name in different directories would
+        // overwrite each other's outputs in the common output directory, as
+        // would the same file given twice
+        wxFileName input(m_files[n]);
+        input.MakeAbsolute();
+
+        wxString output = GetOutputPath(input, wxString(), wxString());
+        if ( !wxFileName::IsCaseSensitive() )
+            output = output.Lower();
+
+        wxStringToStringHashMap::const_iterator i = outputs.find(output);
+        if ( i != outputs.end() )
+        {
+            wxLogError("The output files of \"%s\" would overwrite those of "
+                       "\"%s\", skipping it.", m_files[n], i->second);
+            failed++;
+            continue;
+        }
+
+        outputs[output] = m_files[n];
+
+        files.push_back(m_files[n]);
+        classes.push_back(docClass);
+    }
+
+    if ( !m_options.outputDir.empty() &&
+            !wxFileName::DirExists(m_options.outputDir) &&
+                !wxFileName::Mkdir(m_options.outputDir,
+                                   wxS_DIR_DEFAULT,
+                                   wxPATH_MKDIR_FULL) )
+    {
+        wxLogError("Failed to create the output directory \"%s\".",
+                   m_options.outputDir);
+        return false;
+    }
+
+    FileTask task(*this, files, classes);
+    if ( m_options.jobs == -1 )
+    {
+        WorkerPool::Get().Run(task, files.size());
+    }
+    else
+    {
+        WorkerPool pool(m_options.jobs - 1);
+        pool.Run(task, files.size());
+    }
+
+    failed += task.GetFailedCount();
+
+    // the messages logged by the worker threads are only output when the
+    // main thread flushes them and we don't run the event loop which would
+    // normally do it
+    wxLog::FlushActive();
+
+    wxLogMessage("Processed %lu of %lu files successfully.",
+                 static_cast<unsigned long>(m_files.size() - failed),
+                 static_cast<unsigned long>(m_files.size()));
+
+    return failed == 0;
+}
+
+bool BatchProcessor::ProcessFile(const wxString& filename,
+                                 wxClassInfo *docClass) const
+{
+    wxFileName input(filename);
+    input.MakeAbsolute();
+
+    // the documents are loaded without any views, so DrawingDocument loads
+    // them synchronously and nothing is shown
+    if ( docClass == CLASSINFO(DrawingDocument) )
+    {
+        DrawingDocument doc;
+        return doc.OnOpenDocument(input.GetFullPath()) &&
+                    ProcessDrawing(doc, input);
+    }
+
+    SurveyDocument doc;
+    return doc.OnOpenDocument(input.GetFullPath()) &&
+                ProcessSurvey(doc, input);
+}
+
+bool BatchProcessor::ProcessDrawing(DrawingDocument& doc,
+                                    const wxFileName& input) const
+{
+    bool ok = true;
+
+    if ( m_options.convert )
+    {
+        const wxString output = GetConvertedPath(input);
+        if ( wxFileName(output).SameAs(input) )
+        {
+            wxLogError("Converting \"%s\" would overwrite it, use a "
+                       "different output directory.", input.GetFullPath());
+            ok = false;
+        }
+        else if ( !doc.SaveCopy(output, m_options.format) )
+        {
+            wxLogError("Failed to convert \"%s\".", input.GetFullPath());
+            ok = false;
+        }
+        else
+        {
+            wxLogVerbose("Converted \"%s\" to \"%s\".",
+                         input.GetFullPath(), output);
+        }
+    }
+
+    const wxRect bounds = doc.GetBounds();
+
+    if ( m_options.png )
+    {
+        const int size = wxMax(bounds.width, bounds.height);
+        const double scale = size > MAX_DRAWING_IMAGE_SIZE
+                                ? static_cast<double>(MAX_DRAWING_IMAGE_SIZE)/
+                                    size
+                                : 1.0;
+
+        const int width = static_cast<int>(bounds.width*scale) + 1 +
+                            2*DRAWING_IMAGE_MARGIN,
+                  height = static_cast<int>(bounds.height*scale) + 1 +
+                            2*DRAWING_IMAGE_MARGIN;
+
+        wxImage image(width, height, false);
+        unsigned char * const rgb = image.GetData();
+        memset(rgb, 0xff, static_cast<size_t>(width)*height*3);
+
+        const DoodleLines& lines = doc.GetLines();
+        for ( size_t n = 0; n < lines.size(); n++ )
+        {
+            const DoodleLine& line = lines[n];
+            DrawImageLine(rgb, width, height,
+                          DRAWING_IMAGE_MARGIN +
+                            static_cast<int>((line.x1 - bounds.x)*scale),
+                          DRAWING_IMAGE_MARGIN +
+                            static_cast<int>((line.y1 - bounds.y)*scale),
+                          DRAWING_IMAGE_MARGIN +
+                            static_cast<int>((line.x2 - bounds.x)*scale),
+                          DRAWING_IMAGE_MARGIN +
+                            static_cast<int>((line.y2 - bounds.y)*scale));
+        }
+
+        const wxString output = GetOutputPath(input, wxString(), "png");
+        if ( !image.SaveFile(output, wxBITMAP_TYPE_PNG) )
+        {
+            wxLogError("Failed to render \"%s\".", input.GetFullPath());
+            ok = false;
+        }
+    }
+
+    if ( m_options.stats )
+    {
+        wxString stats;
+        stats.Printf("Segments: %lu\n"
+                     "Lines: %lu\n"
+                     "Bounds: %d, %d, %d x %d\n",
+                     static_cast<unsigned long>(doc.GetSegments().size()),
+                     static_cast<unsigned long>(doc.GetLines().size()),
+                     bounds.x, bounds.y, bounds.width, bounds.height);
+
+        if ( !WriteStats(input, stats) )
+            ok = false;
+    }
+
+    return ok;
+}
+
+bool BatchProcessor::ProcessSurvey(SurveyDocument& doc,
+                                   const wxFileName& input) const
+{
+    bool ok = true;
+
+    const SurveyGrid& readings = doc.GetGrid();
+
+    if ( m_options.png && !readings.IsEmpty() )
+    {
+        // the files are already processed in parallel, so interpolate each
+        // one in the current thread only
+        WorkerPool sequential(0);
+
+        const int factor =
+            wxMax(1, wxMin(SURVEY_IMAGE_FACTOR,
+                           static_cast<int>(sqrt(
+                            static_cast<double>(MAX_SURVEY_IMAGE_PIXELS)/
+                                readings.GetCount()))));
+
+        SurveyGrid interpolated;
+        const SurveyGrid *grid = &readings;
+        if ( factor > 1 &&
+                InterpolateSurvey(readings, Interpolation_Bicubic, factor,
+                                  interpolated, sequential) )
+        {
+            grid = &interpolated;
+        }
+
+        const size_t width = grid->GetWidth();
+        wxImage image(width, grid->GetHeight(), false);
+
+        const SurveyColourMap colours;
+        unsigned char *rgb = image.GetData();
+        for ( size_t y = 0; y < grid->GetHeight(); y++, rgb += 3*width )
+            colours.Map(grid->GetRow(y), width, rgb);
+
+        const wxString output = GetOutputPath(input, wxString(), "png");
+        if ( !image.SaveFile(output, wxBITMAP_TYPE_PNG) )
+        {
+            wxLogError("Failed to render \"%s\".", input.GetFullPath());
+            ok = false;
+        }
+    }
+
+    if ( m_options.stats )
+    {
+        const SurveyStatistics& statistics = doc.GetStatistics();
+
+        wxString stats;
+        stats.Printf("Size: %lu x %lu\n"
+                     "Readings: %lu\n"
+                     "Missing: %lu\n",
+                     static_cast<unsigned long>(readings.GetWidth()),
+                     static_cast<unsigned long>(readings.GetHeight()),
+                     static_cast<unsigned long>(statistics.GetCount()),
+                     static_cast<unsigned long>(
+                        statistics.GetMissingCount()));
+
+        if ( statistics.GetCount() )
+        {
+            stats << wxString::Format("Minimum: %.1f\n"
+                                      "Maximum: %.1f\n"
+                                      "Mean: %.1f\n"
+                                      "Standard deviation: %.1f\n"
+                                      "Low risk: %.1f%%\n"
+                                      "Uncertain: %.1f%%\n"
+                                      "High risk: %.1f%%\n",
+                                      statistics.GetMin(),
+                                      statistics.GetMax(),
+                                      statistics.GetMean(),
+                                      statistics.GetStdDev(),
+                                      statistics.GetBandPercentage(
+                                        RiskBand_Low),
+                                      statistics.GetBandPercentage(
+                                        RiskBand_Uncertain),
+                                      statistics.GetBandPercentage(
+                                        RiskBand_High));
+        }
+
+        if ( !WriteStats(input, stats) )
+            ok = false;
+    }
+
+    return ok;
+}
+
+wxString BatchProcessor::GetConvertedPath(const wxFileName& input) const
+{
+    wxFileName output(input);
+    if ( !m_options.outputDir.empty() )
+    {
+        output.SetPath(m_options.outputDir);
+        output.MakeAbsolute();
+    }
+
+    output.SetExt("drw");
+
+    return output.GetFullPath();
+}
+
+wxString BatchProcessor::GetOutputPath(const wxFileName& input,
+                                       const wxString& suffix,
+                                       const wxString& ext) const
+{
+    wxFileName output(input);
+    if ( !m_options.outputDir.empty() )
+    {
+        output.SetPath(m_options.outputDir);
+        output.MakeAbsolute();
+    }
+
+    output.SetName(input.GetFullName() + suffix);
+    output.SetExt(ext);
+
+    return output.GetFullPath();
+}
+
+bool BatchProcessor::WriteStats(const wxFileName& input,
+                                const wxString& stats) const
+{
+    // use a suffix to avoid clashing with the text files among the inputs
+    const wxString output = GetOutputPath(input, "-stats", "txt");
+
+    wxFFile file(output, "w");
+    if ( !file.IsOpened() ||
+            !file.Write(stats, wxConvUTF8) ||
+                !file.Close() )
+    {
+        wxLogError("Failed to write statistics of \"%s\".",
+                   input.GetFullPath());
+        return false;
+    }
+
+    return true;
+}
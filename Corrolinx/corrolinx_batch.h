@@ -0,0 +1,106 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_batch.h
+// Purpose:     Processing of many documents without showing any windows
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_BATCH_H_
+#define _CORROLINX_CORROLINX_BATCH_H_
+
+#include "wx/arrstr.h"
+#include "wx/vector.h"
+
+#include "corrolinx_doc.h"
+
+class wxFileName;
+
+// The work to do for each file in the batch mode
+struct BatchOptions
+{
+    BatchOptions()
+        : convert(false),
+          format(DrawingFormat_Text),
+          png(false),
+          stats(false),
+          jobs(-1)
+    {
+    }
+
+    // convert the drawings to the given format
+    bool convert;
+    DrawingFileFormat format;
+
+    // render the documents to PNG images
+    bool png;
+
+    // write a summary of the contents of the documents to a text file
+    bool stats;
+
+    // the directory for the output files, they're created next to the input
+    // ones if it's empty
+    wxString outputDir;
+
+    // the number of files processed in parallel or -1 for one per processor
+    int jobs;
+};
+
+// ----------------------------------------------------------------------------
+// BatchProcessor: loads the documents and exports them without any GUI
+// ----------------------------------------------------------------------------
+
+// The documents are loaded by the same DrawingDocument and SurveyDocument
+// classes as in the GUI, but without any views, and several files are
+// processed at once, each one by a different thread of WorkerPool, so nothing
+// done for them can use any GUI functions, which is why the images are
+// rendered directly into wxImage instead of using wxDC.
+//
+// The errors are logged using wxLogError() and the processing continues with
+// the next file.
+class BatchProcessor
+{
+public:
+    explicit BatchProcessor(const BatchOptions& options);
+
+    void AddFile(const wxString& filename) { m_files.push_back(filename); }
+    bool HasFiles() const { return !m_files.empty(); }
+
+    // process all files and return true if there were no errors
+    //
+    // this must be called from the main thread once the document templates
+    // have been created, as they're used to find the type of the files
+    bool Run();
+
+private:
+    class FileTask;
+
+    // process a single file of the type given by the class of its document
+    bool ProcessFile(const wxString& filename, wxClassInfo *docClass) const;
+
+    bool ProcessDrawing(DrawingDocument& doc, const wxFileName& input) const;
+    bool ProcessSurvey(SurveyDocument& doc, const wxFileName& input) const;
+
+    // get the name of the converted drawing for the given input one, which
+    // only differs from it by its directory and extension
+    wxString GetConvertedPath(const wxFileName& input) const;
+
+    // get the name of the output file for the given input one, with the given
+    // suffix and extension added to its full name, e.g. "a.csv.png", so that
+    // the outputs of the drawings and surveys with the same name don't clash
+    wxString GetOutputPath(const wxFileName& input,
+                           const wxString& suffix,
+                           const wxString& ext) const;
+
+    // write the lines of the summary to the output file for the given input
+    bool WriteStats(const wxFileName& input, const wxString& stats) const;
+
+    const BatchOptions m_options;
+
+    wxArrayString m_files;
+
+    wxDECLARE_NO_COPY_CLASS(BatchProcessor);
+};
+
+#endif // _CORROLINX_CORROLINX_BATCH_H_
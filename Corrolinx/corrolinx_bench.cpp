@@ -0,0 +1,1898 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_bench.cpp
+// Purpose:     Implements the benchmarks of the documents and views
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "wx/stopwatch.h"
+#include "wx/filename.h"
+#include "wx/mstream.h"
+#include "wx/tokenzr.h"
+#include "wx/txtstrm.h"
+
+#if wxUSE_STD_IOSTREAM
+    #include "wx/ioswrap.h"
+    #include <fstream>
+#else
+    #include "wx/wfstream.h"
+#endif
+
+#include "corrolinx.h"
+#include "corrolinx_bench.h"
+#include "corrolinx_compare.h"
+#include "corrolinx_doc.h"
+#include "corrolinx_export.h"
+#include "corrolinx_heap.h"
+#include "corrolinx_mmap.h"
+#include "corrolinx_undo.h"
+#include "corrolinx_view.h"
+#include "corrolinx_workers.h"
+
+#include <math.h>
+
+// ----------------------------------------------------------------------------
+// Drawing benchmarks
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// the scratch drawings used by the benchmarks consist of random strokes of
+// this many lines starting inside a square of this size
+const int SCRATCH_SEGMENT_LINES = 10;
+const int SCRATCH_AREA_SIZE = 20000;
+
+// the file formats of the drawings compared by the benchmarks
+struct DrawingFormatInfo
+{
+    DrawingFileFormat format;
+    const char *name;
+};
+
+const DrawingFormatInfo DRAWING_FORMATS[] =
+{
+    { DrawingFormat_Text, "Text" },
+    { DrawingFormat_Binary, "Binary" },
+    { DrawingFormat_Packed, "Packed" },
+};
+
+// The generator of the pseudo-random numbers used by the benchmarks, which
+// always produces the same sequence to make their results reproducible
+class PseudoRandom
+{
+public:
+    PseudoRandom() : m_state(1) {}
+
+    // advance to the next number of the sequence and return it
+    wxUint32 Next()
+    {
+        m_state = m_state*1664525 + 1013904223;
+        return m_state;
+    }
+
+private:
+    wxUint32 m_state;
+};
+
+// append to lines a random stroke of the given number of short connected
+// lines starting inside a square of the given size
+void AddRandomStroke(int strokeLines,
+                     int areaSize,
+                     PseudoRandom& random,
+                     DoodleLines& lines)
+{
+    const wxUint32 start = random.Next();
+
+    wxPoint pt((start >> 4) % areaSize, (start >> 8) % areaSize);
+    for ( int i = 0; i < strokeLines; i++ )
+    {
+        const wxUint32 step = random.Next();
+
+        const int dx = static_cast<int>((step >> 24) % 7) - 3,
+                  dy = static_cast<int>((step >> 16) % 7) - 3;
+
+        const wxPoint next(pt.x + dx, pt.y + dy);
+        lines.push_back(DoodleLine(pt, next));
+        pt = next;
+    }
+}
+
+// return a segment with a random stroke as created by AddRandomStroke()
+DoodleSegment MakeRandomStroke(int strokeLines,
+                               int areaSize,
+                               PseudoRandom& random)
+{
+    DoodleLines lines;
+    lines.reserve(strokeLines);
+    AddRandomStroke(strokeLines, areaSize, random, lines);
+
+    DoodleSegment stroke;
+    stroke.AssignLines(&lines[0], lines.size());
+
+    return stroke;
+}
+
+// fill lines and offsets with the given number of random strokes of the
+// scratch drawings
+void MakeRandomStrokes(int segments,
+                       PseudoRandom& random,
+                       DoodleLines& lines,
+                       DoodleOffsets& offsets)
+{
+    lines.clear();
+    lines.reserve(segments*SCRATCH_SEGMENT_LINES);
+
+    offsets.clear();
+    offsets.reserve(segments + 1);
+    offsets.push_back(0);
+
+    for ( int n = 0; n < segments; n++ )
+    {
+        AddRandomStroke(SCRATCH_SEGMENT_LINES, SCRATCH_AREA_SIZE, random,
+                        lines);
+
+        offsets.push_back(lines.size());
+    }
+}
+
+// add the given number of random strokes to a scratch drawing
+void MakeScratchDrawing(DrawingDocument& doc,
+                        int segments,
+                        PseudoRandom& random)
+{
+    DoodleLines lines;
+    DoodleOffsets offsets;
+    MakeRandomStrokes(segments, random, lines, offsets);
+
+    doc.AddDoodleSegments(DoodleSegments(lines, offsets));
+}
+
+// read a drawing saved in the text format adding its lines and segments one
+// by one, as DrawingDocument::LoadObject() did before the lines were pooled
+void ReadSegmentsOneByOne(DocumentIstream& istream,
+                          wxVector<DoodleSegment>& segments)
+{
+#if wxUSE_STD_IOSTREAM
+    DocumentIstream& stream = istream;
+#else
+    wxTextInputStream stream(istream);
+#endif
+
+    wxInt32 count = 0;
+    stream >> count;
+    for ( wxInt32 n = 0; n < count; n++ )
+    {
+        wxInt32 lines = 0;
+        stream >> lines;
+
+        DoodleSegment segment;
+        for ( wxInt32 i = 0; i < lines; i++ )
+        {
+            DoodleLine line;
+            stream
+                >> line.x1
+                >> line.y1
+                >> line.x2
+                >> line.y2;
+            segment.AddLine(wxPoint(line.x1, line.y1),
+                            wxPoint(line.x2, line.y2));
+        }
+
+        segments.push_back(segment);
+    }
+}
+
+// read a drawing saved in the text format into the lines pool, as
+// DrawingDocument::LoadObject() does
+void ReadPooledSegments(DocumentIstream& istream,
+                        DoodleLines& lines,
+                        DoodleOffsets& offsets)
+{
+#if wxUSE_STD_IOSTREAM
+    DocumentIstream& stream = istream;
+#else
+    wxTextInputStream stream(istream);
+#endif
+
+    wxInt32 count = 0;
+    stream >> count;
+
+    offsets.reserve(count + 1);
+    offsets.push_back(0);
+    for ( wxInt32 n = 0; n < count; n++ )
+    {
+        DoodleSegment::LoadLines(istream, lines);
+        offsets.push_back(lines.size());
+    }
+}
+
+// format the change of the heap statistics between two moments for reports
+wxString FormatHeapChange(const HeapStats& before, const HeapStats& after)
+{
+    return wxString::Format("%ld blocks, %.0f KB, %ld allocations",
+                            static_cast<long>(after.blocks - before.blocks),
+                            (after.bytes - before.bytes)/1024.,
+                            static_cast<long>(after.allocations -
+                                                before.allocations));
+}
+
+// return the position moving back and forth between 0 and range - 1 after
+// the given number of steps
+int BounceInRange(int steps, int range)
+{
+    if ( range < 2 )
+        return 0;
+
+    const int pos = steps % (2*(range - 1));
+    return pos < range ? pos : 2*(range - 1) - pos;
+}
+
+// repaint the canvas synchronously n times calling the given function
+// before each repaint and return the number of frames per second
+double MeasureFrames(MyCanvas& canvas, int n, void (*step)(MyCanvas&, int))
+{
+    wxStopWatch sw;
+    for ( int i = 0; i < n; i++ )
+    {
+        step(canvas, i);
+        canvas.Update();
+    }
+
+    const long ms = sw.Time();
+    return ms ? n*1000./ms : 0;
+}
+
+void ScrollStep(MyCanvas& canvas, int n)
+{
+    // scroll back and forth across the whole virtual area
+    int xUnit, yUnit;
+    canvas.GetScrollPixelsPerUnit(&xUnit, &yUnit);
+
+    const wxSize range = canvas.GetVirtualSize() - canvas.GetClientSize();
+    const int steps = 10;
+    const int pos = n % (2*steps) < steps ? n % steps : steps - n % steps;
+
+    canvas.Scroll(xUnit ? range.x*pos/steps/xUnit : 0,
+                  yUnit ? range.y*pos/steps/yUnit : 0);
+}
+
+void ResizeStep(MyCanvas& canvas, int n)
+{
+    // alternately shrink and grow the frame containing us
+    wxWindow * const parent = canvas.GetParent();
+    const wxSize size = parent->GetSize();
+    const int delta = n % 2 ? 40 : -40;
+
+    parent->SetSize(size.x + delta, size.y + delta);
+    canvas.Refresh();
+}
+
+void ZoomStep(MyCanvas& canvas, int n)
+{
+    // zoom out to the entire drawing and back in while panning across it
+    const int steps = 10;
+    if ( n % (2*steps) < steps )
+        canvas.ZoomOut();
+    else
+        canvas.ZoomIn();
+
+    int xUnit, yUnit;
+    canvas.GetScrollPixelsPerUnit(&xUnit, &yUnit);
+
+    const wxPoint start = canvas.GetViewStart();
+    canvas.Scroll(start.x + (n % 2 ? 50 : -30)/wxMax(xUnit, 1),
+                  start.y + (n % 2 ? 30 : -50)/wxMax(yUnit, 1));
+}
+
+// scroll, resize and zoom the canvas as fast as possible, both with and
+// without the backing bitmap, and report the achieved frame rates
+void MeasureFrameRate(MyCanvas& canvas)
+{
+    static const int FRAMES = 100;
+
+    const bool useBacking = canvas.IsUsingBacking();
+    const double scale = canvas.GetScale();
+
+    double fps[2][3];
+    for ( int n = 0; n < 2; n++ )
+    {
+        canvas.UseBacking(n == 0);
+
+        const wxPoint viewStart = canvas.GetViewStart();
+        fps[n][0] = MeasureFrames(canvas, FRAMES, ScrollStep);
+        canvas.Scroll(viewStart);
+
+        const wxSize size = canvas.GetParent()->GetSize();
+        fps[n][1] = MeasureFrames(canvas, FRAMES, ResizeStep);
+        canvas.GetParent()->SetSize(size);
+
+        fps[n][2] = MeasureFrames(canvas, FRAMES, ZoomStep);
+        canvas.SetScale(scale);
+        canvas.Scroll(viewStart);
+    }
+
+    canvas.UseBacking(useBacking);
+
+    const DrawingDocument * const
+        doc = wxStaticCast(canvas.GetView()->GetDocument(), DrawingDocument);
+
+    wxLogMessage
+    (
+        "Frame rate for %d frames of %lu lines:\n"
+        "\n"
+        "Scrolling: %.1f fps with backing bitmap, %.1f fps without\n"
+        "Resizing: %.1f fps with backing bitmap, %.1f fps without\n"
+        "Zooming: %.1f fps with backing bitmap, %.1f fps without",
+        FRAMES,
+        static_cast<unsigned long>(doc->GetLines().size()),
+        fps[0][0], fps[1][0],
+        fps[0][1], fps[1][1],
+        fps[0][2], fps[1][2]
+    );
+}
+
+// draw a stroke with synthetic mouse events arriving at a high rate, as they
+// do from gaming mice and tablets, and report the time spent handling each of
+// them and the delay until it's shown on screen
+void MeasureStrokeLatency(MyCanvas& canvas)
+{
+    // one second of samples of a 1000Hz mouse, with the window repainted at
+    // 60Hz when the stroke buffer is used
+    static const int SAMPLES = 1000;
+    static const wxLongLong_t SAMPLE_INTERVAL = 1000;
+    static const wxLongLong_t FRAME_INTERVAL = 16667;
+
+    // draw a zigzag line across the window, moving a few pixels per sample
+    const wxSize size = canvas.GetClientSize();
+    wxVector<wxPoint> points(SAMPLES);
+    for ( int n = 0; n < SAMPLES; n++ )
+    {
+        points[n] = wxPoint(BounceInRange(3*n, size.x),
+                            BounceInRange(2*n, size.y));
+    }
+
+    // all times are in microseconds since the start of each measurement: the
+    // samples arrive every SAMPLE_INTERVAL, but are only handled after the
+    // previous ones if they take longer than this, and the delay is measured
+    // from their arrival until they're drawn
+    wxLongLong_t handling[2] = { 0, 0 };
+    wxLongLong_t delay[2] = { 0, 0 };
+
+    // first draw the stroke as it used to be done, directly on the window
+    // while handling each event, adding the lines to a growing segment
+    {
+        DoodleSegment segment;
+        wxPoint last = wxDefaultPosition;
+
+        wxStopWatch sw;
+        for ( int n = 0; n < SAMPLES; n++ )
+        {
+            const wxLongLong_t arrival = n*SAMPLE_INTERVAL;
+            while ( sw.TimeInMicro().GetValue() < arrival )
+                ;
+
+            const wxLongLong_t start = sw.TimeInMicro().GetValue();
+
+            wxClientDC dc(&canvas);
+            canvas.PrepareDC(dc);
+            dc.SetUserScale(canvas.GetScale(), canvas.GetScale());
+            dc.SetPen(*wxBLACK_PEN);
+
+            const wxPoint pt(dc.DeviceToLogicalX(points[n].x),
+                             dc.DeviceToLogicalY(points[n].y));
+            if ( last != wxDefaultPosition )
+            {
+                segment.AddLine(last, pt);
+                dc.DrawLine(last, pt);
+            }
+            last = pt;
+
+            const wxLongLong_t end = sw.TimeInMicro().GetValue();
+            handling[0] += end - start;
+            delay[0] += end - arrival;
+        }
+    }
+
+    canvas.RefreshDrawing();
+    canvas.Update();
+
+    // then send the same events to the canvas, repainting it whenever a
+    // frame is due
+    {
+        wxEvtHandler * const handler = canvas.GetEventHandler();
+
+        wxMouseEvent down(wxEVT_LEFT_DOWN);
+        down.SetEventObject(&canvas);
+        down.m_x = points[0].x;
+        down.m_y = points[0].y;
+        down.m_leftDown = true;
+        handler->ProcessEvent(down);
+
+        wxLongLong_t pendingArrivals = 0;
+        int pending = 0;
+
+        wxStopWatch sw;
+        wxLongLong_t lastFrame = 0;
+        for ( int n = 1; n <= SAMPLES; n++ )
+        {
+            if ( n < SAMPLES )
+            {
+                const wxLongLong_t arrival = n*SAMPLE_INTERVAL;
+                while ( sw.TimeInMicro().GetValue() < arrival )
+                    ;
+
+                wxMouseEvent motion(wxEVT_MOTION);
+                motion.SetEventObject(&canvas);
+                motion.m_x = points[n].x;
+                motion.m_y = points[n].y;
+                motion.m_leftDown = true;
+
+                const wxLongLong_t start = sw.TimeInMicro().GetValue();
+                handler->ProcessEvent(motion);
+                handling[1] += sw.TimeInMicro().GetValue() - start;
+
+                pendingArrivals += arrival;
+                pending++;
+            }
+
+            const wxLongLong_t now = sw.TimeInMicro().GetValue();
+            if ( n == SAMPLES || now - lastFrame >= FRAME_INTERVAL )
+            {
+                canvas.Update();
+
+                lastFrame = sw.TimeInMicro().GetValue();
+                delay[1] += pending*lastFrame - pendingArrivals;
+
+                pendingArrivals = 0;
+                pending = 0;
+            }
+        }
+
+        // the test stroke must not be added to the document
+        canvas.CancelStroke();
+    }
+
+    wxLogMessage
+    (
+        "Drawing a stroke of %d mouse events arriving every %d us:\n"
+        "\n"
+        "Drawing directly: %.1f us per event, shown after %.2f ms\n"
+        "Using stroke buffer: %.1f us per event, shown after %.2f ms\n"
+        "\n"
+        "The stroke buffer is drawn when repainting the window every %.1f ms, "
+        "the delay doesn't include the time taken by the display itself.",
+        SAMPLES, static_cast<int>(SAMPLE_INTERVAL),
+        static_cast<double>(handling[0])/SAMPLES,
+        static_cast<double>(delay[0])/SAMPLES/1000,
+        static_cast<double>(handling[1])/(SAMPLES - 1),
+        static_cast<double>(delay[1])/(SAMPLES - 1)/1000,
+        FRAME_INTERVAL/1000.
+    );
+}
+
+// measure the frame rate of a big scratch drawing shown like the given one
+void MeasureFrameRate(DrawingView *view)
+{
+    // measure the frame rate with a big scratch drawing shown in a new
+    // window, as this one may be too small to show anything, and close it
+    // when done
+    static const int SEGMENTS = 200000;
+
+    wxDocTemplate * const
+        docTemplate = view->GetDocument()->GetDocumentTemplate();
+    wxDocument * const doc = docTemplate->CreateDocument(wxString(),
+                                                         wxDOC_NEW);
+    if ( !doc )
+        return;
+
+    doc->SetDocumentName(docTemplate->GetDocumentName());
+    if ( !doc->OnNewDocument() )
+    {
+        doc->DeleteAllViews();
+        return;
+    }
+
+    {
+        wxBusyCursor wait;
+
+        PseudoRandom random;
+        MakeScratchDrawing(*wxStaticCast(doc, DrawingDocument), SEGMENTS,
+                           random);
+    }
+
+    MeasureFrameRate(*wxStaticCast(doc->GetFirstView(), DrawingView)->
+                        GetCanvas());
+
+    doc->Modify(false);
+    doc->DeleteAllViews();
+}
+
+// compare the size and speed of the packed drawing format with the lines
+void MeasurePacking(DrawingDocument *doc)
+{
+    // pack all segments of the document and unpack them again a few times
+    // and compare the space used by both forms
+    static const int RUNS = 5;
+
+    wxBusyCursor wait;
+
+    doc->Expand();
+    doc->PurgeDeletedSegments();
+
+    const DoodleSegments segments = doc->GetSegments();
+    const DoodleLines& lines = doc->GetLines();
+
+    DoodlePackedSegments packed;
+    wxStopWatch sw;
+    for ( int n = 0; n < RUNS; n++ )
+    {
+        packed.Clear();
+        for ( DoodleSegments::const_iterator i = segments.begin();
+              i != segments.end();
+              ++i )
+        {
+            packed.Add(*i);
+        }
+    }
+
+    const long packTime = sw.Time();
+
+    DoodleLines unpacked;
+    DoodleOffsets offsets;
+    sw.Start();
+    for ( int n = 0; n < RUNS; n++ )
+    {
+        unpacked.clear();
+        unpacked.reserve(lines.size());
+        offsets.clear();
+        offsets.push_back(0);
+
+        packed.Unpack(unpacked, offsets);
+    }
+
+    const long unpackTime = sw.Time();
+
+    const bool same = unpacked.size() == lines.size() &&
+                        (lines.empty() ||
+                            memcmp(&unpacked[0], &lines[0],
+                                   lines.size()*sizeof(DoodleLine)) == 0);
+
+    // the sizes of the binary and packed files and of the lines in memory,
+    // without the spatial index of the document which is also freed when
+    // it's compacted
+    const double binarySize = 40. + (segments.size() + 1)*sizeof(wxUint64) +
+                                lines.size()*sizeof(DoodleLine);
+    const double packedSize = 32. + packed.GetDataSize();
+    const double memorySize = lines.size()*sizeof(DoodleLine) +
+                                (segments.size() + 1)*sizeof(size_t);
+
+    // million lines per second, which is the same as lines per microsecond
+    const double linesDone = static_cast<double>(lines.size())*RUNS;
+
+    wxLogMessage
+    (
+        "Packing %lu segments with %lu lines %d times:\n"
+        "\n"
+        "Packing: %.1f million lines per second\n"
+        "Unpacking: %.1f million lines per second%s\n"
+        "\n"
+        "Binary file: %.0f KB, packed file: %.0f KB (%.1f times smaller)\n"
+        "Lines in memory: %.0f KB, packed: %.0f KB (%.1f times smaller)",
+        static_cast<unsigned long>(segments.size()),
+        static_cast<unsigned long>(lines.size()),
+        RUNS,
+        packTime ? linesDone/packTime/1000 : 0.,
+        unpackTime ? linesDone/unpackTime/1000 : 0.,
+        same ? "" : " (ERROR: the lines differ)",
+        binarySize/1024, packedSize/1024, binarySize/packedSize,
+        memorySize/1024, packed.GetDataSize()/1024.,
+        packed.GetDataSize() ? memorySize/packed.GetDataSize() : 0.
+    );
+}
+
+// measure how long saving the drawing blocks drawing in each format
+void MeasureSaving(DrawingDocument *doc)
+{
+    // save a scratch copy of the document in each format, first in the main
+    // thread, as it used to be done, and then in the background while
+    // drawing a stroke every millisecond, which is faster than anybody can
+    // draw, and undoing some of them, and compare how long the main thread is
+    // blocked in both cases
+    static const int STROKE_LINES = 50;
+    static const int EDIT_INTERVAL = 1;
+
+    wxBusyCursor wait;
+
+    doc->Expand();
+    doc->PurgeDeletedSegments();
+
+    DrawingDocument scratch;
+    scratch.AddDoodleSegments(doc->GetSegments());
+
+    const wxString filename = wxFileName::CreateTempFileName("corrolinx");
+    if ( filename.empty() )
+        return;
+
+    PseudoRandom random;
+
+    wxString report;
+    for ( size_t n = 0; n < WXSIZEOF(DRAWING_FORMATS); n++ )
+    {
+        const DrawingFormatInfo& format = DRAWING_FORMATS[n];
+
+        wxStopWatch sw;
+        if ( !scratch.SaveCopy(filename, format.format) )
+        {
+            wxLogError("Failed to save the drawing to \"%s\".", filename);
+            break;
+        }
+
+        const double saveTime = sw.TimeInMicro().ToDouble()/1000;
+        const double size = static_cast<double>(
+                                wxFileName::GetSize(filename).GetValue());
+
+        sw.Start();
+        scratch.StartSaving(filename, format.format);
+        const double startTime = sw.TimeInMicro().ToDouble()/1000;
+
+        // the first edit undoes the last segment in the snapshot, forcing the
+        // next one to copy the segments instead of appending to them
+        if ( scratch.GetSegmentCount() )
+            scratch.RemoveLastSegments(1);
+
+        int edits = 0;
+        wxLongLong_t longestEdit = 0;
+        while ( scratch.IsSaving() )
+        {
+            wxMilliSleep(EDIT_INTERVAL);
+
+            const wxLongLong_t start = sw.TimeInMicro().GetValue();
+            if ( edits % 4 == 3 )
+            {
+                scratch.RemoveLastSegments(1);
+            }
+            else
+            {
+                scratch.AddDoodleSegment(MakeRandomStroke(STROKE_LINES, 2000,
+                                                          random));
+            }
+
+            longestEdit = wxMax(longestEdit,
+                                sw.TimeInMicro().GetValue() - start);
+            edits++;
+        }
+
+        const bool ok = scratch.WaitForSaving();
+        const double totalTime = sw.TimeInMicro().ToDouble()/1000;
+        if ( !ok )
+            break;
+
+        report += wxString::Format
+                  (
+                    "%s: %.0f KB\n"
+                    "  in the main thread: blocked for %.1f ms, %.1f MB/s\n"
+                    "  in the background: blocked for %.3f ms to start, "
+                    "%.3f ms at most by %d edits, %.1f MB/s\n",
+                    format.name,
+                    size/1024,
+                    saveTime,
+                    saveTime > 0 ? size/1024/1024/saveTime*1000 : 0.,
+                    startTime,
+                    longestEdit/1000.,
+                    edits,
+                    totalTime > 0 ? size/1024/1024/totalTime*1000 : 0.
+                  );
+    }
+
+    wxRemoveFile(filename);
+
+    wxLogMessage
+    (
+        "Saving %lu segments with %lu lines:\n"
+        "\n"
+        "%s",
+        static_cast<unsigned long>(doc->GetSegmentCount()),
+        static_cast<unsigned long>(doc->GetLines().size()),
+        report
+    );
+}
+
+// measure deleting and moving segments in a big scratch drawing
+void MeasureEditing()
+{
+    // delete and move random segments of a big scratch drawing and undo and
+    // redo these changes, which only touches the segments being changed, and
+    // compare this with erasing the lines of a segment from the middle of
+    // the lines array, which moves all the lines after them
+    static const int SEGMENTS = 200000;
+    static const int EDITS = 2000;
+    static const int HIT_TESTS = 10000;
+    static const int ERASES = 20;
+
+    wxBusyCursor wait;
+
+    PseudoRandom random;
+
+    DrawingDocument doc;
+    MakeScratchDrawing(doc, SEGMENTS, random);
+
+    DrawingCommandProcessor processor;
+    processor.SetCoalesceInterval(0);
+
+    enum { Edit_Delete, Edit_Move, Edit_Undo, Edit_Redo, Edit_Max };
+    static const char * const names[] = { "Delete", "Move", "Undo", "Redo" };
+    wxCOMPILE_TIME_ASSERT( WXSIZEOF(names) == Edit_Max, EditNamesMismatch );
+
+    int counts[Edit_Max] = { 0 };
+    wxLongLong_t total[Edit_Max] = { 0 };
+    wxLongLong_t longest[Edit_Max] = { 0 };
+
+    wxStopWatch sw;
+    for ( int n = 0; n < EDITS; n++ )
+    {
+        const wxUint32 r = random.Next();
+
+        const int action = (r >> 16) % 100;
+        const int edit = action < 40 ? Edit_Delete
+                            : action < 70 ? Edit_Move
+                                : action < 85 ? Edit_Undo
+                                    : Edit_Redo;
+
+        // select a few random segments, as the user would do
+        DoodleSegmentIds ids;
+        if ( edit == Edit_Delete || edit == Edit_Move )
+        {
+            const size_t slots = doc.GetSegments().size();
+            for ( int count = 1 + r % 4; count > 0; count-- )
+            {
+                const size_t s = (random.Next() >> 4) % slots;
+                if ( doc.IsSegmentDeleted(s) )
+                    continue;
+
+                const DoodleSegmentId id = doc.GetSegmentId(s);
+
+                size_t i = 0;
+                while ( i < ids.size() && ids[i] != id )
+                    i++;
+
+                if ( i == ids.size() )
+                    ids.push_back(id);
+            }
+
+            if ( ids.empty() )
+                continue;
+        }
+
+        const wxLongLong_t start = sw.TimeInMicro().GetValue();
+        switch ( edit )
+        {
+            case Edit_Delete:
+                processor.Submit(new DrawingDeleteSegmentsCommand(&doc, ids));
+                break;
+
+            case Edit_Move:
+                processor.Submit(new DrawingMoveSegmentsCommand
+                                     (
+                                        &doc,
+                                        ids,
+                                        static_cast<int>(r % 201) - 100,
+                                        static_cast<int>(r % 167) - 83
+                                     ));
+                break;
+
+            case Edit_Undo:
+                processor.Undo();
+                break;
+
+            case Edit_Redo:
+                processor.Redo();
+                break;
+        }
+
+        const wxLongLong_t time = sw.TimeInMicro().GetValue() - start;
+        counts[edit]++;
+        total[edit] += time;
+        longest[edit] = wxMax(longest[edit], time);
+    }
+
+    int hits = 0;
+    sw.Start();
+    for ( int n = 0; n < HIT_TESTS; n++ )
+    {
+        const wxUint32 r = random.Next();
+
+        const wxPoint pt((r >> 4) % SCRATCH_AREA_SIZE,
+                         (r >> 8) % SCRATCH_AREA_SIZE);
+        if ( doc.HitTest(pt, 3) != wxNOT_FOUND )
+            hits++;
+    }
+
+    const double hitTime = sw.TimeInMicro().ToDouble()/HIT_TESTS;
+
+    // this doesn't even update the index, which would need to be rebuilt as
+    // the indices of all lines after the erased ones change
+    DoodleLines lines(doc.GetLines());
+    sw.Start();
+    for ( int n = 0; n < ERASES; n++ )
+    {
+        const size_t first =
+            (random.Next() >> 4) % (lines.size() - SCRATCH_SEGMENT_LINES);
+        lines.erase(lines.begin() + first,
+                    lines.begin() + first + SCRATCH_SEGMENT_LINES);
+    }
+
+    const double eraseTime = sw.TimeInMicro().ToDouble()/ERASES/1000;
+
+    wxString report;
+    for ( int n = 0; n < Edit_Max; n++ )
+    {
+        report += wxString::Format
+                  (
+                    "%s:\t%d times, %.3f ms on average, %.3f ms at most\n",
+                    names[n],
+                    counts[n],
+                    counts[n] ? total[n]/1000./counts[n] : 0.,
+                    longest[n]/1000.
+                  );
+    }
+
+    wxLogMessage
+    (
+        "Editing %d segments with %d lines each:\n"
+        "\n"
+        "%s"
+        "Hit testing: %.1f us per point, %d of %d points hit\n"
+        "\n"
+        "Erasing a segment from the middle of the lines: %.3f ms\n"
+        "\n"
+        "%lu segments left, %lu lines kept in memory",
+        SEGMENTS,
+        SCRATCH_SEGMENT_LINES,
+        report,
+        hitTime,
+        hits,
+        HIT_TESTS,
+        eraseTime,
+        static_cast<unsigned long>(doc.GetSegmentCount()),
+        static_cast<unsigned long>(doc.GetLines().size())
+    );
+}
+
+// compare opening a big scratch drawing saved in each format
+void MeasureLoading()
+{
+    // save a big scratch drawing in each format and open it again in another
+    // document, which parses the text with the stream operators but uses the
+    // binary formats directly from the memory mapped file; as the document
+    // has no views, even the text is loaded synchronously, as when converting
+    static const int SEGMENTS = 100000;
+
+    wxBusyCursor wait;
+
+    PseudoRandom random;
+
+    DrawingDocument scratch;
+    MakeScratchDrawing(scratch, SEGMENTS, random);
+
+    const wxString filename = wxFileName::CreateTempFileName("corrolinx");
+    if ( filename.empty() )
+        return;
+
+    wxString report;
+    for ( size_t n = 0; n < WXSIZEOF(DRAWING_FORMATS); n++ )
+    {
+        const DrawingFormatInfo& format = DRAWING_FORMATS[n];
+
+        if ( !scratch.SaveCopy(filename, format.format) )
+        {
+            wxLogError("Failed to save the drawing to \"%s\".", filename);
+            break;
+        }
+
+        const double size = static_cast<double>(
+                                wxFileName::GetSize(filename).GetValue());
+
+        DrawingDocument loaded;
+
+        wxStopWatch sw;
+        const bool ok = loaded.OnOpenDocument(filename);
+        const double time = sw.TimeInMicro().ToDouble()/1000;
+        if ( !ok )
+            break;
+
+        const bool same =
+            loaded.GetSegmentCount() == scratch.GetSegmentCount() &&
+                loaded.GetLines().size() == scratch.GetLines().size();
+
+        report += wxString::Format
+                  (
+                    "%s: %.0f KB in %.1f ms, %.1f MB/s, %.2f M lines/s%s\n",
+                    format.name,
+                    size/1024,
+                    time,
+                    time > 0 ? size/1024/1024/time*1000 : 0.,
+                    time > 0 ? SEGMENTS*SCRATCH_SEGMENT_LINES/time/1000 : 0.,
+                    same ? "" : " (ERROR: the lines differ)"
+                  );
+    }
+
+    wxRemoveFile(filename);
+
+    wxLogMessage
+    (
+        "Loading %d segments with %d lines each:\n"
+        "\n"
+        "%s",
+        SEGMENTS,
+        SCRATCH_SEGMENT_LINES,
+        report
+    );
+}
+
+// compare the pooled lines with one lines array per segment
+void MeasureStorage()
+{
+    // store the same big scratch drawing with the lines of all segments
+    // pooled in a single array, as DrawingDocument does, and with one lines
+    // array per segment, as it used to do, and compare the heap blocks they
+    // use and the time needed to visit all lines in the order of OnDraw()
+    static const int SEGMENTS = 100000;
+    static const int TRAVERSALS = 20;
+
+    wxBusyCursor wait;
+
+    PseudoRandom random;
+
+    HeapStats start;
+    const bool hasStats = GetHeapStats(start);
+
+    DoodleLines lines;
+    DoodleOffsets offsets;
+    MakeRandomStrokes(SEGMENTS, random, lines, offsets);
+
+    HeapStats pooledStats;
+    GetHeapStats(pooledStats);
+
+    // the segments are read line by line and then copied into the array, as
+    // the old LoadObject() did
+    wxVector<DoodleSegment> segments;
+    for ( size_t s = 0; s + 1 < offsets.size(); s++ )
+    {
+        DoodleSegment segment;
+        for ( size_t n = offsets[s]; n < offsets[s + 1]; n++ )
+        {
+            const DoodleLine& line = lines[n];
+            segment.AddLine(wxPoint(line.x1, line.y1),
+                            wxPoint(line.x2, line.y2));
+        }
+
+        segments.push_back(segment);
+    }
+
+    HeapStats separateStats;
+    GetHeapStats(separateStats);
+
+    // sum the coordinates to make sure the loops are not optimized away and
+    // visit the same lines
+    wxUint32 pooledSum = 0;
+    wxStopWatch sw;
+    for ( int n = 0; n < TRAVERSALS; n++ )
+    {
+        for ( size_t s = 0; s + 1 < offsets.size(); s++ )
+        {
+            for ( size_t i = offsets[s]; i < offsets[s + 1]; i++ )
+            {
+                const DoodleLine& line = lines[i];
+                pooledSum += line.x1 + line.y1 + line.x2 + line.y2;
+            }
+        }
+    }
+
+    const double pooledTime = sw.TimeInMicro().ToDouble()/TRAVERSALS/1000;
+
+    wxUint32 separateSum = 0;
+    sw.Start();
+    for ( int n = 0; n < TRAVERSALS; n++ )
+    {
+        for ( wxVector<DoodleSegment>::const_iterator s = segments.begin();
+              s != segments.end();
+              ++s )
+        {
+            const DoodleLines& segmentLines = s->GetLines();
+            for ( DoodleLines::const_iterator i = segmentLines.begin();
+                  i != segmentLines.end();
+                  ++i )
+            {
+                const DoodleLine& line = *i;
+                separateSum += line.x1 + line.y1 + line.x2 + line.y2;
+            }
+        }
+    }
+
+    const double separateTime = sw.TimeInMicro().ToDouble()/TRAVERSALS/1000;
+
+    wxLogMessage
+    (
+        "Storing %d segments with %d lines each:\n"
+        "\n"
+        "Pooled lines:\t%s, visited in %.2f ms\n"
+        "Lines per segment:\t%s, visited in %.2f ms%s",
+        SEGMENTS,
+        SCRATCH_SEGMENT_LINES,
+        hasStats ? FormatHeapChange(start, pooledStats)
+                 : wxString("heap use unknown"),
+        pooledTime,
+        hasStats ? FormatHeapChange(pooledStats, separateStats)
+                 : wxString("heap use unknown"),
+        separateTime,
+        pooledSum == separateSum ? "" : "\n\nERROR: the lines differ"
+    );
+}
+
+// count the allocations done by loading and drawing strokes
+void MeasureAllocations()
+{
+    // count the allocations done by reading a big scratch drawing saved in
+    // the text format one segment at a time, as it used to be done, and into
+    // the lines pool reserved from the stored counts, and by drawing strokes
+    // and undoing and redoing them, which moves their lines instead of
+    // copying them
+    static const int SEGMENTS = 100000;
+    static const int STROKES = 1000;
+    static const int STROKE_LINES = 50;
+
+    wxBusyCursor wait;
+
+    HeapStats stats;
+    if ( !GetHeapStats(stats) )
+    {
+        wxLogError("Counting allocations is only supported by the benchmark "
+                   "builds.");
+        return;
+    }
+
+    PseudoRandom random;
+
+    const wxString filename = wxFileName::CreateTempFileName("corrolinx");
+    if ( filename.empty() )
+        return;
+
+    {
+        DrawingDocument scratch;
+        MakeScratchDrawing(scratch, SEGMENTS, random);
+
+        if ( !scratch.SaveCopy(filename, DrawingFormat_Text) )
+        {
+            wxLogError("Failed to save the drawing to \"%s\".", filename);
+            wxRemoveFile(filename);
+            return;
+        }
+    }
+
+    HeapStats separateStart,
+              separateEnd;
+    double separateTime;
+    {
+#if wxUSE_STD_IOSTREAM
+        wxSTD ifstream store(filename.mb_str(), wxSTD ios::binary);
+#else
+        wxFileInputStream store(filename);
+#endif
+
+        wxVector<DoodleSegment> segments;
+
+        GetHeapStats(separateStart);
+        wxStopWatch sw;
+        ReadSegmentsOneByOne(store, segments);
+        separateTime = sw.TimeInMicro().ToDouble()/1000;
+        GetHeapStats(separateEnd);
+    }
+
+    HeapStats pooledStart,
+              pooledEnd;
+    double pooledTime;
+    {
+#if wxUSE_STD_IOSTREAM
+        wxSTD ifstream store(filename.mb_str(), wxSTD ios::binary);
+#else
+        wxFileInputStream store(filename);
+#endif
+
+        DoodleLines lines;
+        DoodleOffsets offsets;
+
+        GetHeapStats(pooledStart);
+        wxStopWatch sw;
+        ReadPooledSegments(store, lines, offsets);
+        pooledTime = sw.TimeInMicro().ToDouble()/1000;
+        GetHeapStats(pooledEnd);
+    }
+
+    wxRemoveFile(filename);
+
+    // the strokes are created before counting, as MyCanvas collects them
+    wxVector<DoodleSegment> strokes(STROKES);
+    for ( int n = 0; n < STROKES; n++ )
+        strokes[n] = MakeRandomStroke(STROKE_LINES, SCRATCH_AREA_SIZE, random);
+
+    DrawingDocument doc;
+    DrawingCommandProcessor processor;
+    processor.SetCoalesceInterval(0);
+
+    HeapStats commandStats[4];
+    GetHeapStats(commandStats[0]);
+    for ( int n = 0; n < STROKES; n++ )
+        processor.Submit(new DrawingAddSegmentCommand(&doc, &strokes[n]));
+
+    GetHeapStats(commandStats[1]);
+    for ( int n = 0; n < STROKES; n++ )
+        processor.Undo();
+
+    GetHeapStats(commandStats[2]);
+    for ( int n = 0; n < STROKES; n++ )
+        processor.Redo();
+
+    GetHeapStats(commandStats[3]);
+
+    wxLogMessage
+    (
+        "Reading %d segments with %d lines each:\n"
+        "\n"
+        "One by one:\t%s, %.1f ms\n"
+        "Into the pool:\t%s, %.1f ms\n"
+        "\n"
+        "Allocations per stroke of %d lines:\n"
+        "\n"
+        "Adding:\t%.1f\n"
+        "Undoing:\t%.1f\n"
+        "Redoing:\t%.1f",
+        SEGMENTS,
+        SCRATCH_SEGMENT_LINES,
+        FormatHeapChange(separateStart, separateEnd),
+        separateTime,
+        FormatHeapChange(pooledStart, pooledEnd),
+        pooledTime,
+        STROKE_LINES,
+        static_cast<double>(commandStats[1].allocations -
+                                commandStats[0].allocations)/STROKES,
+        static_cast<double>(commandStats[2].allocations -
+                                commandStats[1].allocations)/STROKES,
+        static_cast<double>(commandStats[3].allocations -
+                                commandStats[2].allocations)/STROKES
+    );
+}
+
+// check the memory used by the undo history in a long editing session
+void MeasureUndo()
+{
+    // simulate a long editing session, adding and removing segments and
+    // undoing and redoing the changes, on a scratch document which is not
+    // shown anywhere, with a small budget and without merging the commands,
+    // to check that the memory used by the undo history doesn't keep growing
+    //
+    // the document itself is kept from growing too, so that all the memory
+    // allocated since the start can be checked: after the first report, when
+    // the history is already full, it may only grow by a small amount, as
+    // the document keeps 4 bytes for each segment id ever given
+    static const int COMMANDS = 200000;
+    static const int REPORTS = 8;
+    static const size_t BUDGET = 4*1024*1024;
+    static const size_t MAX_SEGMENTS = 2000;
+    static const wxInt64 MAX_GROWTH = BUDGET/4;
+
+    wxBusyCursor wait;
+
+    HeapStats start;
+    const bool hasStats = GetHeapStats(start);
+
+    DrawingDocument doc;
+    DrawingCommandProcessor processor;
+    processor.SetMemoryBudget(BUDGET);
+    processor.SetCoalesceInterval(0);
+
+    PseudoRandom random;
+
+    wxString report;
+    size_t peak = 0;
+    wxInt64 firstHeap = 0,
+            lastHeap = 0,
+            peakHeap = 0;
+    wxStopWatch sw;
+    for ( int n = 1; n <= COMMANDS; n++ )
+    {
+        const wxUint32 r = random.Next();
+
+        const int action = (r >> 16) % 100;
+        if ( action < 50 && doc.GetSegmentCount() < MAX_SEGMENTS )
+        {
+            // a stroke of a few dozen short connected lines
+            DoodleSegment segment = MakeRandomStroke(20 + r % 60, 2000,
+                                                     random);
+
+            processor.Submit(new DrawingAddSegmentCommand(&doc, &segment));
+        }
+        else if ( action < 85 )
+        {
+            processor.Submit(new DrawingRemoveSegmentCommand(&doc));
+        }
+        else if ( action < 95 )
+        {
+            processor.Undo();
+        }
+        else
+        {
+            processor.Redo();
+        }
+
+        peak = wxMax(peak, processor.GetMemoryUsage());
+
+        if ( n % (COMMANDS/REPORTS) == 0 )
+        {
+            HeapStats stats;
+            GetHeapStats(stats);
+            lastHeap = stats.bytes - start.bytes;
+            peakHeap = wxMax(peakHeap, lastHeap);
+            if ( n == COMMANDS/REPORTS )
+                firstHeap = lastHeap;
+
+            report += wxString::Format
+                      (
+                        "After %d changes:\t%lu KB in %lu commands, "
+                        "%.0f KB in total\n",
+                        n,
+                        static_cast<unsigned long>(
+                            processor.GetMemoryUsage()/1024),
+                        static_cast<unsigned long>(
+                            processor.GetCommands().GetCount()),
+                        lastHeap/1024.
+                      );
+        }
+    }
+
+    const long time = sw.Time();
+
+    if ( !hasStats )
+    {
+        wxLogWarning("The total memory use is only known in the benchmark "
+                     "builds, only the undo history is checked.");
+    }
+    else if ( lastHeap - firstHeap > MAX_GROWTH )
+    {
+        wxLogError("The memory used by the document and its undo history "
+                   "grew by %.0f KB after the first %d changes.",
+                   (lastHeap - firstHeap)/1024.,
+                   COMMANDS/REPORTS);
+    }
+
+    wxLogMessage("Undo history memory use with %lu KB budget:\n"
+                 "\n"
+                 "%s"
+                 "\n"
+                 "Peak:\t%lu KB, %.0f KB in total\n"
+                 "Time:\t%ld ms",
+                 static_cast<unsigned long>(BUDGET/1024),
+                 report,
+                 static_cast<unsigned long>(peak/1024),
+                 peakHeap/1024.,
+                 time);
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// Survey benchmarks
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// the interpolated grid used for measuring the interpolation speed has about
+// as many values as the biggest one shown by SurveyView
+const size_t MAX_INTERPOLATED = 16*1024*1024;
+
+// the size of A0 paper, in mm, on which the surveys are exported
+const char * const EXPORT_PAPER_NAME = "A0";
+const double EXPORT_PAPER_WIDTH = 841;
+const double EXPORT_PAPER_HEIGHT = 1189;
+
+// parse the survey readings token by token using wxTextInputStream, as the
+// text files used to be read, to compare its speed with that of
+// SurveyDocument::ParseCSV(), and return their number
+size_t ParseCSVWithStreams(const char *data, size_t size)
+{
+    wxMemoryInputStream istream(data, size);
+    wxTextInputStream stream(istream);
+
+    wxVector<float> values;
+    for ( ;; )
+    {
+        const wxString line = stream.ReadLine();
+        if ( line.empty() )
+        {
+            if ( istream.Eof() )
+                break;
+            continue;
+        }
+
+        if ( line[0] == '#' )
+            continue;
+
+        wxStringTokenizer tokens(line, ",;\t", wxTOKEN_RET_EMPTY_ALL);
+        while ( tokens.HasMoreTokens() )
+        {
+            wxString field = tokens.GetNextToken();
+            field.Trim().Trim(false);
+
+            double value = SurveyGrid::GetMissingValue();
+            if ( !field.empty() && !field.ToCDouble(&value) )
+                break;
+
+            values.push_back(value);
+        }
+    }
+
+    return values.size();
+}
+
+// measure how fast the readings are converted to colours
+void MeasureSpeed(SurveyView *view)
+{
+    const SurveyGrid& grid = view->GetDocument()->GetGrid();
+    if ( grid.IsEmpty() )
+        return;
+
+    const SurveyColourMap& colourMap = view->GetColourMap();
+
+    // convert the entire grid as many times as needed to run for at least
+    // half a second with both implementations
+    static const long MIN_DURATION = 500;
+
+    wxBusyCursor wait;
+
+    const size_t width = grid.GetWidth();
+    wxVector<unsigned char> rgb(3*width);
+
+    double speed[2];
+    for ( int n = 0; n < 2; n++ )
+    {
+        size_t pixels = 0;
+        wxStopWatch sw;
+        do
+        {
+            for ( size_t y = 0; y < grid.GetHeight(); y++ )
+            {
+                if ( n == 0 )
+                    colourMap.Map(grid.GetRow(y), width, &rgb[0]);
+                else
+                    colourMap.MapPortable(grid.GetRow(y), width, &rgb[0]);
+            }
+
+            pixels += grid.GetCount();
+        }
+        while ( sw.Time() < MIN_DURATION );
+
+        speed[n] = pixels/(sw.Time()*1000.);
+    }
+
+    wxLogMessage("Colour mapping speed, in megapixels per second:\n"
+                 "\n"
+                 "Optimized (%s):\t%.1f\n"
+                 "Portable:\t%.1f",
+                 SurveyColourMap::HasSIMD() ? "SIMD" : "no SIMD",
+                 speed[0], speed[1]);
+}
+
+// compare the interpolation speed using one and all threads
+void MeasureScaling(SurveyView *view)
+{
+    const SurveyGrid& readings = view->GetDocument()->GetGrid();
+    if ( readings.IsEmpty() )
+        return;
+
+    const SurveyInterpolation method =
+        view->GetInterpolation() == Interpolation_None
+            ? Interpolation_Bicubic
+            : view->GetInterpolation();
+
+    // interpolate to a grid of about MAX_INTERPOLATED values
+    const int factor = wxMax(1, static_cast<int>(
+                        sqrt(static_cast<double>(MAX_INTERPOLATED)/
+                                readings.GetCount())));
+
+    wxBusyCursor wait;
+
+    WorkerPool& pool = WorkerPool::Get();
+    WorkerPool single(0);
+
+    SurveyGrid output;
+    long times[2];
+    for ( int n = 0; n < 2; n++ )
+    {
+        wxStopWatch sw;
+        if ( !InterpolateSurvey(readings, method, factor, output,
+                                n == 0 ? single : pool) )
+        {
+            wxLogError("The survey is too big to be interpolated.");
+            return;
+        }
+
+        times[n] = wxMax(sw.Time(), 1L);
+    }
+
+    wxLogMessage("Interpolation of %lu values:\n"
+                 "\n"
+                 "1 thread:\t%ldms\n"
+                 "%d threads:\t%ldms\n"
+                 "Speedup:\t%.2f",
+                 static_cast<unsigned long>(output.GetCount()),
+                 times[0],
+                 pool.GetConcurrency(), times[1],
+                 static_cast<double>(times[0])/times[1]);
+}
+
+// compare the contouring speed using one and all threads
+void MeasureContours(SurveyDocument *doc)
+{
+    const SurveyGrid& readings = doc->GetGrid();
+    if ( readings.IsEmpty() )
+        return;
+
+    wxBusyCursor wait;
+
+    WorkerPool& pool = WorkerPool::Get();
+    WorkerPool single(0);
+
+    SurveyContours contours;
+    long times[2];
+    for ( int n = 0; n < 2; n++ )
+    {
+        wxStopWatch sw;
+        contours.Compute(readings, n == 0 ? single : pool);
+        times[n] = wxMax(sw.Time(), 1L);
+    }
+
+    // retracing the contours near a single reading, as after editing it
+    wxStopWatch sw;
+    contours.Update(readings,
+                    wxRect(readings.GetWidth()/2, readings.GetHeight()/2,
+                           1, 1),
+                    pool);
+    const long timeUpdate = sw.Time();
+
+    const DoodleSegments segments = contours.GetSegments();
+    wxLogMessage("Contours at %lu levels: %lu contours with %lu lines\n"
+                 "\n"
+                 "1 thread:\t%ldms\n"
+                 "%d threads:\t%ldms\n"
+                 "Speedup:\t%.2f\n"
+                 "Update after editing one reading:\t%ldms",
+                 static_cast<unsigned long>(contours.GetLevels().size()),
+                 static_cast<unsigned long>(segments.size()),
+                 static_cast<unsigned long>(contours.GetLines().size()),
+                 times[0],
+                 pool.GetConcurrency(), times[1],
+                 static_cast<double>(times[0])/times[1],
+                 timeUpdate);
+}
+
+// measure how fast the reading statistics are computed
+void MeasureStatistics(SurveyDocument *doc)
+{
+    const SurveyGrid& grid = doc->GetGrid();
+    if ( grid.IsEmpty() )
+        return;
+
+    // process the entire grid as many times as needed to use at least 10
+    // million readings and run for at least half a second with both
+    // implementations
+    static const size_t MIN_READINGS = 10*1000*1000;
+    static const long MIN_DURATION = 500;
+
+    wxBusyCursor wait;
+
+    double speed[2];
+    for ( int n = 0; n < 2; n++ )
+    {
+        size_t readings = 0;
+        wxStopWatch sw;
+        do
+        {
+            SurveyStatistics stats;
+            for ( size_t y = 0; y < grid.GetHeight(); y++ )
+            {
+                if ( n == 0 )
+                    stats.Add(grid.GetRow(y), grid.GetWidth());
+                else
+                    stats.AddPortable(grid.GetRow(y), grid.GetWidth());
+            }
+
+            readings += grid.GetCount();
+        }
+        while ( readings < MIN_READINGS || sw.Time() < MIN_DURATION );
+
+        speed[n] = readings/(wxMax(sw.Time(), 1L)*1000.);
+    }
+
+    wxLogMessage("Statistics speed, in millions of readings per second:\n"
+                 "\n"
+                 "Optimized (%s):\t%.1f\n"
+                 "Portable:\t%.1f",
+                 SurveyStatistics::HasSIMD() ? "SIMD" : "no SIMD",
+                 speed[0], speed[1]);
+}
+
+// compare the survey file parser with the text streams
+void MeasureParsing(SurveyDocument *doc)
+{
+    const wxString filename = doc->GetFilename();
+    if ( filename.empty() || !wxFileName::FileExists(filename) )
+    {
+        wxLogError("The survey must be saved to measure how fast it's read.");
+        return;
+    }
+
+    MappedFile file;
+    if ( !file.Open(filename) )
+        return;
+
+    // parse the file as many times as needed to run for at least half a
+    // second with both implementations
+    static const long MIN_DURATION = 500;
+
+    wxBusyCursor wait;
+
+    double speed[2];
+    size_t readings[2];
+    for ( int n = 0; n < 2; n++ )
+    {
+        double bytes = 0;
+        wxStopWatch sw;
+        do
+        {
+            if ( n == 0 )
+            {
+                SurveyGrid grid;
+                SurveyStatistics stats;
+                if ( !SurveyDocument::ParseCSV(file.GetData(), file.GetSize(),
+                                               grid, stats) )
+                    return;
+
+                readings[n] = grid.GetCount();
+            }
+            else
+            {
+                readings[n] = ParseCSVWithStreams(file.GetData(),
+                                                  file.GetSize());
+            }
+
+            bytes += file.GetSize();
+        }
+        while ( sw.Time() < MIN_DURATION );
+
+        speed[n] = bytes/(wxMax(sw.Time(), 1L)*1000.);
+    }
+
+#ifdef CORROLINX_USE_SSE2
+    const char * const simd = "SSE2";
+#else
+    const char * const simd = "no SIMD";
+#endif
+
+    wxLogMessage("Survey parsing speed, in megabytes per second:\n"
+                 "\n"
+                 "Memory mapped (%s):\t%.1f\n"
+                 "Text stream:\t%.1f\n"
+                 "Speedup:\t%.2f\n"
+                 "\n"
+                 "Readings found:\t%lu and %lu",
+                 simd,
+                 speed[0], speed[1], speed[0]/wxMax(speed[1], 0.001),
+                 static_cast<unsigned long>(readings[0]),
+                 static_cast<unsigned long>(readings[1]));
+}
+
+// measure how fast the posters of the survey are exported
+void MeasureExport(SurveyView *view)
+{
+    // export the survey on A0 paper at the usual print resolutions in both
+    // formats using all threads, and the smallest image using just one of
+    // them to compare with
+    struct ExportRun
+    {
+        int dpi;
+        SurveyImageFormat format;
+        bool parallel;
+    };
+
+    static const ExportRun runs[] =
+    {
+        { 300, SurveyImage_PNG, false },
+        { 300, SurveyImage_PNG, true },
+        { 300, SurveyImage_TIFF, true },
+        { 600, SurveyImage_PNG, true },
+        { 600, SurveyImage_TIFF, true },
+    };
+
+    const SurveyGrid& readings = view->GetDocument()->GetGrid();
+    if ( readings.IsEmpty() )
+        return;
+
+    const wxString filename = wxFileName::CreateTempFileName("corrolinx");
+    if ( filename.empty() )
+        return;
+
+    wxBusyCursor wait;
+
+    WorkerPool& pool = WorkerPool::Get();
+    WorkerPool single(0);
+
+    wxString report;
+    long times[WXSIZEOF(runs)];
+    for ( size_t n = 0; n < WXSIZEOF(runs); n++ )
+    {
+        const ExportRun& run = runs[n];
+        const wxSize size = GetSurveyImageSize(readings,
+                                               EXPORT_PAPER_WIDTH,
+                                               EXPORT_PAPER_HEIGHT,
+                                               run.dpi);
+
+        WorkerPool& threads = run.parallel ? pool : single;
+
+        size_t peakMemory = 0;
+        wxStopWatch sw;
+        if ( !ExportSurveyImage(view->GetDisplayedGrid(),
+                                view->GetColourMap(),
+                                size,
+                                run.dpi, run.format, filename, threads,
+                                &peakMemory) )
+            return;
+
+        times[n] = wxMax(sw.Time(), 1L);
+
+        const double
+            fileSize = static_cast<double>(
+                        wxFileName::GetSize(filename).GetValue()),
+            pixels = static_cast<double>(size.x)*size.y;
+
+        report += wxString::Format
+                  (
+                    "%s %d DPI, %s, %d thread(s): %d*%d\n"
+                    "  %ldms, %.1f Mpixels/s, %.1f MB file, "
+                    "%.1f MB peak memory\n",
+                    EXPORT_PAPER_NAME,
+                    run.dpi,
+                    run.format == SurveyImage_PNG ? "PNG" : "TIFF",
+                    threads.GetConcurrency(),
+                    size.x, size.y,
+                    times[n],
+                    pixels/times[n]/1000,
+                    fileSize/1024/1024,
+                    peakMemory/1024./1024
+                  );
+    }
+
+    wxRemoveFile(filename);
+
+    wxLogMessage("Exporting the survey as A0 posters:\n"
+                 "\n"
+                 "%s"
+                 "\n"
+                 "Speedup:\t%.2f",
+                 report,
+                 static_cast<double>(times[0])/times[1]);
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// Comparison benchmarks
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// page through all surveys twice and compare the times
+void MeasurePaging(ComparisonView *view)
+{
+    ComparisonDocument * const doc = view->GetDocument();
+    const size_t count = doc->GetSurveyCount();
+    if ( !count || view->GetMode() == Comparison_Trend )
+        return;
+
+    wxBusyCursor wait;
+
+    // page through all surveys twice, the second time everything shown
+    // should be already cached
+    const size_t survey = view->GetSurvey();
+    long times[2];
+    unsigned long misses[2];
+    for ( int pass = 0; pass < 2; pass++ )
+    {
+        const unsigned long missesBefore = doc->GetCacheMisses();
+
+        wxStopWatch sw;
+        for ( size_t n = 0; n < count; n++ )
+        {
+            view->ShowSurvey(n);
+            view->GetCanvas()->Update();
+        }
+
+        times[pass] = sw.Time();
+        misses[pass] = doc->GetCacheMisses() - missesBefore;
+    }
+
+    view->ShowSurvey(survey);
+
+    wxLogMessage("Paging through %lu surveys:\n"
+                 "\n"
+                 "First pass:\t%ldms, %lu tiles computed\n"
+                 "Second pass:\t%ldms, %lu tiles computed",
+                 static_cast<unsigned long>(count),
+                 times[0], misses[0],
+                 times[1], misses[1]);
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// Benchmarks menus and commands
+// ----------------------------------------------------------------------------
+
+wxMenu *CreateDrawingBenchmarksMenu()
+{
+    wxMenu * const menu = new wxMenu;
+    menu->Append(ID_DRAWING_MEASURE_FPS, "&Measure frame rate",
+                 "Measure scrolling and resizing speed of a big drawing");
+    menu->Append(ID_DRAWING_MEASURE_UNDO, "Measure undo memor&y",
+                 "Check the memory used by the undo history in a long session");
+    menu->Append(ID_DRAWING_MEASURE_LATENCY, "Measure stroke &latency",
+                 "Measure the cost and delay of drawing with a fast mouse");
+    menu->Append(ID_DRAWING_MEASURE_PACKING, "Measure &packing",
+                 "Compare the size and speed of the packed drawing format");
+    menu->Append(ID_DRAWING_MEASURE_SAVING, "Measure &saving",
+                 "Measure how long saving blocks drawing in each format");
+    menu->Append(ID_DRAWING_MEASURE_EDITING, "Measure &editing",
+                 "Measure deleting and moving segments in a big drawing");
+    menu->Append(ID_DRAWING_MEASURE_LOADING, "Measure l&oading",
+                 "Compare opening a big drawing saved in each format");
+    menu->Append(ID_DRAWING_MEASURE_STORAGE, "Measure line stor&age",
+                 "Compare the pooled lines with one lines array per segment");
+    menu->Append(ID_DRAWING_MEASURE_ALLOCATIONS, "Measure allocatio&ns",
+                 "Count the allocations done by loading and drawing strokes");
+
+    return menu;
+}
+
+wxMenu *CreateSurveyBenchmarksMenu()
+{
+    wxMenu * const menu = new wxMenu;
+    menu->Append(ID_SURVEY_MEASURE_SPEED, "&Measure rendering speed",
+                 "Measure how fast the readings are converted to colours");
+    menu->Append(ID_SURVEY_MEASURE_SCALING, "Measure interpolation &scaling",
+                 "Compare the interpolation speed using one and all threads");
+    menu->Append(ID_SURVEY_MEASURE_CONTOURS, "Measure con&touring speed",
+                 "Compare the contouring speed using one and all threads");
+    menu->Append(ID_SURVEY_MEASURE_STATISTICS, "Measure statistics s&peed",
+                 "Measure how fast the reading statistics are computed");
+    menu->Append(ID_SURVEY_MEASURE_PARSING, "Measure &loading speed",
+                 "Compare the survey file parser with the text streams");
+    menu->Append(ID_SURVEY_MEASURE_EXPORT, "Measure e&xport speed",
+                 "Measure how fast A0 posters of the survey are exported");
+
+    return menu;
+}
+
+wxMenu *CreateComparisonBenchmarksMenu()
+{
+    wxMenu * const menu = new wxMenu;
+    menu->Append(ID_COMPARISON_MEASURE_PAGING, "&Measure paging speed",
+                 "Page through all surveys twice and compare the times");
+
+    return menu;
+}
+
+bool CanRunBenchmark(int id, wxView *view)
+{
+    if ( id >= ID_DRAWING_MEASURE_FPS && id <= ID_DRAWING_MEASURE_ALLOCATIONS )
+    {
+        // the drawing can't be used while it's being loaded
+        DrawingView * const drawingView = wxDynamicCast(view, DrawingView);
+        return drawingView && !drawingView->GetDocument()->IsLoading();
+    }
+
+    if ( id >= ID_SURVEY_MEASURE_SPEED && id <= ID_SURVEY_MEASURE_EXPORT )
+        return wxDynamicCast(view, SurveyView) != NULL;
+
+    if ( id == ID_COMPARISON_MEASURE_PAGING )
+        return wxDynamicCast(view, ComparisonView) != NULL;
+
+    return false;
+}
+
+void RunBenchmark(int id, wxView *view)
+{
+    if ( !CanRunBenchmark(id, view) )
+        return;
+
+    switch ( id )
+    {
+        case ID_DRAWING_MEASURE_FPS:
+            MeasureFrameRate(wxStaticCast(view, DrawingView));
+            break;
+
+        case ID_DRAWING_MEASURE_UNDO:
+            MeasureUndo();
+            break;
+
+        case ID_DRAWING_MEASURE_LATENCY:
+            MeasureStrokeLatency(
+                *wxStaticCast(view, DrawingView)->GetCanvas());
+            break;
+
+        case ID_DRAWING_MEASURE_PACKING:
+            MeasurePacking(wxStaticCast(view, DrawingView)->GetDocument());
+            break;
+
+        case ID_DRAWING_MEASURE_SAVING:
+            MeasureSaving(wxStaticCast(view, DrawingView)->GetDocument());
+            break;
+
+        case ID_DRAWING_MEASURE_EDITING:
+            MeasureEditing();
+            break;
+
+        case ID_DRAWING_MEASURE_LOADING:
+            MeasureLoading();
+            break;
+
+        case ID_DRAWING_MEASURE_STORAGE:
+            MeasureStorage();
+            break;
+
+        case ID_DRAWING_MEASURE_ALLOCATIONS:
+            MeasureAllocations();
+            break;
+
+        case ID_SURVEY_MEASURE_SPEED:
+            MeasureSpeed(wxStaticCast(view, SurveyView));
+            break;
+
+        case ID_SURVEY_MEASURE_SCALING:
+            MeasureScaling(wxStaticCast(view, SurveyView));
+            break;
+
+        case ID_SURVEY_MEASURE_CONTOURS:
+            MeasureContours(wxStaticCast(view, SurveyView)->GetDocument());
+            break;
+
+        case ID_SURVEY_MEASURE_STATISTICS:
+            MeasureStatistics(wxStaticCast(view, SurveyView)->GetDocument());
+            break;
+
+        case ID_SURVEY_MEASURE_PARSING:
+            MeasureParsing(wxStaticCast(view, SurveyView)->GetDocument());
+            break;
+
+        case ID_SURVEY_MEASURE_EXPORT:
+            MeasureExport(wxStaticCast(view, SurveyView));
+            break;
+
+        case ID_COMPARISON_MEASURE_PAGING:
+            MeasurePaging(wxStaticCast(view, ComparisonView));
+            break;
+    }
+}
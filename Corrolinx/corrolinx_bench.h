@@ -0,0 +1,36 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_bench.h
+// Purpose:     Benchmarks of the documents and views
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_BENCH_H_
+#define _CORROLINX_CORROLINX_BENCH_H_
+
+class wxMenu;
+class wxView;
+
+// The benchmarks measure the speed and the memory use of the documents and
+// views using either the document of the active view or scratch ones filled
+// with a fixed sequence of pseudo-random data, and report the results using
+// wxLogMessage(). They are only offered in the "Benchmarks" submenus of the
+// edit menus when the program is started with "--benchmarks" and some of
+// them block the program for several seconds.
+
+// create the submenus with the benchmarks for each kind of documents
+wxMenu *CreateDrawingBenchmarksMenu();
+wxMenu *CreateSurveyBenchmarksMenu();
+wxMenu *CreateComparisonBenchmarksMenu();
+
+// check if the benchmark with the given menu command id can be run for the
+// given view, which may be NULL, now
+bool CanRunBenchmark(int id, wxView *view);
+
+// run the benchmark with the given menu command id for the given view, does
+// nothing if CanRunBenchmark() returns false for it
+void RunBenchmark(int id, wxView *view);
+
+#endif // _CORROLINX_CORROLINX_BENCH_H_
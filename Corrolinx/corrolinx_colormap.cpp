@@ -0,0 +1,301 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_colormap.cpp
+// Purpose:     Implements conversion of the survey readings to colours
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "corrolinx_colormap.h"
+#include "corrolinx_grid.h"
+
+#ifdef CORROLINX_USE_SSE2
+    #include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// the range of readings covered by the continuous palette, the readings
+// outside of it use the colour of its nearest end
+const float CONTINUOUS_MIN = ASTM_C876_HIGH_RISK - 150;
+const float CONTINUOUS_MAX = ASTM_C876_LOW_RISK + 150;
+
+// the colours at the given readings between which the continuous palette is
+// interpolated
+struct ColourStop
+{
+    float value;
+    unsigned char r, g, b;
+};
+
+const ColourStop CONTINUOUS_STOPS[] =
+{
+    { CONTINUOUS_MIN,                               0x80, 0x00, 0x00 },
+    { ASTM_C876_HIGH_RISK,                          0xd0, 0x00, 0x00 },
+    { (ASTM_C876_HIGH_RISK + ASTM_C876_LOW_RISK)/2, 0xf0, 0xc8, 0x00 },
+    { ASTM_C876_LOW_RISK,                           0x80, 0xc0, 0x00 },
+    { CONTINUOUS_MAX,                               0x00, 0xa0, 0x00 },
+};
+
+// store the first 3 bytes of the packed colour, this may also overwrite the
+// byte following them
+inline void StoreColour(wxUint32 colour, unsigned char *rgb)
+{
+    memcpy(rgb, &colour, 3);
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// SurveyColourMap implementation
+// ----------------------------------------------------------------------------
+
+SurveyColourMap::SurveyColourMap(SurveyColourScheme scheme)
+    : m_scheme(scheme)
+{
+    m_bands[Band_LowRisk] = PackColour(0x00, 0xa0, 0x00);
+    m_bands[Band_Uncertain] = PackColour(0xf0, 0xc8, 0x00);
+    m_bands[Band_HighRisk] = PackColour(0xd0, 0x00, 0x00);
+    m_bands[Band_Missing] = PackColour(0xe0, 0xe0, 0xe0);
+
+    // each palette entry uses the colour in the middle of its range
+    const float step = (CONTINUOUS_MAX - CONTINUOUS_MIN)/PALETTE_SIZE;
+
+    size_t stop = 0;
+    for ( int n = 0; n < PALETTE_SIZE; n++ )
+    {
+        const float value = CONTINUOUS_MIN + (n + 0.5f)*step;
+        while ( CONTINUOUS_STOPS[stop + 1].value < value )
+            stop++;
+
+        const ColourStop& from = CONTINUOUS_STOPS[stop];
+        const ColourStop& to = CONTINUOUS_STOPS[stop + 1];
+        const float t = (value - from.value)/(to.value - from.value);
+
+        m_palette[n] = PackColour(wxRound(from.r + t*(to.r - from.r)),
+                                  wxRound(from.g + t*(to.g - from.g)),
+                                  wxRound(from.b + t*(to.b - from.b)));
+    }
+
+    m_palette[PALETTE_SIZE] = m_bands[Band_Missing];
+}
+
+/* static */
+wxUint32 SurveyColourMap::PackColour(unsigned char r,
+                                     unsigned char g,
+                                     unsigned char b)
+{
+    const unsigned char bytes[4] = { r, g, b, 0 };
+
+    wxUint32 colour;
+    memcpy(&colour, bytes, sizeof(colour));
+
+    return colour;
+}
+
+/* static */
+bool SurveyColourMap::HasSIMD()
+{
+#ifdef CORROLINX_USE_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SurveyColourMap::Map(const float *values,
+                          size_t count,
+                          unsigned char *rgb) const
+{
+#ifdef CORROLINX_USE_SSE2
+    const size_t done = m_scheme == SurveyColours_Bands
+                            ? MapBandsSSE2(values, count, rgb)
+                            : MapContinuousSSE2(values, count, rgb);
+    values += done;
+    count -= done;
+    rgb += 3*done;
+#endif // CORROLINX_USE_SSE2
+
+    MapPortable(values, count, rgb);
+}
+
+void SurveyColourMap::MapPortable(const float *values,
+                                  size_t count,
+                                  unsigned char *rgb) const
+{
+    if ( m_scheme == SurveyColours_Bands )
+        MapBandsPortable(values, count, rgb);
+    else
+        MapContinuousPortable(values, count, rgb);
+}
+
+void SurveyColourMap::MapBandsPortable(const float *values,
+                                       size_t count,
+                                       unsigned char *rgb) const
+{
+    for ( size_t n = 0; n < count; n++, rgb += 3 )
+    {
+        const float value = values[n];
+
+        int band;
+        if ( SurveyGrid::IsMissing(value) )
+            band = Band_Missing;
+        else if ( value > ASTM_C876_LOW_RISK )
+            band = Band_LowRisk;
+        else if ( value < ASTM_C876_HIGH_RISK )
+            band = Band_HighRisk;
+        else
+            band = Band_Uncertain;
+
+        StoreColour(m_bands[band], rgb);
+    }
+}
+
+void SurveyColourMap::MapContinuousPortable(const float *values,
+                                            size_t count,
+                                            unsigned char *rgb) const
+{
+    const float scale = PALETTE_SIZE/(CONTINUOUS_MAX - CONTINUOUS_MIN);
+
+    for ( size_t n = 0; n < count; n++, rgb += 3 )
+    {
+        const float value = values[n];
+
+        int index;
+        if ( SurveyGrid::IsMissing(value) )
+        {
+            index = PALETTE_SIZE;
+        }
+        else
+        {
+            // this must be computed in exactly the same way as in the SSE2
+            // version to give the same results
+            float pos = (value - CONTINUOUS_MIN)*scale;
+            if ( pos < 0 )
+                pos = 0;
+            if ( pos > PALETTE_SIZE - 1 )
+                pos = PALETTE_SIZE - 1;
+
+            index = static_cast<int>(pos);
+        }
+
+        StoreColour(m_palette[index], rgb);
+    }
+}
+
+#ifdef CORROLINX_USE_SSE2
+
+namespace
+{
+
+// return the elements of a where mask is set and those of b elsewhere
+inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// store 4 packed colours, writing 13 bytes
+inline void Store4Colours(__m128i colours, unsigned char *rgb)
+{
+    wxUint32 packed[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(packed), colours);
+
+    // the 4 byte stores are faster than copying 3 bytes and the extra byte
+    // is overwritten by the next colour
+    memcpy(rgb, &packed[0], 4);
+    memcpy(rgb + 3, &packed[1], 4);
+    memcpy(rgb + 6, &packed[2], 4);
+    memcpy(rgb + 9, &packed[3], 4);
+}
+
+} // anonymous namespace
+
+size_t SurveyColourMap::MapBandsSSE2(const float *values,
+                                     size_t count,
+                                     unsigned char *rgb) const
+{
+    const __m128 lowRisk = _mm_set1_ps(ASTM_C876_LOW_RISK),
+                 highRisk = _mm_set1_ps(ASTM_C876_HIGH_RISK);
+
+    const __m128i
+        colourLow = _mm_set1_epi32(m_bands[Band_LowRisk]),
+        colourUncertain = _mm_set1_epi32(m_bands[Band_Uncertain]),
+        colourHigh = _mm_set1_epi32(m_bands[Band_HighRisk]),
+        colourMissing = _mm_set1_epi32(m_bands[Band_Missing]);
+
+    // the last group is left to the portable code as the stores would write
+    // beyond the end of the buffer if it ended there
+    size_t n = 0;
+    for ( ; n + 4 < count; n += 4, rgb += 12 )
+    {
+        const __m128 v = _mm_loadu_ps(values + n);
+
+        // all comparisons with NaN are false except for the unordered one
+        const __m128i low = _mm_castps_si128(_mm_cmpgt_ps(v, lowRisk)),
+                      high = _mm_castps_si128(_mm_cmplt_ps(v, highRisk)),
+                      missing = _mm_castps_si128(_mm_cmpunord_ps(v, v));
+
+        __m128i colours = Select(low, colourLow, colourUncertain);
+        colours = Select(high, colourHigh, colours);
+        colours = Select(missing, colourMissing, colours);
+
+        Store4Colours(colours, rgb);
+    }
+
+    return n;
+}
+
+size_t SurveyColourMap::MapContinuousSSE2(const float *values,
+                                          size_t count,
+                                          unsigned char *rgb) const
+{
+    const __m128 min = _mm_set1_ps(CONTINUOUS_MIN),
+                 scale = _mm_set1_ps(PALETTE_SIZE/
+                                     (CONTINUOUS_MAX - CONTINUOUS_MIN)),
+                 zero = _mm_setzero_ps(),
+                 last = _mm_set1_ps(PALETTE_SIZE - 1);
+    const __m128i missingIndex = _mm_set1_epi32(PALETTE_SIZE);
+
+    size_t n = 0;
+    for ( ; n + 4 < count; n += 4, rgb += 12 )
+    {
+        const __m128 v = _mm_loadu_ps(values + n);
+
+        // notice that _mm_max_ps() returns its second operand if the first
+        // one is NaN, so the missing values become 0 here and are replaced
+        // below
+        __m128 pos = _mm_mul_ps(_mm_sub_ps(v, min), scale);
+        pos = _mm_min_ps(_mm_max_ps(pos, zero), last);
+
+        const __m128i missing = _mm_castps_si128(_mm_cmpunord_ps(v, v));
+        const __m128i
+            index = Select(missing, missingIndex, _mm_cvttps_epi32(pos));
+
+        // there is no gather instruction in SSE2, so look up the colours
+        // one by one
+        wxInt32 indices[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(indices), index);
+
+        memcpy(rgb, &m_palette[indices[0]], 4);
+        memcpy(rgb + 3, &m_palette[indices[1]], 4);
+        memcpy(rgb + 6, &m_palette[indices[2]], 4);
+        memcpy(rgb + 9, &m_palette[indices[3]], 4);
+    }
+
+    return n;
+}
+
+#endif // CORROLINX_USE_SSE2
@@ -0,0 +1,100 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_colormap.h
+// Purpose:     Conversion of the survey readings to colours
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_COLORMAP_H_
+#define _CORROLINX_CORROLINX_COLORMAP_H_
+
+#include "wx/defs.h"
+
+// SSE2 is always available in 64-bit builds and may be enabled for 32-bit ones
+#if defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define CORROLINX_USE_SSE2
+#endif
+
+// The ways of colouring the survey readings
+enum SurveyColourScheme
+{
+    SurveyColours_Bands,        // the ASTM C876 corrosion probability bands
+    SurveyColours_Continuous    // smooth gradient across the bands
+};
+
+// ----------------------------------------------------------------------------
+// SurveyColourMap: converts readings to RGB pixels
+// ----------------------------------------------------------------------------
+
+// The conversion is done using SSE2 when it's available, which is always the
+// case for x86-64 builds, and with a portable, but slower, loop otherwise.
+// Both implementations produce exactly the same results.
+class SurveyColourMap
+{
+public:
+    explicit SurveyColourMap(SurveyColourScheme scheme = SurveyColours_Bands);
+
+    SurveyColourScheme GetScheme() const { return m_scheme; }
+    void SetScheme(SurveyColourScheme scheme) { m_scheme = scheme; }
+
+    // convert count readings to RGB triplets in the format used by wxImage
+    void Map(const float *values, size_t count, unsigned char *rgb) const;
+
+    // the same as Map() but never uses SIMD instructions, this is only useful
+    // for comparing the performance of both versions
+    void MapPortable(const float *values,
+                     size_t count,
+                     unsigned char *rgb) const;
+
+    // return true if Map() uses SIMD instructions
+    static bool HasSIMD();
+
+private:
+    // the number of entries in the continuous palette, not counting the last
+    // one used for the missing readings
+    enum { PALETTE_SIZE = 256 };
+
+    // the colours of the bands followed by the one of missing readings
+    enum
+    {
+        Band_LowRisk,
+        Band_Uncertain,
+        Band_HighRisk,
+        Band_Missing,
+        Band_Max
+    };
+
+    // the colours are stored as 32-bit values containing the red, green and
+    // blue components in this order in memory followed by an unused byte
+    static wxUint32 PackColour(unsigned char r,
+                               unsigned char g,
+                               unsigned char b);
+
+    void MapBandsPortable(const float *values,
+                          size_t count,
+                          unsigned char *rgb) const;
+    void MapContinuousPortable(const float *values,
+                               size_t count,
+                               unsigned char *rgb) const;
+
+#ifdef CORROLINX_USE_SSE2
+    // these functions only process a multiple of 4 readings and return the
+    // number of them which were converted
+    size_t MapBandsSSE2(const float *values,
+                        size_t count,
+                        unsigned char *rgb) const;
+    size_t MapContinuousSSE2(const float *values,
+                             size_t count,
+                             unsigned char *rgb) const;
+#endif // CORROLINX_USE_SSE2
+
+    SurveyColourScheme m_scheme;
+
+    wxUint32 m_bands[Band_Max];
+    wxUint32 m_palette[PALETTE_SIZE + 1];
+};
+
+#endif // _CORROLINX_CORROLINX_COLORMAP_H_
@@ -0,0 +1,462 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_compare.cpp
+// Purpose:     Implements comparison of several surveys
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "wx/ffile.h"
+#include "wx/filename.h"
+#include "wx/math.h"
+#include "wx/tokenzr.h"
+
+#include "corrolinx_compare.h"
+#include "corrolinx_doc.h"
+#include "corrolinx_mmap.h"
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+// ComparisonTile: a cached tile of ComparisonDocument
+// ----------------------------------------------------------------------------
+
+class ComparisonTile
+{
+public:
+    ComparisonTile()
+        : values(ComparisonDocument::TILE_SIZE*ComparisonDocument::TILE_SIZE),
+          lastUsed(0)
+    {
+    }
+
+    wxVector<float> values;
+
+    // the value of ComparisonDocument::m_tileClock when it was last used
+    unsigned long lastUsed;
+};
+
+// ----------------------------------------------------------------------------
+// ComparisonDocument implementation
+// ----------------------------------------------------------------------------
+
+IMPLEMENT_DYNAMIC_CLASS(ComparisonDocument, wxDocument)
+
+ComparisonDocument::ComparisonDocument()
+    : wxDocument(),
+      m_tileClock(0),
+      m_cacheHits(0),
+      m_cacheMisses(0)
+{
+}
+
+ComparisonDocument::~ComparisonDocument()
+{
+    ClearSurveys();
+}
+
+const SurveyGrid& ComparisonDocument::GetBaseGrid() const
+{
+    static const SurveyGrid s_empty;
+
+    return m_surveys.empty() ? s_empty : m_surveys[0]->grid;
+}
+
+bool ComparisonDocument::AddSurvey(const wxString& path,
+                                   const wxDateTime& date)
+{
+    Survey * const survey = new Survey(path, date);
+    if ( !ReadSurvey(*survey) )
+    {
+        delete survey;
+        return false;
+    }
+
+    // the cells of all surveys change if the new one becomes the first one
+    const size_t pos = InsertSurvey(survey);
+    if ( pos == 0 )
+    {
+        for ( size_t n = 0; n < m_surveys.size(); n++ )
+        {
+            if ( m_surveys[n]->loaded )
+                AlignSurvey(*m_surveys[n]);
+        }
+    }
+    else
+    {
+        AlignSurvey(*survey);
+    }
+
+    // the indices of the following surveys change and all trends depend on
+    // the new one, so it's simpler to recompute everything
+    ClearCache();
+
+    Modify(true);
+    UpdateAllViews();
+
+    return true;
+}
+
+size_t ComparisonDocument::InsertSurvey(Survey *survey)
+{
+    // the surveys taken at the same date are kept in the order of addition
+    size_t pos = m_surveys.size();
+    while ( pos && m_surveys[pos - 1]->date.IsLaterThan(survey->date) )
+        pos--;
+
+    m_surveys.insert(m_surveys.begin() + pos, survey);
+
+    return pos;
+}
+
+/* static */
+bool ComparisonDocument::ReadSurvey(Survey& survey)
+{
+    MappedFile file;
+    SurveyStatistics stats;
+    if ( !file.Open(survey.path) ||
+            !SurveyDocument::ParseCSV(file.GetData(), file.GetSize(),
+                                      survey.grid, stats) )
+    {
+        wxLogError("Failed to read survey from the file \"%s\".",
+                   survey.path);
+
+        survey.failed = true;
+        return false;
+    }
+
+    survey.loaded = true;
+    return true;
+}
+
+bool ComparisonDocument::LoadSurvey(size_t n)
+{
+    Survey& survey = *m_surveys[n];
+    if ( survey.loaded || survey.failed )
+        return survey.loaded;
+
+    // the other surveys are aligned to the first one which must be read first
+    if ( n && !LoadSurvey(0) )
+        return false;
+
+    if ( !ReadSurvey(survey) )
+        return false;
+
+    AlignSurvey(survey);
+
+    return true;
+}
+
+void ComparisonDocument::AlignSurvey(Survey& survey)
+{
+    const SurveyGrid& base = GetBaseGrid();
+    const SurveyGrid& grid = survey.grid;
+
+    // each cell of the base grid uses the closest reading of the survey
+    survey.columns.resize(base.GetWidth());
+    for ( size_t x = 0; x < base.GetWidth(); x++ )
+    {
+        const double pos = base.GetOriginX() + x*base.GetSpacingX();
+        const double column = floor((pos - grid.GetOriginX())/
+                                        grid.GetSpacingX() + 0.5);
+        survey.columns[x] = column >= 0 && column < grid.GetWidth()
+                                ? static_cast<int>(column)
+                                : -1;
+    }
+
+    survey.rows.resize(base.GetHeight());
+    for ( size_t y = 0; y < base.GetHeight(); y++ )
+    {
+        const double pos = base.GetOriginY() + y*base.GetSpacingY();
+        const double row = floor((pos - grid.GetOriginY())/
+                                    grid.GetSpacingY() + 0.5);
+        survey.rows[y] = row >= 0 && row < grid.GetHeight()
+                            ? static_cast<int>(row)
+                            : -1;
+    }
+}
+
+const float *ComparisonDocument::GetTile(ComparisonMode mode,
+                                         size_t survey,
+                                         size_t tileX,
+                                         size_t tileY)
+{
+    if ( mode == Comparison_Trend )
+        survey = 0;
+
+    const TileKey key = MakeTileKey(mode, survey, tileX, tileY);
+
+    ComparisonTile *tile;
+    ComparisonTiles::const_iterator it = m_tiles.find(key);
+    if ( it != m_tiles.end() )
+    {
+        tile = it->second;
+        m_cacheHits++;
+    }
+    else
+    {
+        if ( m_tiles.size() >= MAX_CACHED_TILES )
+            TrimCache();
+
+        tile = new ComparisonTile;
+        ComputeTile(mode, survey, tileX, tileY, &tile->values[0]);
+        m_tiles[key] = tile;
+        m_cacheMisses++;
+    }
+
+    tile->lastUsed = ++m_tileClock;
+
+    return &tile->values[0];
+}
+
+void ComparisonDocument::ComputeTile(ComparisonMode mode,
+                                     size_t survey,
+                                     size_t tileX,
+                                     size_t tileY,
+                                     float *values)
+{
+    std::fill(values, values + TILE_SIZE*TILE_SIZE,
+              SurveyGrid::GetMissingValue());
+
+    if ( m_surveys.empty() || !LoadSurvey(0) )
+        return;
+
+    const SurveyGrid& base = GetBaseGrid();
+    const size_t left = tileX*TILE_SIZE,
+                 top = tileY*TILE_SIZE;
+    if ( left >= base.GetWidth() || top >= base.GetHeight() )
+        return;
+
+    const size_t width = wxMin(static_cast<size_t>(TILE_SIZE),
+                               base.GetWidth() - left),
+                 height = wxMin(static_cast<size_t>(TILE_SIZE),
+                                base.GetHeight() - top);
+
+    switch ( mode )
+    {
+        case Comparison_Readings:
+            {
+                if ( !LoadSurvey(survey) )
+                    return;
+
+                const Survey& current = *m_surveys[survey];
+                for ( size_t y = 0; y < height; y++ )
+                {
+                    float * const row = values + y*TILE_SIZE;
+                    for ( size_t x = 0; x < width; x++ )
+                        row[x] = GetAlignedValue(current, left + x, top + y);
+                }
+            }
+            break;
+
+        case Comparison_SinceFirst:
+        case Comparison_SincePrevious:
+            {
+                const size_t other = mode == Comparison_SinceFirst || !survey
+                                        ? 0
+                                        : survey - 1;
+                if ( !LoadSurvey(survey) || !LoadSurvey(other) )
+                    return;
+
+                // the missing readings in either survey give missing changes
+                const Survey& current = *m_surveys[survey];
+                const Survey& previous = *m_surveys[other];
+                for ( size_t y = 0; y < height; y++ )
+                {
+                    float * const row = values + y*TILE_SIZE;
+                    for ( size_t x = 0; x < width; x++ )
+                    {
+                        row[x] = GetAlignedValue(current, left + x, top + y) -
+                                    GetAlignedValue(previous,
+                                                    left + x, top + y);
+                    }
+                }
+            }
+            break;
+
+        case Comparison_Trend:
+            {
+                // fit a line to the readings of each cell by least squares,
+                // using the time since the first survey in years
+                const size_t count = TILE_SIZE*TILE_SIZE;
+                wxVector<unsigned> n(count, 0);
+                wxVector<double> sumT(count, 0.),
+                                 sumV(count, 0.),
+                                 sumTT(count, 0.),
+                                 sumTV(count, 0.);
+
+                const wxDateTime& first = m_surveys[0]->date;
+                for ( size_t s = 0; s < m_surveys.size(); s++ )
+                {
+                    if ( !LoadSurvey(s) )
+                        continue;
+
+                    const Survey& current = *m_surveys[s];
+                    const double t = (current.date - first).GetDays()/365.25;
+                    for ( size_t y = 0; y < height; y++ )
+                    {
+                        for ( size_t x = 0; x < width; x++ )
+                        {
+                            const float v = GetAlignedValue(current,
+                                                            left + x,
+                                                            top + y);
+                            if ( SurveyGrid::IsMissing(v) )
+                                continue;
+
+                            const size_t i = y*TILE_SIZE + x;
+                            n[i]++;
+                            sumT[i] += t;
+                            sumV[i] += v;
+                            sumTT[i] += t*t;
+                            sumTV[i] += t*v;
+                        }
+                    }
+                }
+
+                for ( size_t i = 0; i < count; i++ )
+                {
+                    // at least two readings at different dates are needed
+                    const double d = n[i]*sumTT[i] - sumT[i]*sumT[i];
+                    if ( n[i] < 2 || d < 1e-9 )
+                        continue;
+
+                    values[i] = (n[i]*sumTV[i] - sumT[i]*sumV[i])/d;
+                }
+            }
+            break;
+    }
+}
+
+void ComparisonDocument::ClearSurveys()
+{
+    ClearCache();
+
+    for ( size_t n = 0; n < m_surveys.size(); n++ )
+        delete m_surveys[n];
+    m_surveys.clear();
+}
+
+void ComparisonDocument::ClearCache()
+{
+    for ( ComparisonTiles::const_iterator it = m_tiles.begin();
+          it != m_tiles.end();
+          ++it )
+    {
+        delete it->second;
+    }
+
+    m_tiles.clear();
+}
+
+void ComparisonDocument::TrimCache()
+{
+    if ( m_tiles.empty() )
+        return;
+
+    wxVector<unsigned long> used;
+    used.reserve(m_tiles.size());
+    for ( ComparisonTiles::const_iterator it = m_tiles.begin();
+          it != m_tiles.end();
+          ++it )
+    {
+        used.push_back(it->second->lastUsed);
+    }
+
+    wxVector<unsigned long>::iterator oldest = used.begin() + used.size()/4;
+    std::nth_element(used.begin(), oldest, used.end());
+    const unsigned long threshold = *oldest;
+
+    wxVector<TileKey> keys;
+    for ( ComparisonTiles::const_iterator it = m_tiles.begin();
+          it != m_tiles.end();
+          ++it )
+    {
+        if ( it->second->lastUsed <= threshold )
+            keys.push_back(it->first);
+    }
+
+    for ( size_t n = 0; n < keys.size(); n++ )
+    {
+        ComparisonTiles::iterator it = m_tiles.find(keys[n]);
+        delete it->second;
+        m_tiles.erase(it);
+    }
+}
+
+bool ComparisonDocument::DoOpenDocument(const wxString& filename)
+{
+    ClearSurveys();
+
+    wxFFile file(filename, "r");
+    wxString contents;
+    if ( !file.IsOpened() || !file.ReadAll(&contents, wxConvUTF8) )
+        return false;
+
+    const wxString dir = wxFileName(filename).GetPath();
+
+    wxStringTokenizer lines(contents, "\n", wxTOKEN_RET_EMPTY_ALL);
+    for ( unsigned long lineNum = 1; lines.HasMoreTokens(); lineNum++ )
+    {
+        wxString line = lines.GetNextToken();
+        line.Trim().Trim(false);
+        if ( line.empty() || line[0] == '#' )
+            continue;
+
+        wxString path;
+        const wxString date = line.BeforeFirst(',', &path).Trim();
+        path.Trim(false);
+
+        wxDateTime dt;
+        if ( !dt.ParseISODate(date) || path.empty() )
+        {
+            wxLogWarning("Comparison corrupted: invalid survey in line %lu.",
+                         lineNum);
+            return false;
+        }
+
+        wxFileName fn(path);
+        fn.MakeAbsolute(dir);
+        InsertSurvey(new Survey(fn.GetFullPath(), dt));
+    }
+
+    if ( m_surveys.empty() )
+    {
+        wxLogWarning("Comparison doesn't contain any surveys.");
+        return false;
+    }
+
+    // the other surveys are only read when they're shown
+    return LoadSurvey(0);
+}
+
+bool ComparisonDocument::DoSaveDocument(const wxString& filename)
+{
+    wxFFile file(filename, "w");
+    if ( !file.IsOpened() )
+        return false;
+
+    const wxString dir = wxFileName(filename).GetPath();
+
+    wxString contents = "# survey date, survey file\n";
+    for ( size_t n = 0; n < m_surveys.size(); n++ )
+    {
+        wxFileName fn(m_surveys[n]->path);
+        fn.MakeRelativeTo(dir);
+        contents << m_surveys[n]->date.FormatISODate() << ", "
+                 << fn.GetFullPath() << '\n';
+    }
+
+    return file.Write(contents, wxConvUTF8) && file.Close();
+}
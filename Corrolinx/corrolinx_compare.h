@@ -0,0 +1,188 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_compare.h
+// Purpose:     Comparison of several surveys of the same structure
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_COMPARE_H_
+#define _CORROLINX_CORROLINX_COMPARE_H_
+
+#include "wx/datetime.h"
+#include "wx/docview.h"
+#include "wx/hashmap.h"
+#include "wx/vector.h"
+
+#include "corrolinx_grid.h"
+
+// What is shown for each cell of the surveys being compared
+enum ComparisonMode
+{
+    Comparison_Readings,        // the readings of the survey itself
+    Comparison_SinceFirst,      // the change since the first survey
+    Comparison_SincePrevious,   // the change since the previous survey
+    Comparison_Trend            // the trend of all surveys, in mV per year
+};
+
+class ComparisonTile;
+
+// the cached tiles of ComparisonDocument, see its MakeTileKey()
+WX_DECLARE_HASH_MAP(wxLongLong_t, ComparisonTile *,
+                    wxIntegerHash, wxIntegerEqual,
+                    ComparisonTiles);
+
+// ----------------------------------------------------------------------------
+// ComparisonDocument: the surveys of a structure taken at different dates
+// ----------------------------------------------------------------------------
+
+// The document file only lists the survey files, one per line, as the date of
+// the survey in ISO 8601 format followed by a comma and the path of the file,
+// which is relative to the directory of the document if it's not absolute.
+//
+// All comparisons use the cells of the first survey, the other ones are
+// aligned to them using their origin and spacing. The surveys are only read
+// when they're needed for the first time and kept in memory afterwards, while
+// the comparisons are computed by tiles, only for the tiles being shown, and
+// cached, so that showing them again doesn't recompute anything.
+class ComparisonDocument : public wxDocument
+{
+public:
+    // the number of cells along each side of a tile
+    enum { TILE_SIZE = 64 };
+
+    // the maximal number of cached tiles, 16KB each
+    enum { MAX_CACHED_TILES = 4096 };
+
+    ComparisonDocument();
+    virtual ~ComparisonDocument();
+
+    // the surveys are always sorted by their dates
+    size_t GetSurveyCount() const { return m_surveys.size(); }
+    const wxString& GetSurveyPath(size_t n) const
+        { return m_surveys[n]->path; }
+    const wxDateTime& GetSurveyDate(size_t n) const
+        { return m_surveys[n]->date; }
+
+    // read the survey taken at the given date and add it to the document,
+    // logs an error and returns false if it couldn't be read
+    bool AddSurvey(const wxString& path, const wxDateTime& date);
+
+    // the readings of the first survey, which define the cells shown by all
+    // comparisons, empty if there are no surveys
+    const SurveyGrid& GetBaseGrid() const;
+
+    // get the TILE_SIZE*TILE_SIZE values of the given tile of the comparison,
+    // row by row, with the cells outside of the base grid or without the
+    // readings needed to compute them missing; the survey is ignored for
+    // Comparison_Trend
+    //
+    // the returned pointer is only valid until the next call to this function
+    const float *GetTile(ComparisonMode mode,
+                         size_t survey,
+                         size_t tileX,
+                         size_t tileY);
+
+    // the number of tiles found in the cache and computed since the document
+    // was opened
+    unsigned long GetCacheHits() const { return m_cacheHits; }
+    unsigned long GetCacheMisses() const { return m_cacheMisses; }
+
+protected:
+    virtual bool DoOpenDocument(const wxString& filename);
+    virtual bool DoSaveDocument(const wxString& filename);
+
+private:
+    // a single survey of the comparison
+    struct Survey
+    {
+        Survey(const wxString& path_, const wxDateTime& date_)
+            : path(path_), date(date_), loaded(false), failed(false)
+        {
+        }
+
+        // the absolute path of the file and the date of the survey
+        wxString path;
+        wxDateTime date;
+
+        // the readings, only read when needed, and whether reading them was
+        // already tried and failed
+        SurveyGrid grid;
+        bool loaded;
+        bool failed;
+
+        // the column and the row of this survey for each column and row of
+        // the base grid, or -1 if it doesn't cover it
+        wxVector<int> columns;
+        wxVector<int> rows;
+    };
+
+    typedef wxLongLong_t TileKey;
+
+    static TileKey MakeTileKey(ComparisonMode mode,
+                               size_t survey,
+                               size_t tileX,
+                               size_t tileY)
+    {
+        return static_cast<TileKey>((static_cast<wxULongLong_t>(mode) << 60) |
+                                    (static_cast<wxULongLong_t>(survey) << 40) |
+                                    (static_cast<wxULongLong_t>(tileY) << 20) |
+                                    static_cast<wxULongLong_t>(tileX));
+    }
+
+    // insert the survey at its place in m_surveys and return its index
+    size_t InsertSurvey(Survey *survey);
+
+    // read the readings of the survey, logs an error and returns false if
+    // they couldn't be read
+    static bool ReadSurvey(Survey& survey);
+
+    // read the readings of the given survey if not done yet and align them to
+    // the base grid, return false if they couldn't be read
+    bool LoadSurvey(size_t n);
+
+    // compute the alignment of the survey to the base grid
+    void AlignSurvey(Survey& survey);
+
+    // get the value of the survey in the given cell of the base grid
+    static float GetAlignedValue(const Survey& survey, size_t x, size_t y)
+    {
+        const int column = survey.columns[x],
+                  row = survey.rows[y];
+        return column == -1 || row == -1
+                ? SurveyGrid::GetMissingValue()
+                : survey.grid.GetValue(column, row);
+    }
+
+    // compute the values of a tile
+    void ComputeTile(ComparisonMode mode,
+                     size_t survey,
+                     size_t tileX,
+                     size_t tileY,
+                     float *values);
+
+    // forget all surveys and the cached tiles
+    void ClearSurveys();
+
+    // forget the cached tiles, this must be done when the base survey changes
+    void ClearCache();
+
+    // forget the least recently used quarter of the cached tiles
+    void TrimCache();
+
+    wxVector<Survey *> m_surveys;
+
+    ComparisonTiles m_tiles;
+
+    // incremented each time a tile is used, to find the least recently used
+    unsigned long m_tileClock;
+
+    unsigned long m_cacheHits;
+    unsigned long m_cacheMisses;
+
+    wxDECLARE_NO_COPY_CLASS(ComparisonDocument);
+    wxDECLARE_DYNAMIC_CLASS(ComparisonDocument);
+};
+
+#endif // _CORROLINX_CORROLINX_COMPARE_H_
@@ -0,0 +1,727 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_contour.cpp
+// Purpose:     Implements equipotential contours of the survey readings
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "corrolinx_contour.h"
+#include "corrolinx_workers.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// the number of rows of cells in each band, which is small enough to balance
+// the load between the threads and to make updating the contours after
+// editing a reading fast, but big enough for most contours to stay inside
+// a single band
+const int BAND_ROWS = 64;
+
+// the sides of a cell, i.e. the edges of the grid between its corners
+enum
+{
+    Side_Top,
+    Side_Right,
+    Side_Bottom,
+    Side_Left,
+    Side_None = -1
+};
+
+// the sides connected by the contour segment inside a cell for each
+// combination of its corners above the level, with the bits 0 to 3 for the
+// top left, top right, bottom right and bottom left corners respectively,
+// except for the ambiguous saddle cases 5 and 10 handled separately
+const int CELL_SIDES[16][2] =
+{
+    { Side_None,   Side_None   },
+    { Side_Left,   Side_Top    },
+    { Side_Top,    Side_Right  },
+    { Side_Left,   Side_Right  },
+    { Side_Right,  Side_Bottom },
+    { Side_None,   Side_None   },
+    { Side_Top,    Side_Bottom },
+    { Side_Left,   Side_Bottom },
+    { Side_Bottom, Side_Left   },
+    { Side_Top,    Side_Bottom },
+    { Side_None,   Side_None   },
+    { Side_Right,  Side_Bottom },
+    { Side_Left,   Side_Right  },
+    { Side_Top,    Side_Right  },
+    { Side_Left,   Side_Top    },
+    { Side_None,   Side_None   }
+};
+
+// the identifier of the ends of the contours which are not continued in
+// another band
+const wxUint64 NO_EDGE = static_cast<wxUint64>(-1);
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// SurveyContourBand: the contours traced inside a band of rows
+// ----------------------------------------------------------------------------
+
+struct SurveyContourBand
+{
+    struct Contour
+    {
+        size_t level;
+
+        // the range of the contour points in SurveyContourBand::points
+        size_t first,
+               count;
+
+        // the identifiers of the grid edges at the start and the end of the
+        // contour if it crosses the band boundary there or NO_EDGE
+        wxUint64 ends[2];
+    };
+
+    wxVector<wxPoint> points;
+    wxVector<Contour> contours;
+};
+
+namespace
+{
+
+// ----------------------------------------------------------------------------
+// BandTracer: traces the contours of a single band
+// ----------------------------------------------------------------------------
+
+class BandTracer
+{
+public:
+    // the band consists of the rows of cells from top to bottom, exclusive
+    BandTracer(const SurveyGrid& grid, int top, int bottom)
+        : m_grid(grid),
+          m_width(grid.GetWidth()),
+          m_height(grid.GetHeight()),
+          m_top(top),
+          m_bottom(bottom),
+          m_visited((m_width - 1)*(bottom - top))
+    {
+    }
+
+    // append all the contours at the given level to the band
+    void Trace(size_t levelIndex, float level, SurveyContourBand& band);
+
+private:
+    // get the pairs of sides connected by the contour segments inside the
+    // given cell and return their number, from 0 to 2
+    int GetSegments(int x, int y, int sides[2][2]) const;
+
+    // get the point where the contour crosses the given side of the cell
+    wxPoint GetSidePoint(int x, int y, int side) const;
+
+    // get the identifier of the given side of the cell, which is the same
+    // for both cells sharing it
+    wxUint64 GetSideId(int x, int y, int side) const
+    {
+        switch ( side )
+        {
+            case Side_Right:
+                x++;
+                // fall through
+
+            case Side_Left:
+                return 2*(static_cast<wxUint64>(y)*m_width + x) + 1;
+
+            case Side_Bottom:
+                y++;
+                break;
+        }
+
+        return 2*(static_cast<wxUint64>(y)*m_width + x);
+    }
+
+    unsigned char& GetVisited(int x, int y)
+        { return m_visited[(y - m_top)*(m_width - 1) + x]; }
+
+    // follow the contour leaving the cell through the given side and append
+    // its points to the provided array, the segment inside this cell must
+    // be already marked as visited
+    //
+    // returns the identifier of the band boundary edge at which the contour
+    // ends or NO_EDGE if it ends anywhere else, including at its start, in
+    // which case closed is set to true
+    wxUint64 Follow(int x, int y, int side,
+                    wxVector<wxPoint>& points,
+                    bool& closed);
+
+    const SurveyGrid& m_grid;
+    const int m_width,
+              m_height,
+              m_top,
+              m_bottom;
+
+    float m_level;
+
+    // the bits 0 and 1 are set for the already traced segments of each cell
+    wxVector<unsigned char> m_visited;
+
+    // the contour points found going forward and backward from the starting
+    // cell, kept here to avoid reallocating them for each contour
+    wxVector<wxPoint> m_forward,
+                      m_backward;
+};
+
+int BandTracer::GetSegments(int x, int y, int sides[2][2]) const
+{
+    const float * const row = m_grid.GetRow(y);
+    const float * const next = m_grid.GetRow(y + 1);
+    const float values[4] = { row[x], row[x + 1], next[x + 1], next[x] };
+
+    int index = 0;
+    for ( int n = 0; n < 4; n++ )
+    {
+        if ( SurveyGrid::IsMissing(values[n]) )
+            return 0;
+
+        if ( values[n] >= m_level )
+            index |= 1 << n;
+    }
+
+    if ( index == 5 || index == 10 )
+    {
+        // use the average value at the center of the cell to decide whether
+        // the opposite corners above the level are connected or separated
+        const bool centerAbove =
+            (values[0] + values[1] + values[2] + values[3])/4 >= m_level;
+
+        if ( centerAbove == (index == 5) )
+        {
+            sides[0][0] = Side_Top;
+            sides[0][1] = Side_Right;
+            sides[1][0] = Side_Bottom;
+            sides[1][1] = Side_Left;
+        }
+        else
+        {
+            sides[0][0] = Side_Left;
+            sides[0][1] = Side_Top;
+            sides[1][0] = Side_Right;
+            sides[1][1] = Side_Bottom;
+        }
+
+        return 2;
+    }
+
+    if ( CELL_SIDES[index][0] == Side_None )
+        return 0;
+
+    sides[0][0] = CELL_SIDES[index][0];
+    sides[0][1] = CELL_SIDES[index][1];
+
+    return 1;
+}
+
+wxPoint BandTracer::GetSidePoint(int x, int y, int side) const
+{
+    // always interpolate from the top or left end of the edge, so that the
+    // result doesn't depend on the cell it is computed for
+    int x2 = x,
+        y2 = y;
+    switch ( side )
+    {
+        case Side_Top:
+            x2++;
+            break;
+
+        case Side_Right:
+            x = ++x2;
+            y2++;
+            break;
+
+        case Side_Bottom:
+            y = ++y2;
+            x2++;
+            break;
+
+        case Side_Left:
+            y2++;
+            break;
+    }
+
+    const float v1 = m_grid.GetValue(x, y),
+                v2 = m_grid.GetValue(x2, y2);
+    const float t = (m_level - v1)/(v2 - v1);
+
+    const float px = x + 0.5f + t*(x2 - x),
+                py = y + 0.5f + t*(y2 - y);
+
+    return wxPoint(wxRound(px*SurveyContours::CONTOUR_UNITS),
+                   wxRound(py*SurveyContours::CONTOUR_UNITS));
+}
+
+wxUint64 BandTracer::Follow(int x, int y, int side,
+                            wxVector<wxPoint>& points,
+                            bool& closed)
+{
+    for ( ;; )
+    {
+        points.push_back(GetSidePoint(x, y, side));
+
+        // move to the cell on the other side of the edge
+        int entry;
+        int nx = x,
+            ny = y;
+        switch ( side )
+        {
+            case Side_Top:
+                ny--;
+                entry = Side_Bottom;
+                break;
+
+            case Side_Right:
+                nx++;
+                entry = Side_Left;
+                break;
+
+            case Side_Bottom:
+                ny++;
+                entry = Side_Top;
+                break;
+
+            case Side_Left:
+            default:
+                nx--;
+                entry = Side_Right;
+                break;
+        }
+
+        if ( nx < 0 || nx >= m_width - 1 || ny < 0 || ny >= m_height - 1 )
+            return NO_EDGE;
+
+        // the contour continues in the neighbouring band
+        if ( ny < m_top || ny >= m_bottom )
+            return GetSideId(x, y, side);
+
+        int sides[2][2];
+        const int count = GetSegments(nx, ny, sides);
+
+        int segment;
+        for ( segment = 0; segment < count; segment++ )
+        {
+            if ( sides[segment][0] == entry || sides[segment][1] == entry )
+                break;
+        }
+
+        // the cell has missing readings
+        if ( segment == count )
+            return NO_EDGE;
+
+        unsigned char& visited = GetVisited(nx, ny);
+        if ( visited & (1 << segment) )
+        {
+            closed = true;
+            return NO_EDGE;
+        }
+
+        visited |= 1 << segment;
+
+        side = sides[segment][0] == entry ? sides[segment][1]
+                                          : sides[segment][0];
+        x = nx;
+        y = ny;
+    }
+}
+
+void BandTracer::Trace(size_t levelIndex,
+                       float level,
+                       SurveyContourBand& band)
+{
+    m_level = level;
+
+    if ( !m_visited.empty() )
+        memset(&m_visited[0], 0, m_visited.size());
+
+    for ( int y = m_top; y < m_bottom; y++ )
+    {
+        const float * const row = m_grid.GetRow(y);
+        const float * const next = m_grid.GetRow(y + 1);
+
+        // most cells are not crossed by any contour, so skip them as quickly
+        // as possible: the comparisons are false for the missing readings,
+        // so cells with them are only skipped here if their other corners are
+        // below the level, but they don't have any segments anyway
+        bool left = row[0] >= level,
+             leftNext = next[0] >= level;
+        for ( int x = 0; x < m_width - 1; x++ )
+        {
+            const bool right = row[x + 1] >= level,
+                       rightNext = next[x + 1] >= level;
+            const bool uniform = left == right &&
+                                    leftNext == rightNext &&
+                                        left == leftNext;
+            left = right;
+            leftNext = rightNext;
+            if ( uniform )
+                continue;
+
+            int sides[2][2];
+            const int count = GetSegments(x, y, sides);
+            for ( int segment = 0; segment < count; segment++ )
+            {
+                unsigned char& visited = GetVisited(x, y);
+                if ( visited & (1 << segment) )
+                    continue;
+
+                visited |= 1 << segment;
+
+                SurveyContourBand::Contour contour;
+                contour.level = levelIndex;
+                contour.first = band.points.size();
+
+                m_forward.clear();
+                bool closed = false;
+                contour.ends[1] = Follow(x, y, sides[segment][1],
+                                         m_forward, closed);
+
+                if ( closed )
+                {
+                    // the last point is the same as the first one
+                    contour.ends[0] = NO_EDGE;
+                    band.points.push_back(GetSidePoint(x, y,
+                                                       sides[segment][0]));
+                }
+                else
+                {
+                    // the contour may extend in the other direction too
+                    m_backward.clear();
+                    contour.ends[0] = Follow(x, y, sides[segment][0],
+                                             m_backward, closed);
+
+                    for ( size_t n = m_backward.size(); n > 0; n-- )
+                        band.points.push_back(m_backward[n - 1]);
+                }
+
+                for ( size_t n = 0; n < m_forward.size(); n++ )
+                    band.points.push_back(m_forward[n]);
+
+                contour.count = band.points.size() - contour.first;
+                band.contours.push_back(contour);
+            }
+        }
+    }
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// SurveyContours::BandTask: traces the bands in parallel
+// ----------------------------------------------------------------------------
+
+class SurveyContours::BandTask : public ParallelTask
+{
+public:
+    BandTask(const SurveyGrid& grid,
+             const wxVector<float>& levels,
+             wxVector<SurveyContourBand *>& bands,
+             const wxVector<size_t>& indices)
+        : m_grid(grid),
+          m_levels(levels),
+          m_bands(bands),
+          m_indices(indices)
+    {
+    }
+
+    virtual void Process(size_t n)
+    {
+        const size_t index = m_indices[n];
+        const int top = index*BAND_ROWS,
+                  bottom = wxMin(top + BAND_ROWS,
+                                 static_cast<int>(m_grid.GetHeight()) - 1);
+
+        SurveyContourBand * const band = new SurveyContourBand;
+
+        BandTracer tracer(m_grid, top, bottom);
+        for ( size_t level = 0; level < m_levels.size(); level++ )
+            tracer.Trace(level, m_levels[level], *band);
+
+        // each band is only processed by one thread
+        delete m_bands[index];
+        m_bands[index] = band;
+    }
+
+private:
+    const SurveyGrid& m_grid;
+    const wxVector<float>& m_levels;
+    wxVector<SurveyContourBand *>& m_bands;
+    const wxVector<size_t>& m_indices;
+
+    wxDECLARE_NO_COPY_CLASS(BandTask);
+};
+
+// ----------------------------------------------------------------------------
+// SurveyContours implementation
+// ----------------------------------------------------------------------------
+
+SurveyContours::SurveyContours()
+{
+    m_width =
+    m_height = 0;
+
+    for ( int level = -550; level <= 0; level += 50 )
+        m_levels.push_back(level);
+
+    m_offsets.push_back(0);
+}
+
+SurveyContours::~SurveyContours()
+{
+    Clear();
+}
+
+void SurveyContours::SetLevels(const wxVector<float>& levels)
+{
+    m_levels = levels;
+
+    Clear();
+}
+
+void SurveyContours::Clear()
+{
+    for ( size_t n = 0; n < m_bands.size(); n++ )
+        delete m_bands[n];
+    m_bands.clear();
+
+    m_width =
+    m_height = 0;
+
+    m_lines.clear();
+    m_offsets.clear();
+    m_offsets.push_back(0);
+    m_bounds.clear();
+}
+
+void SurveyContours::Compute(const SurveyGrid& grid, WorkerPool& pool)
+{
+    Clear();
+
+    // there are no cells at all in a grid with a single row or column
+    if ( grid.GetWidth() < 2 || grid.GetHeight() < 2 )
+        return;
+
+    m_width = grid.GetWidth();
+    m_height = grid.GetHeight();
+
+    const size_t count = (m_height - 1 + BAND_ROWS - 1)/BAND_ROWS;
+    m_bands.resize(count, NULL);
+
+    wxVector<size_t> bands(count);
+    for ( size_t n = 0; n < count; n++ )
+        bands[n] = n;
+
+    ComputeBands(grid, bands, pool);
+}
+
+void SurveyContours::Update(const SurveyGrid& grid,
+                            const wxRect& rect,
+                            WorkerPool& pool)
+{
+    if ( !IsComputed() ||
+            grid.GetWidth() != m_width || grid.GetHeight() != m_height )
+    {
+        Compute(grid, pool);
+        return;
+    }
+
+    // the readings of the given rows are the corners of the cells from the
+    // row above the first one to the last one
+    const int last = m_bands.size() - 1;
+    const int first = wxMax(0, wxMin(last, (rect.y - 1)/BAND_ROWS)),
+              end = wxMax(0, wxMin(last, rect.GetBottom()/BAND_ROWS));
+
+    wxVector<size_t> bands;
+    for ( int n = first; n <= end; n++ )
+        bands.push_back(n);
+
+    ComputeBands(grid, bands, pool);
+}
+
+void SurveyContours::ComputeBands(const SurveyGrid& grid,
+                                  const wxVector<size_t>& bands,
+                                  WorkerPool& pool)
+{
+    BandTask task(grid, m_levels, m_bands, bands);
+    pool.Run(task, bands.size());
+
+    Stitch();
+}
+
+namespace
+{
+
+// an end of a contour crossing the band boundary
+struct ContourEnd
+{
+    size_t level;
+    wxUint64 edge;
+
+    // the index of the contour in the list of all of them, multiplied by 2
+    // and plus 1 for its end
+    size_t contourEnd;
+
+    bool operator<(const ContourEnd& other) const
+    {
+        if ( level != other.level )
+            return level < other.level;
+
+        return edge < other.edge;
+    }
+};
+
+// the points of a contour traced inside a band
+struct ContourPart
+{
+    const wxPoint *points;
+    size_t count;
+};
+
+} // anonymous namespace
+
+void SurveyContours::Stitch()
+{
+    m_lines.clear();
+    m_offsets.clear();
+    m_offsets.push_back(0);
+    m_bounds.clear();
+
+    // number all contours in the order of the bands
+    wxVector<ContourPart> contours;
+    wxVector<ContourEnd> ends;
+    for ( size_t n = 0; n < m_bands.size(); n++ )
+    {
+        const SurveyContourBand * const band = m_bands[n];
+        for ( size_t i = 0; i < band->contours.size(); i++ )
+        {
+            const SurveyContourBand::Contour& contour = band->contours[i];
+            for ( int e = 0; e < 2; e++ )
+            {
+                if ( contour.ends[e] != NO_EDGE )
+                {
+                    ContourEnd end;
+                    end.level = contour.level;
+                    end.edge = contour.ends[e];
+                    end.contourEnd = 2*contours.size() + e;
+                    ends.push_back(end);
+                }
+            }
+
+            ContourPart part;
+            part.points = &band->points[contour.first];
+            part.count = contour.count;
+            contours.push_back(part);
+        }
+    }
+
+    // the two ends at the same edge belong to the parts of the same contour
+    // on both sides of the boundary, unless one of the cells has missing
+    // readings, in which case there is only one
+    static const size_t NO_PARTNER = static_cast<size_t>(-1);
+    wxVector<size_t> partners(2*contours.size(), NO_PARTNER);
+
+    std::sort(ends.begin(), ends.end());
+    for ( size_t n = 1; n < ends.size(); n++ )
+    {
+        const ContourEnd& end = ends[n];
+        const ContourEnd& prev = ends[n - 1];
+        if ( end.level == prev.level && end.edge == prev.edge )
+        {
+            partners[end.contourEnd] = prev.contourEnd;
+            partners[prev.contourEnd] = end.contourEnd;
+        }
+    }
+
+    // join the parts, starting from the free ends first and then doing the
+    // remaining closed contours spanning several bands
+    wxVector<bool> done(contours.size(), false);
+    for ( int pass = 0; pass < 2; pass++ )
+    {
+        for ( size_t n = 0; n < contours.size(); n++ )
+        {
+            if ( done[n] )
+                continue;
+
+            int start = 0;
+            if ( pass == 0 )
+            {
+                if ( partners[2*n] == NO_PARTNER )
+                    start = 0;
+                else if ( partners[2*n + 1] == NO_PARTNER )
+                    start = 1;
+                else
+                    continue;
+            }
+
+            const size_t first = m_lines.size();
+
+            bool hasPoint = false;
+            wxPoint last;
+
+            size_t current = n;
+            int from = start;
+            for ( ;; )
+            {
+                done[current] = true;
+
+                const wxPoint * const points = contours[current].points;
+                const size_t count = contours[current].count;
+
+                // the first point of the next part is the same as the last
+                // point of the previous one
+                for ( size_t i = 0; i < count; i++ )
+                {
+                    const wxPoint& pt = points[from == 0 ? i : count - 1 - i];
+                    if ( hasPoint && pt != last )
+                        m_lines.push_back(DoodleLine(last, pt));
+
+                    last = pt;
+                    hasPoint = true;
+                }
+
+                const size_t next = partners[2*current + 1 - from];
+                if ( next == NO_PARTNER || done[next/2] )
+                    break;
+
+                current = next/2;
+                from = next % 2;
+            }
+
+            if ( m_lines.size() == first )
+                continue;
+
+            m_offsets.push_back(m_lines.size());
+
+            wxInt32 left = m_lines[first].x1,
+                    top = m_lines[first].y1,
+                    right = left,
+                    bottom = top;
+            for ( size_t i = first; i < m_lines.size(); i++ )
+            {
+                const DoodleLine& line = m_lines[i];
+                left = wxMin(left, line.x2);
+                right = wxMax(right, line.x2);
+                top = wxMin(top, line.y2);
+                bottom = wxMax(bottom, line.y2);
+            }
+
+            m_bounds.push_back(wxRect(left, top,
+                                      right - left + 1, bottom - top + 1));
+        }
+    }
+}
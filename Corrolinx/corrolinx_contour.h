@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_contour.h
+// Purpose:     Equipotential contours of the survey readings
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_CONTOUR_H_
+#define _CORROLINX_CORROLINX_CONTOUR_H_
+
+#include "wx/vector.h"
+
+#include "corrolinx_doc.h"
+
+class WorkerPool;
+struct SurveyContourBand;
+
+// ----------------------------------------------------------------------------
+// SurveyContours: the contour lines of a survey grid at several levels
+// ----------------------------------------------------------------------------
+
+// The contours are found using marching squares over the cells formed by
+// each 4 adjacent readings, cells with any missing readings are skipped and
+// the contours just end at them.
+//
+// The grid is split into bands of rows which are traced independently, in
+// parallel, and the contours crossing the band boundaries are joined at the
+// end, so only the bands containing the changed readings need to be traced
+// again when the grid is edited.
+//
+// The result is stored in the same way as the segments of DrawingDocument,
+// with one segment per contour, using CONTOUR_UNITS per reading, so that the
+// center of the reading (x, y) is at ((x + 0.5)*CONTOUR_UNITS, (y + 0.5)*
+// CONTOUR_UNITS).
+class SurveyContours
+{
+public:
+    enum { CONTOUR_UNITS = 16 };
+
+    SurveyContours();
+    ~SurveyContours();
+
+    // the default levels are every 50mV from -550mV to 0
+    const wxVector<float>& GetLevels() const { return m_levels; }
+
+    // set the levels for which the contours are computed, this clears them
+    void SetLevels(const wxVector<float>& levels);
+
+    // forget the contours, they have to be computed again
+    void Clear();
+
+    // true if the contours were computed and not cleared since then
+    bool IsComputed() const { return !m_bands.empty(); }
+
+    // compute the contours of the entire grid
+    void Compute(const SurveyGrid& grid, WorkerPool& pool);
+
+    // recompute the contours after changing the readings in the given
+    // rectangle of the grid, this is the same as Compute() if they were not
+    // computed yet or the size of the grid changed
+    void Update(const SurveyGrid& grid, const wxRect& rect, WorkerPool& pool);
+
+    // get all contours as segments
+    DoodleSegments GetSegments() const
+        { return DoodleSegments(m_lines, m_offsets); }
+
+    // get the lines of all contours, in order
+    const DoodleLines& GetLines() const { return m_lines; }
+
+    // get the bounding box of the given contour
+    const wxRect& GetBounds(size_t n) const { return m_bounds[n]; }
+
+private:
+    class BandTask;
+
+    // trace the bands with the given indices
+    void ComputeBands(const SurveyGrid& grid,
+                      const wxVector<size_t>& bands,
+                      WorkerPool& pool);
+
+    // join the contours of all bands into m_lines and m_offsets
+    void Stitch();
+
+    wxVector<float> m_levels;
+
+    // the bands of the grid, empty if not computed
+    wxVector<SurveyContourBand *> m_bands;
+    size_t m_width,
+           m_height;
+
+    // the lines of all contours and the index of the first line of each one
+    // followed by the total number of lines
+    DoodleLines m_lines;
+    DoodleOffsets m_offsets;
+
+    // the bounding box of each contour
+    wxVector<wxRect> m_bounds;
+
+    wxDECLARE_NO_COPY_CLASS(SurveyContours);
+};
+
+#endif // _CORROLINX_CORROLINX_CONTOUR_H_
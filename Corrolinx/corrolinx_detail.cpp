@@ -0,0 +1,209 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_detail.cpp
+// Purpose:     Implements simplified drawing segments
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "corrolinx_detail.h"
+
+namespace
+{
+
+// return the square of the distance from pt to the segment from a to b
+double DistanceToSegment2(const wxPoint& pt, const wxPoint& a, const wxPoint& b)
+{
+    const double dx = b.x - a.x,
+                 dy = b.y - a.y;
+    const double len2 = dx*dx + dy*dy;
+
+    double t = 0;
+    if ( len2 > 0 )
+    {
+        t = ((pt.x - a.x)*dx + (pt.y - a.y)*dy) / len2;
+        t = wxMax(0., wxMin(1., t));
+    }
+
+    const double ex = a.x + t*dx - pt.x,
+                 ey = a.y + t*dy - pt.y;
+    return ex*ex + ey*ey;
+}
+
+// convert the lines of a segment to polylines without simplifying them
+void ToPolylines(const DoodleSegmentSpan& segment, DoodleSimplified& to)
+{
+    for ( const DoodleLine *line = segment.begin();
+          line != segment.end();
+          ++line )
+    {
+        const wxPoint start(line->x1, line->y1);
+        if ( to.points.empty() || to.points.back() != start )
+        {
+            if ( !to.points.empty() )
+                to.ends.push_back(to.points.size());
+
+            to.points.push_back(start);
+        }
+
+        to.points.push_back(wxPoint(line->x2, line->y2));
+    }
+
+    if ( !to.points.empty() )
+        to.ends.push_back(to.points.size());
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// DoodleDetailCache implementation
+// ----------------------------------------------------------------------------
+
+/* static */
+int DoodleDetailCache::GetLevelForScale(double scale)
+{
+    // details smaller than half a pixel are invisible anyhow
+    const double tolerance = scale > 0 ? 0.5 / scale : 0;
+    if ( tolerance < 1 )
+        return -1;
+
+    int level = 0;
+    while ( level < LEVELS - 1 && (1 << (level + 1)) <= tolerance )
+        level++;
+
+    return level;
+}
+
+const DoodleSimplified& DoodleDetailCache::Get(const DoodleSegmentSpan& segment,
+                                               size_t n,
+                                               int level)
+{
+    wxASSERT_MSG( level >= 0 && level < LEVELS, "invalid detail level" );
+
+    wxVector<DoodleSimplified *>& cache = m_levels[level];
+    if ( cache.size() <= n )
+        cache.resize(n + 1, NULL);
+
+    if ( !cache[n] )
+    {
+        DoodleSimplified * const simplified = new DoodleSimplified;
+        if ( level == 0 )
+        {
+            DoodleSimplified lines;
+            ToPolylines(segment, lines);
+            Simplify(lines, 1, *simplified);
+        }
+        else // simplifying the previous level is much faster
+        {
+            Simplify(Get(segment, n, level - 1), 1 << level, *simplified);
+        }
+
+        cache[n] = simplified;
+    }
+
+    return *cache[n];
+}
+
+void DoodleDetailCache::Forget(size_t n)
+{
+    for ( int level = 0; level < LEVELS; level++ )
+    {
+        wxVector<DoodleSimplified *>& cache = m_levels[level];
+        if ( n < cache.size() )
+            wxDELETE(cache[n]);
+    }
+}
+
+void DoodleDetailCache::Truncate(size_t count)
+{
+    for ( int level = 0; level < LEVELS; level++ )
+    {
+        wxVector<DoodleSimplified *>& cache = m_levels[level];
+        for ( size_t n = count; n < cache.size(); n++ )
+            delete cache[n];
+
+        if ( count < cache.size() )
+            cache.resize(count);
+    }
+}
+
+/* static */
+void DoodleDetailCache::Simplify(const DoodleSimplified& from,
+                                 double tolerance,
+                                 DoodleSimplified& to)
+{
+    const double tolerance2 = tolerance*tolerance;
+
+    wxVector<bool> keep;
+    wxVector<wxUint32> stack;
+
+    wxUint32 start = 0;
+    for ( wxVector<wxUint32>::const_iterator end = from.ends.begin();
+          end != from.ends.end();
+          start = *end++ )
+    {
+        const wxUint32 last = *end - 1;
+
+        // this is the usual Douglas-Peucker algorithm using an explicit stack
+        // instead of recursion as strokes can be very long
+        keep.clear();
+        keep.resize(*end - start, false);
+        keep[0] = true;
+        keep[last - start] = true;
+
+        stack.clear();
+        stack.push_back(start);
+        stack.push_back(last);
+        while ( !stack.empty() )
+        {
+            const wxUint32 j = stack.back();
+            stack.pop_back();
+            const wxUint32 i = stack.back();
+            stack.pop_back();
+
+            double maxDist2 = 0;
+            wxUint32 farthest = i;
+            for ( wxUint32 k = i + 1; k < j; k++ )
+            {
+                const double dist2 = DistanceToSegment2(from.points[k],
+                                                        from.points[i],
+                                                        from.points[j]);
+                if ( dist2 > maxDist2 )
+                {
+                    maxDist2 = dist2;
+                    farthest = k;
+                }
+            }
+
+            if ( maxDist2 > tolerance2 )
+            {
+                keep[farthest - start] = true;
+
+                stack.push_back(i);
+                stack.push_back(farthest);
+                stack.push_back(farthest);
+                stack.push_back(j);
+            }
+        }
+
+        for ( wxUint32 k = start; k <= last; k++ )
+        {
+            if ( keep[k - start] )
+                to.points.push_back(from.points[k]);
+        }
+
+        to.ends.push_back(to.points.size());
+    }
+}
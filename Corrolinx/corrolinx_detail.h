@@ -0,0 +1,80 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_detail.h
+// Purpose:     Simplified drawing segments for rendering at small scales
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_DETAIL_H_
+#define _CORROLINX_CORROLINX_DETAIL_H_
+
+#include "wx/vector.h"
+
+#include "corrolinx_doc.h"
+
+// ----------------------------------------------------------------------------
+// A segment simplified at some level of detail
+// ----------------------------------------------------------------------------
+
+// The segment is represented as a list of polylines because its lines are not
+// necessarily connected to each other.
+struct DoodleSimplified
+{
+    // the points of all polylines one after another
+    wxVector<wxPoint> points;
+
+    // the index in points of the end of each polyline
+    wxVector<wxUint32> ends;
+};
+
+// ----------------------------------------------------------------------------
+// DoodleDetailCache: lazily computed simplified segments of a drawing
+// ----------------------------------------------------------------------------
+
+// Level n uses Douglas-Peucker simplification with the tolerance of 2^n
+// logical units and is computed from level n - 1 when it's first needed.
+class DoodleDetailCache
+{
+public:
+    enum
+    {
+        LEVELS = 8
+    };
+
+    DoodleDetailCache() { }
+    ~DoodleDetailCache() { Clear(); }
+
+    // get the level to use for drawing at the given scale or -1 if the
+    // segments should be drawn without simplification
+    static int GetLevelForScale(double scale);
+
+    // get the given segment simplified at the given level
+    const DoodleSimplified& Get(const DoodleSegmentSpan& segment,
+                                size_t n,
+                                int level);
+
+    // forget the simplified versions of the given segment, which changed
+    void Forget(size_t n);
+
+    // forget the simplified versions of all segments with indices greater or
+    // equal to count
+    void Truncate(size_t count);
+
+    // forget everything
+    void Clear() { Truncate(0); }
+
+private:
+    // simplify the polylines of "from" with the given tolerance
+    static void Simplify(const DoodleSimplified& from,
+                         double tolerance,
+                         DoodleSimplified& to);
+
+    // the simplified segments at each level, NULL if not computed yet
+    wxVector<DoodleSimplified *> m_levels[LEVELS];
+
+    wxDECLARE_NO_COPY_CLASS(DoodleDetailCache);
+};
+
+#endif // _CORROLINX_CORROLINX_DETAIL_H_
@@ -29,42 +29,541 @@
 
 #if wxUSE_STD_IOSTREAM
     #include "wx/ioswrap.h"
+    #include <fstream>
 #else
     #include "wx/txtstrm.h"
 #endif
 #include "wx/wfstream.h"
+#include "wx/ffile.h"
+#include "wx/file.h"
+#include "wx/config.h"
+#include "wx/filename.h"
+
+#if defined(__WINDOWS__)
+    #include "wx/msw/wrapwin.h"
+#elif defined(__UNIX__)
+    #include <sys/types.h>
+    #include <sys/stat.h>
+#endif
 
 #include "corrolinx_doc.h"
 #include "corrolinx_view.h"
+#include "corrolinx_mmap.h"
+#include "corrolinx_index.h"
+#include "corrolinx_detail.h"
+#include "corrolinx_loader.h"
+#include "corrolinx_saver.h"
+#include "corrolinx_undo.h"
+
+#ifdef CORROLINX_USE_SSE2
+    #include <emmintrin.h>
+#endif
+
+#include <algorithm>
 
 // ----------------------------------------------------------------------------
-// DrawingDocument implementation
+// Binary drawing format
 // ----------------------------------------------------------------------------
 
-IMPLEMENT_DYNAMIC_CLASS(DrawingDocument, wxDocument)
+// A binary drawing file consists of a fixed size header followed by the
+// segment offset table, containing segmentCount + 1 indices of the first line
+// of each segment (the last one being the total number of lines), and then by
+// the lines of all segments packed together as 4 32-bit coordinates each.
+//
+// All values are little-endian and both the table and the lines are 8 byte
+// aligned so that they can be used directly from the mapped file.
+//
+// A packed drawing file starts with the same signature, but has a different
+// version and header, which is followed by the segments packed by
+// DoodlePackedSegments. They need to be decoded when loading the file, but
+// take several times less space.
+namespace DrawingBinary
+{
 
-DocumentOstream& DrawingDocument::SaveObject(DocumentOstream& ostream)
+const char Magic[8] = { 'C', 'L', 'X', 'D', 'R', 'A', 'W', '\x1a' };
+const wxUint32 Version = 1;
+const wxUint32 PackedVersion = 2;
+
+struct Header
+{
+    char magic[8];
+    wxUint32 version;
+    wxUint32 segmentCount;
+    wxUint64 lineCount;
+    wxUint64 tableOffset;
+    wxUint64 linesOffset;
+};
+
+struct PackedHeader
+{
+    char magic[8];
+    wxUint32 version;
+    wxUint32 segmentCount;
+    wxUint64 lineCount;
+    wxUint64 dataSize;
+};
+
+wxCOMPILE_TIME_ASSERT( sizeof(Header) == 40, BadDrawingHeaderSize );
+wxCOMPILE_TIME_ASSERT( sizeof(PackedHeader) == 32, BadPackedHeaderSize );
+wxCOMPILE_TIME_ASSERT( sizeof(DoodleLine) == 4*sizeof(wxInt32),
+                       BadDoodleLineSize );
+
+bool HasSignature(const char *data, size_t size)
+{
+    return size >= sizeof(Magic) && memcmp(data, Magic, sizeof(Magic)) == 0;
+}
+
+// get the version of the file with the signature, which follows it in all
+// headers, or 0 if the file is too small to have it
+wxUint32 GetVersion(const char *data, size_t size)
+{
+    wxUint32 version;
+    if ( size < sizeof(Magic) + sizeof(version) )
+        return 0;
+
+    memcpy(&version, data + sizeof(Magic), sizeof(version));
+    return wxUINT32_SWAP_ON_BE(version);
+}
+
+} // namespace DrawingBinary
+
+// text documents bigger than this are loaded in the background
+const size_t BACKGROUND_LOAD_THRESHOLD = 4*1024*1024;
+
+// the counts stored in text documents are used to preallocate memory before
+// reading the data, but can't be trusted not to be bogus, so never reserve
+// more than this many elements in advance
+const size_t MAX_RESERVED_SEGMENTS = 1024*1024;
+const size_t MAX_RESERVED_LINES = 1024*1024;
+
+// the default interval between autosaves of the modified documents
+const long AUTOSAVE_MINUTES = 5;
+
+// the value of DrawingDocument::m_segmentsById for the ids of the segments
+// which don't exist any more
+const wxUint32 NO_SEGMENT = wxUINT32_MAX;
+
+namespace
+{
+
+bool IsStreamOk(DocumentIstream& stream)
+{
+#if wxUSE_STD_IOSTREAM
+    return !stream.fail();
+#else
+    return stream.IsOk();
+#endif
+}
+
+// check that the coordinates of all lines are valid, logging a warning if not
+bool AreLinesValid(const DoodleLines& lines)
+{
+    for ( DoodleLines::const_iterator i = lines.begin(); i != lines.end(); ++i )
+    {
+        if ( !i->IsValid() )
+        {
+            wxLogWarning("Drawing document corrupted: invalid coordinates.");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// make room for count more elements, but keep growing the vector
+// geometrically as reserving the exact size each time would make appending
+// many small chunks quadratic
+template <typename T>
+void ReserveMore(wxVector<T>& v, size_t count, size_t maxCount)
+{
+    const size_t size = v.size() + wxMin(count, maxCount);
+    if ( size > v.capacity() )
+        v.reserve(wxMax(size, 2*v.capacity()));
+}
+
+// replace the file with another one in the same directory, atomically, i.e.
+// the file has either its old or its new contents at any moment
+bool ReplaceFile(const wxString& from, const wxString& to)
+{
+#if defined(__WINDOWS__)
+    // wxRenameFile() copies the file instead if the target already exists
+    return ::MoveFileEx(from.t_str(), to.t_str(),
+                        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)
+                != 0;
+#else
+    return wxRenameFile(from, to, true);
+#endif
+}
+
+// give the file the same access permissions as another one, this is only
+// needed under Unix where the temporary files are only accessible to their
+// owner, while the files they replace could be shared with others
+bool CopyPermissions(const wxString& from, const wxString& to)
+{
+#if defined(__UNIX__)
+    struct stat st;
+    return stat(from.fn_str(), &st) == 0 &&
+            chmod(to.fn_str(), st.st_mode & 07777) == 0;
+#else
+    wxUnusedVar(from);
+    wxUnusedVar(to);
+
+    return true;
+#endif
+}
+
+// append the lines of the segment to the given ones
+void AppendLines(DoodleLines& lines, const DoodleSegmentSpan& segment)
+{
+    const size_t start = lines.size();
+    lines.resize(start + segment.GetCount());
+    if ( !segment.IsEmpty() )
+    {
+        memcpy(&lines[start], segment.begin(),
+               segment.GetCount()*sizeof(DoodleLine));
+    }
+}
+
+// compares the ids of the segments by their position in the document
+class SegmentOrder
+{
+public:
+    explicit SegmentOrder(const DrawingDocument& doc) : m_doc(doc) { }
+
+    bool operator()(DoodleSegmentId id1, DoodleSegmentId id2) const
+        { return m_doc.FindSegment(id1) < m_doc.FindSegment(id2); }
+
+private:
+    const DrawingDocument& m_doc;
+};
+
+// get the name of a file next to the given one with a suffix added to its
+// name, keeping the extension so that it can be opened in the same way
+wxString AddNameSuffix(const wxString& filename, const wxString& suffix)
+{
+    wxFileName fn(filename);
+    fn.SetName(fn.GetName() + suffix);
+
+    return fn.GetFullPath();
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// DrawingSnapshot implementation
+// ----------------------------------------------------------------------------
+
+DrawingSnapshot::DrawingSnapshot(const DoodleLines& lines,
+                                 const DoodleOffsets& offsets,
+                                 const DoodleSegmentIds *ids)
+    : m_lines(lines.empty() ? NULL : &lines[0]),
+      m_lineCount(lines.size()),
+      m_offsets(&offsets[0]),
+      m_segmentCount(offsets.size() - 1),
+      m_ids(ids && !ids->empty() ? &(*ids)[0] : NULL),
+      m_packed(NULL)
+{
+}
+
+DrawingSnapshot::DrawingSnapshot(const DoodlePackedSegments& packed)
+    : m_lines(NULL),
+      m_lineCount(0),
+      m_offsets(NULL),
+      m_segmentCount(0),
+      m_ids(NULL),
+      m_packed(&packed)
+{
+}
+
+size_t DrawingSnapshot::GetLineCount() const
+{
+    return m_packed ? m_packed->GetLineCount() : m_lineCount;
+}
+
+size_t DrawingSnapshot::GetSegmentCount() const
+{
+    return m_packed ? m_packed->GetCount() : m_segmentCount;
+}
+
+bool DrawingSnapshot::Save(const wxString& filename,
+                           DrawingFileFormat format) const
+{
+    // a new file is created empty first, to give it the default permissions
+    // which the temporary file replacing it can then take
+    const bool created = !wxFileExists(filename);
+    if ( created && !wxFile().Create(filename) )
+        return false;
+
+    // write a temporary file in the same directory, which can then be just
+    // renamed instead of being copied to the real one
+    const wxString temp = wxFileName::CreateTempFileName(filename);
+    if ( temp.empty() ||
+            !Write(temp, format) ||
+                !CopyPermissions(filename, temp) ||
+                    !ReplaceFile(temp, filename) )
+    {
+        if ( !temp.empty() )
+            wxRemoveFile(temp);
+        if ( created )
+            wxRemoveFile(filename);
+
+        return false;
+    }
+
+    return true;
+}
+
+DocumentOstream& DrawingSnapshot::SaveText(DocumentOstream& ostream) const
 {
+    DoodleLines lines;
+    DoodleOffsets offsets(1, 0);
+    if ( Unpack(lines, offsets) )
+        return DrawingSnapshot(lines, offsets).SaveText(ostream);
+
 #if wxUSE_STD_IOSTREAM
     DocumentOstream& stream = ostream;
 #else
     wxTextOutputStream stream(ostream);
 #endif
 
-    wxDocument::SaveObject(ostream);
-
-    const wxInt32 count = m_doodleSegments.size();
+    const wxInt32 count = m_segmentCount;
     stream << count << '\n';
 
-    for ( int n = 0; n < count; n++ )
+    for ( size_t n = 0; n < m_segmentCount; n++ )
     {
-        m_doodleSegments[n].SaveObject(ostream);
+        GetSegment(n).SaveObject(ostream);
         stream << '\n';
     }
 
     return ostream;
 }
 
+bool DrawingSnapshot::Write(const wxString& filename,
+                            DrawingFileFormat format) const
+{
+    // only the packed format can be written without unpacking the segments
+    if ( !m_packed || format != DrawingFormat_Packed )
+    {
+        DoodleLines lines;
+        DoodleOffsets offsets(1, 0);
+        if ( Unpack(lines, offsets) )
+            return DrawingSnapshot(lines, offsets).Write(filename, format);
+    }
+
+    switch ( format )
+    {
+        case DrawingFormat_Text:
+            return WriteText(filename);
+
+        case DrawingFormat_Binary:
+            return WriteBinary(filename);
+
+        case DrawingFormat_Packed:
+            return WritePacked(filename);
+    }
+
+    return false;
+}
+
+bool DrawingSnapshot::Unpack(DoodleLines& lines, DoodleOffsets& offsets) const
+{
+    if ( m_packed )
+    {
+        lines.reserve(m_packed->GetLineCount());
+        offsets.reserve(m_packed->GetCount() + 1);
+        m_packed->Unpack(lines, offsets);
+
+        return true;
+    }
+
+    if ( !m_ids )
+        return false;
+
+    lines.reserve(m_lineCount);
+    for ( size_t n = 0; n < m_segmentCount; n++ )
+    {
+        if ( m_ids[n] & DrawingDocument::SEGMENT_DELETED )
+            continue;
+
+        AppendLines(lines, GetSegment(n));
+        offsets.push_back(lines.size());
+    }
+
+    return true;
+}
+
+bool DrawingSnapshot::WriteText(const wxString& filename) const
+{
+#if wxUSE_STD_IOSTREAM
+    wxSTD ofstream store(filename.mb_str(), wxSTD ios::binary);
+    if ( !store )
+        return false;
+
+    SaveText(store);
+    store.close();
+
+    return !store.fail();
+#else
+    wxFileOutputStream store(filename);
+    if ( !store.IsOk() )
+        return false;
+
+    SaveText(store);
+
+    return store.IsOk() && store.Close();
+#endif
+}
+
+bool DrawingSnapshot::WriteBinary(const wxString& filename) const
+{
+    wxFFile file(filename, "wb");
+    if ( !file.IsOpened() )
+        return false;
+
+    const wxUint32 count = m_segmentCount;
+
+    DrawingBinary::Header header;
+    memcpy(header.magic, DrawingBinary::Magic, sizeof(header.magic));
+    header.version = wxUINT32_SWAP_ON_BE(DrawingBinary::Version);
+    header.segmentCount = wxUINT32_SWAP_ON_BE(count);
+
+    wxVector<wxUint64> table;
+    table.reserve(count + 1);
+    for ( wxUint32 n = 0; n <= count; n++ )
+        table.push_back(wxUINT64_SWAP_ON_BE(m_offsets[n]));
+
+    const wxUint64 tableOffset = sizeof(header);
+    header.lineCount = wxUINT64_SWAP_ON_BE(m_lineCount);
+    header.tableOffset = wxUINT64_SWAP_ON_BE(tableOffset);
+    header.linesOffset = wxUINT64_SWAP_ON_BE(tableOffset +
+                                             table.size()*sizeof(wxUint64));
+
+    bool ok = file.Write(&header, sizeof(header)) == sizeof(header) &&
+              file.Write(&table[0], table.size()*sizeof(wxUint64)) ==
+                table.size()*sizeof(wxUint64);
+
+    if ( ok && m_lineCount )
+    {
+#ifdef WORDS_BIGENDIAN
+        for ( const DoodleLine *i = m_lines;
+              ok && i != m_lines + m_lineCount;
+              ++i )
+        {
+            const wxInt32 coords[4] =
+            {
+                wxINT32_SWAP_ON_BE(i->x1), wxINT32_SWAP_ON_BE(i->y1),
+                wxINT32_SWAP_ON_BE(i->x2), wxINT32_SWAP_ON_BE(i->y2)
+            };
+
+            ok = file.Write(coords, sizeof(coords)) == sizeof(coords);
+        }
+#else // !WORDS_BIGENDIAN
+        const size_t bytes = m_lineCount*sizeof(DoodleLine);
+        ok = file.Write(m_lines, bytes) == bytes;
+#endif // WORDS_BIGENDIAN/!WORDS_BIGENDIAN
+    }
+
+    return file.Close() && ok;
+}
+
+bool DrawingSnapshot::WritePacked(const wxString& filename) const
+{
+    // a compacted document already has all its segments packed
+    DoodlePackedSegments packed;
+    const DoodlePackedSegments *segments = m_packed;
+    if ( !segments )
+    {
+        for ( size_t n = 0; n < m_segmentCount; n++ )
+            packed.Add(GetSegment(n));
+
+        segments = &packed;
+    }
+
+    wxFFile file(filename, "wb");
+    if ( !file.IsOpened() )
+        return false;
+
+    const size_t size = segments->GetDataSize();
+
+    DrawingBinary::PackedHeader header;
+    memcpy(header.magic, DrawingBinary::Magic, sizeof(header.magic));
+    header.version = wxUINT32_SWAP_ON_BE(DrawingBinary::PackedVersion);
+    header.segmentCount = wxUINT32_SWAP_ON_BE(segments->GetCount());
+    header.lineCount = wxUINT64_SWAP_ON_BE(segments->GetLineCount());
+    header.dataSize = wxUINT64_SWAP_ON_BE(size);
+
+    const bool ok = file.Write(&header, sizeof(header)) == sizeof(header) &&
+                    (!size || file.Write(segments->GetData(), size) == size);
+
+    return file.Close() && ok;
+}
+
+
+// ----------------------------------------------------------------------------
+// DrawingDocument implementation
+// ----------------------------------------------------------------------------
+
+IMPLEMENT_DYNAMIC_CLASS(DrawingDocument, wxDocument)
+IMPLEMENT_CLASS(DrawingUpdateHint, wxObject)
+
+DrawingDocument::DrawingDocument()
+    : wxDocument(),
+      m_deletedSegments(0),
+      m_deletedLines(0),
+      m_compact(NULL),
+      m_fileFormat(DrawingFormat_Text),
+      m_loader(NULL),
+      m_saver(NULL),
+      m_saverOwnsSnapshot(false),
+      m_oldSaved(false),
+      m_restoreOnSaveFailure(false),
+      m_autosaveTimer(NULL),
+      m_changeCount(0),
+      m_autosavedChangeCount(0)
+{
+    m_segmentOffsets.push_back(0);
+
+    // the ids start from 1, so that 0 can be used as an invalid id
+    m_segmentsById.push_back(NO_SEGMENT);
+
+    m_index = new DoodleIndex(m_lines);
+    m_detail = new DoodleDetailCache;
+
+    Bind(wxEVT_THREAD, &DrawingDocument::OnLoaderEvent, this);
+    Bind(wxEVT_THREAD, &DrawingDocument::OnSaverEvent, this,
+         DrawingSaver::EVENT_ID);
+}
+
+DrawingDocument::~DrawingDocument()
+{
+    // the loader refers to us, so it must be gone before we are
+    if ( m_loader )
+    {
+        m_loader->Delete();
+        DeleteLoader();
+    }
+
+    // and so does the saver, which also uses our segments
+    if ( m_saver )
+    {
+        m_saver->Wait();
+        delete m_saver;
+    }
+
+    delete m_autosaveTimer;
+
+    delete m_compact;
+    delete m_detail;
+    delete m_index;
+}
+
+DocumentOstream& DrawingDocument::SaveObject(DocumentOstream& ostream)
+{
+    wxDocument::SaveObject(ostream);
+
+    return TakeSnapshot().SaveText(ostream);
+}
+
 DocumentIstream& DrawingDocument::LoadObject(DocumentIstream& istream)
 {
 #if wxUSE_STD_IOSTREAM
@@ -88,97 +587,2231 @@ DocumentIstream& DrawingDocument::LoadObject(DocumentIstream& istream)
         return istream;
     }
 
+    // parse the lines directly into the pool, replacing any existing ones
+    m_lines.clear();
+    m_segmentOffsets.clear();
+    m_segmentOffsets.reserve(wxMin(static_cast<size_t>(count),
+                                   MAX_RESERVED_SEGMENTS) + 1);
+    m_segmentOffsets.push_back(0);
+
     for ( int n = 0; n < count; n++ )
     {
-        DoodleSegment segment;
-        segment.LoadObject(istream);
-        m_doodleSegments.push_back(segment);
+        if ( !IsStreamOk(DoodleSegment::LoadLines(istream, m_lines)) )
+            break;
+
+        m_segmentOffsets.push_back(m_lines.size());
     }
 
+    // drop the lines of the segment during which the stream failed, if any
+    m_lines.resize(m_segmentOffsets.back());
+
+    ResetSegmentIds();
+
+    m_index->Clear();
+    m_index->AddLines(0);
+    m_detail->Clear();
+
     return istream;
 }
 
-void DrawingDocument::DoUpdate()
+wxCommandProcessor *DrawingDocument::OnCreateCommandProcessor()
 {
-    Modify(true);
-    UpdateAllViews();
-}
+    DrawingCommandProcessor * const processor = new DrawingCommandProcessor;
 
-void DrawingDocument::AddDoodleSegment(const DoodleSegment& segment)
-{
-    m_doodleSegments.push_back(segment);
+#if wxUSE_CONFIG
+    // the budget can be changed in the configuration, in megabytes
+    long budget;
+    if ( wxConfigBase::Get()->Read("UndoMemoryBudget", &budget) && budget > 0 )
+        processor->SetMemoryBudget(static_cast<size_t>(budget)*1024*1024);
+#endif // wxUSE_CONFIG
 
-    DoUpdate();
+    return processor;
 }
 
-bool DrawingDocument::PopLastSegment(DoodleSegment *segment)
+bool DrawingDocument::OnCreate(const wxString& path, long flags)
 {
-    if ( m_doodleSegments.empty() )
+    if ( !wxDocument::OnCreate(path, flags) )
         return false;
 
-    if ( segment )
-        *segment = m_doodleSegments.back();
-
-    m_doodleSegments.pop_back();
+    // only the documents edited interactively are autosaved, the interval
+    // can be changed in the configuration, in minutes, 0 disables autosaving
+    long minutes = AUTOSAVE_MINUTES;
+#if wxUSE_CONFIG
+    wxConfigBase::Get()->Read("AutosaveMinutes", &minutes);
+#endif // wxUSE_CONFIG
 
-    DoUpdate();
+    if ( minutes > 0 )
+    {
+        m_autosaveTimer = new wxTimer(this);
+        Bind(wxEVT_TIMER, &DrawingDocument::OnAutosaveTimer, this,
+             m_autosaveTimer->GetId());
+        m_autosaveTimer->Start(minutes*60*1000);
+    }
 
     return true;
 }
 
-// ----------------------------------------------------------------------------
-// DoodleSegment implementation
-// ----------------------------------------------------------------------------
-
-DocumentOstream& DoodleSegment::SaveObject(DocumentOstream& ostream)
+bool DrawingDocument::DoOpenDocument(const wxString& filename)
 {
-#if wxUSE_STD_IOSTREAM
-    DocumentOstream& stream = ostream;
-#else
-    wxTextOutputStream stream(ostream);
-#endif
+    // this can happen when reverting a document which is still being loaded
+    if ( m_loader )
+    {
+        m_loader->Delete();
+        DeleteLoader();
+    }
 
-    const wxInt32 count = m_lines.size();
-    stream << count << '\n';
+    // or saved, in which case the old segments are still used by the saver
+    WaitForSaving();
 
-    for ( int n = 0; n < count; n++ )
+    // the changes autosaved by a previous session which didn't end normally
+    // would be overwritten by autosaving this one, so put them aside
+    const wxString autosave = AddNameSuffix(filename, ".autosave");
+    if ( GetFirstView() && wxFileExists(autosave) )
     {
-        const DoodleLine& line = m_lines[n];
-        stream
-            << line.x1 << ' '
-            << line.y1 << ' '
-            << line.x2 << ' '
-            << line.y2 << '\n';
+        if ( wxFileModificationTime(autosave) >=
+                wxFileModificationTime(filename) )
+        {
+            const wxString recovered = AddNameSuffix(filename, ".recovered");
+            if ( wxRenameFile(autosave, recovered, true) )
+            {
+                wxLogWarning("The changes to \"%s\" which were autosaved "
+                             "but never saved were recovered to \"%s\".",
+                             filename, recovered);
+            }
+        }
+        else
+        {
+            wxRemoveFile(autosave);
+        }
     }
 
-    return ostream;
-}
-
-DocumentIstream& DoodleSegment::LoadObject(DocumentIstream& istream)
-{
-#if wxUSE_STD_IOSTREAM
-    DocumentIstream& stream = istream;
-#else
-    wxTextInputStream stream(istream);
-#endif
+    // all segments are going to be replaced anyhow
+    DiscardCompact();
 
-    wxInt32 count = 0;
-    stream >> count;
+    MappedFile file;
+    if ( !file.Open(filename) )
+        return false;
 
-    for ( int n = 0; n < count; n++ )
+    if ( !DrawingBinary::HasSignature(file.GetData(), file.GetSize()) )
     {
-        DoodleLine line;
-        stream
-            >> line.x1
-            >> line.y1
-            >> line.x2
-            >> line.y2;
-        m_lines.push_back(line);
+        const size_t size = file.GetSize();
+        file.Close();
+
+        m_fileFormat = DrawingFormat_Text;
+
+        // there is no point in loading the document progressively if nobody
+        // is going to see it, e.g. when converting it
+        if ( size < BACKGROUND_LOAD_THRESHOLD || !GetFirstView() )
+            return wxDocument::DoOpenDocument(filename);
+
+        m_lines.clear();
+        m_segmentOffsets.clear();
+        m_segmentOffsets.push_back(0);
+        ResetSegmentIds();
+        m_index->Clear();
+        m_detail->Clear();
+
+        m_loader = new DrawingLoader(this, filename);
+        if ( m_loader->Run() != wxTHREAD_NO_ERROR )
+        {
+            wxLogDebug("Failed to start the loader thread.");
+
+            delete m_loader;
+            m_loader = NULL;
+
+            return wxDocument::DoOpenDocument(filename);
+        }
+
+        wxLogStatus("Loading \"%s\"...", filename);
+
+        return true;
+    }
+
+    bool ok;
+    if ( DrawingBinary::GetVersion(file.GetData(), file.GetSize()) ==
+            DrawingBinary::PackedVersion )
+    {
+        m_fileFormat = DrawingFormat_Packed;
+        ok = LoadPacked(file.GetData(), file.GetSize());
+    }
+    else
+    {
+        m_fileFormat = DrawingFormat_Binary;
+        ok = LoadBinary(file.GetData(), file.GetSize());
+    }
+
+    if ( !ok )
+    {
+        wxLogError("Failed to read document from the file \"%s\".", filename);
+        return false;
+    }
+
+    return true;
+}
+
+bool DrawingDocument::DoSaveDocument(const wxString& filename)
+{
+    if ( m_loader )
+    {
+        wxLogError("The document can't be saved while it is being loaded.");
+        return false;
+    }
+
+    // without any views there is no reason not to just wait until it's done
+    if ( !GetFirstView() )
+        return SaveCopy(filename, m_fileFormat);
+
+    return StartSaving(filename, m_fileFormat);
+}
+
+bool DrawingDocument::SaveAs()
+{
+    // wxDocument::SaveAs() gives the document its new name before saving it
+    // and keeps it even if saving fails
+    m_oldFilename = GetFilename();
+    m_oldTitle = GetTitle();
+    m_oldSaved = GetDocumentSaved();
+
+    if ( !wxDocument::SaveAs() )
+    {
+        RestoreFilename();
+        return false;
+    }
+
+    // the result is only known when the background save finishes
+    if ( IsSaving() )
+        m_restoreOnSaveFailure = true;
+
+    return true;
+}
+
+void DrawingDocument::RestoreFilename()
+{
+    // set the title first for the views to use it when they're notified
+    SetTitle(m_oldTitle);
+    SetFilename(m_oldFilename, true);
+    SetDocumentSaved(m_oldSaved);
+}
+
+bool DrawingDocument::SaveCopy(const wxString& filename,
+                               DrawingFileFormat format)
+{
+    return TakeSnapshot().Save(filename, format);
+}
+
+/* static */
+bool DrawingDocument::ConvertFile(const wxString& input,
+                                  const wxString& output,
+                                  DrawingFileFormat format)
+{
+    DrawingDocument doc;
+
+    return doc.DoOpenDocument(input) && doc.SaveCopy(output, format);
+}
+
+bool DrawingDocument::LoadBinary(const char *data, size_t size)
+{
+    DrawingBinary::Header header;
+    if ( size < sizeof(header) )
+    {
+        wxLogWarning("Drawing document corrupted: truncated header.");
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(header));
+    header.version = wxUINT32_SWAP_ON_BE(header.version);
+    header.segmentCount = wxUINT32_SWAP_ON_BE(header.segmentCount);
+    header.lineCount = wxUINT64_SWAP_ON_BE(header.lineCount);
+    header.tableOffset = wxUINT64_SWAP_ON_BE(header.tableOffset);
+    header.linesOffset = wxUINT64_SWAP_ON_BE(header.linesOffset);
+
+    if ( header.version != DrawingBinary::Version )
+    {
+        wxLogWarning("Unsupported drawing document version %u.",
+                     header.version);
+        return false;
+    }
+
+    // check that both arrays are aligned and entirely inside the file, taking
+    // care to avoid overflows with bogus values
+    const wxUint64 tableSize = static_cast<wxUint64>(header.segmentCount) + 1;
+    if ( header.tableOffset % 8 || header.linesOffset % 8 ||
+         header.tableOffset > size || header.linesOffset > size ||
+         (size - header.tableOffset) / sizeof(wxUint64) < tableSize ||
+         (size - header.linesOffset) / sizeof(DoodleLine) < header.lineCount )
+    {
+        wxLogWarning("Drawing document corrupted: invalid layout.");
+        return false;
+    }
+
+    const wxUint64 * const
+        table = reinterpret_cast<const wxUint64 *>(data + header.tableOffset);
+    const DoodleLine * const
+        lines = reinterpret_cast<const DoodleLine *>(data + header.linesOffset);
+
+    wxUint64 first = wxUINT64_SWAP_ON_BE(table[0]);
+    if ( first != 0 )
+    {
+        wxLogWarning("Drawing document corrupted: invalid segments table.");
+        return false;
+    }
+
+    DoodleOffsets offsets;
+    offsets.reserve(tableSize);
+    offsets.push_back(0);
+
+    for ( wxUint32 n = 0; n < header.segmentCount; n++ )
+    {
+        const wxUint64 last = wxUINT64_SWAP_ON_BE(table[n + 1]);
+        if ( last < first || last > header.lineCount )
+        {
+            wxLogWarning("Drawing document corrupted: invalid segments table.");
+            return false;
+        }
+
+        offsets.push_back(last);
+        first = last;
+    }
+
+    if ( first != header.lineCount )
+    {
+        wxLogWarning("Drawing document corrupted: invalid segments table.");
+        return false;
+    }
+
+    // all lines are stored in the same layout as in memory, so just copy them
+    DoodleLines loaded(header.lineCount);
+    if ( header.lineCount )
+        memcpy(&loaded[0], lines, header.lineCount*sizeof(DoodleLine));
+
+#ifdef WORDS_BIGENDIAN
+    for ( DoodleLines::iterator i = loaded.begin(); i != loaded.end(); ++i )
+    {
+        i->x1 = wxINT32_SWAP_ON_BE(i->x1);
+        i->y1 = wxINT32_SWAP_ON_BE(i->y1);
+        i->x2 = wxINT32_SWAP_ON_BE(i->x2);
+        i->y2 = wxINT32_SWAP_ON_BE(i->y2);
+    }
+#endif // WORDS_BIGENDIAN
+
+    if ( !AreLinesValid(loaded) )
+        return false;
+
+    m_lines.swap(loaded);
+    m_segmentOffsets.swap(offsets);
+    ResetSegmentIds();
+
+    m_index->Clear();
+    m_index->AddLines(0);
+    m_detail->Clear();
+
+    return true;
+}
+
+bool DrawingDocument::OnCloseDocument()
+{
+    if ( m_loader )
+    {
+        m_loader->Delete();
+        DeleteLoader();
+    }
+
+    // keep the document open if saving it in the background failed, to let
+    // the user save it elsewhere
+    const bool saving = m_saver && !m_saver->IsAutosave();
+    if ( !WaitForSaving() && saving )
+        return false;
+
+    // the document was already saved, if the user wanted it, so the changes
+    // autosaved since then are not needed any more
+    RemoveAutosave();
+
+    return wxDocument::OnCloseDocument();
+}
+
+void DrawingDocument::CancelLoading()
+{
+    if ( !m_loader )
+        return;
+
+    // stop the thread but keep whatever it had already parsed
+    m_loader->Delete();
+    AppendLoadedBatches();
+    DeleteLoader();
+
+    // don't let the user overwrite the original file with a part of it
+    SetDocumentSaved(false);
+
+    wxLogWarning("Loading was cancelled, the document is incomplete.");
+}
+
+void DrawingDocument::OnLoaderEvent(wxThreadEvent& event)
+{
+    // let OnSaverEvent() handle the events of the saver
+    if ( event.GetId() == DrawingSaver::EVENT_ID )
+    {
+        event.Skip();
+        return;
+    }
+
+    // the event may have been queued before the loader was cancelled
+    if ( !m_loader )
+        return;
+
+    AppendLoadedBatches();
+
+    const DrawingLoader::Status status = m_loader->GetStatus();
+    if ( status == DrawingLoader::Status_Running )
+        return;
+
+    // the thread has already terminated or is about to
+    m_loader->Wait();
+
+    // it could have produced the final batch after we took the others
+    AppendLoadedBatches();
+    DeleteLoader();
+
+    if ( status == DrawingLoader::Status_Done )
+    {
+        wxLogStatus("Loaded %lu segments.",
+                    static_cast<unsigned long>(m_segmentOffsets.size() - 1));
+    }
+    else
+    {
+        SetDocumentSaved(false);
+
+        wxLogError("Failed to read document from the file \"%s\".",
+                   GetFilename());
+    }
+}
+
+void DrawingDocument::AppendLoadedBatches()
+{
+    DrawingLoadBatches batches;
+    m_loader->TakeBatches(batches);
+    if ( batches.empty() )
+        return;
+
+    const size_t first = m_lines.size();
+
+    for ( DrawingLoadBatches::iterator i = batches.begin();
+          i != batches.end();
+          ++i )
+    {
+        const DrawingLoadBatch& batch = **i;
+
+        const size_t start = m_lines.size();
+        m_lines.resize(start + batch.lines.size());
+        if ( !batch.lines.empty() )
+        {
+            memcpy(&m_lines[start], &batch.lines[0],
+                   batch.lines.size()*sizeof(DoodleLine));
+        }
+
+        size_t offset = m_segmentOffsets.back();
+        for ( size_t n = 0; n < batch.counts.size(); n++ )
+        {
+            offset += batch.counts[n];
+            m_segmentOffsets.push_back(offset);
+        }
+
+        delete *i;
+    }
+
+    AssignSegmentIds();
+
+    m_index->AddLines(first);
+
+    // loading doesn't modify the document, so don't use DoUpdate() here
+    DrawingUpdateHint hint(GetLinesBounds(first, m_lines.size() - first));
+    UpdateAllViews(NULL, &hint);
+}
+
+void DrawingDocument::DeleteLoader()
+{
+    delete m_loader;
+    m_loader = NULL;
+}
+
+bool DrawingDocument::StartSaving(const wxString& filename,
+                                  DrawingFileFormat format,
+                                  bool autosave)
+{
+    if ( m_loader )
+    {
+        wxLogError("The document can't be saved while it is being loaded.");
+        return false;
+    }
+
+    // only one snapshot can be saved at once
+    WaitForSaving();
+
+    m_saver = new DrawingSaver(this, TakeSnapshot(), filename, format,
+                               autosave);
+    m_saverOwnsSnapshot = false;
+
+    if ( autosave )
+    {
+        m_autosavedChangeCount = m_changeCount;
+        m_autosaveFilename = filename;
+    }
+
+    if ( m_saver->Run() != wxTHREAD_NO_ERROR )
+    {
+        wxLogDebug("Failed to start the saver thread.");
+
+        wxDELETE(m_saver);
+
+        return SaveCopy(filename, format);
+    }
+
+    return true;
+}
+
+bool DrawingDocument::IsSaving() const
+{
+    return m_saver && !m_saver->IsDone();
+}
+
+bool DrawingDocument::WaitForSaving()
+{
+    if ( !m_saver )
+        return true;
+
+    m_saver->Wait();
+
+    return FinishSaving();
+}
+
+void DrawingDocument::OnSaverEvent(wxThreadEvent& WXUNUSED(event))
+{
+    // the event may have been queued before we waited for the saver
+    if ( !m_saver || !m_saver->IsDone() )
+        return;
+
+    m_saver->Wait();
+
+    FinishSaving();
+}
+
+bool DrawingDocument::FinishSaving()
+{
+    const bool ok = m_saver->Succeeded();
+    const bool autosave = m_saver->IsAutosave();
+    const wxString filename = m_saver->GetFilename();
+    const long saveTime = m_saver->GetSaveTime();
+
+    wxDELETE(m_saver);
+    m_saverOwnsSnapshot = false;
+
+    if ( autosave )
+    {
+        if ( ok )
+            wxLogStatus("Autosaved to \"%s\".", filename);
+        else
+            wxLogWarning("Failed to autosave to \"%s\".", filename);
+
+        return ok;
+    }
+
+    const bool restoreFilename = m_restoreOnSaveFailure;
+    m_restoreOnSaveFailure = false;
+
+    if ( !ok )
+    {
+        // the document was marked as saved when saving started and, for Save
+        // As, was given the new name too
+        Modify(true);
+        if ( restoreFilename )
+            RestoreFilename();
+
+        wxLogError("Failed to save document to the file \"%s\".", filename);
+
+        return false;
+    }
+
+    RemoveAutosave();
+
+    wxLogStatus("Saved \"%s\" in %ld ms.", filename, saveTime);
+
+    return true;
+}
+
+wxString DrawingDocument::GetAutosaveFilename() const
+{
+    const wxString filename = GetFilename();
+    if ( !filename.empty() )
+        return AddNameSuffix(filename, ".autosave");
+
+    // include the process id to avoid clashes with the other instances
+    wxFileName fn(wxFileName::GetTempDir(),
+                  wxString::Format("%s-%lu.autosave",
+                                   GetUserReadableName(),
+                                   wxGetProcessId()));
+    fn.SetExt("drw");
+
+    return fn.GetFullPath();
+}
+
+void DrawingDocument::OnAutosaveTimer(wxTimerEvent& WXUNUSED(event))
+{
+    if ( !IsModified() || m_changeCount == m_autosavedChangeCount )
+        return;
+
+    // don't wait for the previous save to finish, just try again later
+    if ( m_loader || IsSaving() )
+        return;
+
+    // the packed format is the fastest to write for the compacted documents
+    // and the smallest for all of them
+    const wxString filename = GetAutosaveFilename();
+    if ( filename != m_autosaveFilename )
+        RemoveAutosave();
+
+    StartSaving(filename, DrawingFormat_Packed, true);
+}
+
+void DrawingDocument::RemoveAutosave()
+{
+    if ( m_autosaveFilename.empty() )
+        return;
+
+    if ( wxFileExists(m_autosaveFilename) )
+        wxRemoveFile(m_autosaveFilename);
+
+    m_autosaveFilename.clear();
+}
+
+DrawingSnapshot DrawingDocument::TakeSnapshot() const
+{
+    if ( m_compact )
+        return DrawingSnapshot(*m_compact);
+
+    // the ids are only needed to skip the deleted segments
+    return DrawingSnapshot(m_lines,
+                           m_segmentOffsets,
+                           m_deletedSegments ? &m_segmentIds : NULL);
+}
+
+void DrawingDocument::PrepareToAppend(size_t lineCount, size_t segmentCount)
+{
+    if ( !IsSnapshotAttached() )
+        return;
+
+    // appending must neither reallocate the vectors nor overwrite any of the
+    // lines and offsets in the snapshot, which is possible if some segments
+    // were removed since it was taken
+    const DrawingSnapshot& snapshot = m_saver->GetSnapshot();
+    if ( m_lines.size() >= snapshot.GetLineCount() &&
+            m_segmentOffsets.size() > snapshot.GetSegmentCount() &&
+                m_segmentIds.size() >= snapshot.GetSegmentCount() &&
+                    m_lines.size() + lineCount <= m_lines.capacity() &&
+                        m_segmentOffsets.size() + segmentCount <=
+                            m_segmentOffsets.capacity() &&
+                                m_segmentIds.size() + segmentCount <=
+                                    m_segmentIds.capacity() )
+    {
+        return;
+    }
+
+    DetachSnapshot(lineCount, segmentCount);
+}
+
+void DrawingDocument::DetachSnapshot(size_t lineCount, size_t segmentCount)
+{
+    // this costs the same as reallocating the vectors when they grow, which
+    // is what happens most of the time anyhow
+    DoodleLines lines;
+    lines.reserve(wxMax(m_lines.size() + lineCount, 2*m_lines.capacity()));
+    lines.resize(m_lines.size());
+    if ( !m_lines.empty() )
+        memcpy(&lines[0], &m_lines[0], m_lines.size()*sizeof(DoodleLine));
+
+    DoodleOffsets offsets;
+    offsets.reserve(wxMax(m_segmentOffsets.size() + segmentCount,
+                          2*m_segmentOffsets.capacity()));
+    offsets.resize(m_segmentOffsets.size());
+    memcpy(&offsets[0], &m_segmentOffsets[0],
+           m_segmentOffsets.size()*sizeof(size_t));
+
+    DoodleSegmentIds ids;
+    ids.reserve(wxMax(m_segmentIds.size() + segmentCount,
+                      2*m_segmentIds.capacity()));
+    ids.resize(m_segmentIds.size());
+    if ( !m_segmentIds.empty() )
+    {
+        memcpy(&ids[0], &m_segmentIds[0],
+               m_segmentIds.size()*sizeof(DoodleSegmentId));
+    }
+
+    SwapSegments(lines, offsets, ids);
+}
+
+void DrawingDocument::DiscardLines()
+{
+    // the segments keep their ids
+    DoodleLines lines;
+    DoodleOffsets offsets(1, 0);
+    DoodleSegmentIds ids(m_segmentIds);
+    SwapSegments(lines, offsets, ids);
+}
+
+void DrawingDocument::SwapSegments(DoodleLines& lines,
+                                   DoodleOffsets& offsets,
+                                   DoodleSegmentIds& ids)
+{
+    m_lines.swap(lines);
+    m_segmentOffsets.swap(offsets);
+    m_segmentIds.swap(ids);
+
+    // the snapshot being saved may still use the old ones
+    if ( IsSnapshotAttached() )
+    {
+        m_saver->AdoptLines(lines, offsets, ids);
+        m_saverOwnsSnapshot = true;
+    }
+}
+
+void DrawingDocument::PrepareToChange(size_t n)
+{
+    if ( IsSnapshotAttached() && n < m_saver->GetSnapshot().GetSegmentCount() )
+        DetachSnapshot(0, 0);
+}
+
+void DrawingDocument::AssignSegmentIds()
+{
+    const size_t count = m_segmentOffsets.size() - 1;
+    ReserveMore(m_segmentIds, count - m_segmentIds.size(), count);
+
+    while ( m_segmentIds.size() < count )
+    {
+        m_segmentIds.push_back(m_segmentsById.size());
+        m_segmentsById.push_back(m_segmentIds.size() - 1);
+    }
+}
+
+void DrawingDocument::ResetSegmentIds()
+{
+    // the old ids are never reused, so that the commands referring to them
+    // can't affect the new segments
+    for ( size_t n = 0; n < m_segmentIds.size(); n++ )
+        m_segmentsById[m_segmentIds[n] & ~SEGMENT_DELETED] = NO_SEGMENT;
+
+    m_segmentIds.clear();
+    m_deletedSegments = 0;
+    m_deletedLines = 0;
+
+    AssignSegmentIds();
+}
+
+void DrawingDocument::AppendSegment(const DoodleSegmentSpan& segment,
+                                    DoodleSegmentId id)
+{
+    const size_t first = m_lines.size();
+    AppendLines(m_lines, segment);
+    m_segmentOffsets.push_back(m_lines.size());
+
+    m_segmentsById[id] = m_segmentIds.size();
+    m_segmentIds.push_back(id);
+
+    m_index->AddLines(first);
+}
+
+void DrawingDocument::TrimDeletedSegments()
+{
+    while ( !m_segmentIds.empty() && IsSegmentDeleted(m_segmentIds.size() - 1) )
+    {
+        m_segmentsById[m_segmentIds.back() & ~SEGMENT_DELETED] = NO_SEGMENT;
+        m_segmentIds.pop_back();
+        m_segmentOffsets.pop_back();
+
+        const size_t first = m_segmentOffsets.back();
+        m_deletedSegments--;
+        m_deletedLines -= m_lines.size() - first;
+        m_lines.resize(first);
+    }
+
+    m_detail->Truncate(m_segmentIds.size());
+
+    // keeping the deleted segments makes deleting them and undoing it cheap,
+    // but not at the price of using much more memory than needed
+    if ( 2*m_deletedLines > m_lines.size() ||
+            2*m_deletedSegments > m_segmentIds.size() )
+        PurgeDeletedSegments();
+}
+
+void DrawingDocument::PurgeDeletedSegments()
+{
+    if ( !m_deletedSegments )
+        return;
+
+    const size_t count = m_segmentIds.size() - m_deletedSegments;
+
+    DoodleLines lines;
+    lines.reserve(m_lines.size() - m_deletedLines);
+
+    DoodleOffsets offsets;
+    offsets.reserve(count + 1);
+    offsets.push_back(0);
+
+    DoodleSegmentIds ids;
+    ids.reserve(count);
+
+    const DoodleSegments segments = GetSegments();
+    for ( size_t n = 0; n < m_segmentIds.size(); n++ )
+    {
+        const DoodleSegmentId id = m_segmentIds[n];
+        if ( id & SEGMENT_DELETED )
+        {
+            m_segmentsById[id & ~SEGMENT_DELETED] = NO_SEGMENT;
+            continue;
+        }
+
+        m_segmentsById[id] = ids.size();
+        ids.push_back(id);
+
+        AppendLines(lines, segments[n]);
+        offsets.push_back(lines.size());
+    }
+
+    SwapSegments(lines, offsets, ids);
+
+    m_deletedSegments = 0;
+    m_deletedLines = 0;
+
+    // the indices of all lines after the first deleted one have changed
+    m_index->Clear();
+    m_index->AddLines(0);
+    m_detail->Clear();
+}
+
+bool DrawingDocument::LoadPacked(const char *data, size_t size)
+{
+    DrawingBinary::PackedHeader header;
+    if ( size < sizeof(header) )
+    {
+        wxLogWarning("Drawing document corrupted: truncated header.");
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(header));
+    header.segmentCount = wxUINT32_SWAP_ON_BE(header.segmentCount);
+    header.lineCount = wxUINT64_SWAP_ON_BE(header.lineCount);
+    header.dataSize = wxUINT64_SWAP_ON_BE(header.dataSize);
+
+    if ( size - sizeof(header) < header.dataSize )
+    {
+        wxLogWarning("Drawing document corrupted: truncated data.");
+        return false;
+    }
+
+    DoodlePackedReader
+        reader(reinterpret_cast<const unsigned char *>(data) + sizeof(header),
+               header.dataSize);
+
+    // every segment takes at least one byte and every line at least two, so
+    // this can't reserve too much even if the counts are bogus
+    DoodleLines lines;
+    lines.reserve(static_cast<size_t>(wxMin(header.lineCount,
+                                            header.dataSize/2)));
+
+    DoodleOffsets offsets;
+    offsets.reserve(static_cast<size_t>(
+                        wxMin(static_cast<wxUint64>(header.segmentCount),
+                              header.dataSize)) + 1);
+    offsets.push_back(0);
+
+    while ( reader.ReadSegment(lines) )
+        offsets.push_back(lines.size());
+
+    if ( !reader.IsOk() ||
+            offsets.size() - 1 != header.segmentCount ||
+                lines.size() != header.lineCount )
+    {
+        wxLogWarning("Drawing document corrupted: invalid packed segments.");
+        return false;
+    }
+
+    if ( !AreLinesValid(lines) )
+        return false;
+
+    m_lines.swap(lines);
+    m_segmentOffsets.swap(offsets);
+    ResetSegmentIds();
+
+    m_index->Clear();
+    m_index->AddLines(0);
+    m_detail->Clear();
+
+    return true;
+}
+
+void DrawingDocument::Compact()
+{
+    // the loader is still adding lines to the document
+    if ( m_compact || m_loader )
+        return;
+
+    // only the existing segments are packed
+    PurgeDeletedSegments();
+
+    DoodlePackedSegments * const packed = new DoodlePackedSegments;
+
+    const DoodleSegments segments = GetSegments();
+    for ( DoodleSegments::const_iterator i = segments.begin();
+          i != segments.end();
+          ++i )
+    {
+        packed->Add(*i);
+    }
+
+    packed->Shrink();
+
+    m_compactBounds = GetBounds();
+    m_compact = packed;
+
+    // free the memory used by the lines and everything derived from them
+    DiscardLines();
+    m_index->Clear();
+    m_detail->Clear();
+}
+
+void DrawingDocument::Expand()
+{
+    if ( !m_compact )
+        return;
+
+    m_lines.reserve(m_compact->GetLineCount());
+    m_segmentOffsets.reserve(m_compact->GetCount() + 1);
+    m_compact->Unpack(m_lines, m_segmentOffsets);
+
+    DiscardCompact();
+
+    m_index->AddLines(0);
+}
+
+void DrawingDocument::DiscardCompact()
+{
+    if ( !m_compact )
+        return;
+
+    // the snapshot being saved may still use them
+    if ( IsSnapshotAttached() )
+    {
+        m_saver->AdoptPacked(m_compact);
+        m_compact = NULL;
+        m_saverOwnsSnapshot = true;
+        return;
+    }
+
+    wxDELETE(m_compact);
+}
+
+void DrawingDocument::GetLinesInRect(const wxRect& rect,
+                                     DoodleLineIndices& lines) const
+{
+    m_index->QueryRect(rect, lines);
+}
+
+size_t DrawingDocument::GetSegmentOfLine(size_t line) const
+{
+    // find the first segment starting after this line, the line belongs to
+    // the one before it
+    return std::upper_bound(m_segmentOffsets.begin(),
+                            m_segmentOffsets.end(),
+                            line) - m_segmentOffsets.begin() - 1;
+}
+
+int DrawingDocument::HitTest(const wxPoint& pt, int tolerance) const
+{
+    // the lines of the deleted segments are not in the index
+    const int line = m_index->QueryPoint(pt, tolerance);
+
+    return line == wxNOT_FOUND ? wxNOT_FOUND : GetSegmentOfLine(line);
+}
+
+int DrawingDocument::FindSegment(DoodleSegmentId id) const
+{
+    if ( id >= m_segmentsById.size() )
+        return wxNOT_FOUND;
+
+    const wxUint32 n = m_segmentsById[id];
+    if ( n == NO_SEGMENT || IsSegmentDeleted(n) )
+        return wxNOT_FOUND;
+
+    return n;
+}
+
+DoodleSegmentId DrawingDocument::GetLastSegmentId() const
+{
+    // there are no deleted segments at the end unless they're all deleted
+    for ( size_t n = m_segmentIds.size(); n-- > 0; )
+    {
+        if ( !IsSegmentDeleted(n) )
+            return m_segmentIds[n];
+    }
+
+    return 0;
+}
+
+wxRect DrawingDocument::GetSegmentsBounds(const DoodleSegmentIds& ids) const
+{
+    wxASSERT_MSG( !m_compact, "compacted document must be expanded" );
+
+    wxRect rect;
+    for ( size_t i = 0; i < ids.size(); i++ )
+    {
+        const int n = FindSegment(ids[i]);
+        wxCHECK_MSG( n != wxNOT_FOUND, rect, "no segment with this id" );
+
+        const size_t first = m_segmentOffsets[n];
+        rect.Union(GetLinesBounds(first, m_segmentOffsets[n + 1] - first));
+    }
+
+    return rect;
+}
+
+wxRect DrawingDocument::GetBounds() const
+{
+    return m_compact ? m_compactBounds : m_index->GetBounds();
+}
+
+const DoodleSimplified&
+DrawingDocument::GetSimplifiedSegment(size_t n, int level)
+{
+    return m_detail->Get(GetSegments()[n], n, level);
+}
+
+void DrawingDocument::DoUpdate(const wxRect& rect)
+{
+    Modify(true);
+    m_changeCount++;
+
+    DrawingUpdateHint hint(rect);
+    UpdateAllViews(NULL, &hint);
+}
+
+wxRect DrawingDocument::GetLinesBounds(size_t first, size_t count) const
+{
+    if ( !count )
+        return wxRect();
+
+    wxInt32 left = m_lines[first].x1,
+            top = m_lines[first].y1,
+            right = left,
+            bottom = top;
+    for ( size_t n = first; n < first + count; n++ )
+    {
+        const DoodleLine& line = m_lines[n];
+
+        left = wxMin(left, wxMin(line.x1, line.x2));
+        right = wxMax(right, wxMax(line.x1, line.x2));
+        top = wxMin(top, wxMin(line.y1, line.y2));
+        bottom = wxMax(bottom, wxMax(line.y1, line.y2));
+    }
+
+    return wxRect(left, top, right - left + 1, bottom - top + 1);
+}
+
+void DrawingDocument::AddDoodleSegment(const DoodleSegment& segment)
+{
+    Expand();
+
+    const DoodleLines& lines = segment.GetLines();
+    PrepareToAppend(lines.size(), 1);
+
+    const size_t first = m_lines.size();
+    m_lines.resize(first + lines.size());
+    if ( !lines.empty() )
+        memcpy(&m_lines[first], &lines[0], lines.size()*sizeof(DoodleLine));
+
+    m_segmentOffsets.push_back(m_lines.size());
+    AssignSegmentIds();
+
+    m_index->AddLines(first);
+
+    DoUpdate(GetLinesBounds(first, lines.size()));
+}
+
+void DrawingDocument::AddDoodleSegments(const DoodleSegments& segments,
+                                        DoodleSegmentIds *ids)
+{
+    Expand();
+    PrepareToAppend(segments.GetFirstLine(segments.size()) -
+                        segments.GetFirstLine(0),
+                    segments.size());
+
+    const size_t first = m_lines.size();
+    const size_t firstSegment = m_segmentIds.size();
+
+    for ( DoodleSegments::const_iterator i = segments.begin();
+          i != segments.end();
+          ++i )
+    {
+        AppendLines(m_lines, *i);
+        m_segmentOffsets.push_back(m_lines.size());
+    }
+
+    AssignSegmentIds();
+    if ( ids )
+    {
+        for ( size_t n = firstSegment; n < m_segmentIds.size(); n++ )
+            ids->push_back(m_segmentIds[n]);
+    }
+
+    m_index->AddLines(first);
+
+    DoUpdate(GetLinesBounds(first, m_lines.size() - first));
+}
+
+void DrawingDocument::RestoreSegments(const DoodleSegments& segments,
+                                      const DoodleSegmentIds& ids)
+{
+    wxCHECK_RET( segments.size() == ids.size(), "wrong number of segment ids" );
+
+    Expand();
+    PrepareToAppend(segments.GetFirstLine(segments.size()) -
+                        segments.GetFirstLine(0),
+                    segments.size());
+
+    wxRect rect;
+    for ( size_t i = 0; i < ids.size(); i++ )
+    {
+        const DoodleSegmentId id = ids[i];
+        wxCHECK2_MSG( id && id < m_segmentsById.size(), continue,
+                      "invalid segment id" );
+
+        const wxUint32 n = m_segmentsById[id];
+        if ( n == NO_SEGMENT )
+        {
+            // its place was reclaimed, so put it on top of everything
+            const size_t first = m_lines.size();
+            AppendSegment(segments[i], id);
+            rect.Union(GetLinesBounds(first, m_lines.size() - first));
+            continue;
+        }
+
+        wxCHECK2_MSG( IsSegmentDeleted(n), continue, "segment not deleted" );
+
+        // its lines are still there, it just needs to be undeleted
+        PrepareToChange(n);
+
+        const size_t first = m_segmentOffsets[n],
+                     count = m_segmentOffsets[n + 1] - first;
+
+        m_segmentIds[n] = id;
+        m_deletedSegments--;
+        m_deletedLines -= count;
+
+        m_index->InsertLines(first, count);
+        rect.Union(GetLinesBounds(first, count));
+    }
+
+    DoUpdate(rect);
+}
+
+bool DrawingDocument::DeleteSegments(const DoodleSegmentIds& ids)
+{
+    Expand();
+
+    for ( size_t i = 0; i < ids.size(); i++ )
+    {
+        if ( FindSegment(ids[i]) == wxNOT_FOUND )
+            return false;
+    }
+
+    wxRect rect;
+    for ( size_t i = 0; i < ids.size(); i++ )
+    {
+        // the same segment could be given more than once
+        const size_t n = m_segmentsById[ids[i]];
+        if ( IsSegmentDeleted(n) )
+            continue;
+
+        PrepareToChange(n);
+
+        const size_t first = m_segmentOffsets[n],
+                     count = m_segmentOffsets[n + 1] - first;
+        rect.Union(GetLinesBounds(first, count));
+
+        // the lines are only removed from the index, so that the indices of
+        // the other ones don't change
+        m_index->RemoveLines(first, count);
+
+        m_segmentIds[n] |= SEGMENT_DELETED;
+        m_deletedSegments++;
+        m_deletedLines += count;
+    }
+
+    TrimDeletedSegments();
+
+    DoUpdate(rect);
+
+    return true;
+}
+
+bool DrawingDocument::MoveSegments(const DoodleSegmentIds& ids, int dx, int dy)
+{
+    Expand();
+
+    wxRect bounds;
+    for ( size_t i = 0; i < ids.size(); i++ )
+    {
+        const int n = FindSegment(ids[i]);
+        if ( n == wxNOT_FOUND )
+            return false;
+
+        const size_t first = m_segmentOffsets[n];
+        bounds.Union(GetLinesBounds(first, m_segmentOffsets[n + 1] - first));
+    }
+
+    // refuse to move the lines outside of the range of valid coordinates
+    const wxLongLong_t moveX = dx,
+                       moveY = dy;
+    if ( !bounds.IsEmpty() &&
+            !(DoodleLine::IsValidCoord(bounds.x + moveX) &&
+              DoodleLine::IsValidCoord(bounds.GetRight() + moveX) &&
+              DoodleLine::IsValidCoord(bounds.y + moveY) &&
+              DoodleLine::IsValidCoord(bounds.GetBottom() + moveY)) )
+    {
+        return false;
+    }
+
+    wxRect rect;
+    for ( size_t i = 0; i < ids.size(); i++ )
+    {
+        const size_t n = m_segmentsById[ids[i]];
+        PrepareToChange(n);
+
+        const size_t first = m_segmentOffsets[n],
+                     count = m_segmentOffsets[n + 1] - first;
+        rect.Union(GetLinesBounds(first, count));
+
+        // the segment keeps its place, only its lines are moved
+        m_index->RemoveLines(first, count);
+        for ( size_t l = first; l < first + count; l++ )
+        {
+            DoodleLine& line = m_lines[l];
+            line.x1 += dx;
+            line.y1 += dy;
+            line.x2 += dx;
+            line.y2 += dy;
+        }
+        m_index->InsertLines(first, count);
+
+        m_detail->Forget(n);
+
+        rect.Union(GetLinesBounds(first, count));
+    }
+
+    DoUpdate(rect);
+
+    return true;
+}
+
+bool DrawingDocument::PopLastSegment(DoodleSegment *segment)
+{
+    Expand();
+
+    const DoodleSegmentId id = GetLastSegmentId();
+    if ( !id )
+        return false;
+
+    if ( segment )
+    {
+        const size_t n = m_segmentsById[id];
+        const size_t first = m_segmentOffsets[n],
+                     count = m_segmentOffsets[n + 1] - first;
+        segment->AssignLines(count ? &m_lines[first] : NULL, count);
+    }
+
+    return DeleteSegments(DoodleSegmentIds(1, id));
+}
+
+bool DrawingDocument::RemoveLastSegments(size_t count)
+{
+    Expand();
+
+    if ( !count || GetSegmentCount() < count )
+        return false;
+
+    DoodleSegmentIds ids;
+    ids.reserve(count);
+    for ( size_t n = m_segmentIds.size(); ids.size() < count; )
+    {
+        if ( !IsSegmentDeleted(--n) )
+            ids.push_back(m_segmentIds[n]);
+    }
+
+    return DeleteSegments(ids);
+}
+
+// ----------------------------------------------------------------------------
+// DoodleSegment implementation
+// ----------------------------------------------------------------------------
+
+DocumentOstream& DoodleSegmentSpan::SaveObject(DocumentOstream& ostream) const
+{
+#if wxUSE_STD_IOSTREAM
+    DocumentOstream& stream = ostream;
+#else
+    wxTextOutputStream stream(ostream);
+#endif
+
+    const wxInt32 count = m_count;
+    stream << count << '\n';
+
+    for ( int n = 0; n < count; n++ )
+    {
+        const DoodleLine& line = m_lines[n];
+        stream
+            << line.x1 << ' '
+            << line.y1 << ' '
+            << line.x2 << ' '
+            << line.y2 << '\n';
+    }
+
+    return ostream;
+}
+
+DocumentOstream& DoodleSegment::SaveObject(DocumentOstream& ostream)
+{
+    return DoodleSegmentSpan(m_lines.empty() ? NULL : &m_lines[0],
+                             m_lines.size()).SaveObject(ostream);
+}
+
+DocumentIstream& DoodleSegment::LoadObject(DocumentIstream& istream)
+{
+    return LoadLines(istream, m_lines);
+}
+
+/* static */
+DocumentIstream& DoodleSegment::LoadLines(DocumentIstream& istream,
+                                          DoodleLines& lines)
+{
+#if wxUSE_STD_IOSTREAM
+    DocumentIstream& stream = istream;
+#else
+    wxTextInputStream stream(istream);
+#endif
+
+    wxInt32 count = 0;
+    stream >> count;
+    if ( count < 0 )
+    {
+        wxLogWarning("Drawing document corrupted: invalid lines count.");
+#if wxUSE_STD_IOSTREAM
+        istream.clear(std::ios::badbit);
+#else
+        istream.Reset(wxSTREAM_READ_ERROR);
+#endif
+        return istream;
+    }
+
+    ReserveMore(lines, count, MAX_RESERVED_LINES);
+
+    for ( int n = 0; n < count && IsStreamOk(istream); n++ )
+    {
+        DoodleLine line;
+        stream
+            >> line.x1
+            >> line.y1
+            >> line.x2
+            >> line.y2;
+
+        if ( IsStreamOk(istream) && !line.IsValid() )
+        {
+            wxLogWarning("Drawing document corrupted: invalid coordinates.");
+#if wxUSE_STD_IOSTREAM
+            istream.clear(std::ios::badbit);
+#else
+            istream.Reset(wxSTREAM_READ_ERROR);
+#endif
+            break;
+        }
+
+        lines.push_back(line);
     }
 
     return istream;
 }
 
+void DoodleSegment::Clear()
+{
+    // clear() doesn't free the memory, but swapping with an empty vector does
+    DoodleLines().swap(m_lines);
+}
+
+void DoodleSegment::AssignLines(const DoodleLine *lines, size_t count)
+{
+    m_lines.resize(count);
+    if ( !count )
+        return;
+
+    memcpy(&m_lines[0], lines, count*sizeof(DoodleLine));
+}
+
+// ----------------------------------------------------------------------------
+// DoodlePackedSegments implementation
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// append the value using 7 bits per byte, with the high bit set in all bytes
+// except the last one
+void PutVarint(wxVector<unsigned char>& data, wxUint64 value)
+{
+    while ( value >= 0x80 )
+    {
+        data.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+
+    data.push_back(static_cast<unsigned char>(value));
+}
+
+// the differences between two 32-bit coordinates need 33 bits, and zigzag
+// encoding maps them to unsigned numbers, with the small negative ones
+// becoming small too: 0, -1, 1, -2, 2, ... are mapped to 0, 1, 2, 3, 4, ...
+void PutDelta(wxVector<unsigned char>& data, wxInt64 delta)
+{
+    PutVarint(data, (static_cast<wxUint64>(delta) << 1) ^
+                        static_cast<wxUint64>(delta >> 63));
+}
+
+} // anonymous namespace
+
+void DoodlePackedSegments::Add(const DoodleSegmentSpan& segment)
+{
+    const size_t count = segment.GetCount();
+
+    bool connected = true;
+    for ( size_t n = 1; n < count && connected; n++ )
+    {
+        connected = segment[n].x1 == segment[n - 1].x2 &&
+                        segment[n].y1 == segment[n - 1].y2;
+    }
+
+    PutVarint(m_data, (static_cast<wxUint64>(count) << 1) | connected);
+
+    // the lines of each segment are stored independently of the other ones,
+    // so that the segments can be appended to each other without re-encoding
+    wxInt64 x = 0,
+            y = 0;
+    for ( size_t n = 0; n < count; n++ )
+    {
+        const DoodleLine& line = segment[n];
+
+        // only the first line of a connected segment starts at a new point
+        if ( !connected || n == 0 )
+        {
+            PutDelta(m_data, line.x1 - x);
+            PutDelta(m_data, line.y1 - y);
+        }
+
+        PutDelta(m_data, static_cast<wxInt64>(line.x2) - line.x1);
+        PutDelta(m_data, static_cast<wxInt64>(line.y2) - line.y1);
+
+        x = line.x2;
+        y = line.y2;
+    }
+
+    m_count++;
+    m_lineCount += count;
+}
+
+void DoodlePackedSegments::Append(const DoodlePackedSegments& other)
+{
+    m_data.reserve(m_data.size() + other.m_data.size());
+    for ( size_t n = 0; n < other.m_data.size(); n++ )
+        m_data.push_back(other.m_data[n]);
+
+    m_count += other.m_count;
+    m_lineCount += other.m_lineCount;
+}
+
+void DoodlePackedSegments::Unpack(DoodleLines& lines,
+                                  DoodleOffsets& offsets) const
+{
+    DoodlePackedReader reader(*this);
+    while ( reader.ReadSegment(lines) )
+        offsets.push_back(lines.size());
+
+    wxASSERT_MSG( reader.IsOk(), "packed segments corrupted" );
+}
+
+void DoodlePackedSegments::Swap(DoodlePackedSegments& other)
+{
+    m_data.swap(other.m_data);
+
+    const size_t count = m_count;
+    m_count = other.m_count;
+    other.m_count = count;
+
+    const size_t lineCount = m_lineCount;
+    m_lineCount = other.m_lineCount;
+    other.m_lineCount = lineCount;
+}
+
+void DoodlePackedSegments::Clear()
+{
+    wxVector<unsigned char>().swap(m_data);
+    m_count = 0;
+    m_lineCount = 0;
+}
+
+void DoodlePackedSegments::Shrink()
+{
+    // the copy only allocates as much memory as it needs
+    wxVector<unsigned char>(m_data).swap(m_data);
+}
+
+// ----------------------------------------------------------------------------
+// DoodlePackedReader implementation
+// ----------------------------------------------------------------------------
+
+bool DoodlePackedReader::ReadVarint(wxUint64& value)
+{
+    value = 0;
+    for ( int shift = 0; shift < 64; shift += 7 )
+    {
+        if ( m_p == m_end )
+            return false;
+
+        const unsigned char byte = *m_p++;
+        value |= static_cast<wxUint64>(byte & 0x7f) << shift;
+        if ( !(byte & 0x80) )
+            return true;
+    }
+
+    // too many bytes for a 64-bit value
+    return false;
+}
+
+bool DoodlePackedReader::ReadDelta(wxInt64& delta)
+{
+    wxUint64 value;
+    if ( !ReadVarint(value) )
+        return false;
+
+    delta = static_cast<wxInt64>(value >> 1) ^ -static_cast<wxInt64>(value & 1);
+    return true;
+}
+
+bool DoodlePackedReader::ReadCoord(wxInt64& coord)
+{
+    // the differences between 32-bit coordinates always fit in 33 bits
+    static const wxInt64 MAX_DELTA = static_cast<wxInt64>(1) << 32;
+
+    wxInt64 delta;
+    if ( !ReadDelta(delta) || delta < -MAX_DELTA || delta > MAX_DELTA )
+        return false;
+
+    coord += delta;
+    return coord >= wxINT32_MIN && coord <= wxINT32_MAX;
+}
+
+bool DoodlePackedReader::ReadSegment(DoodleLines& lines)
+{
+    if ( m_p == m_end )
+        return false;
+
+    wxUint64 header;
+    if ( !ReadVarint(header) )
+    {
+        m_ok = false;
+        return false;
+    }
+
+    const wxUint64 count = header >> 1;
+    const bool connected = (header & 1) != 0;
+
+    // every line takes at least two bytes, so the count can be checked before
+    // using it to reserve memory
+    if ( count > static_cast<wxUint64>(m_end - m_p)/2 )
+    {
+        m_ok = false;
+        return false;
+    }
+
+    ReserveMore(lines, count, MAX_RESERVED_LINES);
+
+    wxInt64 x = 0,
+            y = 0;
+    for ( wxUint64 n = 0; n < count; n++ )
+    {
+        DoodleLine line;
+
+        if ( !connected || n == 0 )
+        {
+            if ( !ReadCoord(x) || !ReadCoord(y) )
+            {
+                m_ok = false;
+                return false;
+            }
+        }
+
+        line.x1 = static_cast<wxInt32>(x);
+        line.y1 = static_cast<wxInt32>(y);
+
+        if ( !ReadCoord(x) || !ReadCoord(y) )
+        {
+            m_ok = false;
+            return false;
+        }
+
+        line.x2 = static_cast<wxInt32>(x);
+        line.y2 = static_cast<wxInt32>(y);
+
+        lines.push_back(line);
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// DrawingCommand implementation
+// ----------------------------------------------------------------------------
+
+IMPLEMENT_ABSTRACT_CLASS(DrawingCommand, wxCommand)
+IMPLEMENT_ABSTRACT_CLASS(DrawingSegmentsCommand, DrawingCommand)
+IMPLEMENT_CLASS(DrawingMoveSegmentsCommand, DrawingCommand)
+
+DrawingSegmentsCommand::DrawingSegmentsCommand(DrawingDocument *doc,
+                                               const wxString& name,
+                                               DoodleSegment *segment)
+    : DrawingCommand(doc, name)
+{
+    if ( segment )
+    {
+        const DoodleLines& lines = segment->GetLines();
+        m_segments.Add(DoodleSegmentSpan(lines.empty() ? NULL : &lines[0],
+                                         lines.size()));
+        segment->Clear();
+    }
+}
+
+DrawingSegmentsCommand::DrawingSegmentsCommand(DrawingDocument *doc,
+                                               const wxString& name,
+                                               const DoodleSegmentSpan& span)
+    : DrawingCommand(doc, name)
+{
+    m_segments.Add(span);
+}
+
+DrawingSegmentsCommand::DrawingSegmentsCommand(DrawingDocument *doc,
+                                               const wxString& name,
+                                               const DoodleSegmentIds& ids)
+    : DrawingCommand(doc, name)
+{
+    m_ids = ids;
+}
+
+bool DrawingSegmentsCommand::Merge(DrawingCommand& command)
+{
+    DrawingSegmentsCommand * const
+        next = wxDynamicCast(&command, DrawingSegmentsCommand);
+    if ( !next ||
+            next->m_doc != m_doc ||
+                !CanMerge() || !next->CanMerge() ||
+                    next->RemovesSegments() != RemovesSegments() )
+        return false;
+
+    if ( RemovesSegments() )
+    {
+        // the segments removed by the next command usually came before ours
+        // in the document, so they must be added back before them
+        next->m_segments.Append(m_segments);
+        m_segments.Swap(next->m_segments);
+
+        for ( size_t i = 0; i < m_ids.size(); i++ )
+            next->m_ids.push_back(m_ids[i]);
+        m_ids.swap(next->m_ids);
+    }
+    else
+    {
+        m_segments.Append(next->m_segments);
+        for ( size_t i = 0; i < next->m_ids.size(); i++ )
+            m_ids.push_back(next->m_ids[i]);
+    }
+
+    return true;
+}
+
+bool DrawingSegmentsCommand::DoAdd()
+{
+    DoodleLines lines;
+    DoodleOffsets offsets;
+    offsets.push_back(0);
+    m_segments.Unpack(lines, offsets);
+
+    // the segments only get their ids when they're added for the first time
+    const DoodleSegments segments(lines, offsets);
+    if ( m_ids.empty() )
+        m_doc->AddDoodleSegments(segments, &m_ids);
+    else
+        m_doc->RestoreSegments(segments, m_ids);
+
+    m_segments.Clear();
+
+    return true;
+}
+
+bool DrawingSegmentsCommand::DoRemove()
+{
+    m_doc->Expand();
+
+    // the command removing the last segment only knows which one it is once
+    // it's done for the first time
+    if ( m_ids.empty() )
+    {
+        const DoodleSegmentId id = m_doc->GetLastSegmentId();
+        if ( !id )
+            return false;
+
+        m_ids.push_back(id);
+    }
+
+    // keep the segments in the order in which they're drawn, so that they
+    // are drawn in the same order if they have to be added back on top
+    std::sort(m_ids.begin(), m_ids.end(), SegmentOrder(*m_doc));
+
+    const DoodleSegments segments = m_doc->GetSegments();
+    for ( size_t i = 0; i < m_ids.size(); i++ )
+    {
+        const int n = m_doc->FindSegment(m_ids[i]);
+        if ( n == wxNOT_FOUND )
+        {
+            m_segments.Clear();
+            return false;
+        }
+
+        m_segments.Add(segments[n]);
+    }
+
+    return m_doc->DeleteSegments(m_ids);
+}
+
+DrawingMoveSegmentsCommand::DrawingMoveSegmentsCommand(
+        DrawingDocument *doc,
+        const DoodleSegmentIds& ids,
+        int dx,
+        int dy)
+    : DrawingCommand(doc, "Move segments"),
+      m_dx(dx),
+      m_dy(dy)
+{
+    m_ids = ids;
+}
+
+bool DrawingMoveSegmentsCommand::Merge(DrawingCommand& command)
+{
+    DrawingMoveSegmentsCommand * const
+        next = wxDynamicCast(&command, DrawingMoveSegmentsCommand);
+    if ( !next ||
+            next->m_doc != m_doc ||
+                next->m_ids.size() != m_ids.size() ||
+                    !std::equal(m_ids.begin(), m_ids.end(),
+                                next->m_ids.begin()) )
+        return false;
+
+    m_dx += next->m_dx;
+    m_dy += next->m_dy;
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// SurveyDocument implementation
+// ----------------------------------------------------------------------------
+
+IMPLEMENT_DYNAMIC_CLASS(SurveyDocument, wxDocument)
+
+namespace
+{
+
+// the powers of 10 which are exactly representable as doubles
+const double POWERS_OF_10[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const int MAX_EXACT_POWER_OF_10 = WXSIZEOF(POWERS_OF_10) - 1;
+
+bool IsFieldSeparator(char ch)
+{
+    return ch == ',' || ch == ';' || ch == '\t';
+}
+
+#ifdef CORROLINX_USE_SSE2
+
+// return the mask with the bits set for the field separators among the 16
+// characters starting at p
+inline unsigned FindFieldSeparatorsSSE2(const char *p)
+{
+    const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const __m128i found = _mm_or_si128
+                          (
+                            _mm_or_si128
+                            (
+                                _mm_cmpeq_epi8(chars, _mm_set1_epi8(',')),
+                                _mm_cmpeq_epi8(chars, _mm_set1_epi8(';'))
+                            ),
+                            _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t'))
+                          );
+
+    return static_cast<unsigned>(_mm_movemask_epi8(found));
+}
+
+// return the index of the lowest bit set in a non-zero mask
+inline unsigned GetLowestBit(unsigned mask)
+{
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    unsigned n = 0;
+    for ( ; !(mask & 1); mask >>= 1 )
+        n++;
+    return n;
+#endif
+}
+
+#endif // CORROLINX_USE_SSE2
+
+// parse a single reading occupying the entire [p, end) range except for the
+// surrounding spaces, an empty field is a missing reading
+//
+// this doesn't use strtod() which depends on the current locale and is slow
+bool ParseReading(const char *p, const char *end, float& value)
+{
+    while ( p != end && *p == ' ' )
+        p++;
+    while ( p != end && end[-1] == ' ' )
+        end--;
+
+    if ( p == end )
+    {
+        value = SurveyGrid::GetMissingValue();
+        return true;
+    }
+
+    bool negative = false;
+    if ( *p == '-' || *p == '+' )
+        negative = *p++ == '-';
+
+    // accumulate up to 18 significant digits, which is more than enough for
+    // a float, and just count the other ones
+    wxUint64 mantissa = 0;
+    int digits = 0,
+        exponent = 0;
+    bool hasDigits = false;
+
+    for ( ; p != end && *p >= '0' && *p <= '9'; p++ )
+    {
+        hasDigits = true;
+        if ( digits < 18 )
+        {
+            mantissa = mantissa*10 + (*p - '0');
+            if ( mantissa )
+                digits++;
+        }
+        else
+        {
+            exponent++;
+        }
+    }
+
+    if ( p != end && *p == '.' )
+    {
+        for ( p++; p != end && *p >= '0' && *p <= '9'; p++ )
+        {
+            hasDigits = true;
+            if ( digits < 18 )
+            {
+                mantissa = mantissa*10 + (*p - '0');
+                if ( mantissa )
+                    digits++;
+                exponent--;
+            }
+        }
+    }
+
+    if ( !hasDigits )
+        return false;
+
+    if ( p != end && (*p == 'e' || *p == 'E') )
+    {
+        p++;
+
+        bool negativeExp = false;
+        if ( p != end && (*p == '-' || *p == '+') )
+            negativeExp = *p++ == '-';
+
+        if ( p == end || *p < '0' || *p > '9' )
+            return false;
+
+        int exp = 0;
+        for ( ; p != end && *p >= '0' && *p <= '9'; p++ )
+        {
+            if ( exp < 10000 )
+                exp = exp*10 + (*p - '0');
+        }
+
+        exponent += negativeExp ? -exp : exp;
+    }
+
+    if ( p != end )
+        return false;
+
+    // dividing by an exact power of 10 is both faster than calling pow() and
+    // correctly rounded, which is all that matters for the usual readings
+    // with only a few decimal digits
+    double result = static_cast<double>(mantissa);
+    if ( exponent < 0 && exponent >= -MAX_EXACT_POWER_OF_10 )
+        result /= POWERS_OF_10[-exponent];
+    else if ( exponent > 0 && exponent <= MAX_EXACT_POWER_OF_10 )
+        result *= POWERS_OF_10[exponent];
+    else if ( exponent )
+        result *= pow(10., exponent);
+
+    value = static_cast<float>(negative ? -result : result);
+
+    return true;
+}
+
+// parse the reading in [p, end) and append it to the values
+inline bool AddReading(const char *p, const char *end, wxVector<float>& values)
+{
+    float value;
+    if ( !ParseReading(p, end, value) )
+        return false;
+
+    values.push_back(value);
+
+    return true;
+}
+
+// parse all readings of the line [p, eol), not including the line terminator,
+// and append them to the values
+bool ParseReadingsLine(const char *p, const char *eol, wxVector<float>& values)
+{
+    const char *field = p;
+
+#ifdef CORROLINX_USE_SSE2
+    // find the separators in the blocks of 16 characters at once, which is
+    // much faster than checking them one by one for the long lines
+    for ( ; eol - p >= 16; p += 16 )
+    {
+        for ( unsigned mask = FindFieldSeparatorsSSE2(p);
+              mask;
+              mask &= mask - 1 )
+        {
+            const char * const sep = p + GetLowestBit(mask);
+            if ( !AddReading(field, sep, values) )
+                return false;
+
+            field = sep + 1;
+        }
+    }
+#endif // CORROLINX_USE_SSE2
+
+    for ( ; p != eol; p++ )
+    {
+        if ( IsFieldSeparator(*p) )
+        {
+            if ( !AddReading(field, p, values) )
+                return false;
+
+            field = p + 1;
+        }
+    }
+
+    return AddReading(field, eol, values);
+}
+
+// parse a metadata line, without the leading '#', into the grid
+void ParseSurveyMetadata(const wxString& line, SurveyGrid& grid)
+{
+    wxString value;
+    const wxString key = line.BeforeFirst(':', &value).Trim().Trim(false);
+    value.Trim().Trim(false);
+
+    if ( key.CmpNoCase("units") == 0 )
+    {
+        grid.SetUnits(value);
+        return;
+    }
+
+    double x, y;
+    wxString second;
+    const wxString first = value.BeforeFirst(',', &second).Trim();
+    if ( !first.ToCDouble(&x) )
+        return;
+    if ( second.empty() )
+        y = x;
+    else if ( !second.Trim(false).ToCDouble(&y) )
+        return;
+
+    if ( key.CmpNoCase("spacing") == 0 )
+    {
+        if ( x > 0 && y > 0 )
+            grid.SetSpacing(x, y);
+    }
+    else if ( key.CmpNoCase("origin") == 0 )
+    {
+        grid.SetOrigin(x, y);
+    }
+}
+
+// format a reading with 0.01 mV resolution into the buffer, which must be
+// big enough, and return the pointer to its end; missing readings are empty
+//
+// this is used instead of sprintf() because it doesn't depend on the locale
+char *FormatReading(float value, char *buf)
+{
+    if ( SurveyGrid::IsMissing(value) )
+        return buf;
+
+    double scaled = value*100.;
+    const bool negative = scaled < 0;
+    if ( negative )
+        scaled = -scaled;
+
+    // this is certainly not a real reading, but still save it correctly
+    if ( scaled >= 1e18 )
+    {
+        if ( negative )
+            *buf++ = '-';
+        const wxString s = wxString::FromCDouble(fabs(value));
+        for ( wxString::const_iterator i = s.begin(); i != s.end(); ++i )
+            *buf++ = static_cast<char>(*i);
+        return buf;
+    }
+
+    const wxUint64 n = static_cast<wxUint64>(scaled + 0.5);
+
+    // don't write "-0" for the small negative values rounded to zero
+    if ( negative && n )
+        *buf++ = '-';
+
+    char digits[24];
+    int len = 0;
+    for ( wxUint64 integral = n/100; ; integral /= 10 )
+    {
+        digits[len++] = static_cast<char>('0' + integral % 10);
+        if ( integral < 10 )
+            break;
+    }
+
+    while ( len )
+        *buf++ = digits[--len];
+
+    const unsigned fraction = static_cast<unsigned>(n % 100);
+    if ( fraction )
+    {
+        *buf++ = '.';
+        *buf++ = static_cast<char>('0' + fraction/10);
+        if ( fraction % 10 )
+            *buf++ = static_cast<char>('0' + fraction % 10);
+    }
+
+    return buf;
+}
+
+} // anonymous namespace
+
+bool SurveyDocument::DoOpenDocument(const wxString& filename)
+{
+    MappedFile file;
+    if ( !file.Open(filename) )
+        return false;
+
+    if ( !LoadCSV(file.GetData(), file.GetSize()) )
+    {
+        wxLogError("Failed to read survey from the file \"%s\".", filename);
+        return false;
+    }
+
+    return true;
+}
+
+bool SurveyDocument::DoSaveDocument(const wxString& filename)
+{
+    return SaveCSV(filename);
+}
+
+void SurveyDocument::SetReading(int x, int y, float value)
+{
+    const float old = m_grid.GetValue(x, y);
+    m_grid.SetValue(x, y, value);
+
+    if ( !m_stats.Replace(old, value) )
+        m_stats.Compute(m_grid);
+
+    Modify(true);
+
+    DrawingUpdateHint hint(wxRect(x, y, 1, 1));
+    UpdateAllViews(NULL, &hint);
+}
+
+bool SurveyDocument::LoadCSV(const char *data, size_t size)
+{
+    SurveyGrid grid;
+    SurveyStatistics stats;
+    if ( !ParseCSV(data, size, grid, stats) )
+        return false;
+
+    m_grid.Swap(grid);
+    m_stats = stats;
+
+    return true;
+}
+
+/* static */
+bool SurveyDocument::ParseCSV(const char *data,
+                              size_t size,
+                              SurveyGrid& grid,
+                              SurveyStatistics& stats)
+{
+    wxVector<float> values;
+    size_t width = 0,
+           height = 0;
+    bool headerAllowed = true;
+
+    const char *p = data;
+    const char * const end = data + size;
+    for ( unsigned long lineNum = 1; p != end; lineNum++ )
+    {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if ( !eol )
+            eol = end;
+
+        const char * const next = eol == end ? end : eol + 1;
+        if ( eol != p && eol[-1] == '\r' )
+            eol--;
+
+        if ( p == eol )
+        {
+            p = next;
+            continue;
+        }
+
+        if ( *p == '#' )
+        {
+            ParseSurveyMetadata(wxString::FromUTF8(p + 1, eol - p - 1), grid);
+            p = next;
+            continue;
+        }
+
+        const size_t rowStart = values.size();
+        const bool ok = ParseReadingsLine(p, eol, values);
+        const size_t lineLength = next - p;
+        const size_t remaining = end - p;
+        p = next;
+
+        if ( !ok )
+        {
+            // the column names may precede the readings
+            if ( headerAllowed )
+            {
+                values.resize(rowStart);
+                headerAllowed = false;
+                continue;
+            }
+
+            wxLogWarning("Survey corrupted: invalid reading in line %lu.",
+                         lineNum);
+            return false;
+        }
+
+        headerAllowed = false;
+
+        // the first row determines the width of the grid and the shorter
+        // rows are padded with missing readings
+        const size_t columns = values.size() - rowStart;
+        if ( !width )
+        {
+            width = columns;
+
+            // assume that all the remaining lines are about as long as the
+            // first row of readings, and not the header or the metadata
+            // before it, to avoid reallocating the readings many times, but
+            // don't reserve more than one reading per remaining character
+            const size_t rows = remaining/lineLength + 1;
+            values.reserve(wxMin(rows*width, remaining + width));
+        }
+        else if ( columns > width )
+        {
+            wxLogWarning("Survey corrupted: too many readings in line %lu.",
+                         lineNum);
+            return false;
+        }
+        else
+        {
+            values.resize(rowStart + width, SurveyGrid::GetMissingValue());
+        }
+
+        // the statistics are computed while the row is still in the cache
+        stats.Add(&values[rowStart], width);
+
+        height++;
+    }
+
+    if ( !height )
+    {
+        wxLogWarning("Survey doesn't contain any readings.");
+        return false;
+    }
+
+    grid.SetValues(width, height, values);
+
+    return true;
+}
+
+bool SurveyDocument::SaveCSV(const wxString& filename) const
+{
+    wxFFile file(filename, "w");
+    if ( !file.IsOpened() )
+        return false;
+
+    wxString header;
+    header << "# spacing: " << wxString::FromCDouble(m_grid.GetSpacingX())
+           << ", " << wxString::FromCDouble(m_grid.GetSpacingY()) << '\n'
+           << "# origin: " << wxString::FromCDouble(m_grid.GetOriginX())
+           << ", " << wxString::FromCDouble(m_grid.GetOriginY()) << '\n';
+    if ( !m_grid.GetUnits().empty() )
+        header << "# units: " << m_grid.GetUnits() << '\n';
+
+    if ( !file.Write(header, wxConvUTF8) )
+        return false;
+
+    // every reading takes at most 32 characters including the separator
+    const size_t width = m_grid.GetWidth();
+    wxVector<char> buf(width*32 + 1);
+
+    for ( size_t y = 0; y < m_grid.GetHeight(); y++ )
+    {
+        const float * const row = m_grid.GetRow(y);
+
+        char *p = &buf[0];
+        for ( size_t x = 0; x < width; x++ )
+        {
+            if ( x )
+                *p++ = ',';
+            p = FormatReading(row[x], p);
+        }
+        *p++ = '\n';
+
+        const size_t len = p - &buf[0];
+        if ( file.Write(&buf[0], len) != len )
+            return false;
+    }
+
+    return file.Close();
+}
+
 // ----------------------------------------------------------------------------
 // wxTextDocument: wxDocument and wxTextCtrl married
 // ----------------------------------------------------------------------------
@@ -14,6 +14,10 @@
 #include "wx/cmdproc.h"
 #include "wx/vector.h"
 #include "wx/image.h"
+#include "wx/timer.h"
+
+#include "corrolinx_grid.h"
+#include "corrolinx_stats.h"
 
 // This sample is written to build both with wxUSE_STD_IOSTREAM==0 and 1, which
 // somewhat complicates its code but is necessary in order to support building
@@ -43,6 +47,21 @@ struct DoodleLine
     {
     }
 
+    // the largest absolute value of the coordinates of the lines accepted by
+    // DrawingDocument, which keeps the computations with them from overflowing
+    enum { MAX_COORD = 1 << 24 };
+
+    static bool IsValidCoord(wxLongLong_t coord)
+    {
+        return coord >= -MAX_COORD && coord <= MAX_COORD;
+    }
+
+    bool IsValid() const
+    {
+        return IsValidCoord(x1) && IsValidCoord(y1) &&
+               IsValidCoord(x2) && IsValidCoord(y2);
+    }
+
     wxInt32 x1;
     wxInt32 y1;
     wxInt32 x2;
@@ -51,6 +70,31 @@ struct DoodleLine
 
 typedef wxVector<DoodleLine> DoodleLines;
 
+// A read-only view of a contiguous range of lines, used to access the lines
+// of the segments stored inside DrawingDocument without copying them
+class DoodleSegmentSpan
+{
+public:
+    DoodleSegmentSpan(const DoodleLine *lines, size_t count)
+        : m_lines(lines), m_count(count)
+    {
+    }
+
+    DocumentOstream& SaveObject(DocumentOstream& stream) const;
+
+    bool IsEmpty() const { return m_count == 0; }
+    size_t GetCount() const { return m_count; }
+
+    const DoodleLine& operator[](size_t n) const { return m_lines[n]; }
+
+    const DoodleLine *begin() const { return m_lines; }
+    const DoodleLine *end() const { return m_lines + m_count; }
+
+private:
+    const DoodleLine *m_lines;
+    size_t m_count;
+};
+
 // Contains a list of lines: represents a mouse-down doodle
 class DoodleSegment
 {
@@ -65,37 +109,598 @@ public:
     }
     const DoodleLines& GetLines() const { return m_lines; }
 
+    // exchange the contents of two segments without copying them
+    void Swap(DoodleSegment& other) { m_lines.swap(other.m_lines); }
+
+    // remove all lines and free the memory used by them
+    void Clear();
+
+    // replace the lines of this segment with a copy of the given array
+    void AssignLines(const DoodleLine *lines, size_t count);
+
+    // read the lines count followed by the lines themselves from the stream
+    // and append them to the given array
+    static DocumentIstream& LoadLines(DocumentIstream& stream,
+                                      DoodleLines& lines);
+
 private:
     DoodleLines m_lines;
 };
 
-typedef wxVector<DoodleSegment> DoodleSegments;
+// Offsets of the segments in the lines pool of DrawingDocument
+typedef wxVector<size_t> DoodleOffsets;
+
+// Indices of lines in the lines pool of DrawingDocument
+typedef wxVector<wxUint32> DoodleLineIndices;
+
+// The identifier of a segment of DrawingDocument, which doesn't change when
+// the other segments are added or removed or when it's moved, and is never 0
+typedef wxUint32 DoodleSegmentId;
+typedef wxVector<DoodleSegmentId> DoodleSegmentIds;
+
+class DoodleIndex;
+class DoodleDetailCache;
+struct DoodleSimplified;
+class DrawingLoader;
+class DrawingSaver;
+
+// The segments of DrawingDocument: this is a lightweight object referring to
+// the document storage which provides access to its segments as spans
+class DoodleSegments
+{
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator(const DoodleSegments& segments, size_t n)
+            : m_segments(&segments), m_n(n)
+        {
+        }
+
+        DoodleSegmentSpan operator*() const { return (*m_segments)[m_n]; }
+
+        const_iterator& operator++() { ++m_n; return *this; }
+
+        bool operator==(const const_iterator& other) const
+            { return m_n == other.m_n; }
+        bool operator!=(const const_iterator& other) const
+            { return m_n != other.m_n; }
+
+    private:
+        const DoodleSegments *m_segments;
+        size_t m_n;
+    };
+
+    DoodleSegments(const DoodleLines& lines, const DoodleOffsets& offsets)
+        : m_lines(lines), m_offsets(offsets)
+    {
+    }
+
+    size_t size() const { return m_offsets.size() - 1; }
+    bool empty() const { return size() == 0; }
+
+    DoodleSegmentSpan operator[](size_t n) const
+    {
+        const size_t first = m_offsets[n];
+        const DoodleLine * const lines = m_lines.empty() ? NULL : &m_lines[0];
+        return DoodleSegmentSpan(lines + first, m_offsets[n + 1] - first);
+    }
+
+    // get the index of the first line of the given segment in the lines pool
+    size_t GetFirstLine(size_t n) const { return m_offsets[n]; }
+
+    const_iterator begin() const { return const_iterator(*this, 0); }
+    const_iterator end() const { return const_iterator(*this, size()); }
+
+private:
+    const DoodleLines& m_lines;
+    const DoodleOffsets& m_offsets;
+};
+
+// A compact copy of some segments, used by the commands to keep the segments
+// which are not in the document, by DrawingDocument when it's compacted and
+// in the packed drawing files: the coordinates are stored as the differences
+// from the previous point, which are small for the lines drawn with the
+// mouse, zigzag encoded so that small negative differences are small numbers
+// too and written using as few bytes as necessary.
+//
+// Each segment starts with its number of lines, shifted left by one bit, with
+// the low bit set if every line of the segment starts where the previous one
+// ends, as it's the case for all strokes drawn with the mouse. The connected
+// segments are stored as their first point followed by the differences to
+// the end of each line, while for the other ones both ends of each line are
+// stored as the differences from the previous point.
+class DoodlePackedSegments
+{
+public:
+    DoodlePackedSegments() : m_count(0), m_lineCount(0) { }
+
+    bool IsEmpty() const { return m_count == 0; }
+    size_t GetCount() const { return m_count; }
+
+    // the total number of lines of all segments
+    size_t GetLineCount() const { return m_lineCount; }
+
+    // append a copy of the given segment
+    void Add(const DoodleSegmentSpan& segment);
+
+    // append copies of all segments of another object
+    void Append(const DoodlePackedSegments& other);
+
+    // append all segments to the given lines and their offsets, which must
+    // already contain the offset of the first line to be appended
+    void Unpack(DoodleLines& lines, DoodleOffsets& offsets) const;
+
+    // exchange the contents of two objects without copying them
+    void Swap(DoodlePackedSegments& other);
+
+    // remove all segments and free the memory used by them
+    void Clear();
+
+    // free the memory reserved for the segments which could be added later
+    void Shrink();
+
+    // the amount of memory used by the packed data
+    size_t GetMemoryUsage() const { return m_data.capacity(); }
+
+    // direct access to the packed data, e.g. to save it to a file
+    const unsigned char *GetData() const
+        { return m_data.empty() ? NULL : &m_data[0]; }
+    size_t GetDataSize() const { return m_data.size(); }
+
+private:
+    wxVector<unsigned char> m_data;
+    size_t m_count;
+    size_t m_lineCount;
+};
+
+// Decodes the segments packed by DoodlePackedSegments one by one, which is
+// fast enough to do while drawing them, checking that the data is valid as
+// it can come from a file
+class DoodlePackedReader
+{
+public:
+    DoodlePackedReader(const unsigned char *data, size_t size)
+        : m_p(data), m_end(data + size), m_ok(true)
+    {
+    }
+
+    explicit DoodlePackedReader(const DoodlePackedSegments& segments)
+        : m_p(segments.GetData()),
+          m_end(m_p + segments.GetDataSize()),
+          m_ok(true)
+    {
+    }
+
+    // append the lines of the next segment to the given array and return
+    // true or return false if there are no more segments or if the data is
+    // invalid, which can be distinguished using IsOk()
+    bool ReadSegment(DoodleLines& lines);
+
+    bool IsOk() const { return m_ok; }
+
+private:
+    // read a single value, return false if the data is truncated or invalid
+    bool ReadVarint(wxUint64& value);
+    bool ReadDelta(wxInt64& delta);
+
+    // add the delta to the coordinate, return false if it doesn't fit in 32
+    // bits any more
+    bool ReadCoord(wxInt64& coord);
+
+    const unsigned char *m_p;
+    const unsigned char * const m_end;
+    bool m_ok;
+};
+
+// The hint passed by DrawingDocument to UpdateAllViews() when it changes,
+// describing the area of the drawing affected by the change; SurveyDocument
+// uses it too, with the rectangle of the changed readings
+class DrawingUpdateHint : public wxObject
+{
+public:
+    explicit DrawingUpdateHint(const wxRect& rect) : m_rect(rect) { }
 
+    // the bounding box of the added or removed lines in logical coordinates,
+    // or of the changed readings in grid coordinates for SurveyDocument,
+    // empty if no lines were affected
+    const wxRect& GetRect() const { return m_rect; }
+
+private:
+    const wxRect m_rect;
+
+    wxDECLARE_CLASS(DrawingUpdateHint);
+};
+
+// The formats in which drawing documents can be stored on disk
+enum DrawingFileFormat
+{
+    DrawingFormat_Text,     // the original human-readable format
+    DrawingFormat_Binary,   // packed binary container usable after mmap()
+    DrawingFormat_Packed    // delta encoded segments, several times smaller
+};
+
+// The segments of a drawing at some moment, used to save it, possibly in
+// another thread while the document keeps changing
+//
+// The snapshot is taken in constant time as it doesn't copy the segments but
+// refers to those of the document, which must neither change nor free them
+// while the snapshot is used: appending new segments after them is fine, but
+// anything else requires passing them to the snapshot user first and working
+// on a copy, as DrawingDocument does while it's being saved.
+class DrawingSnapshot
+{
+public:
+    // the ids are only needed to skip the deleted segments, if any
+    DrawingSnapshot(const DoodleLines& lines,
+                    const DoodleOffsets& offsets,
+                    const DoodleSegmentIds *ids = NULL);
+    explicit DrawingSnapshot(const DoodlePackedSegments& packed);
+
+    size_t GetLineCount() const;
+    size_t GetSegmentCount() const;
+
+    // save the segments in the given format, replacing the file atomically,
+    // i.e. it keeps its old contents if saving fails for any reason
+    bool Save(const wxString& filename, DrawingFileFormat format) const;
+
+    // write the segments in the text format, which is also used by
+    // DrawingDocument::SaveObject()
+    DocumentOstream& SaveText(DocumentOstream& stream) const;
+
+private:
+    // write the file in the given format without any precautions
+    bool Write(const wxString& filename, DrawingFileFormat format) const;
+
+    // return true if the snapshot can't be written directly because it is
+    // either packed or contains deleted segments and copy its existing
+    // segments into the provided arrays then
+    bool Unpack(DoodleLines& lines, DoodleOffsets& offsets) const;
+
+    bool WriteText(const wxString& filename) const;
+    bool WriteBinary(const wxString& filename) const;
+    bool WritePacked(const wxString& filename) const;
+
+    DoodleSegmentSpan GetSegment(size_t n) const
+    {
+        return DoodleSegmentSpan(m_lines + m_offsets[n],
+                                 m_offsets[n + 1] - m_offsets[n]);
+    }
+
+    // either the lines and the offsets of the segments or, for a compacted
+    // document, the packed segments
+    const DoodleLine *m_lines;
+    size_t m_lineCount;
+    const size_t *m_offsets;
+    size_t m_segmentCount;
+
+    // the ids of the segments, or NULL if none of them is deleted
+    const DoodleSegmentId *m_ids;
+
+    const DoodlePackedSegments *m_packed;
+};
 
 // The drawing document (model) class itself
 class DrawingDocument : public wxDocument
 {
 public:
-    DrawingDocument() : wxDocument() { }
+    DrawingDocument();
+    virtual ~DrawingDocument();
 
     DocumentOstream& SaveObject(DocumentOstream& stream);
     DocumentIstream& LoadObject(DocumentIstream& stream);
 
+    // the format used when saving the document, by default the same one it
+    // was loaded from
+    DrawingFileFormat GetFileFormat() const { return m_fileFormat; }
+    void SetFileFormat(DrawingFileFormat format) { m_fileFormat = format; }
+
+    // save a copy of the document in the given format without changing the
+    // file it is associated with
+    bool SaveCopy(const wxString& filename, DrawingFileFormat format);
+
+    // convert a drawing file in any format to the given one
+    static bool ConvertFile(const wxString& input,
+                            const wxString& output,
+                            DrawingFileFormat format);
+
+    // the flag set in the ids of the deleted segments which weren't purged
+    enum { SEGMENT_DELETED = 0x80000000 };
+
     // add a new segment to the document
     void AddDoodleSegment(const DoodleSegment& segment);
 
+    // add copies of all the given segments at once, this is much faster than
+    // adding them one by one; their new ids are appended to the provided
+    // array if it's not NULL
+    void AddDoodleSegments(const DoodleSegments& segments,
+                           DoodleSegmentIds *ids = NULL);
+
+    // add back the segments with the given ids, which were removed before:
+    // they get back their old place in the drawing if it wasn't reclaimed
+    // yet, otherwise they're added on top of it
+    void RestoreSegments(const DoodleSegments& segments,
+                         const DoodleSegmentIds& ids);
+
+    // remove the segments with the given ids, return false and do nothing if
+    // any of them doesn't exist
+    //
+    // this doesn't move the other segments, the lines of the deleted ones
+    // are kept until they take too much memory or the document is compacted
+    bool DeleteSegments(const DoodleSegmentIds& ids);
+
+    // move the segments with the given ids by the given offset, return false
+    // and do nothing if any of them doesn't exist
+    bool MoveSegments(const DoodleSegmentIds& ids, int dx, int dy);
+
     // remove the last segment, if any, and copy it in the provided pointer if
     // not NULL and return true or return false and do nothing if there are no
     // segments
     bool PopLastSegment(DoodleSegment *segment);
 
-    // get direct access to our segments (for DrawingView)
-    const DoodleSegments& GetSegments() const { return m_doodleSegments; }
+    // remove the given number of segments from the end, return false and do
+    // nothing if there are not enough of them
+    bool RemoveLastSegments(size_t count);
+
+    // the number of segments, not counting the deleted ones
+    size_t GetSegmentCount() const
+        { return m_segmentIds.size() - m_deletedSegments; }
+
+    // the id of the segment with the given index in GetSegments(), which
+    // must not be deleted
+    DoodleSegmentId GetSegmentId(size_t n) const
+    {
+        wxASSERT_MSG( !IsSegmentDeleted(n), "segment is deleted" );
+
+        return m_segmentIds[n];
+    }
+
+    // the index of the segment with the given id in GetSegments() or
+    // wxNOT_FOUND if there is no such segment or it was deleted
+    int FindSegment(DoodleSegmentId id) const;
+
+    // the id of the last segment or 0 if there are none
+    DoodleSegmentId GetLastSegmentId() const;
+
+    // the deleted segments are still returned by GetSegments() until they
+    // are purged, but must be skipped by its users
+    bool HasDeletedSegments() const { return m_deletedSegments != 0; }
+    bool IsSegmentDeleted(size_t n) const
+        { return (m_segmentIds[n] & SEGMENT_DELETED) != 0; }
+
+    // forget the deleted segments, so that they are not returned by
+    // GetSegments() any more and the indices of the other ones change
+    void PurgeDeletedSegments();
+
+    // get the rectangle containing all lines of the given segments, which
+    // must exist and not be deleted
+    wxRect GetSegmentsBounds(const DoodleSegmentIds& ids) const;
+
+    // get direct access to our segments (for DrawingView), including the
+    // deleted ones
+    DoodleSegments GetSegments() const
+    {
+        wxASSERT_MSG( !m_compact, "compacted document must be expanded" );
+
+        return DoodleSegments(m_lines, m_segmentOffsets);
+    }
+
+    // get the lines of all segments, in order, including the deleted ones
+    const DoodleLines& GetLines() const
+    {
+        wxASSERT_MSG( !m_compact, "compacted document must be expanded" );
+
+        return m_lines;
+    }
+
+    // documents which are not used can be compacted to keep their segments
+    // only in packed form, using several times less memory: they can still
+    // be drawn using GetCompactSegments() and their bounds are still known,
+    // but they must be expanded before accessing their segments or lines in
+    // any other way, which is done automatically when modifying or saving
+    // them
+    void Compact();
+    void Expand();
+
+    // return NULL if the document is not compacted
+    const DoodlePackedSegments *GetCompactSegments() const
+        { return m_compact; }
+
+    // get the indices of all lines intersecting the given rectangle, sorted
+    // in the order in which they're drawn
+    void GetLinesInRect(const wxRect& rect, DoodleLineIndices& lines) const;
+
+    // get the index of the segment containing the line with the given index
+    size_t GetSegmentOfLine(size_t line) const;
+
+    // return the index of the topmost segment passing within the given
+    // distance of the point or wxNOT_FOUND if there is none, the deleted
+    // segments are never found
+    int HitTest(const wxPoint& pt, int tolerance) const;
+
+    // get the rectangle containing all lines of the document
+    wxRect GetBounds() const;
+
+    // get the given segment simplified at the detail level returned by
+    // DoodleDetailCache::GetLevelForScale(), this is computed on demand
+    const DoodleSimplified& GetSimplifiedSegment(size_t n, int level);
+
+    // large text documents are loaded in the background and appear in the
+    // views progressively, the document can't be modified until this is done
+    bool IsLoading() const { return m_loader != NULL; }
+
+    // stop loading the document, keeping the segments loaded so far
+    void CancelLoading();
+
+    // save the document in the given format in the background, it can be
+    // modified while this is done as the segments at the moment of this call
+    // are saved; autosaving doesn't mark the document as saved
+    //
+    // returns false if saving couldn't be started, the result of saving is
+    // logged when it's done
+    bool StartSaving(const wxString& filename,
+                     DrawingFileFormat format,
+                     bool autosave = false);
+
+    // true if the document is still being saved in the background
+    bool IsSaving() const;
+
+    // wait until the background save, if any, is done and return its result
+    bool WaitForSaving();
+
+    // get the file the document is autosaved to, which is next to its own
+    // file or in the temporary directory if it doesn't have any yet
+    wxString GetAutosaveFilename() const;
+
+    virtual bool OnCreate(const wxString& path, long flags);
+    virtual bool OnCloseDocument();
+
+    // keep the old file name if saving under the new one fails, even when it
+    // happens in the background
+    virtual bool SaveAs();
+
+protected:
+    // use DrawingCommandProcessor to limit the memory used by the undo history
+    virtual wxCommandProcessor *OnCreateCommandProcessor();
+
+    // binary files are recognized by their signature and loaded directly from
+    // their memory mapped contents, anything else goes through LoadObject()
+    virtual bool DoSaveDocument(const wxString& filename);
+    virtual bool DoOpenDocument(const wxString& filename);
 
 private:
-    void DoUpdate();
+    // mark the document as modified and refresh the given area in all views
+    void DoUpdate(const wxRect& rect);
+
+    // get the bounding box of count lines of m_lines starting at first
+    wxRect GetLinesBounds(size_t first, size_t count) const;
+
+    bool LoadBinary(const char *data, size_t size);
+    bool LoadPacked(const char *data, size_t size);
+
+    // forget the packed segments of a compacted document without expanding
+    // them, used before replacing all segments
+    void DiscardCompact();
+
+    // forget the lines and the segment offsets, used after packing them
+    void DiscardLines();
+
+    // use the given lines, segment offsets and ids instead of the current
+    // ones, which are returned in the arguments unless the snapshot being
+    // saved uses them, in which case they're passed to the saver instead
+    void SwapSegments(DoodleLines& lines,
+                      DoodleOffsets& offsets,
+                      DoodleSegmentIds& ids);
+
+    // must be called before changing the lines or the id of an existing
+    // segment to make sure that doing it doesn't change the snapshot
+    void PrepareToChange(size_t n);
+
+    // give new ids to all segments after the last one having an id
+    void AssignSegmentIds();
+
+    // forget the ids of all segments and give them new ones, used after
+    // replacing all segments
+    void ResetSegmentIds();
+
+    // append a segment with the given id, which must not be used
+    void AppendSegment(const DoodleSegmentSpan& segment, DoodleSegmentId id);
+
+    // remove the deleted segments at the end of the document, which can be
+    // done without moving anything, and purge the other deleted ones if
+    // they take too much memory
+    void TrimDeletedSegments();
+
+    // get the segments of the document as they're now
+    DrawingSnapshot TakeSnapshot() const;
+
+    // must be called before appending the given number of lines and segments
+    // to make sure that doing it doesn't change the snapshot being saved
+    void PrepareToAppend(size_t lineCount, size_t segmentCount);
+
+    // pass the lines and the segment offsets used by the snapshot being saved
+    // to the saver and continue with a copy of them with room for the given
+    // number of lines and segments more
+    void DetachSnapshot(size_t lineCount, size_t segmentCount);
+
+    // true if the snapshot being saved uses the segments of the document
+    bool IsSnapshotAttached() const { return m_saver && !m_saverOwnsSnapshot; }
+
+    // finish the background save once its thread has terminated
+    void OnSaverEvent(wxThreadEvent& event);
+    bool FinishSaving();
+
+    // give the document back the file name it had before SaveAs()
+    void RestoreFilename();
+
+    // save the modified document to its autosave file
+    void OnAutosaveTimer(wxTimerEvent& event);
+
+    // remove the last autosave file, if any
+    void RemoveAutosave();
+
+    // append the segments parsed by m_loader to the document
+    void OnLoaderEvent(wxThreadEvent& event);
+    void AppendLoadedBatches();
+
+    // delete m_loader once its thread has terminated
+    void DeleteLoader();
+
+    // the lines of all segments stored one after another
+    DoodleLines m_lines;
+
+    // the index of the first line of each segment in m_lines followed by the
+    // total number of lines, so that it always has at least one element
+    DoodleOffsets m_segmentOffsets;
+
+    // the id of each segment, with SEGMENT_DELETED set for the deleted ones,
+    // and the index of the segment with each id ever given or NO_SEGMENT if
+    // it doesn't exist any more; as the ids are given sequentially, starting
+    // from 1, this is just a vector too
+    DoodleSegmentIds m_segmentIds;
+    wxVector<wxUint32> m_segmentsById;
 
-    DoodleSegments m_doodleSegments;
+    // the number of deleted segments not purged yet and of their lines
+    size_t m_deletedSegments;
+    size_t m_deletedLines;
+
+    // spatial index of m_lines, kept in sync with it
+    DoodleIndex *m_index;
+
+    // simplified versions of the segments for drawing at small scales
+    DoodleDetailCache *m_detail;
+
+    // all segments of the compacted document, which doesn't have any lines,
+    // index or simplified segments then, or NULL
+    DoodlePackedSegments *m_compact;
+
+    // the bounds of the lines of the compacted document
+    wxRect m_compactBounds;
+
+    DrawingFileFormat m_fileFormat;
+
+    // the background loader thread, only non-NULL while loading
+    DrawingLoader *m_loader;
+
+    // the background saver thread, only non-NULL while saving, and whether
+    // it still uses our segments or has already got them for itself
+    DrawingSaver *m_saver;
+    bool m_saverOwnsSnapshot;
+
+    // the file name, title and saved state of the document before the last
+    // SaveAs(), and whether they must be restored if m_saver fails
+    wxString m_oldFilename;
+    wxString m_oldTitle;
+    bool m_oldSaved;
+    bool m_restoreOnSaveFailure;
+
+    // the timer for autosaving the document, only created for the documents
+    // shown in the views, the number of changes made to the document and
+    // when it was last autosaved and the file it was autosaved to
+    wxTimer *m_autosaveTimer;
+    unsigned long m_changeCount;
+    unsigned long m_autosavedChangeCount;
+    wxString m_autosaveFilename;
 
     wxDECLARE_DYNAMIC_CLASS(DrawingDocument);
 };
@@ -106,51 +711,254 @@ private:
 // ----------------------------------------------------------------------------
 
 // Base class for all operations on DrawingDocument
+//
+// The commands refer to the segments by their ids, which don't change when
+// the other segments are changed, so that they can be undone and redone in
+// any order the command processor uses.
 class DrawingCommand : public wxCommand
 {
 public:
-    DrawingCommand(DrawingDocument *doc,
-                   const wxString& name,
-                   const DoodleSegment& segment = DoodleSegment())
+    // merge the command done immediately after this one into it if both of
+    // them make the same kind of change to the same document and return
+    // true, otherwise return false and do nothing
+    virtual bool Merge(DrawingCommand& next) = 0;
+
+    // the approximate amount of memory used by the command
+    virtual size_t GetMemoryUsage() const = 0;
+
+protected:
+    DrawingCommand(DrawingDocument *doc, const wxString& name)
         : wxCommand(true, name),
-          m_doc(doc),
-          m_segment(segment)
+          m_doc(doc)
+    {
+    }
+
+    DrawingDocument * const m_doc;
+
+    // the ids of the segments changed by the command
+    DoodleSegmentIds m_ids;
+
+    wxDECLARE_ABSTRACT_CLASS(DrawingCommand);
+};
+
+// Base class for the commands adding or removing segments
+//
+// The segments are only stored here while they're not in the document, so
+// that the undo history doesn't keep a second copy of all the lines, and are
+// packed to use less memory. A command can add or remove several segments,
+// as DrawingCommandProcessor merges the commands done one after another in
+// quick succession.
+class DrawingSegmentsCommand : public DrawingCommand
+{
+public:
+    virtual bool Merge(DrawingCommand& next);
+
+    virtual size_t GetMemoryUsage() const
     {
+        return sizeof(*this) + m_segments.GetMemoryUsage() +
+                    m_ids.capacity()*sizeof(DoodleSegmentId);
     }
 
 protected:
-    bool DoAdd() { m_doc->AddDoodleSegment(m_segment); return true; }
-    bool DoRemove() { return m_doc->PopLastSegment(&m_segment); }
+    // the lines of the segment, if any, are taken by the command which
+    // leaves it empty
+    DrawingSegmentsCommand(DrawingDocument *doc,
+                           const wxString& name,
+                           DoodleSegment *segment = NULL);
+
+    // the lines of the span are copied, so it can be reused afterwards
+    DrawingSegmentsCommand(DrawingDocument *doc,
+                           const wxString& name,
+                           const DoodleSegmentSpan& span);
+
+    // the command removing the segments with the given ids
+    DrawingSegmentsCommand(DrawingDocument *doc,
+                           const wxString& name,
+                           const DoodleSegmentIds& ids);
+
+    // return true if the segments are removed when the command is done
+    virtual bool RemovesSegments() const = 0;
+
+    // return false if the command must not be merged with the others
+    virtual bool CanMerge() const { return true; }
+
+    // add the stored segments to the document, giving them new ids the
+    // first time it's done
+    bool DoAdd();
+
+    // remove the segments with m_ids from the document and store them, or
+    // the last segment if there are no ids yet
+    bool DoRemove();
 
 private:
-    DrawingDocument * const m_doc;
-    DoodleSegment m_segment;
+    // the segments while they're not in the document, empty otherwise, in
+    // the same order as their ids
+    DoodlePackedSegments m_segments;
+
+    wxDECLARE_ABSTRACT_CLASS(DrawingSegmentsCommand);
 };
 
 // The command for adding a new segment
-class DrawingAddSegmentCommand : public DrawingCommand
+class DrawingAddSegmentCommand : public DrawingSegmentsCommand
 {
 public:
-    DrawingAddSegmentCommand(DrawingDocument *doc, const DoodleSegment& segment)
-        : DrawingCommand(doc, "Add new segment", segment)
+    DrawingAddSegmentCommand(DrawingDocument *doc, DoodleSegment *segment)
+        : DrawingSegmentsCommand(doc, "Add new segment", segment)
+    {
+    }
+
+    DrawingAddSegmentCommand(DrawingDocument *doc,
+                             const DoodleSegmentSpan& span)
+        : DrawingSegmentsCommand(doc, "Add new segment", span)
     {
     }
 
     virtual bool Do() { return DoAdd(); }
     virtual bool Undo() { return DoRemove(); }
+
+protected:
+    virtual bool RemovesSegments() const { return false; }
 };
 
 // The command for removing the last segment
-class DrawingRemoveSegmentCommand : public DrawingCommand
+class DrawingRemoveSegmentCommand : public DrawingSegmentsCommand
 {
 public:
     DrawingRemoveSegmentCommand(DrawingDocument *doc)
-        : DrawingCommand(doc, "Remove last segment")
+        : DrawingSegmentsCommand(doc, "Remove last segment")
+    {
+    }
+
+    virtual bool Do() { return DoRemove(); }
+    virtual bool Undo() { return DoAdd(); }
+
+protected:
+    virtual bool RemovesSegments() const { return true; }
+};
+
+// The command for deleting any segments
+class DrawingDeleteSegmentsCommand : public DrawingSegmentsCommand
+{
+public:
+    DrawingDeleteSegmentsCommand(DrawingDocument *doc,
+                                 const DoodleSegmentIds& ids)
+        : DrawingSegmentsCommand(doc, "Delete segments", ids)
     {
     }
 
     virtual bool Do() { return DoRemove(); }
     virtual bool Undo() { return DoAdd(); }
+
+protected:
+    virtual bool RemovesSegments() const { return true; }
+
+    // each deletion of the selected segments is undone separately, unlike
+    // the strokes drawn or removed in quick succession
+    virtual bool CanMerge() const { return false; }
+};
+
+// The command for moving segments
+class DrawingMoveSegmentsCommand : public DrawingCommand
+{
+public:
+    DrawingMoveSegmentsCommand(DrawingDocument *doc,
+                               const DoodleSegmentIds& ids,
+                               int dx,
+                               int dy);
+
+    virtual bool Do() { return m_doc->MoveSegments(m_ids, m_dx, m_dy); }
+    virtual bool Undo() { return m_doc->MoveSegments(m_ids, -m_dx, -m_dy); }
+
+    // the consecutive moves of the same segments are merged
+    virtual bool Merge(DrawingCommand& next);
+
+    virtual size_t GetMemoryUsage() const
+        { return sizeof(*this) + m_ids.capacity()*sizeof(DoodleSegmentId); }
+
+private:
+    int m_dx;
+    int m_dy;
+
+    wxDECLARE_CLASS(DrawingMoveSegmentsCommand);
+};
+
+
+// ----------------------------------------------------------------------------
+// SurveyDocument: the readings of a Cor-Map survey
+// ----------------------------------------------------------------------------
+
+// Survey files are exported by the devices as comma, semicolon or tab
+// separated values, one line per row of the grid and an empty field for each
+// missing reading. Lines starting with '#' contain the survey metadata as
+// "key: value" pairs, currently "spacing", "origin" and "units", and an
+// optional header line with the column names is ignored.
+class SurveyDocument : public wxDocument
+{
+public:
+    SurveyDocument() : wxDocument() { }
+
+    const SurveyGrid& GetGrid() const { return m_grid; }
+
+    // the statistics of all readings, kept up to date when they change
+    const SurveyStatistics& GetStatistics() const { return m_stats; }
+
+    // change a single reading, use SurveyGrid::GetMissingValue() to remove it
+    void SetReading(int x, int y, float value);
+
+    // parse the contents of a survey file into the grid, whose metadata is
+    // also updated, and compute the statistics of its readings while doing
+    // it, which must be initially empty; logs a warning and returns false if
+    // the data is invalid
+    static bool ParseCSV(const char *data,
+                         size_t size,
+                         SurveyGrid& grid,
+                         SurveyStatistics& stats);
+
+protected:
+    virtual bool DoSaveDocument(const wxString& filename);
+    virtual bool DoOpenDocument(const wxString& filename);
+
+private:
+    bool LoadCSV(const char *data, size_t size);
+    bool SaveCSV(const wxString& filename) const;
+
+    SurveyGrid m_grid;
+    SurveyStatistics m_stats;
+
+    wxDECLARE_NO_COPY_CLASS(SurveyDocument);
+    wxDECLARE_DYNAMIC_CLASS(SurveyDocument);
+};
+
+// The command for changing a single reading of SurveyDocument
+class SurveySetReadingCommand : public wxCommand
+{
+public:
+    SurveySetReadingCommand(SurveyDocument *doc, int x, int y, float value)
+        : wxCommand(true, "Change reading"),
+          m_doc(doc),
+          m_x(x),
+          m_y(y),
+          m_value(value)
+    {
+    }
+
+    virtual bool Do() { return Exchange(); }
+    virtual bool Undo() { return Exchange(); }
+
+private:
+    // set the reading to m_value and remember its previous value in it
+    bool Exchange()
+    {
+        const float value = m_doc->GetGrid().GetValue(m_x, m_y);
+        m_doc->SetReading(m_x, m_y, m_value);
+        m_value = value;
+        return true;
+    }
+
+    SurveyDocument * const m_doc;
+    const int m_x,
+              m_y;
+    float m_value;
 };
 
 
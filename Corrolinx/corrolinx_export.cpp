@@ -0,0 +1,821 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_export.cpp
+// Purpose:     Implements export of the survey colour maps as big images
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "wx/ffile.h"
+#include "wx/math.h"
+#include "wx/mstream.h"
+#include "wx/zstream.h"
+
+#include "corrolinx_export.h"
+#include "corrolinx_colormap.h"
+#include "corrolinx_workers.h"
+
+namespace
+{
+
+// the approximate size of the uncompressed pixels of each band, the bands
+// always span the entire width of the image and have at least one row
+const size_t BAND_BYTES = 4*1024*1024;
+
+// the number of bands processed at once per thread of the pool: having more
+// than one of them keeps all threads busy even if some bands take longer to
+// compress than the others, while the memory used by the bands waiting to be
+// written remains bounded
+const size_t BANDS_PER_THREAD = 2;
+
+// the images mostly consist of big uniform areas, which are compressed well
+// even by the fastest level, and the slower ones don't gain much for them
+const int COMPRESSION_LEVEL = 1;
+
+const double MM_PER_INCH = 25.4;
+
+typedef wxVector<unsigned char> ByteBuffer;
+
+void PutBE32(ByteBuffer& buffer, wxUint32 value)
+{
+    buffer.push_back(static_cast<unsigned char>(value >> 24));
+    buffer.push_back(static_cast<unsigned char>(value >> 16));
+    buffer.push_back(static_cast<unsigned char>(value >> 8));
+    buffer.push_back(static_cast<unsigned char>(value));
+}
+
+void PutLE16(ByteBuffer& buffer, wxUint16 value)
+{
+    buffer.push_back(static_cast<unsigned char>(value));
+    buffer.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+void PutLE32(ByteBuffer& buffer, wxUint32 value)
+{
+    PutLE16(buffer, static_cast<wxUint16>(value));
+    PutLE16(buffer, static_cast<wxUint16>(value >> 16));
+}
+
+// ----------------------------------------------------------------------------
+// checksums
+// ----------------------------------------------------------------------------
+
+// the CRC-32 used by PNG chunks
+class CRCTable
+{
+public:
+    CRCTable()
+    {
+        for ( wxUint32 n = 0; n < 256; n++ )
+        {
+            wxUint32 crc = n;
+            for ( int k = 0; k < 8; k++ )
+                crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+
+            m_values[n] = crc;
+        }
+    }
+
+    // return the CRC of the data following that with the given CRC, which
+    // is 0 for the first block of data
+    wxUint32 Update(wxUint32 crc, const void *data, size_t size) const
+    {
+        const unsigned char * const bytes =
+            static_cast<const unsigned char *>(data);
+
+        crc = ~crc;
+        for ( size_t n = 0; n < size; n++ )
+            crc = m_values[(crc ^ bytes[n]) & 0xff] ^ (crc >> 8);
+
+        return ~crc;
+    }
+
+private:
+    wxUint32 m_values[256];
+};
+
+// the Adler-32 checksum of the uncompressed data of zlib streams, which is 1
+// for the empty data
+const wxUint32 ADLER_BASE = 65521;
+
+// the largest number of bytes whose sums can't overflow before being reduced
+const size_t ADLER_MAX_RUN = 5552;
+
+wxUint32 UpdateAdler32(wxUint32 adler, const unsigned char *data, size_t size)
+{
+    wxUint32 a = adler & 0xffff,
+             b = adler >> 16;
+    while ( size )
+    {
+        const size_t run = wxMin(size, ADLER_MAX_RUN);
+        for ( size_t n = 0; n < run; n++ )
+        {
+            a += data[n];
+            b += a;
+        }
+
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+
+        data += run;
+        size -= run;
+    }
+
+    return (b << 16) | a;
+}
+
+// return the checksum of two consecutive blocks of data given their checksums
+// and the size of the second one, as zlib adler32_combine() does
+wxUint32 CombineAdler32(wxUint32 adler1, wxUint32 adler2, wxUint64 size2)
+{
+    const wxUint32 rem = static_cast<wxUint32>(size2 % ADLER_BASE);
+
+    wxUint32 a = adler1 & 0xffff;
+    wxUint32 b = static_cast<wxUint32>(static_cast<wxUint64>(rem)*a %
+                                            ADLER_BASE);
+
+    a += (adler2 & 0xffff) + ADLER_BASE - 1;
+    b += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+
+    if ( a >= ADLER_BASE )
+        a -= ADLER_BASE;
+    if ( a >= ADLER_BASE )
+        a -= ADLER_BASE;
+    if ( b >= 2*ADLER_BASE )
+        b -= 2*ADLER_BASE;
+    if ( b >= ADLER_BASE )
+        b -= ADLER_BASE;
+
+    return (b << 16) | a;
+}
+
+// ----------------------------------------------------------------------------
+// ExportTask: renders and compresses the bands of the image
+// ----------------------------------------------------------------------------
+
+// a band of the image ready to be written to the file
+struct ExportBand
+{
+    const unsigned char *GetData() const
+    {
+        return static_cast<const unsigned char *>
+               (
+                    data.GetOutputStreamBuffer()->GetBufferStart()
+               );
+    }
+
+    // the compressed pixels, of which only the first size bytes are used
+    wxMemoryOutputStream data;
+    size_t size;
+
+    // the size of the uncompressed pixels and their Adler-32 checksum
+    size_t rawSize;
+    wxUint32 adler;
+
+    // the CRC of the PNG chunk containing the data
+    wxUint32 crc;
+};
+
+// The bands are compressed independently of each other, which allows doing
+// it concurrently. For TIFF each of them is just a strip of the image and a
+// complete zlib stream, but PNG uses a single stream for the entire image,
+// so the bands are compressed as raw deflate data terminated by a full flush,
+// which makes them valid on their own and when concatenated, and the header
+// and the trailer of the stream are added by PNGWriter.
+class ExportTask : public ParallelTask
+{
+public:
+    ExportTask(const SurveyGrid& grid,
+               const SurveyColourMap& colourMap,
+               const wxSize& size,
+               SurveyImageFormat format);
+    virtual ~ExportTask();
+
+    size_t GetBandCount() const
+        { return (m_height + m_bandHeight - 1)/m_bandHeight; }
+    size_t GetBandHeight() const { return m_bandHeight; }
+
+    // prepare to process count bands starting with the given one, forgetting
+    // the previously processed ones
+    void StartBands(size_t first, size_t count);
+
+    // get the n-th band processed after the last call to StartBands()
+    const ExportBand& GetBand(size_t n) const { return *m_bands[n]; }
+
+    // the memory used by the bands processed by the given number of threads
+    // and by the already processed ones waiting to be written
+    size_t GetMemoryUsage(int threads) const;
+
+    virtual void Process(size_t n);
+
+private:
+    // render the given row of the image
+    void RenderRow(size_t y, float *values, unsigned char *rgb) const;
+
+    const SurveyGrid& m_grid;
+    const SurveyColourMap& m_colourMap;
+    const SurveyImageFormat m_format;
+    const size_t m_width;
+    const size_t m_height;
+
+    // the number of bytes in each row of the uncompressed data, which starts
+    // with the filter type for PNG
+    const size_t m_rowSize;
+
+    size_t m_bandHeight;
+
+    // the column and the row of the grid shown by each pixel column and row
+    wxVector<size_t> m_columns;
+    wxVector<size_t> m_rows;
+
+    const CRCTable m_crcTable;
+
+    // the bands being processed, starting with m_first
+    size_t m_first;
+    wxVector<ExportBand *> m_bands;
+
+    wxDECLARE_NO_COPY_CLASS(ExportTask);
+};
+
+ExportTask::ExportTask(const SurveyGrid& grid,
+                       const SurveyColourMap& colourMap,
+                       const wxSize& size,
+                       SurveyImageFormat format)
+    : m_grid(grid),
+      m_colourMap(colourMap),
+      m_format(format),
+      m_width(size.x),
+      m_height(size.y),
+      m_rowSize(3*m_width + (format == SurveyImage_PNG ? 1 : 0)),
+      m_first(0)
+{
+    m_bandHeight = wxMax(BAND_BYTES/m_rowSize, 1);
+
+    m_columns.resize(m_width);
+    for ( size_t i = 0; i < m_width; i++ )
+    {
+        const double pos = (i + 0.5)*grid.GetWidth()/m_width;
+        m_columns[i] = wxMin(static_cast<size_t>(pos), grid.GetWidth() - 1);
+    }
+
+    m_rows.resize(m_height);
+    for ( size_t i = 0; i < m_height; i++ )
+    {
+        const double pos = (i + 0.5)*grid.GetHeight()/m_height;
+        m_rows[i] = wxMin(static_cast<size_t>(pos), grid.GetHeight() - 1);
+    }
+}
+
+ExportTask::~ExportTask()
+{
+    StartBands(0, 0);
+}
+
+void ExportTask::StartBands(size_t first, size_t count)
+{
+    for ( size_t n = 0; n < m_bands.size(); n++ )
+        delete m_bands[n];
+
+    m_first = first;
+    m_bands.clear();
+    m_bands.resize(count, NULL);
+}
+
+size_t ExportTask::GetMemoryUsage(int threads) const
+{
+    // the uncompressed band, the row above it and the values of a row
+    const size_t working = m_bandHeight*m_rowSize + 3*m_width +
+                                m_width*sizeof(float);
+
+    size_t usage = wxMin(static_cast<size_t>(threads), m_bands.size())*working;
+    for ( size_t n = 0; n < m_bands.size(); n++ )
+    {
+        if ( m_bands[n] )
+            usage += m_bands[n]->data.GetSize();
+    }
+
+    return usage;
+}
+
+void ExportTask::RenderRow(size_t y, float *values, unsigned char *rgb) const
+{
+    const float * const row = m_grid.GetRow(m_rows[y]);
+    for ( size_t x = 0; x < m_width; x++ )
+        values[x] = row[m_columns[x]];
+
+    m_colourMap.Map(values, m_width, rgb);
+}
+
+void ExportTask::Process(size_t n)
+{
+    const size_t top = (m_first + n)*m_bandHeight,
+                 rows = wxMin(m_bandHeight, m_height - top),
+                 stride = 3*m_width,
+                 offset = m_rowSize - stride;
+
+    wxVector<float> values(m_width);
+    ByteBuffer raw(rows*m_rowSize);
+
+    for ( size_t y = 0; y < rows; y++ )
+    {
+        unsigned char * const rgb = &raw[y*m_rowSize + offset];
+
+        // when the image is bigger than the grid, several rows show the same
+        // values
+        if ( y > 0 && m_rows[top + y] == m_rows[top + y - 1] )
+            memcpy(rgb, rgb - m_rowSize, stride);
+        else
+            RenderRow(top + y, &values[0], rgb);
+    }
+
+    if ( m_format == SurveyImage_PNG )
+    {
+        // use the "Up" filter, storing the difference with the row above, as
+        // the rows are often the same or differ only in a few places and so
+        // become mostly zeros, which compress much better than the pixels
+        // themselves; the first row of the image is the same as unfiltered,
+        // but the other bands need the last row of the previous one
+        ByteBuffer above;
+        if ( top > 0 )
+        {
+            above.resize(stride);
+            RenderRow(top - 1, &values[0], &above[0]);
+        }
+
+        // filter the rows from the bottom up to use the unfiltered ones above
+        for ( size_t y = rows; y-- > 0; )
+        {
+            unsigned char * const row = &raw[y*m_rowSize];
+            row[0] = 2;
+
+            const unsigned char *prev;
+            if ( y > 0 )
+                prev = row - m_rowSize + 1;
+            else if ( top > 0 )
+                prev = &above[0];
+            else
+                continue;
+
+            if ( m_rows[top + y] == m_rows[top + y - 1] )
+            {
+                memset(row + 1, 0, stride);
+                continue;
+            }
+
+            for ( size_t i = 1; i <= stride; i++ )
+                row[i] = static_cast<unsigned char>(row[i] - prev[i - 1]);
+        }
+    }
+
+    ExportBand * const band = new ExportBand;
+    band->rawSize = raw.size();
+
+    {
+        wxZlibOutputStream zstream(band->data,
+                                   COMPRESSION_LEVEL,
+                                   m_format == SurveyImage_PNG
+                                    ? wxZLIB_NO_HEADER
+                                    : wxZLIB_ZLIB);
+        zstream.Write(&raw[0], raw.size());
+
+        // the data written by closing the stream, which happens in its dtor
+        // anyhow, only terminates it and is not used for PNG
+        if ( m_format == SurveyImage_PNG )
+            zstream.Sync();
+        else
+            zstream.Close();
+
+        band->size = band->data.GetSize();
+    }
+
+    if ( m_format == SurveyImage_PNG )
+    {
+        band->adler = UpdateAdler32(1, &raw[0], raw.size());
+        band->crc = m_crcTable.Update(m_crcTable.Update(0, "IDAT", 4),
+                                      band->GetData(),
+                                      band->size);
+    }
+
+    m_bands[n] = band;
+}
+
+// ----------------------------------------------------------------------------
+// ImageWriter: writes the bands to the file in the given format
+// ----------------------------------------------------------------------------
+
+class ImageWriter
+{
+public:
+    ImageWriter(wxFFile& file, const wxSize& size, int dpi)
+        : m_file(file),
+          m_size(size),
+          m_dpi(dpi)
+    {
+    }
+
+    virtual ~ImageWriter() { }
+
+    // all functions return false if writing fails, logging an error if it
+    // isn't a write error, which is logged by wxFFile itself
+    virtual bool WriteHeader() = 0;
+    virtual bool WriteBand(const ExportBand& band) = 0;
+    virtual bool WriteTrailer() = 0;
+
+protected:
+    bool Write(const void *data, size_t size)
+    {
+        return m_file.Write(data, size) == size;
+    }
+
+    bool Write(const ByteBuffer& buffer)
+    {
+        return buffer.empty() || Write(&buffer[0], buffer.size());
+    }
+
+    wxFFile& m_file;
+    const wxSize m_size;
+    const int m_dpi;
+
+    wxDECLARE_NO_COPY_CLASS(ImageWriter);
+};
+
+// Each band is written as a separate IDAT chunk, preceded by one containing
+// just the zlib header and followed by one with the final empty deflate block
+// and the checksum of the entire stream.
+class PNGWriter : public ImageWriter
+{
+public:
+    PNGWriter(wxFFile& file, const wxSize& size, int dpi)
+        : ImageWriter(file, size, dpi),
+          m_adler(1)
+    {
+    }
+
+    virtual bool WriteHeader();
+    virtual bool WriteBand(const ExportBand& band);
+    virtual bool WriteTrailer();
+
+private:
+    bool WriteChunk(const char *type, const ByteBuffer& data);
+
+    const CRCTable m_crcTable;
+
+    // the checksum of the uncompressed data of all bands written so far
+    wxUint32 m_adler;
+};
+
+bool PNGWriter::WriteChunk(const char *type, const ByteBuffer& data)
+{
+    wxUint32 crc = m_crcTable.Update(0, type, 4);
+    if ( !data.empty() )
+        crc = m_crcTable.Update(crc, &data[0], data.size());
+
+    ByteBuffer header;
+    PutBE32(header, data.size());
+
+    ByteBuffer trailer;
+    PutBE32(trailer, crc);
+
+    return Write(header) && Write(type, 4) && Write(data) && Write(trailer);
+}
+
+bool PNGWriter::WriteHeader()
+{
+    static const unsigned char SIGNATURE[] =
+        { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    // 8 bit RGB without interlacing
+    ByteBuffer header;
+    PutBE32(header, m_size.x);
+    PutBE32(header, m_size.y);
+    header.push_back(8);
+    header.push_back(2);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+
+    // the resolution, in pixels per metre
+    const wxUint32 resolution = wxRound(m_dpi*1000/MM_PER_INCH);
+
+    ByteBuffer physical;
+    PutBE32(physical, resolution);
+    PutBE32(physical, resolution);
+    physical.push_back(1);
+
+    // deflate with 32KB window and the fastest compression
+    ByteBuffer zlibHeader;
+    zlibHeader.push_back(0x78);
+    zlibHeader.push_back(0x01);
+
+    return Write(SIGNATURE, sizeof(SIGNATURE)) &&
+            WriteChunk("IHDR", header) &&
+            WriteChunk("pHYs", physical) &&
+            WriteChunk("IDAT", zlibHeader);
+}
+
+bool PNGWriter::WriteBand(const ExportBand& band)
+{
+    m_adler = CombineAdler32(m_adler, band.adler, band.rawSize);
+
+    ByteBuffer header;
+    PutBE32(header, band.size);
+
+    ByteBuffer trailer;
+    PutBE32(trailer, band.crc);
+
+    return Write(header) &&
+            Write("IDAT", 4) &&
+            Write(band.GetData(), band.size) &&
+            Write(trailer);
+}
+
+bool PNGWriter::WriteTrailer()
+{
+    // an empty final block with fixed Huffman codes followed by the checksum
+    ByteBuffer end;
+    end.push_back(0x03);
+    end.push_back(0x00);
+    PutBE32(end, m_adler);
+
+    return WriteChunk("IDAT", end) && WriteChunk("IEND", ByteBuffer());
+}
+
+// The strips are written as they become available, starting right after the
+// header, and the image file directory, which needs their offsets, after all
+// of them, so the header is updated to point to it at the end.
+class TIFFWriter : public ImageWriter
+{
+public:
+    TIFFWriter(wxFFile& file, const wxSize& size, int dpi, size_t stripHeight)
+        : ImageWriter(file, size, dpi),
+          m_stripHeight(stripHeight),
+          m_offset(0)
+    {
+    }
+
+    virtual bool WriteHeader();
+    virtual bool WriteBand(const ExportBand& band);
+    virtual bool WriteTrailer();
+
+private:
+    // the largest offset in the file representable in TIFF
+    static const wxUint64 MAX_OFFSET = 0xffffffff;
+
+    // the types of the directory entries
+    enum
+    {
+        Type_Short = 3,
+        Type_Long = 4,
+        Type_Rational = 5
+    };
+
+    static void AddEntry(ByteBuffer& ifd,
+                         wxUint16 tag,
+                         wxUint16 type,
+                         wxUint32 count,
+                         wxUint32 value);
+
+    // check that the given amount of data can be appended to the file
+    bool CanWrite(wxUint64 size) const;
+
+    const size_t m_stripHeight;
+
+    // the current size of the file
+    wxUint64 m_offset;
+
+    wxVector<wxUint32> m_stripOffsets;
+    wxVector<wxUint32> m_stripSizes;
+};
+
+/* static */
+void TIFFWriter::AddEntry(ByteBuffer& ifd,
+                          wxUint16 tag,
+                          wxUint16 type,
+                          wxUint32 count,
+                          wxUint32 value)
+{
+    PutLE16(ifd, tag);
+    PutLE16(ifd, type);
+    PutLE32(ifd, count);
+
+    // a single short value is stored in the first half of the field, which
+    // is the same as storing it as a long in little endian byte order
+    PutLE32(ifd, value);
+}
+
+bool TIFFWriter::CanWrite(wxUint64 size) const
+{
+    if ( m_offset + size <= MAX_OFFSET )
+        return true;
+
+    wxLogError("The image is too big to be saved in TIFF format, "
+               "please use PNG instead.");
+    return false;
+}
+
+bool TIFFWriter::WriteHeader()
+{
+    // little endian byte order and the offset of the directory, written
+    // later
+    ByteBuffer header;
+    header.push_back('I');
+    header.push_back('I');
+    PutLE16(header, 42);
+    PutLE32(header, 0);
+
+    m_offset = header.size();
+
+    return Write(header);
+}
+
+bool TIFFWriter::WriteBand(const ExportBand& band)
+{
+    if ( !CanWrite(band.size) )
+        return false;
+
+    m_stripOffsets.push_back(m_offset);
+    m_stripSizes.push_back(band.size);
+    m_offset += band.size;
+
+    return Write(band.GetData(), band.size);
+}
+
+bool TIFFWriter::WriteTrailer()
+{
+    static const int ENTRIES = 13;
+
+    // the directory must start at a word boundary
+    ByteBuffer ifd;
+    if ( m_offset % 2 )
+        ifd.push_back(0);
+
+    const size_t strips = m_stripOffsets.size();
+
+    // the values which don't fit in the entries follow the directory
+    const wxUint32 ifdOffset = m_offset + ifd.size(),
+                   bitsOffset = ifdOffset + 2 + 12*ENTRIES + 4,
+                   xResOffset = bitsOffset + 8,
+                   yResOffset = xResOffset + 8,
+                   offsetsOffset = yResOffset + 8,
+                   sizesOffset = offsetsOffset + 4*strips;
+
+    PutLE16(ifd, ENTRIES);
+    AddEntry(ifd, 256 /* ImageWidth */, Type_Long, 1, m_size.x);
+    AddEntry(ifd, 257 /* ImageLength */, Type_Long, 1, m_size.y);
+    AddEntry(ifd, 258 /* BitsPerSample */, Type_Short, 3, bitsOffset);
+    AddEntry(ifd, 259 /* Compression */, Type_Short, 1, 8 /* Deflate */);
+    AddEntry(ifd, 262 /* PhotometricInterpretation */, Type_Short, 1,
+             2 /* RGB */);
+    AddEntry(ifd, 273 /* StripOffsets */, Type_Long, strips,
+             strips == 1 ? m_stripOffsets[0] : offsetsOffset);
+    AddEntry(ifd, 277 /* SamplesPerPixel */, Type_Short, 1, 3);
+    AddEntry(ifd, 278 /* RowsPerStrip */, Type_Long, 1, m_stripHeight);
+    AddEntry(ifd, 279 /* StripByteCounts */, Type_Long, strips,
+             strips == 1 ? m_stripSizes[0] : sizesOffset);
+    AddEntry(ifd, 282 /* XResolution */, Type_Rational, 1, xResOffset);
+    AddEntry(ifd, 283 /* YResolution */, Type_Rational, 1, yResOffset);
+    AddEntry(ifd, 284 /* PlanarConfiguration */, Type_Short, 1,
+             1 /* contiguous */);
+    AddEntry(ifd, 296 /* ResolutionUnit */, Type_Short, 1, 2 /* inch */);
+    PutLE32(ifd, 0 /* no more directories */);
+
+    for ( int n = 0; n < 3; n++ )
+        PutLE16(ifd, 8);
+    PutLE16(ifd, 0);
+
+    for ( int n = 0; n < 2; n++ )
+    {
+        PutLE32(ifd, m_dpi);
+        PutLE32(ifd, 1);
+    }
+
+    if ( strips > 1 )
+    {
+        for ( size_t n = 0; n < strips; n++ )
+            PutLE32(ifd, m_stripOffsets[n]);
+        for ( size_t n = 0; n < strips; n++ )
+            PutLE32(ifd, m_stripSizes[n]);
+    }
+
+    if ( !CanWrite(ifd.size()) || !Write(ifd) )
+        return false;
+
+    ByteBuffer header;
+    PutLE32(header, ifdOffset);
+
+    return m_file.Seek(4) && Write(header);
+}
+
+// render all bands of the image and write them to the file
+bool WriteImage(ExportTask& task,
+                ImageWriter& writer,
+                WorkerPool& pool,
+                size_t *peakMemory)
+{
+    if ( !writer.WriteHeader() )
+        return false;
+
+    const int threads = pool.GetConcurrency();
+    const size_t batch = BANDS_PER_THREAD*threads,
+                 bands = task.GetBandCount();
+
+    size_t peak = 0;
+    for ( size_t first = 0; first < bands; first += batch )
+    {
+        const size_t count = wxMin(batch, bands - first);
+
+        task.StartBands(first, count);
+        pool.Run(task, count);
+
+        peak = wxMax(peak, task.GetMemoryUsage(threads));
+
+        for ( size_t n = 0; n < count; n++ )
+        {
+            if ( !writer.WriteBand(task.GetBand(n)) )
+                return false;
+        }
+    }
+
+    if ( peakMemory )
+        *peakMemory = peak;
+
+    return writer.WriteTrailer();
+}
+
+} // anonymous namespace
+
+wxSize GetSurveyImageSize(const SurveyGrid& grid,
+                          double pageWidth,
+                          double pageHeight,
+                          int dpi)
+{
+    if ( grid.IsEmpty() )
+        return wxSize();
+
+    const double width = grid.GetWidth(),
+                 height = grid.GetHeight();
+
+    // use the orientation of the page matching the shape of the grid
+    if ( (width > height) != (pageWidth > pageHeight) )
+        wxSwap(pageWidth, pageHeight);
+
+    const double scale = wxMin(pageWidth/width, pageHeight/height)*
+                            dpi/MM_PER_INCH;
+
+    return wxSize(wxMax(wxRound(width*scale), 1),
+                  wxMax(wxRound(height*scale), 1));
+}
+
+bool ExportSurveyImage(const SurveyGrid& grid,
+                       const SurveyColourMap& colourMap,
+                       const wxSize& size,
+                       int dpi,
+                       SurveyImageFormat format,
+                       const wxString& filename,
+                       WorkerPool& pool,
+                       size_t *peakMemory)
+{
+    wxCHECK_MSG( !grid.IsEmpty() && size.x > 0 && size.y > 0, false,
+                 "nothing to export" );
+
+    wxFFile file(filename, "wb");
+    if ( !file.IsOpened() )
+        return false;
+
+    ExportTask task(grid, colourMap, size, format);
+
+    bool ok;
+    if ( format == SurveyImage_PNG )
+    {
+        PNGWriter writer(file, size, dpi);
+        ok = WriteImage(task, writer, pool, peakMemory);
+    }
+    else
+    {
+        TIFFWriter writer(file, size, dpi, task.GetBandHeight());
+        ok = WriteImage(task, writer, pool, peakMemory);
+    }
+
+    if ( !file.Close() )
+        ok = false;
+
+    if ( !ok )
+    {
+        wxLogError("Failed to export the image to \"%s\".", filename);
+        wxRemoveFile(filename);
+    }
+
+    return ok;
+}
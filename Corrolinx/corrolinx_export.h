@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_export.h
+// Purpose:     Export of the survey colour maps as big images
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_EXPORT_H_
+#define _CORROLINX_CORROLINX_EXPORT_H_
+
+#include "wx/gdicmn.h"
+#include "wx/string.h"
+
+#include "corrolinx_grid.h"
+
+class SurveyColourMap;
+class WorkerPool;
+
+// The formats of the exported images
+enum SurveyImageFormat
+{
+    SurveyImage_PNG,
+    SurveyImage_TIFF            // Deflate-compressed, limited to 4GB
+};
+
+// the size of the biggest image showing the grid, with one square per
+// reading as in SurveyView, which fits on a page of the given size, in mm,
+// printed at the given resolution in either orientation
+wxSize GetSurveyImageSize(const SurveyGrid& grid,
+                          double pageWidth,
+                          double pageHeight,
+                          int dpi);
+
+// Write the colour map of the grid scaled to the given size in pixels to a
+// file, mapping each pixel to the value containing its center as
+// SurveyView::OnDraw() does.
+//
+// Unlike drawing on a DC, this never keeps the entire image in memory: it is
+// rendered and compressed in horizontal bands by the threads of the pool, a
+// few of them at a time, and each batch of bands is written to the file as
+// soon as it's done. The maximal memory used by the bands is returned in
+// peakMemory if it's not NULL.
+//
+// Logs an error and returns false if the image couldn't be written, in which
+// case the file is removed.
+bool ExportSurveyImage(const SurveyGrid& grid,
+                       const SurveyColourMap& colourMap,
+                       const wxSize& size,
+                       int dpi,
+                       SurveyImageFormat format,
+                       const wxString& filename,
+                       WorkerPool& pool,
+                       size_t *peakMemory = NULL);
+
+#endif // _CORROLINX_CORROLINX_EXPORT_H_
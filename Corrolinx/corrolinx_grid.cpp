@@ -0,0 +1,83 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_grid.cpp
+// Purpose:     Implements the grid of half-cell potential readings
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "corrolinx_grid.h"
+
+#include <limits>
+
+// ----------------------------------------------------------------------------
+// SurveyGrid implementation
+// ----------------------------------------------------------------------------
+
+SurveyGrid::SurveyGrid()
+{
+    m_width =
+    m_height = 0;
+
+    m_spacingX =
+    m_spacingY = 1;
+    m_originX =
+    m_originY = 0;
+}
+
+void SurveyGrid::Clear()
+{
+    // clear() doesn't free the memory, but swapping with an empty vector does
+    wxVector<float>().swap(m_values);
+
+    m_width =
+    m_height = 0;
+
+    m_spacingX =
+    m_spacingY = 1;
+    m_originX =
+    m_originY = 0;
+    m_units.clear();
+}
+
+void SurveyGrid::Swap(SurveyGrid& other)
+{
+    m_values.swap(other.m_values);
+    wxSwap(m_width, other.m_width);
+    wxSwap(m_height, other.m_height);
+    wxSwap(m_spacingX, other.m_spacingX);
+    wxSwap(m_spacingY, other.m_spacingY);
+    wxSwap(m_originX, other.m_originX);
+    wxSwap(m_originY, other.m_originY);
+    m_units.swap(other.m_units);
+}
+
+void SurveyGrid::SetValues(size_t width, size_t height,
+                           wxVector<float>& values)
+{
+    wxCHECK_RET( values.size() == width*height, "wrong number of readings" );
+
+    m_values.swap(values);
+    wxVector<float>().swap(values);
+
+    m_width = width;
+    m_height = height;
+}
+
+/* static */
+float SurveyGrid::GetMissingValue()
+{
+    return std::numeric_limits<float>::quiet_NaN();
+}
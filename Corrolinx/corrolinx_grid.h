@@ -0,0 +1,92 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_grid.h
+// Purpose:     Grid of half-cell potential readings of a survey
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_GRID_H_
+#define _CORROLINX_CORROLINX_GRID_H_
+
+#include "wx/string.h"
+#include "wx/vector.h"
+
+// ASTM C876 thresholds of the half-cell potential, in mV against a copper-
+// copper sulfate electrode: there is a 90% probability of no corrosion above
+// the first one and of active corrosion below the second one
+const float ASTM_C876_LOW_RISK = -200.0f;
+const float ASTM_C876_HIGH_RISK = -350.0f;
+
+// ----------------------------------------------------------------------------
+// SurveyGrid: dense 2D array of readings
+// ----------------------------------------------------------------------------
+
+// The readings are stored row by row as 32-bit floats, in mV, with the places
+// where no reading was taken containing NaN. The grid also knows where it is
+// located in the survey coordinate system, i.e. the position of its first
+// reading and the distance between the adjacent ones.
+class SurveyGrid
+{
+public:
+    SurveyGrid();
+
+    // remove all readings and reset the metadata to defaults
+    void Clear();
+
+    // exchange the contents of two grids without copying them
+    void Swap(SurveyGrid& other);
+
+    // replace the readings with the given ones, which must contain exactly
+    // width*height values, taking them from the vector which is left empty
+    void SetValues(size_t width, size_t height, wxVector<float>& values);
+
+    bool IsEmpty() const { return m_values.empty(); }
+    size_t GetWidth() const { return m_width; }
+    size_t GetHeight() const { return m_height; }
+    size_t GetCount() const { return m_values.size(); }
+
+    // access the readings without any checks
+    float GetValue(size_t x, size_t y) const
+        { return m_values[y*m_width + x]; }
+    void SetValue(size_t x, size_t y, float value)
+        { m_values[y*m_width + x] = value; }
+
+    // get all readings of the given row
+    const float *GetRow(size_t y) const { return &m_values[y*m_width]; }
+    float *GetRow(size_t y) { return &m_values[y*m_width]; }
+
+    // the value used for the missing readings and the test for it
+    static float GetMissingValue();
+    static bool IsMissing(float value) { return value != value; }
+
+    // the distance between adjacent readings, in survey units
+    double GetSpacingX() const { return m_spacingX; }
+    double GetSpacingY() const { return m_spacingY; }
+    void SetSpacing(double x, double y) { m_spacingX = x; m_spacingY = y; }
+
+    // the position of the first reading, in survey units
+    double GetOriginX() const { return m_originX; }
+    double GetOriginY() const { return m_originY; }
+    void SetOrigin(double x, double y) { m_originX = x; m_originY = y; }
+
+    // the name of the survey units, e.g. "ft" or "m", may be empty
+    const wxString& GetUnits() const { return m_units; }
+    void SetUnits(const wxString& units) { m_units = units; }
+
+private:
+    wxVector<float> m_values;
+    size_t m_width;
+    size_t m_height;
+
+    double m_spacingX;
+    double m_spacingY;
+    double m_originX;
+    double m_originY;
+    wxString m_units;
+
+    wxDECLARE_NO_COPY_CLASS(SurveyGrid);
+};
+
+#endif // _CORROLINX_CORROLINX_GRID_H_
@@ -0,0 +1,204 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_heap.cpp
+// Purpose:     Counts the memory allocated with operator new
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include <new>
+#include <stdlib.h>
+
+// counting the blocks slows down all allocations, so it's only done in the
+// builds used for the benchmarks, and it needs the size of a block allocated
+// by malloc() and a way to update the counters from all threads
+#if !defined(CORROLINX_BENCHMARKS)
+    // use the standard operators
+#elif defined(__WINDOWS__)
+    #include <malloc.h>
+    #include "wx/msw/wrapwin.h"
+    #define CORROLINX_BLOCK_SIZE(p) _msize(p)
+    #define CORROLINX_COUNT_HEAP
+#elif defined(__GNUC__)
+    #if defined(__APPLE__)
+        #include <malloc/malloc.h>
+        #define CORROLINX_BLOCK_SIZE(p) malloc_size(p)
+        #define CORROLINX_COUNT_HEAP
+    #elif defined(__GLIBC__)
+        #include <malloc.h>
+        #define CORROLINX_BLOCK_SIZE(p) malloc_usable_size(p)
+        #define CORROLINX_COUNT_HEAP
+    #endif
+#endif
+
+#include "corrolinx_heap.h"
+
+#ifdef CORROLINX_COUNT_HEAP
+
+// the replaced operators must have the same exception specifications as the
+// standard ones, which changed in C++11
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+    #define CORROLINX_THROW_BAD_ALLOC
+    #define CORROLINX_NOTHROW noexcept
+#else
+    #define CORROLINX_THROW_BAD_ALLOC throw(std::bad_alloc)
+    #define CORROLINX_NOTHROW throw()
+#endif
+
+namespace
+{
+
+#ifdef __WINDOWS__
+
+typedef LONGLONG Counter;
+
+inline void AddToCounter(volatile Counter& counter, Counter value)
+{
+    InterlockedExchangeAdd64(&counter, value);
+}
+
+inline Counter ReadCounter(volatile Counter& counter)
+{
+    return InterlockedCompareExchange64(&counter, 0, 0);
+}
+
+#else // !__WINDOWS__
+
+typedef wxInt64 Counter;
+
+inline void AddToCounter(volatile Counter& counter, Counter value)
+{
+    __sync_fetch_and_add(&counter, value);
+}
+
+inline Counter ReadCounter(volatile Counter& counter)
+{
+    return __sync_fetch_and_add(&counter, 0);
+}
+
+#endif // __WINDOWS__/!__WINDOWS__
+
+// these are used before any constructors run, so they must be statically
+// initialized
+volatile Counter gs_allocations = 0;
+volatile Counter gs_blocks = 0;
+volatile Counter gs_bytes = 0;
+
+void *Allocate(size_t size)
+{
+    // new must return a unique pointer even for empty blocks
+    void *p;
+    while ( (p = malloc(size ? size : 1)) == NULL )
+    {
+        std::new_handler handler = std::set_new_handler(NULL);
+        std::set_new_handler(handler);
+        if ( !handler )
+            return NULL;
+
+        handler();
+    }
+
+    AddToCounter(gs_allocations, 1);
+    AddToCounter(gs_blocks, 1);
+    AddToCounter(gs_bytes, CORROLINX_BLOCK_SIZE(p));
+
+    return p;
+}
+
+void Free(void *p)
+{
+    if ( !p )
+        return;
+
+    AddToCounter(gs_blocks, -1);
+    AddToCounter(gs_bytes, -static_cast<Counter>(CORROLINX_BLOCK_SIZE(p)));
+
+    free(p);
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// global operators replacement
+// ----------------------------------------------------------------------------
+
+void *operator new(size_t size) CORROLINX_THROW_BAD_ALLOC
+{
+    void * const p = Allocate(size);
+    if ( !p )
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void *operator new[](size_t size) CORROLINX_THROW_BAD_ALLOC
+{
+    void * const p = Allocate(size);
+    if ( !p )
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t&) CORROLINX_NOTHROW
+{
+    return Allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) CORROLINX_NOTHROW
+{
+    return Allocate(size);
+}
+
+void operator delete(void *p) CORROLINX_NOTHROW
+{
+    Free(p);
+}
+
+void operator delete[](void *p) CORROLINX_NOTHROW
+{
+    Free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t&) CORROLINX_NOTHROW
+{
+    Free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t&) CORROLINX_NOTHROW
+{
+    Free(p);
+}
+
+#endif // CORROLINX_COUNT_HEAP
+
+// ----------------------------------------------------------------------------
+// HeapStats implementation
+// ----------------------------------------------------------------------------
+
+bool GetHeapStats(HeapStats& stats)
+{
+#ifdef CORROLINX_COUNT_HEAP
+    stats.allocations = ReadCounter(gs_allocations);
+    stats.blocks = ReadCounter(gs_blocks);
+    stats.bytes = ReadCounter(gs_bytes);
+
+    return true;
+#else // !CORROLINX_COUNT_HEAP
+    wxUnusedVar(stats);
+
+    return false;
+#endif // CORROLINX_COUNT_HEAP/!CORROLINX_COUNT_HEAP
+}
@@ -0,0 +1,46 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_heap.h
+// Purpose:     Statistics of the memory allocated by the program
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_HEAP_H_
+#define _CORROLINX_CORROLINX_HEAP_H_
+
+#include "wx/defs.h"
+
+// ----------------------------------------------------------------------------
+// HeapStats: the blocks allocated with operator new
+// ----------------------------------------------------------------------------
+
+// When CORROLINX_BENCHMARKS is defined, the global operator new and delete are
+// replaced in corrolinx_heap.cpp to count the blocks they allocate, which is
+// used by the benchmarks to check how many allocations the data structures
+// need and how much memory they keep. The other builds use the standard
+// operators, as counting slows down all allocations. The size of the blocks is the one reported by the C run-time library,
+// so it includes the allocator slack but not its bookkeeping.
+//
+// Only the memory allocated with operator new is counted: wxVector of the
+// primitive types uses realloc() in the wxWidgets builds not using the
+// standard containers and so isn't, and neither are the blocks allocated by
+// the libraries with their own operators, e.g. by wxWidgets DLLs.
+struct HeapStats
+{
+    HeapStats() : allocations(0), blocks(0), bytes(0) { }
+
+    // the number of allocations done since the program start
+    wxInt64 allocations;
+
+    // the number and the total size of the blocks allocated and not freed
+    wxInt64 blocks;
+    wxInt64 bytes;
+};
+
+// get the current statistics, returns false if they're not available in this
+// build or on this platform
+bool GetHeapStats(HeapStats& stats);
+
+#endif // _CORROLINX_CORROLINX_HEAP_H_
@@ -0,0 +1,284 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_index.cpp
+// Purpose:     Implements the spatial index of the lines of a drawing
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include <algorithm>
+
+#include "corrolinx_index.h"
+
+namespace
+{
+
+// the size of the grid cells in logical units: this is a compromise between
+// the number of cells a long line is registered in and the number of lines
+// to check in each cell, and works well for hand drawn strokes
+const int CellSize = 64;
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// DoodleIndex implementation
+// ----------------------------------------------------------------------------
+
+DoodleIndex::DoodleIndex(const DoodleLines& lines)
+    : m_lines(lines)
+{
+}
+
+/* static */
+int DoodleIndex::GetCell(wxInt32 coord)
+{
+    // round towards negative infinity for negative coordinates too
+    return coord >= 0 ? coord / CellSize : -((-(coord + 1)) / CellSize) - 1;
+}
+
+/* static */
+void DoodleIndex::GetLineCells(const DoodleLine& line, CellKeys& cells)
+{
+    cells.clear();
+
+    int cx = GetCell(line.x1),
+        cy = GetCell(line.y1);
+    const int cxLast = GetCell(line.x2),
+              cyLast = GetCell(line.y2);
+    const int stepX = cxLast < cx ? -1 : 1,
+              stepY = cyLast < cy ? -1 : 1;
+
+    // walk along the line from one cell to the next one, finding which cell
+    // boundary it crosses first by comparing the distances to the next
+    // vertical and horizontal ones divided by the line extent in the same
+    // direction, but multiplying instead of dividing to keep it exact
+    const int dx = line.x2 > line.x1 ? line.x2 - line.x1 : line.x1 - line.x2,
+              dy = line.y2 > line.y1 ? line.y2 - line.y1 : line.y1 - line.y2;
+    int nextX = stepX > 0 ? (cx + 1)*CellSize - line.x1
+                          : line.x1 - cx*CellSize,
+        nextY = stepY > 0 ? (cy + 1)*CellSize - line.y1
+                          : line.y1 - cy*CellSize;
+
+    cells.push_back(MakeKey(cx, cy));
+    while ( cx != cxLast || cy != cyLast )
+    {
+        const wxLongLong_t crossX = static_cast<wxLongLong_t>(nextX)*dy,
+                           crossY = static_cast<wxLongLong_t>(nextY)*dx;
+        if ( cy == cyLast || (cx != cxLast && crossX < crossY) )
+        {
+            cx += stepX;
+            nextX += CellSize;
+        }
+        else if ( cx == cxLast || crossY < crossX )
+        {
+            cy += stepY;
+            nextY += CellSize;
+        }
+        else
+        {
+            // the line passes exactly through the corner of the cells, so
+            // it touches both cells adjacent to it too
+            cells.push_back(MakeKey(cx + stepX, cy));
+            cells.push_back(MakeKey(cx, cy + stepY));
+
+            cx += stepX;
+            nextX += CellSize;
+            cy += stepY;
+            nextY += CellSize;
+        }
+
+        cells.push_back(MakeKey(cx, cy));
+    }
+}
+
+void DoodleIndex::Clear()
+{
+    m_cells.clear();
+    m_bounds = wxRect();
+}
+
+void DoodleIndex::AddLines(size_t first)
+{
+    InsertLines(first, m_lines.size() - first);
+}
+
+void DoodleIndex::InsertLines(size_t first, size_t count)
+{
+    for ( size_t n = first; n < first + count; n++ )
+    {
+        const DoodleLine& line = m_lines[n];
+
+        GetLineCells(line, m_lineCells);
+        for ( CellKeys::const_iterator i = m_lineCells.begin();
+              i != m_lineCells.end();
+              ++i )
+        {
+            DoodleLineIndices& cell = m_cells[*i];
+
+            // the lines are usually added at the end
+            if ( cell.empty() || cell.back() < n )
+            {
+                cell.push_back(n);
+            }
+            else
+            {
+                cell.insert(std::lower_bound(cell.begin(), cell.end(),
+                                             static_cast<wxUint32>(n)),
+                            n);
+            }
+        }
+
+        const wxInt32 left = wxMin(line.x1, line.x2),
+                      right = wxMax(line.x1, line.x2),
+                      top = wxMin(line.y1, line.y2),
+                      bottom = wxMax(line.y1, line.y2);
+
+        m_bounds.Union(wxRect(left, top, right - left + 1, bottom - top + 1));
+    }
+}
+
+void DoodleIndex::RemoveLines(size_t first, size_t count)
+{
+    // removing the lines starting from the last one makes removing them from
+    // the end of the lines array, which is the most common case, cheap
+    for ( size_t n = first + count; n-- > first; )
+    {
+        GetLineCells(m_lines[n], m_lineCells);
+        for ( CellKeys::const_iterator key = m_lineCells.begin();
+              key != m_lineCells.end();
+              ++key )
+        {
+            DoodleIndexCells::iterator it = m_cells.find(*key);
+            wxCHECK_RET( it != m_cells.end(),
+                         "spatial index out of sync with the lines" );
+
+            DoodleLineIndices& cell = it->second;
+            DoodleLineIndices::iterator
+                i = cell.back() == n
+                        ? cell.end() - 1
+                        : std::lower_bound(cell.begin(), cell.end(),
+                                           static_cast<wxUint32>(n));
+            wxCHECK_RET( i != cell.end() && *i == n,
+                         "spatial index out of sync with the lines" );
+
+            cell.erase(i);
+            if ( cell.empty() )
+                m_cells.erase(it);
+        }
+    }
+}
+
+void DoodleIndex::CollectCell(const DoodleLineIndices& cell,
+                              const wxRect& rect,
+                              DoodleLineIndices& result) const
+{
+    for ( DoodleLineIndices::const_iterator i = cell.begin();
+          i != cell.end();
+          ++i )
+    {
+        const DoodleLine& line = m_lines[*i];
+
+        const wxInt32 left = wxMax(wxMin(line.x1, line.x2), rect.x),
+                      top = wxMax(wxMin(line.y1, line.y2), rect.y);
+        if ( left > wxMin(wxMax(line.x1, line.x2), rect.GetRight()) ||
+             top > wxMin(wxMax(line.y1, line.y2), rect.GetBottom()) )
+            continue;
+
+        result.push_back(*i);
+    }
+}
+
+void DoodleIndex::QueryRect(const wxRect& rect, DoodleLineIndices& result) const
+{
+    result.clear();
+
+    if ( rect.IsEmpty() )
+        return;
+
+    const int cxFirst = GetCell(rect.x),
+              cyFirst = GetCell(rect.y),
+              cxLast = GetCell(rect.GetRight()),
+              cyLast = GetCell(rect.GetBottom());
+
+    // when the rectangle spans more cells than are actually used, e.g. for a
+    // zoomed out view, it's cheaper to check all the existing cells
+    const double cellsInRect = (cxLast - cxFirst + 1.) * (cyLast - cyFirst + 1.);
+    if ( cellsInRect > m_cells.size() )
+    {
+        for ( DoodleIndexCells::const_iterator it = m_cells.begin();
+              it != m_cells.end();
+              ++it )
+        {
+            const wxULongLong_t key = static_cast<wxULongLong_t>(it->first);
+            const int cx = static_cast<wxInt32>(key >> 32),
+                      cy = static_cast<wxInt32>(static_cast<wxUint32>(key));
+
+            if ( cx >= cxFirst && cx <= cxLast &&
+                 cy >= cyFirst && cy <= cyLast )
+                CollectCell(it->second, rect, result);
+        }
+    }
+    else
+    {
+        for ( int cy = cyFirst; cy <= cyLast; cy++ )
+        {
+            for ( int cx = cxFirst; cx <= cxLast; cx++ )
+            {
+                DoodleIndexCells::const_iterator
+                    it = m_cells.find(MakeKey(cx, cy));
+                if ( it != m_cells.end() )
+                    CollectCell(it->second, rect, result);
+            }
+        }
+    }
+
+    // the lines passing through several cells were found in each of them
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+int DoodleIndex::QueryPoint(const wxPoint& pt, int tolerance) const
+{
+    DoodleLineIndices candidates;
+    QueryRect(wxRect(pt.x - tolerance, pt.y - tolerance,
+                     2*tolerance + 1, 2*tolerance + 1),
+              candidates);
+
+    // the lines drawn last are on top, so check them first
+    const double maxDist2 = static_cast<double>(tolerance)*tolerance;
+    for ( size_t n = candidates.size(); n-- > 0; )
+    {
+        const DoodleLine& line = m_lines[candidates[n]];
+
+        // find the closest point of the line to pt
+        const double dx = line.x2 - line.x1,
+                     dy = line.y2 - line.y1;
+        const double len2 = dx*dx + dy*dy;
+
+        double t = 0;
+        if ( len2 > 0 )
+        {
+            t = ((pt.x - line.x1)*dx + (pt.y - line.y1)*dy) / len2;
+            t = wxMax(0., wxMin(1., t));
+        }
+
+        const double ex = line.x1 + t*dx - pt.x,
+                     ey = line.y1 + t*dy - pt.y;
+        if ( ex*ex + ey*ey <= maxDist2 )
+            return candidates[n];
+    }
+
+    return wxNOT_FOUND;
+}
@@ -0,0 +1,106 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_index.h
+// Purpose:     Spatial index of the lines of a drawing
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_INDEX_H_
+#define _CORROLINX_CORROLINX_INDEX_H_
+
+#include "wx/hashmap.h"
+#include "wx/vector.h"
+
+#include "corrolinx_doc.h"
+
+// the non-empty cells of DoodleIndex, see its MakeKey()
+WX_DECLARE_HASH_MAP(wxLongLong_t, DoodleLineIndices,
+                    wxIntegerHash, wxIntegerEqual,
+                    DoodleIndexCells);
+
+// ----------------------------------------------------------------------------
+// DoodleIndex: uniform grid of lines used for culling and hit testing
+// ----------------------------------------------------------------------------
+
+// The plane is divided into square cells and each line is registered in all
+// the cells it passes through. Only non-empty cells are stored, so the grid
+// is unbounded and its memory use proportional to the geometry.
+//
+// The indices of the lines in each cell are kept sorted, so that the lines
+// are found in the order in which they're drawn. Adding the lines at the end
+// is the most common case and is cheap, inserting or removing them in the
+// middle is also possible but costs proportionally to the size of the cells.
+class DoodleIndex
+{
+public:
+    // the index refers to, but doesn't own, the lines it indexes
+    explicit DoodleIndex(const DoodleLines& lines);
+
+    // forget all lines
+    void Clear();
+
+    // add the lines with indices starting at first and up to the end of the
+    // lines array
+    void AddLines(size_t first);
+
+    // add count lines starting at first which were not indexed yet, e.g.
+    // because they were removed from the index before being changed
+    void InsertLines(size_t first, size_t count);
+
+    // remove count lines starting at first, this must be called before they
+    // are actually changed or removed from the lines array
+    void RemoveLines(size_t first, size_t count);
+
+    // get the indices of all lines passing through the cells overlapping the
+    // given rectangle and with the bounding box intersecting it, sorted in
+    // increasing order
+    void QueryRect(const wxRect& rect, DoodleLineIndices& result) const;
+
+    // get the index of the topmost line passing within the given distance of
+    // the point or wxNOT_FOUND
+    int QueryPoint(const wxPoint& pt, int tolerance) const;
+
+    // get the bounding box of all lines ever added since the last Clear(),
+    // this doesn't shrink when lines are removed or moved
+    const wxRect& GetBounds() const { return m_bounds; }
+
+private:
+    typedef wxLongLong_t CellKey;
+    typedef wxVector<CellKey> CellKeys;
+
+    static CellKey MakeKey(int cx, int cy)
+    {
+        const wxULongLong_t hi = static_cast<wxUint32>(cx);
+        return static_cast<CellKey>((hi << 32) | static_cast<wxUint32>(cy));
+    }
+
+    // return the cell containing the given coordinate
+    static int GetCell(wxInt32 coord);
+
+    // get the keys of all cells the line passes through, its coordinates
+    // must be valid, see DoodleLine::IsValid()
+    static void GetLineCells(const DoodleLine& line, CellKeys& cells);
+
+    // append the lines of the given cell with the bounding box intersecting
+    // the rectangle, the lines passing through several cells are appended
+    // once for each of them
+    void CollectCell(const DoodleLineIndices& cell,
+                     const wxRect& rect,
+                     DoodleLineIndices& result) const;
+
+    const DoodleLines& m_lines;
+
+    DoodleIndexCells m_cells;
+
+    wxRect m_bounds;
+
+    // the cells of the line being added or removed, only used by
+    // InsertLines() and RemoveLines() but kept here to avoid reallocating it
+    CellKeys m_lineCells;
+
+    wxDECLARE_NO_COPY_CLASS(DoodleIndex);
+};
+
+#endif // _CORROLINX_CORROLINX_INDEX_H_
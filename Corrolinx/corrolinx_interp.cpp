@@ -0,0 +1,302 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_interp.cpp
+// Purpose:     Implements interpolation of the survey readings
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "corrolinx_interp.h"
+#include "corrolinx_workers.h"
+
+#include <math.h>
+
+namespace
+{
+
+// the output is computed in square tiles of this size, which are small
+// enough to balance the load between the threads and big enough to make the
+// scheduling overhead negligible
+const size_t TILE_SIZE = 128;
+
+// the readings used by the inverse distance weighting are those at most this
+// many cells away from the interpolated point along each axis
+const int IDW_RADIUS = 3;
+
+// if the sum of the weights of the readings used by bicubic interpolation is
+// smaller than this because some of them are missing, the result can't be
+// trusted and bilinear interpolation is used instead, which itself falls back
+// to inverse distance weighting if it has no readings to work with
+const float MIN_BICUBIC_WEIGHT = 0.25f;
+
+// the coordinate in the input grid of the center of the output cell n and the
+// integer and fractional parts of it
+struct SourcePos
+{
+    SourcePos(size_t n, int factor)
+    {
+        const float pos = (n + 0.5f)/factor - 0.5f;
+        index = static_cast<int>(floor(pos));
+        frac = pos - index;
+    }
+
+    int index;
+    float frac;
+};
+
+class InterpolationTask : public ParallelTask
+{
+public:
+    InterpolationTask(const SurveyGrid& input,
+                      SurveyInterpolation method,
+                      int factor,
+                      SurveyGrid& output)
+        : m_input(input),
+          m_method(method),
+          m_factor(factor),
+          m_output(output),
+          m_width(input.GetWidth()),
+          m_height(input.GetHeight())
+    {
+        m_tilesX = (output.GetWidth() + TILE_SIZE - 1)/TILE_SIZE;
+    }
+
+    size_t GetTileCount() const
+    {
+        return m_tilesX*((m_output.GetHeight() + TILE_SIZE - 1)/TILE_SIZE);
+    }
+
+    virtual void Process(size_t n);
+
+private:
+    // return the reading at the given position clamped to the grid
+    float GetClamped(int x, int y) const
+    {
+        return m_input.GetValue(wxMax(0, wxMin(x, m_width - 1)),
+                                wxMax(0, wxMin(y, m_height - 1)));
+    }
+
+    float Nearest(const SourcePos& x, const SourcePos& y) const;
+    float Bilinear(const SourcePos& x, const SourcePos& y) const;
+    float Bicubic(const SourcePos& x, const SourcePos& y) const;
+    float InverseDistance(const SourcePos& x, const SourcePos& y) const;
+
+    const SurveyGrid& m_input;
+    const SurveyInterpolation m_method;
+    const int m_factor;
+    SurveyGrid& m_output;
+
+    const int m_width;
+    const int m_height;
+    size_t m_tilesX;
+
+    wxDECLARE_NO_COPY_CLASS(InterpolationTask);
+};
+
+void InterpolationTask::Process(size_t n)
+{
+    const size_t left = (n % m_tilesX)*TILE_SIZE,
+                 top = (n / m_tilesX)*TILE_SIZE,
+                 right = wxMin(left + TILE_SIZE, m_output.GetWidth()),
+                 bottom = wxMin(top + TILE_SIZE, m_output.GetHeight());
+
+    for ( size_t row = top; row < bottom; row++ )
+    {
+        const SourcePos y(row, m_factor);
+        float * const values = m_output.GetRow(row);
+
+        for ( size_t col = left; col < right; col++ )
+        {
+            const SourcePos x(col, m_factor);
+
+            float value;
+            switch ( m_method )
+            {
+                case Interpolation_Bilinear:
+                    value = Bilinear(x, y);
+                    break;
+
+                case Interpolation_Bicubic:
+                    value = Bicubic(x, y);
+                    break;
+
+                case Interpolation_InverseDistance:
+                    value = InverseDistance(x, y);
+                    break;
+
+                case Interpolation_None:
+                default:
+                    value = Nearest(x, y);
+                    break;
+            }
+
+            values[col] = value;
+        }
+    }
+}
+
+float InterpolationTask::Nearest(const SourcePos& x, const SourcePos& y) const
+{
+    return GetClamped(x.index + (x.frac >= 0.5f), y.index + (y.frac >= 0.5f));
+}
+
+float InterpolationTask::Bilinear(const SourcePos& x, const SourcePos& y) const
+{
+    const float wx[2] = { 1 - x.frac, x.frac },
+                wy[2] = { 1 - y.frac, y.frac };
+
+    float sum = 0,
+          weights = 0;
+    for ( int j = 0; j < 2; j++ )
+    {
+        for ( int i = 0; i < 2; i++ )
+        {
+            const float value = GetClamped(x.index + i, y.index + j);
+            if ( SurveyGrid::IsMissing(value) )
+                continue;
+
+            const float w = wx[i]*wy[j];
+            sum += w*value;
+            weights += w;
+        }
+    }
+
+    // all readings with non-zero weights are missing, look further away
+    if ( weights == 0 )
+        return InverseDistance(x, y);
+
+    return sum/weights;
+}
+
+float InterpolationTask::Bicubic(const SourcePos& x, const SourcePos& y) const
+{
+    // Catmull-Rom spline weights of the 4 readings around the point
+    float wx[4], wy[4];
+    const SourcePos *pos[2] = { &x, &y };
+    float *w[2] = { wx, wy };
+    for ( int k = 0; k < 2; k++ )
+    {
+        const float t = pos[k]->frac,
+                    t2 = t*t,
+                    t3 = t2*t;
+
+        w[k][0] = 0.5f*(-t3 + 2*t2 - t);
+        w[k][1] = 0.5f*(3*t3 - 5*t2 + 2);
+        w[k][2] = 0.5f*(-3*t3 + 4*t2 + t);
+        w[k][3] = 0.5f*(t3 - t2);
+    }
+
+    float sum = 0,
+          weights = 0;
+    for ( int j = 0; j < 4; j++ )
+    {
+        for ( int i = 0; i < 4; i++ )
+        {
+            const float value = GetClamped(x.index + i - 1, y.index + j - 1);
+            if ( SurveyGrid::IsMissing(value) )
+                continue;
+
+            const float weight = wx[i]*wy[j];
+            sum += weight*value;
+            weights += weight;
+        }
+    }
+
+    // the weights sum to 1 if no readings are missing
+    if ( weights < MIN_BICUBIC_WEIGHT )
+        return Bilinear(x, y);
+
+    return sum/weights;
+}
+
+float InterpolationTask::InverseDistance(const SourcePos& x,
+                                         const SourcePos& y) const
+{
+    const int cx = x.index + (x.frac >= 0.5f),
+              cy = y.index + (y.frac >= 0.5f);
+
+    const int left = wxMax(0, cx - IDW_RADIUS),
+              top = wxMax(0, cy - IDW_RADIUS),
+              right = wxMin(m_width - 1, cx + IDW_RADIUS),
+              bottom = wxMin(m_height - 1, cy + IDW_RADIUS);
+
+    const float px = x.index + x.frac,
+                py = y.index + y.frac;
+
+    float sum = 0,
+          weights = 0;
+    for ( int j = top; j <= bottom; j++ )
+    {
+        const float * const row = m_input.GetRow(j);
+        const float dy = j - py;
+
+        for ( int i = left; i <= right; i++ )
+        {
+            const float value = row[i];
+            if ( SurveyGrid::IsMissing(value) )
+                continue;
+
+            const float dx = i - px;
+            const float d2 = dx*dx + dy*dy;
+
+            // the value at the reading itself is just the reading
+            if ( d2 < 1e-6f )
+                return value;
+
+            // use the usual power of 2, i.e. weights inversely proportional
+            // to the squared distance
+            const float weight = 1/d2;
+            sum += weight*value;
+            weights += weight;
+        }
+    }
+
+    return weights > 0 ? sum/weights : SurveyGrid::GetMissingValue();
+}
+
+} // anonymous namespace
+
+bool InterpolateSurvey(const SurveyGrid& input,
+                       SurveyInterpolation method,
+                       int factor,
+                       SurveyGrid& output,
+                       WorkerPool& pool)
+{
+    wxCHECK_MSG( factor > 0, false, "invalid interpolation factor" );
+
+    const size_t width = input.GetWidth()*factor,
+                 height = input.GetHeight()*factor;
+    if ( height && width > MAX_INTERPOLATED_VALUES/height )
+        return false;
+
+    wxVector<float> values(width*height);
+    output.SetValues(width, height, values);
+
+    // the output covers the same area as the input
+    output.SetSpacing(input.GetSpacingX()/factor, input.GetSpacingY()/factor);
+    output.SetOrigin(input.GetOriginX() +
+                        input.GetSpacingX()*(0.5/factor - 0.5),
+                     input.GetOriginY() +
+                        input.GetSpacingY()*(0.5/factor - 0.5));
+    output.SetUnits(input.GetUnits());
+
+    if ( input.IsEmpty() )
+        return true;
+
+    InterpolationTask task(input, method, factor, output);
+    pool.Run(task, task.GetTileCount());
+
+    return true;
+}
@@ -0,0 +1,45 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_interp.h
+// Purpose:     Interpolation of the survey readings
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_INTERP_H_
+#define _CORROLINX_CORROLINX_INTERP_H_
+
+#include "corrolinx_grid.h"
+
+class WorkerPool;
+
+// The methods of computing the values between the readings
+enum SurveyInterpolation
+{
+    Interpolation_None,         // just use the nearest reading
+    Interpolation_Bilinear,
+    Interpolation_Bicubic,      // Catmull-Rom spline
+    Interpolation_InverseDistance
+};
+
+// the maximal number of values in the grid produced by InterpolateSurvey()
+const size_t MAX_INTERPOLATED_VALUES = 64*1024*1024;
+
+// Fill the output grid with values interpolated between the readings of the
+// input one, with factor times more values than it along each axis and
+// covering the same area, splitting the work between the threads of the pool.
+//
+// The missing readings are ignored by all methods, with the weights of the
+// other ones adjusted accordingly, so the gaps in the readings are filled in
+// too. The output values are only missing if there are no readings at all
+// near them.
+//
+// Returns false if the output grid would be too big.
+bool InterpolateSurvey(const SurveyGrid& input,
+                       SurveyInterpolation method,
+                       int factor,
+                       SurveyGrid& output,
+                       WorkerPool& pool);
+
+#endif // _CORROLINX_CORROLINX_INTERP_H_
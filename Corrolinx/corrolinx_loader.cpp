@@ -0,0 +1,210 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_loader.cpp
+// Purpose:     Implements background loading of large drawing documents
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "corrolinx_loader.h"
+#include "corrolinx_mmap.h"
+
+namespace
+{
+
+// the size of the first and of the largest batches, in lines
+const size_t FIRST_BATCH_SIZE = 4096;
+const size_t MAX_BATCH_SIZE = 256*1024;
+
+// the number of lines and segments read between the checks for cancellation
+const size_t CANCEL_CHECK_INTERVAL = 4096;
+
+// read a decimal integer preceded by optional whitespace, advancing p
+bool ReadInt(const char *& p, const char *end, wxInt32& value)
+{
+    while ( p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') )
+        p++;
+
+    bool negative = false;
+    if ( p != end && (*p == '-' || *p == '+') )
+        negative = *p++ == '-';
+
+    if ( p == end || *p < '0' || *p > '9' )
+        return false;
+
+    wxInt64 n = 0;
+    while ( p != end && *p >= '0' && *p <= '9' )
+    {
+        n = n*10 + (*p++ - '0');
+        if ( n > wxINT32_MAX )
+            return false;
+    }
+
+    value = static_cast<wxInt32>(negative ? -n : n);
+
+    return true;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// DrawingLoader implementation
+// ----------------------------------------------------------------------------
+
+DrawingLoader::DrawingLoader(wxEvtHandler *handler, const wxString& filename)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_handler(handler),
+      m_filename(filename)
+{
+    m_current = new DrawingLoadBatch;
+    m_batchSize = FIRST_BATCH_SIZE;
+    m_status = Status_Running;
+}
+
+DrawingLoader::~DrawingLoader()
+{
+    delete m_current;
+
+    for ( DrawingLoadBatches::iterator i = m_batches.begin();
+          i != m_batches.end();
+          ++i )
+    {
+        delete *i;
+    }
+}
+
+void DrawingLoader::TakeBatches(DrawingLoadBatches& batches)
+{
+    wxCriticalSectionLocker lock(m_cs);
+
+    batches.insert(batches.end(), m_batches.begin(), m_batches.end());
+    m_batches.clear();
+}
+
+DrawingLoader::Status DrawingLoader::GetStatus() const
+{
+    wxCriticalSectionLocker lock(m_cs);
+
+    return m_status;
+}
+
+wxThread::ExitCode DrawingLoader::Entry()
+{
+    Status status = Status_Failed;
+
+    MappedFile file;
+    if ( file.Open(m_filename) )
+        status = Parse(file.GetData(), file.GetData() + file.GetSize());
+
+    // give whatever we have to the handler even if we failed
+    {
+        wxCriticalSectionLocker lock(m_cs);
+
+        if ( !m_current->counts.empty() )
+        {
+            m_batches.push_back(m_current);
+            m_current = new DrawingLoadBatch;
+        }
+
+        m_status = status;
+    }
+
+    wxQueueEvent(m_handler, new wxThreadEvent);
+
+    return 0;
+}
+
+DrawingLoader::Status DrawingLoader::Parse(const char *p, const char *end)
+{
+    wxInt32 count = 0;
+    if ( !ReadInt(p, end, count) || count < 0 )
+    {
+        wxLogWarning("Drawing document corrupted: invalid segments count.");
+        return Status_Failed;
+    }
+
+    // check for cancellation regularly and not only when a batch is full, as
+    // a single segment can be huge and empty segments never fill a batch
+    size_t sinceCheck = 0;
+
+    for ( wxInt32 n = 0; n < count; n++ )
+    {
+        if ( ++sinceCheck == CANCEL_CHECK_INTERVAL )
+        {
+            sinceCheck = 0;
+            if ( TestDestroy() )
+                return Status_Cancelled;
+        }
+
+        wxInt32 lines = 0;
+        if ( !ReadInt(p, end, lines) || lines < 0 )
+        {
+            wxLogWarning("Drawing document corrupted: invalid lines count.");
+            return Status_Failed;
+        }
+
+        for ( wxInt32 k = 0; k < lines; k++ )
+        {
+            DoodleLine line;
+            if ( !ReadInt(p, end, line.x1) || !ReadInt(p, end, line.y1) ||
+                    !ReadInt(p, end, line.x2) || !ReadInt(p, end, line.y2) )
+            {
+                wxLogWarning("Drawing document corrupted: invalid line.");
+                return Status_Failed;
+            }
+
+            if ( !line.IsValid() )
+            {
+                wxLogWarning("Drawing document corrupted: "
+                             "invalid coordinates.");
+                return Status_Failed;
+            }
+
+            m_current->lines.push_back(line);
+
+            if ( ++sinceCheck == CANCEL_CHECK_INTERVAL )
+            {
+                sinceCheck = 0;
+                if ( TestDestroy() )
+                    return Status_Cancelled;
+            }
+        }
+
+        m_current->counts.push_back(lines);
+
+        if ( m_current->lines.size() >= m_batchSize )
+            Flush();
+    }
+
+    return Status_Done;
+}
+
+void DrawingLoader::Flush()
+{
+    DrawingLoadBatch * const batch = m_current;
+    m_current = new DrawingLoadBatch;
+    m_current->lines.reserve(m_batchSize);
+
+    if ( m_batchSize < MAX_BATCH_SIZE )
+        m_batchSize *= 2;
+
+    {
+        wxCriticalSectionLocker lock(m_cs);
+
+        m_batches.push_back(batch);
+    }
+
+    wxQueueEvent(m_handler, new wxThreadEvent);
+}
@@ -0,0 +1,88 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_loader.h
+// Purpose:     Background loading of large drawing documents
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_LOADER_H_
+#define _CORROLINX_CORROLINX_LOADER_H_
+
+#include "wx/thread.h"
+#include "wx/vector.h"
+
+#include "corrolinx_doc.h"
+
+// ----------------------------------------------------------------------------
+// A chunk of segments parsed by DrawingLoader
+// ----------------------------------------------------------------------------
+
+struct DrawingLoadBatch
+{
+    // the lines of all segments of this batch
+    DoodleLines lines;
+
+    // the number of lines in each segment
+    wxVector<size_t> counts;
+};
+
+typedef wxVector<DrawingLoadBatch *> DrawingLoadBatches;
+
+// ----------------------------------------------------------------------------
+// DrawingLoader: parses a text drawing file in a worker thread
+// ----------------------------------------------------------------------------
+
+// The loader sends wxEVT_THREAD events to its handler whenever a new batch of
+// segments is available and once more when it terminates. The handler should
+// then call TakeBatches() and, if the loader is not running any more,
+// Wait() for it and delete it.
+class DrawingLoader : public wxThread
+{
+public:
+    enum Status
+    {
+        Status_Running,
+        Status_Done,
+        Status_Failed,
+        Status_Cancelled
+    };
+
+    DrawingLoader(wxEvtHandler *handler, const wxString& filename);
+    virtual ~DrawingLoader();
+
+    // get the batches parsed since the last call, the caller becomes
+    // responsible for deleting them
+    void TakeBatches(DrawingLoadBatches& batches);
+
+    Status GetStatus() const;
+
+protected:
+    virtual ExitCode Entry();
+
+private:
+    // parse the document contents
+    Status Parse(const char *p, const char *end);
+
+    // pass the current batch to the handler
+    void Flush();
+
+    wxEvtHandler * const m_handler;
+    const wxString m_filename;
+
+    // the batch being filled by the worker thread and its desired size which
+    // starts small to show something as soon as possible and then grows
+    DrawingLoadBatch *m_current;
+    size_t m_batchSize;
+
+    // protects the fields below which are shared with the main thread
+    mutable wxCriticalSection m_cs;
+
+    DrawingLoadBatches m_batches;
+    Status m_status;
+
+    wxDECLARE_NO_COPY_CLASS(DrawingLoader);
+};
+
+#endif // _CORROLINX_CORROLINX_LOADER_H_
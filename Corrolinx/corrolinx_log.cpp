@@ -0,0 +1,385 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_log.cpp
+// Purpose:     Implements read-only documents for big text files
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "wx/ffile.h"
+#include "wx/filename.h"
+
+#include "corrolinx_log.h"
+#include "corrolinx_doc.h"
+#include "corrolinx_view.h"
+
+namespace
+{
+
+// the text files bigger than this are opened as logs
+const unsigned long LARGE_TEXT_FILE_SIZE = 8*1024*1024;
+
+// the size of the first and of the largest chunks of the file indexed before
+// passing the lines found in them to the main thread
+const size_t FIRST_CHUNK_SIZE = 256*1024;
+const size_t MAX_CHUNK_SIZE = 16*1024*1024;
+
+// find the line terminators in the given range of data, continuing after the
+// given number of lines found before it, append the offset of the start of
+// every LogIndexer::CHECKPOINT_LINES-th line to checkpoints and return the
+// new number of lines
+size_t FindLines(const char *data,
+                 size_t from,
+                 size_t to,
+                 size_t lines,
+                 wxVector<size_t>& checkpoints)
+{
+    const char *p = data + from;
+    const char * const end = data + to;
+    while ( p != end )
+    {
+        const char * const
+            eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if ( !eol )
+            break;
+
+        p = eol + 1;
+
+        if ( ++lines % LogIndexer::CHECKPOINT_LINES == 0 )
+            checkpoints.push_back(p - data);
+    }
+
+    return lines;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// LogIndexer implementation
+// ----------------------------------------------------------------------------
+
+LogIndexer::LogIndexer(wxEvtHandler *handler, const char *data, size_t size)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_handler(handler),
+      m_data(data),
+      m_size(size),
+      m_lineCount(0),
+      m_done(false)
+{
+}
+
+size_t LogIndexer::TakeCheckpoints(wxVector<size_t>& checkpoints)
+{
+    wxCriticalSectionLocker lock(m_cs);
+
+    for ( size_t n = 0; n < m_checkpoints.size(); n++ )
+        checkpoints.push_back(m_checkpoints[n]);
+    m_checkpoints.clear();
+
+    return m_lineCount;
+}
+
+bool LogIndexer::IsDone() const
+{
+    wxCriticalSectionLocker lock(m_cs);
+
+    return m_done;
+}
+
+/* static */
+size_t LogIndexer::IndexAll(const char *data,
+                            size_t size,
+                            wxVector<size_t>& checkpoints)
+{
+    size_t lines = FindLines(data, 0, size, 0, checkpoints);
+
+    // the last line may be not terminated
+    if ( size && data[size - 1] != '\n' )
+        lines++;
+
+    return lines;
+}
+
+wxThread::ExitCode LogIndexer::Entry()
+{
+    wxVector<size_t> checkpoints;
+    size_t lines = 0;
+
+    // the chunks start small to show the first lines as soon as possible
+    size_t pos = 0;
+    size_t chunk = FIRST_CHUNK_SIZE;
+    for ( ;; )
+    {
+        const size_t end = pos + wxMin(chunk, m_size - pos);
+        lines = FindLines(m_data, pos, end, lines, checkpoints);
+        pos = end;
+
+        // the last chunk is passed to the handler below
+        if ( pos == m_size )
+            break;
+
+        if ( chunk < MAX_CHUNK_SIZE )
+            chunk *= 2;
+
+        {
+            wxCriticalSectionLocker lock(m_cs);
+
+            for ( size_t n = 0; n < checkpoints.size(); n++ )
+                m_checkpoints.push_back(checkpoints[n]);
+            m_lineCount = lines;
+        }
+
+        checkpoints.clear();
+
+        wxQueueEvent(m_handler, new wxThreadEvent);
+
+        if ( TestDestroy() )
+            return 0;
+    }
+
+    if ( m_size && m_data[m_size - 1] != '\n' )
+        lines++;
+
+    {
+        wxCriticalSectionLocker lock(m_cs);
+
+        for ( size_t n = 0; n < checkpoints.size(); n++ )
+            m_checkpoints.push_back(checkpoints[n]);
+        m_lineCount = lines;
+        m_done = true;
+    }
+
+    wxQueueEvent(m_handler, new wxThreadEvent);
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// LogDocument implementation
+// ----------------------------------------------------------------------------
+
+IMPLEMENT_DYNAMIC_CLASS(LogDocument, wxDocument)
+
+LogDocument::LogDocument()
+    : wxDocument(),
+      m_lineCount(0),
+      m_indexer(NULL)
+{
+    m_checkpoints.push_back(0);
+
+    Bind(wxEVT_THREAD, &LogDocument::OnIndexerEvent, this);
+}
+
+LogDocument::~LogDocument()
+{
+    // the indexer uses our file mapping, so it must be gone before it is
+    StopIndexer();
+}
+
+wxString LogDocument::GetLine(size_t n, size_t maxLength) const
+{
+    const char * const data = m_file.GetData();
+    const char * const end = data + m_file.GetSize();
+
+    // skip the lines between the closest checkpoint and this one
+    const char *p = data + m_checkpoints[n / LogIndexer::CHECKPOINT_LINES];
+    for ( size_t i = n % LogIndexer::CHECKPOINT_LINES; i; i-- )
+        p = static_cast<const char *>(memchr(p, '\n', end - p)) + 1;
+
+    // don't look for the end of a huge line further than we need
+    const size_t scan = wxMin(static_cast<size_t>(end - p), maxLength);
+    const char *eol = static_cast<const char *>(memchr(p, '\n', scan));
+    if ( !eol )
+        eol = p + scan;
+    if ( eol != p && eol[-1] == '\r' )
+        eol--;
+
+    const size_t length = eol - p;
+
+    // don't cut a long line in the middle of a UTF-8 character
+    const char *cut = eol;
+    while ( cut != p && cut != end && (*cut & 0xC0) == 0x80 )
+        cut--;
+
+    // the logs are normally in UTF-8, but fall back to Latin-1 which accepts
+    // anything if they're not
+    wxString line = wxString::FromUTF8(p, cut - p);
+    if ( line.empty() && length )
+        line = wxString(p, wxConvISO8859_1, length);
+
+    return line;
+}
+
+bool LogDocument::OnNewDocument()
+{
+    wxLogError("Logs can only be opened, not created.");
+
+    return false;
+}
+
+bool LogDocument::OnCloseDocument()
+{
+    StopIndexer();
+
+    return wxDocument::OnCloseDocument();
+}
+
+bool LogDocument::DoOpenDocument(const wxString& filename)
+{
+    // this can happen when reverting a document which is still being indexed
+    StopIndexer();
+
+    m_checkpoints.clear();
+    m_checkpoints.push_back(0);
+    m_lineCount = 0;
+
+    if ( !m_file.Open(filename) )
+        return false;
+
+    // without any views there is nobody to show the lines progressively
+    if ( !GetFirstView() )
+    {
+        m_lineCount = LogIndexer::IndexAll(m_file.GetData(),
+                                           m_file.GetSize(),
+                                           m_checkpoints);
+        return true;
+    }
+
+    m_indexer = new LogIndexer(this, m_file.GetData(), m_file.GetSize());
+    if ( m_indexer->Run() != wxTHREAD_NO_ERROR )
+    {
+        wxLogDebug("Failed to start the indexer thread.");
+
+        delete m_indexer;
+        m_indexer = NULL;
+
+        m_lineCount = LogIndexer::IndexAll(m_file.GetData(),
+                                           m_file.GetSize(),
+                                           m_checkpoints);
+    }
+
+    return true;
+}
+
+bool LogDocument::DoSaveDocument(const wxString& filename)
+{
+    // the file can't be overwritten while it's mapped, and there is nothing
+    // to save in it anyhow
+    if ( wxFileName(filename).SameAs(GetFilename()) )
+        return true;
+
+    wxFFile file(filename, "wb");
+    if ( !file.IsOpened() )
+        return false;
+
+    const size_t size = m_file.GetSize();
+    return (!size || file.Write(m_file.GetData(), size) == size) &&
+                file.Close();
+}
+
+void LogDocument::OnIndexerEvent(wxThreadEvent& WXUNUSED(event))
+{
+    // the event may have been queued before the indexer was stopped
+    if ( !m_indexer )
+        return;
+
+    TakeCheckpoints();
+
+    if ( !m_indexer->IsDone() )
+        return;
+
+    m_indexer->Wait();
+
+    // it could have found more lines after we took the others
+    TakeCheckpoints();
+    wxDELETE(m_indexer);
+
+    wxLogStatus("Indexed %lu lines.", static_cast<unsigned long>(m_lineCount));
+}
+
+void LogDocument::TakeCheckpoints()
+{
+    const size_t lines = m_indexer->TakeCheckpoints(m_checkpoints);
+    if ( lines == m_lineCount )
+        return;
+
+    m_lineCount = lines;
+
+    UpdateAllViews();
+}
+
+void LogDocument::StopIndexer()
+{
+    if ( !m_indexer )
+        return;
+
+    m_indexer->Delete();
+    wxDELETE(m_indexer);
+}
+
+// ----------------------------------------------------------------------------
+// TextDocTemplate implementation
+// ----------------------------------------------------------------------------
+
+TextDocTemplate::TextDocTemplate(wxDocManager *manager,
+                                 const wxString& descr,
+                                 const wxString& filter,
+                                 const wxString& dir,
+                                 const wxString& ext,
+                                 const wxString& docTypeName,
+                                 const wxString& viewTypeName)
+    : wxDocTemplate(manager, descr, filter, dir, ext,
+                    docTypeName, viewTypeName,
+                    CLASSINFO(TextEditDocument), CLASSINFO(TextEditView)),
+      m_log(false)
+{
+}
+
+wxDocument *TextDocTemplate::CreateDocument(const wxString& path, long flags)
+{
+    // the document and its first view are created by the base class, so
+    // decide which kind of them to create before calling it
+    m_log = false;
+    if ( !(flags & wxDOC_NEW) )
+    {
+        const wxULongLong size = wxFileName::GetSize(path);
+        m_log = size != wxInvalidSize && size > LARGE_TEXT_FILE_SIZE;
+    }
+
+    return wxDocTemplate::CreateDocument(path, flags);
+}
+
+wxView *TextDocTemplate::CreateView(wxDocument *doc, long flags)
+{
+    m_log = wxDynamicCast(doc, LogDocument) != NULL;
+
+    return wxDocTemplate::CreateView(doc, flags);
+}
+
+wxDocument *TextDocTemplate::DoCreateDocument()
+{
+    if ( m_log )
+        return new LogDocument;
+
+    return wxDocTemplate::DoCreateDocument();
+}
+
+wxView *TextDocTemplate::DoCreateView()
+{
+    if ( m_log )
+        return new LogView;
+
+    return wxDocTemplate::DoCreateView();
+}
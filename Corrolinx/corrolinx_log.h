@@ -0,0 +1,158 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_log.h
+// Purpose:     Read-only documents for the text files too big to edit
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_LOG_H_
+#define _CORROLINX_CORROLINX_LOG_H_
+
+#include "wx/docview.h"
+#include "wx/thread.h"
+#include "wx/vector.h"
+
+#include "corrolinx_mmap.h"
+
+// ----------------------------------------------------------------------------
+// LogIndexer: finds the lines of a log in a worker thread
+// ----------------------------------------------------------------------------
+
+// Only the offset of every CHECKPOINT_LINES-th line is stored, which keeps
+// the index small even for huge files, the other lines are found when they're
+// needed by scanning forward from the closest preceding checkpoint.
+//
+// The indexer sends wxEVT_THREAD events to its handler whenever it finds more
+// lines and once more when it terminates. The handler should then call
+// TakeCheckpoints() and, if the indexer is done, Wait() for it and delete it.
+class LogIndexer : public wxThread
+{
+public:
+    enum { CHECKPOINT_LINES = 64 };
+
+    // the data must remain valid until the thread terminates
+    LogIndexer(wxEvtHandler *handler, const char *data, size_t size);
+
+    // append the checkpoints found since the last call to the given vector
+    // and return the number of complete lines found so far
+    size_t TakeCheckpoints(wxVector<size_t>& checkpoints);
+
+    bool IsDone() const;
+
+    // find the lines of the given data in the calling thread, appending the
+    // checkpoints to the vector which must already contain the first one, and
+    // return the number of lines
+    static size_t IndexAll(const char *data,
+                           size_t size,
+                           wxVector<size_t>& checkpoints);
+
+protected:
+    virtual ExitCode Entry();
+
+private:
+    wxEvtHandler * const m_handler;
+    const char * const m_data;
+    const size_t m_size;
+
+    // protects the fields below which are shared with the main thread
+    mutable wxCriticalSection m_cs;
+
+    wxVector<size_t> m_checkpoints;
+    size_t m_lineCount;
+    bool m_done;
+
+    wxDECLARE_NO_COPY_CLASS(LogIndexer);
+};
+
+// ----------------------------------------------------------------------------
+// LogDocument: a read-only memory mapped text file
+// ----------------------------------------------------------------------------
+
+// The file is never loaded into memory, the lines are read directly from its
+// mapping when they're shown, so opening even a huge file is instant, with
+// its lines being indexed in the background and appearing in the views
+// progressively.
+class LogDocument : public wxDocument
+{
+public:
+    LogDocument();
+    virtual ~LogDocument();
+
+    // the number of lines found so far
+    size_t GetLineCount() const { return m_lineCount; }
+
+    // get the given line, which must be less than GetLineCount(), without the
+    // line terminator and truncated to maxLength bytes
+    wxString GetLine(size_t n, size_t maxLength) const;
+
+    // true while the lines are still being indexed
+    bool IsIndexing() const { return m_indexer != NULL; }
+
+    // the document can't be modified
+    virtual bool IsModified() const { return false; }
+
+    virtual bool OnNewDocument();
+    virtual bool OnCloseDocument();
+
+protected:
+    virtual bool DoOpenDocument(const wxString& filename);
+
+    // saving the document just copies the file
+    virtual bool DoSaveDocument(const wxString& filename);
+
+private:
+    // take the checkpoints found by m_indexer and update the views
+    void OnIndexerEvent(wxThreadEvent& event);
+    void TakeCheckpoints();
+
+    // stop m_indexer if it's running and delete it
+    void StopIndexer();
+
+    MappedFile m_file;
+
+    // the offset of every LogIndexer::CHECKPOINT_LINES-th line
+    wxVector<size_t> m_checkpoints;
+    size_t m_lineCount;
+
+    // the background indexer thread, only non-NULL while indexing
+    LogIndexer *m_indexer;
+
+    wxDECLARE_NO_COPY_CLASS(LogDocument);
+    wxDECLARE_DYNAMIC_CLASS(LogDocument);
+};
+
+// ----------------------------------------------------------------------------
+// TextDocTemplate: opens the big text files as logs
+// ----------------------------------------------------------------------------
+
+// wxTextCtrl becomes unusable with files of more than a few megabytes, so the
+// text files bigger than that are opened as read-only LogDocument shown by
+// LogView, while the smaller ones remain editable TextEditDocument objects.
+class TextDocTemplate : public wxDocTemplate
+{
+public:
+    TextDocTemplate(wxDocManager *manager,
+                    const wxString& descr,
+                    const wxString& filter,
+                    const wxString& dir,
+                    const wxString& ext,
+                    const wxString& docTypeName,
+                    const wxString& viewTypeName);
+
+    virtual wxDocument *CreateDocument(const wxString& path, long flags = 0);
+    virtual wxView *CreateView(wxDocument *doc, long flags = 0);
+
+protected:
+    virtual wxDocument *DoCreateDocument();
+    virtual wxView *DoCreateView();
+
+private:
+    // true if the document or view being created is for a log
+    bool m_log;
+
+    wxDECLARE_NO_COPY_CLASS(TextDocTemplate);
+};
+
+#endif // _CORROLINX_CORROLINX_LOG_H_
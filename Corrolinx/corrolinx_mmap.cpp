@@ -0,0 +1,195 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_mmap.cpp
+// Purpose:     Implements read-only memory mapped files
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "wx/file.h"
+
+#if defined(__WINDOWS__)
+    #include "wx/msw/wrapwin.h"
+#elif defined(__UNIX__)
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #define CORROLINX_USE_MMAP
+#endif
+
+#include "corrolinx_mmap.h"
+
+// ----------------------------------------------------------------------------
+// MappedFile implementation
+// ----------------------------------------------------------------------------
+
+MappedFile::MappedFile()
+{
+    m_data = NULL;
+    m_size = 0;
+    m_opened = false;
+    m_ownsBuffer = false;
+#ifdef __WINDOWS__
+    m_mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const wxString& filename)
+{
+    Close();
+
+#if defined(__WINDOWS__)
+    HANDLE file = ::CreateFile(filename.t_str(), GENERIC_READ, FILE_SHARE_READ,
+                               NULL, OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if ( file == INVALID_HANDLE_VALUE )
+    {
+        wxLogSysError("Failed to open file \"%s\"", filename);
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if ( !::GetFileSizeEx(file, &size) )
+    {
+        wxLogSysError("Failed to get the size of file \"%s\"", filename);
+        ::CloseHandle(file);
+        return false;
+    }
+
+    if ( size.QuadPart > 0 )
+    {
+        m_mapping = ::CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if ( m_mapping )
+        {
+            m_data = static_cast<const char *>(
+                        ::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+
+        if ( !m_data )
+        {
+            wxLogSysError("Failed to map file \"%s\" into memory", filename);
+            if ( m_mapping )
+                ::CloseHandle(m_mapping);
+            m_mapping = NULL;
+            ::CloseHandle(file);
+            return false;
+        }
+    }
+
+    // the mapping keeps its own reference to the file
+    ::CloseHandle(file);
+
+    m_size = static_cast<size_t>(size.QuadPart);
+#elif defined(CORROLINX_USE_MMAP)
+    const int fd = ::open(filename.fn_str(), O_RDONLY);
+    if ( fd == -1 )
+    {
+        wxLogSysError("Failed to open file \"%s\"", filename);
+        return false;
+    }
+
+    struct stat st;
+    if ( ::fstat(fd, &st) != 0 )
+    {
+        wxLogSysError("Failed to get the size of file \"%s\"", filename);
+        ::close(fd);
+        return false;
+    }
+
+    if ( st.st_size > 0 )
+    {
+        void * const data = ::mmap(NULL, st.st_size, PROT_READ, MAP_SHARED,
+                                   fd, 0);
+        if ( data == MAP_FAILED )
+        {
+            wxLogSysError("Failed to map file \"%s\" into memory", filename);
+            ::close(fd);
+            return false;
+        }
+
+        // we always read the file front to back
+        ::madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+        m_data = static_cast<const char *>(data);
+    }
+
+    ::close(fd);
+
+    m_size = static_cast<size_t>(st.st_size);
+#else // no memory mapping support, just read the whole file
+    wxFile file;
+    if ( !file.Open(filename) )
+        return false;
+
+    const wxFileOffset size = file.Length();
+    if ( size == wxInvalidOffset )
+        return false;
+
+    if ( size > 0 )
+    {
+        char * const buffer = new char[size];
+        if ( file.Read(buffer, size) != static_cast<ssize_t>(size) )
+        {
+            delete [] buffer;
+            return false;
+        }
+
+        m_data = buffer;
+        m_ownsBuffer = true;
+    }
+
+    m_size = static_cast<size_t>(size);
+#endif
+
+    m_opened = true;
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if ( m_ownsBuffer )
+    {
+        delete [] m_data;
+    }
+    else if ( m_data )
+    {
+#if defined(__WINDOWS__)
+        ::UnmapViewOfFile(m_data);
+#elif defined(CORROLINX_USE_MMAP)
+        ::munmap(const_cast<char *>(m_data), m_size);
+#endif
+    }
+
+#ifdef __WINDOWS__
+    if ( m_mapping )
+    {
+        ::CloseHandle(m_mapping);
+        m_mapping = NULL;
+    }
+#endif
+
+    m_data = NULL;
+    m_size = 0;
+    m_opened = false;
+    m_ownsBuffer = false;
+}
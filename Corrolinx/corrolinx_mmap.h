@@ -0,0 +1,54 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_mmap.h
+// Purpose:     Read-only memory mapped files
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_MMAP_H_
+#define _CORROLINX_CORROLINX_MMAP_H_
+
+#include "wx/string.h"
+
+// ----------------------------------------------------------------------------
+// MappedFile: the whole contents of a file mapped read-only into memory
+// ----------------------------------------------------------------------------
+
+// On platforms without mmap() or CreateFileMapping() the file is simply read
+// into a heap buffer, so callers can always treat GetData() as the complete
+// file contents.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // map the given file, closing any previously mapped one first; logs an
+    // error and returns false if the file couldn't be opened
+    bool Open(const wxString& filename);
+    void Close();
+
+    bool IsOpened() const { return m_opened; }
+
+    // the mapped contents, NULL for an empty file
+    const char *GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    const char *m_data;
+    size_t m_size;
+    bool m_opened;
+
+    // true if m_data was allocated with new[] instead of being mapped
+    bool m_ownsBuffer;
+
+#ifdef __WINDOWS__
+    void *m_mapping;
+#endif
+
+    wxDECLARE_NO_COPY_CLASS(MappedFile);
+};
+
+#endif // _CORROLINX_CORROLINX_MMAP_H_
@@ -0,0 +1,94 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_saver.cpp
+// Purpose:     Implements background saving of drawing documents
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "wx/stopwatch.h"
+
+#include "corrolinx_saver.h"
+
+// ----------------------------------------------------------------------------
+// DrawingSaver implementation
+// ----------------------------------------------------------------------------
+
+DrawingSaver::DrawingSaver(wxEvtHandler *handler,
+                           const DrawingSnapshot& snapshot,
+                           const wxString& filename,
+                           DrawingFileFormat format,
+                           bool autosave)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_handler(handler),
+      m_snapshot(snapshot),
+      m_filename(filename),
+      m_format(format),
+      m_autosave(autosave),
+      m_packed(NULL),
+      m_done(false),
+      m_ok(false),
+      m_saveTime(0)
+{
+}
+
+DrawingSaver::~DrawingSaver()
+{
+    delete m_packed;
+}
+
+void DrawingSaver::AdoptLines(DoodleLines& lines,
+                              DoodleOffsets& offsets,
+                              DoodleSegmentIds& ids)
+{
+    // swapping the vectors doesn't move their contents, so the snapshot
+    // remains valid even if the worker thread is using it right now
+    m_lines.swap(lines);
+    m_offsets.swap(offsets);
+    m_ids.swap(ids);
+}
+
+void DrawingSaver::AdoptPacked(DoodlePackedSegments *packed)
+{
+    wxASSERT_MSG( !m_packed, "the snapshot can only be adopted once" );
+
+    m_packed = packed;
+}
+
+bool DrawingSaver::IsDone() const
+{
+    wxCriticalSectionLocker lock(m_cs);
+
+    return m_done;
+}
+
+wxThread::ExitCode DrawingSaver::Entry()
+{
+    wxStopWatch sw;
+    const bool ok = m_snapshot.Save(m_filename, m_format);
+    const long saveTime = sw.Time();
+
+    {
+        wxCriticalSectionLocker lock(m_cs);
+
+        m_ok = ok;
+        m_saveTime = saveTime;
+        m_done = true;
+    }
+
+    wxQueueEvent(m_handler, new wxThreadEvent(wxEVT_THREAD, EVENT_ID));
+
+    return 0;
+}
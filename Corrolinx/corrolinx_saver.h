@@ -0,0 +1,86 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_saver.h
+// Purpose:     Background saving of drawing documents
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_SAVER_H_
+#define _CORROLINX_CORROLINX_SAVER_H_
+
+#include "wx/thread.h"
+
+#include "corrolinx_doc.h"
+
+// ----------------------------------------------------------------------------
+// DrawingSaver: saves a snapshot of a drawing in a worker thread
+// ----------------------------------------------------------------------------
+
+// The saver sends a wxEVT_THREAD event with EVENT_ID to its handler when it
+// terminates, the handler should then Wait() for it and delete it.
+//
+// The snapshot refers to the segments of the document, which must give them
+// to the saver using one of the Adopt functions before changing them.
+class DrawingSaver : public wxThread
+{
+public:
+    // the id of the events sent by the saver, different from the default id
+    // used by DrawingLoader
+    enum { EVENT_ID = 1 };
+
+    DrawingSaver(wxEvtHandler *handler,
+                 const DrawingSnapshot& snapshot,
+                 const wxString& filename,
+                 DrawingFileFormat format,
+                 bool autosave);
+    virtual ~DrawingSaver();
+
+    const DrawingSnapshot& GetSnapshot() const { return m_snapshot; }
+    const wxString& GetFilename() const { return m_filename; }
+    DrawingFileFormat GetFormat() const { return m_format; }
+    bool IsAutosave() const { return m_autosave; }
+
+    // take ownership of the storage used by the snapshot, the arguments are
+    // left empty
+    void AdoptLines(DoodleLines& lines,
+                    DoodleOffsets& offsets,
+                    DoodleSegmentIds& ids);
+    void AdoptPacked(DoodlePackedSegments *packed);
+
+    bool IsDone() const;
+
+    // these functions can only be used once the saver is done
+    bool Succeeded() const { return m_ok; }
+
+    // the time taken by saving, in milliseconds
+    long GetSaveTime() const { return m_saveTime; }
+
+protected:
+    virtual ExitCode Entry();
+
+private:
+    wxEvtHandler * const m_handler;
+    const DrawingSnapshot m_snapshot;
+    const wxString m_filename;
+    const DrawingFileFormat m_format;
+    const bool m_autosave;
+
+    // the storage of the snapshot, once the document doesn't use it any more
+    DoodleLines m_lines;
+    DoodleOffsets m_offsets;
+    DoodleSegmentIds m_ids;
+    DoodlePackedSegments *m_packed;
+
+    // protects the fields below which are shared with the main thread
+    mutable wxCriticalSection m_cs;
+
+    bool m_done;
+    bool m_ok;
+    long m_saveTime;
+
+    wxDECLARE_NO_COPY_CLASS(DrawingSaver);
+};
+
+#endif // _CORROLINX_CORROLINX_SAVER_H_
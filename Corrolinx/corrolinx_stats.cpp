@@ -0,0 +1,445 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_stats.cpp
+// Purpose:     Implements statistics of the survey readings
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "corrolinx_stats.h"
+#include "corrolinx_grid.h"
+
+#ifdef CORROLINX_USE_SSE2
+    #include <emmintrin.h>
+#endif
+
+#include <float.h>
+#include <math.h>
+
+namespace
+{
+
+const float HISTOGRAM_SCALE = 1.0f/SurveyStatistics::HISTOGRAM_STEP;
+
+// return the histogram bin of a non-missing reading, this must be computed in
+// exactly the same way as in the SSE2 version to give the same results
+inline int GetHistogramBin(float value)
+{
+    float pos = (value - SurveyStatistics::HISTOGRAM_MIN)*HISTOGRAM_SCALE;
+    if ( pos < 0 )
+        pos = 0;
+    if ( pos > SurveyStatistics::HISTOGRAM_BINS - 1 )
+        pos = SurveyStatistics::HISTOGRAM_BINS - 1;
+
+    return static_cast<int>(pos);
+}
+
+inline SurveyRiskBand GetRiskBand(float value)
+{
+    if ( value > ASTM_C876_LOW_RISK )
+        return RiskBand_Low;
+    if ( value < ASTM_C876_HIGH_RISK )
+        return RiskBand_High;
+
+    return RiskBand_Uncertain;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// SurveyStatistics implementation
+// ----------------------------------------------------------------------------
+
+void SurveyStatistics::Clear()
+{
+    m_count = 0;
+    m_mean = 0;
+    m_sumSquares = 0;
+
+    m_min = FLT_MAX;
+    m_max = -FLT_MAX;
+
+    for ( int n = 0; n < RiskBand_Max; n++ )
+        m_bands[n] = 0;
+
+    for ( int n = 0; n <= HISTOGRAM_BINS; n++ )
+        m_histogram[n] = 0;
+}
+
+/* static */
+bool SurveyStatistics::HasSIMD()
+{
+#ifdef CORROLINX_USE_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SurveyStatistics::Add(const float *values, size_t count)
+{
+    for ( size_t n = 0; n < count; n += BLOCK_SIZE )
+        AddBlock(values + n, wxMin(count - n, size_t(BLOCK_SIZE)), true);
+}
+
+void SurveyStatistics::AddPortable(const float *values, size_t count)
+{
+    for ( size_t n = 0; n < count; n += BLOCK_SIZE )
+        AddBlock(values + n, wxMin(count - n, size_t(BLOCK_SIZE)), false);
+}
+
+void SurveyStatistics::Compute(const SurveyGrid& grid)
+{
+    Clear();
+
+    for ( size_t y = 0; y < grid.GetHeight(); y++ )
+        Add(grid.GetRow(y), grid.GetWidth());
+}
+
+void SurveyStatistics::AddBlock(const float *values,
+                                size_t count,
+                                bool useSIMD)
+{
+    Block block;
+    block.count = 0;
+    block.sum = 0;
+    block.min = FLT_MAX;
+    block.max = -FLT_MAX;
+    block.lowRisk = 0;
+    block.highRisk = 0;
+
+    size_t done = 0;
+#ifdef CORROLINX_USE_SSE2
+    if ( useSIMD )
+        done = ScanBlockSSE2(values, count, block);
+#else
+    wxUnusedVar(useSIMD);
+#endif // CORROLINX_USE_SSE2
+
+    ScanBlockPortable(values + done, count - done, block);
+
+    // the deviations are computed from the mean of the block rather than
+    // accumulating the sum of squares directly to avoid the catastrophic
+    // cancellation when subtracting the squared mean from it at the end
+    const double mean = block.count ? block.sum/block.count : 0;
+
+    double sumSquares = 0;
+    done = 0;
+#ifdef CORROLINX_USE_SSE2
+    if ( useSIMD )
+        done = BinBlockSSE2(values, count, mean, sumSquares);
+#endif // CORROLINX_USE_SSE2
+
+    sumSquares += BinBlockPortable(values + done, count - done, mean);
+
+    if ( !block.count )
+        return;
+
+    // combine the statistics of the block with those of all the previous
+    // readings, see Chan, Golub and LeVeque, "Algorithms for computing the
+    // sample variance", 1983
+    const double countPrev = m_count,
+                 countBlock = block.count,
+                 countTotal = countPrev + countBlock;
+    const double delta = mean - m_mean;
+
+    m_mean += delta*countBlock/countTotal;
+    m_sumSquares += sumSquares + delta*delta*countPrev*countBlock/countTotal;
+    m_count += block.count;
+
+    m_min = wxMin(m_min, block.min);
+    m_max = wxMax(m_max, block.max);
+
+    m_bands[RiskBand_Low] += block.lowRisk;
+    m_bands[RiskBand_High] += block.highRisk;
+    m_bands[RiskBand_Uncertain] += block.count - block.lowRisk -
+                                        block.highRisk;
+}
+
+/* static */
+void SurveyStatistics::ScanBlockPortable(const float *values,
+                                         size_t count,
+                                         Block& block)
+{
+    for ( size_t n = 0; n < count; n++ )
+    {
+        const float value = values[n];
+        if ( SurveyGrid::IsMissing(value) )
+            continue;
+
+        block.count++;
+        block.sum += value;
+
+        if ( value < block.min )
+            block.min = value;
+        if ( value > block.max )
+            block.max = value;
+
+        if ( value > ASTM_C876_LOW_RISK )
+            block.lowRisk++;
+        else if ( value < ASTM_C876_HIGH_RISK )
+            block.highRisk++;
+    }
+}
+
+double SurveyStatistics::BinBlockPortable(const float *values,
+                                          size_t count,
+                                          double mean)
+{
+    double sumSquares = 0;
+    for ( size_t n = 0; n < count; n++ )
+    {
+        const float value = values[n];
+        if ( SurveyGrid::IsMissing(value) )
+        {
+            m_histogram[HISTOGRAM_BINS]++;
+            continue;
+        }
+
+        const double deviation = value - mean;
+        sumSquares += deviation*deviation;
+
+        m_histogram[GetHistogramBin(value)]++;
+    }
+
+    return sumSquares;
+}
+
+#ifdef CORROLINX_USE_SSE2
+
+namespace
+{
+
+// return the elements of a where mask is set and those of b elsewhere
+inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// return the sum of all elements
+inline double HorizontalSum(__m128d v)
+{
+    double parts[2];
+    _mm_storeu_pd(parts, v);
+    return parts[0] + parts[1];
+}
+
+inline wxInt32 HorizontalSum(__m128i v)
+{
+    wxInt32 parts[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(parts), v);
+    return parts[0] + parts[1] + parts[2] + parts[3];
+}
+
+// add the 4 floats to the 2 pairs of doubles
+inline void AccumulateDoubles(__m128 v, __m128d& low, __m128d& high)
+{
+    low = _mm_add_pd(low, _mm_cvtps_pd(v));
+    high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+}
+
+} // anonymous namespace
+
+/* static */
+size_t SurveyStatistics::ScanBlockSSE2(const float *values,
+                                       size_t count,
+                                       Block& block)
+{
+    const __m128 lowRisk = _mm_set1_ps(ASTM_C876_LOW_RISK),
+                 highRisk = _mm_set1_ps(ASTM_C876_HIGH_RISK),
+                 largest = _mm_set1_ps(FLT_MAX),
+                 smallest = _mm_set1_ps(-FLT_MAX);
+
+    __m128d sumLow = _mm_setzero_pd(),
+            sumHigh = _mm_setzero_pd();
+    __m128 min = largest,
+           max = smallest;
+
+    // the comparison masks are -1 where true, so subtracting them counts the
+    // readings, there are too few of them in a block to overflow
+    __m128i valid = _mm_setzero_si128(),
+            low = _mm_setzero_si128(),
+            high = _mm_setzero_si128();
+
+    size_t n = 0;
+    for ( ; n + 4 <= count; n += 4 )
+    {
+        const __m128 v = _mm_loadu_ps(values + n);
+
+        // all comparisons with NaN are false except for the unordered one
+        const __m128 ordered = _mm_cmpord_ps(v, v);
+
+        AccumulateDoubles(_mm_and_ps(ordered, v), sumLow, sumHigh);
+
+        min = _mm_min_ps(min, Select(ordered, v, largest));
+        max = _mm_max_ps(max, Select(ordered, v, smallest));
+
+        valid = _mm_sub_epi32(valid, _mm_castps_si128(ordered));
+        low = _mm_sub_epi32(low,
+                            _mm_castps_si128(_mm_cmpgt_ps(v, lowRisk)));
+        high = _mm_sub_epi32(high,
+                             _mm_castps_si128(_mm_cmplt_ps(v, highRisk)));
+    }
+
+    block.count += HorizontalSum(valid);
+    block.sum += HorizontalSum(_mm_add_pd(sumLow, sumHigh));
+    block.lowRisk += HorizontalSum(low);
+    block.highRisk += HorizontalSum(high);
+
+    float mins[4], maxs[4];
+    _mm_storeu_ps(mins, min);
+    _mm_storeu_ps(maxs, max);
+    for ( int i = 0; i < 4; i++ )
+    {
+        block.min = wxMin(block.min, mins[i]);
+        block.max = wxMax(block.max, maxs[i]);
+    }
+
+    return n;
+}
+
+size_t SurveyStatistics::BinBlockSSE2(const float *values,
+                                      size_t count,
+                                      double mean,
+                                      double& sumSquares)
+{
+    const __m128 meanValue = _mm_set1_ps(static_cast<float>(mean)),
+                 histogramMin = _mm_set1_ps(HISTOGRAM_MIN),
+                 scale = _mm_set1_ps(HISTOGRAM_SCALE),
+                 zero = _mm_setzero_ps(),
+                 last = _mm_set1_ps(HISTOGRAM_BINS - 1);
+    const __m128i missingBin = _mm_set1_epi32(HISTOGRAM_BINS);
+
+    __m128d sumLow = _mm_setzero_pd(),
+            sumHigh = _mm_setzero_pd();
+
+    size_t n = 0;
+    for ( ; n + 4 <= count; n += 4 )
+    {
+        const __m128 v = _mm_loadu_ps(values + n);
+        const __m128 ordered = _mm_cmpord_ps(v, v);
+
+        const __m128 deviation = _mm_sub_ps(v, meanValue);
+        AccumulateDoubles(_mm_and_ps(ordered,
+                                     _mm_mul_ps(deviation, deviation)),
+                          sumLow, sumHigh);
+
+        // _mm_max_ps() returns its second operand if the first one is NaN,
+        // so the missing values become 0 here and are replaced below
+        __m128 pos = _mm_mul_ps(_mm_sub_ps(v, histogramMin), scale);
+        pos = _mm_min_ps(_mm_max_ps(pos, zero), last);
+
+        const __m128i missing = _mm_castps_si128(_mm_cmpunord_ps(v, v));
+        const __m128i bin = _mm_or_si128(
+                                _mm_and_si128(missing, missingBin),
+                                _mm_andnot_si128(missing,
+                                                 _mm_cvttps_epi32(pos)));
+
+        // there is no scatter instruction in SSE2, so increment the bins one
+        // by one, the missing readings are counted in the extra last one
+        wxInt32 bins[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bins), bin);
+
+        m_histogram[bins[0]]++;
+        m_histogram[bins[1]]++;
+        m_histogram[bins[2]]++;
+        m_histogram[bins[3]]++;
+    }
+
+    sumSquares += HorizontalSum(_mm_add_pd(sumLow, sumHigh));
+
+    return n;
+}
+
+#endif // CORROLINX_USE_SSE2
+
+void SurveyStatistics::AddOne(float value)
+{
+    if ( SurveyGrid::IsMissing(value) )
+    {
+        m_histogram[HISTOGRAM_BINS]++;
+        return;
+    }
+
+    // Welford's update
+    m_count++;
+    const double delta = value - m_mean;
+    m_mean += delta/m_count;
+    m_sumSquares += delta*(value - m_mean);
+
+    m_min = wxMin(m_min, value);
+    m_max = wxMax(m_max, value);
+
+    m_bands[GetRiskBand(value)]++;
+    m_histogram[GetHistogramBin(value)]++;
+}
+
+bool SurveyStatistics::Replace(float oldValue, float newValue)
+{
+    if ( SurveyGrid::IsMissing(oldValue) )
+    {
+        m_histogram[HISTOGRAM_BINS]--;
+        AddOne(newValue);
+        return true;
+    }
+
+    // the new extreme value is unknown if the old one is removed, unless the
+    // new value replaces it
+    if ( (oldValue == m_min && !(newValue <= oldValue)) ||
+            (oldValue == m_max && !(newValue >= oldValue)) )
+        return false;
+
+    m_bands[GetRiskBand(oldValue)]--;
+    m_histogram[GetHistogramBin(oldValue)]--;
+
+    // Welford's update in reverse
+    if ( --m_count )
+    {
+        const double delta = oldValue - m_mean;
+        m_mean -= delta/m_count;
+        m_sumSquares = wxMax(0., m_sumSquares - delta*(oldValue - m_mean));
+    }
+    else
+    {
+        m_mean = 0;
+        m_sumSquares = 0;
+    }
+
+    AddOne(newValue);
+
+    return true;
+}
+
+double SurveyStatistics::GetStdDev() const
+{
+    return m_count ? sqrt(m_sumSquares/m_count) : 0;
+}
+
+double SurveyStatistics::GetCumulativePercentage(int bin) const
+{
+    if ( !m_count )
+        return 0;
+
+    size_t count = 0;
+    for ( int n = 0; n <= bin; n++ )
+        count += m_histogram[n];
+
+    return 100.*count/m_count;
+}
+
+double SurveyStatistics::GetBandPercentage(SurveyRiskBand band) const
+{
+    return m_count ? 100.*m_bands[band]/m_count : 0;
+}
@@ -0,0 +1,154 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_stats.h
+// Purpose:     Statistics of the survey readings
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_STATS_H_
+#define _CORROLINX_CORROLINX_STATS_H_
+
+#include "wx/defs.h"
+
+#include "corrolinx_colormap.h"       // for CORROLINX_USE_SSE2
+
+class SurveyGrid;
+
+// The ASTM C876 corrosion probability bands of the readings
+enum SurveyRiskBand
+{
+    RiskBand_Low,           // above ASTM_C876_LOW_RISK
+    RiskBand_Uncertain,
+    RiskBand_High,          // below ASTM_C876_HIGH_RISK
+    RiskBand_Max
+};
+
+// ----------------------------------------------------------------------------
+// SurveyStatistics: summary of a set of readings
+// ----------------------------------------------------------------------------
+
+// The statistics are accumulated in a single pass over the readings, which
+// may be added in any number of pieces, e.g. one row at a time while loading
+// the survey, and use a fixed amount of memory whatever their number. The
+// missing readings are counted but otherwise ignored.
+//
+// The readings are processed using SSE2 when it's available, the results of
+// the portable version are the same up to the floating point rounding.
+class SurveyStatistics
+{
+public:
+    // the histogram has bins of HISTOGRAM_STEP mV starting at HISTOGRAM_MIN,
+    // with the readings outside of its range counted in the first or last one
+    enum
+    {
+        HISTOGRAM_MIN = -800,
+        HISTOGRAM_STEP = 10,
+        HISTOGRAM_BINS = 100
+    };
+
+    SurveyStatistics() { Clear(); }
+
+    // forget all readings
+    void Clear();
+
+    // add count readings
+    void Add(const float *values, size_t count);
+
+    // the same as Add() but never uses SIMD instructions, this is only useful
+    // for comparing the performance of both versions
+    void AddPortable(const float *values, size_t count);
+
+    // recompute the statistics of all readings of the grid
+    void Compute(const SurveyGrid& grid);
+
+    // update the statistics after changing a single reading
+    //
+    // the minimum and maximum can't be updated if the old value was one of
+    // them, in which case false is returned and Compute() must be called
+    bool Replace(float oldValue, float newValue);
+
+    // the number of non-missing and missing readings
+    size_t GetCount() const { return m_count; }
+    size_t GetMissingCount() const { return m_histogram[HISTOGRAM_BINS]; }
+
+    // these functions can only be used if there are some readings
+    float GetMin() const { return m_min; }
+    float GetMax() const { return m_max; }
+    double GetMean() const { return m_mean; }
+
+    // the population standard deviation
+    double GetStdDev() const;
+
+    // the number of readings in the given bin of the histogram
+    size_t GetHistogramCount(int bin) const { return m_histogram[bin]; }
+
+    // the percentage of readings in the given bin or all the previous ones,
+    // i.e. the cumulative frequency distribution
+    double GetCumulativePercentage(int bin) const;
+
+    // the percentage of readings in the given band
+    double GetBandPercentage(SurveyRiskBand band) const;
+
+    // return true if Add() uses SIMD instructions
+    static bool HasSIMD();
+
+private:
+    // the statistics of a block of readings
+    struct Block
+    {
+        size_t count;
+        double sum;
+        float min;
+        float max;
+        size_t lowRisk;
+        size_t highRisk;
+    };
+
+    // the readings are processed in blocks small enough to stay in the cache
+    // between the two passes over them, see AddBlock()
+    enum { BLOCK_SIZE = 1024 };
+
+    void AddBlock(const float *values, size_t count, bool useSIMD);
+
+    // the first pass computes everything except the sum of squared deviations
+    // from the mean of the block and the histogram, which are done by the
+    // second pass, which returns that sum
+    static void ScanBlockPortable(const float *values,
+                                  size_t count,
+                                  Block& block);
+    double BinBlockPortable(const float *values, size_t count, double mean);
+
+#ifdef CORROLINX_USE_SSE2
+    // these functions only process a multiple of 4 readings and return the
+    // number of them which were processed
+    static size_t ScanBlockSSE2(const float *values,
+                                size_t count,
+                                Block& block);
+    size_t BinBlockSSE2(const float *values,
+                        size_t count,
+                        double mean,
+                        double& sumSquares);
+#endif // CORROLINX_USE_SSE2
+
+    // add a single reading
+    void AddOne(float value);
+
+    // the number of the non-missing readings, their mean and the sum of their
+    // squared deviations from it
+    size_t m_count;
+    double m_mean;
+    double m_sumSquares;
+
+    float m_min;
+    float m_max;
+
+    // the number of readings in each band
+    size_t m_bands[RiskBand_Max];
+
+    // the last element counts the missing readings
+    size_t m_histogram[HISTOGRAM_BINS + 1];
+};
+
+#endif // _CORROLINX_CORROLINX_STATS_H_
@@ -0,0 +1,170 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_undo.cpp
+// Purpose:     Implements undo history of drawing documents
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "corrolinx_undo.h"
+#include "corrolinx_doc.h"
+
+// ----------------------------------------------------------------------------
+// DrawingCommandProcessor implementation
+// ----------------------------------------------------------------------------
+
+DrawingCommandProcessor::DrawingCommandProcessor()
+    : wxCommandProcessor(),
+      m_memoryBudget(DEFAULT_MEMORY_BUDGET),
+      m_memoryUsage(0),
+      m_coalesceInterval(DEFAULT_COALESCE_INTERVAL),
+      m_canMerge(false)
+{
+}
+
+void DrawingCommandProcessor::SetMemoryBudget(size_t budget)
+{
+    m_memoryBudget = budget;
+
+    Trim();
+}
+
+/* static */
+size_t DrawingCommandProcessor::GetCommandMemory(wxCommand *command)
+{
+    if ( !command )
+        return 0;
+
+    DrawingCommand * const drawing = wxDynamicCast(command, DrawingCommand);
+
+    return drawing ? drawing->GetMemoryUsage() : sizeof(wxCommand);
+}
+
+void DrawingCommandProcessor::Store(wxCommand *command)
+{
+    // the commands which could be redone are deleted by the base class
+    wxList::compatibility_iterator node = m_currentCommand
+                                            ? m_currentCommand->GetNext()
+                                            : m_commands.GetFirst();
+    for ( ; node; node = node->GetNext() )
+        m_memoryUsage -= GetCommandMemory((wxCommand *)node->GetData());
+
+    const bool merge = m_canMerge && MergeWithCurrent(command);
+    m_sinceLastStore.Start();
+    m_canMerge = true;
+
+    if ( merge )
+    {
+        delete command;
+    }
+    else
+    {
+        wxCommandProcessor::Store(command);
+        m_memoryUsage += GetCommandMemory(command);
+    }
+
+    Trim();
+}
+
+bool DrawingCommandProcessor::MergeWithCurrent(wxCommand *command)
+{
+    if ( !m_coalesceInterval || m_sinceLastStore.Time() > m_coalesceInterval )
+        return false;
+
+    // only merge with the last command, and not with the one corresponding to
+    // the saved state of the document as it would then appear unmodified
+    if ( !m_currentCommand ||
+            m_currentCommand->GetNext() ||
+                m_currentCommand == m_lastSavedCommand )
+        return false;
+
+    DrawingCommand * const
+        current = wxDynamicCast(m_currentCommand->GetData(), DrawingCommand);
+    DrawingCommand * const next = wxDynamicCast(command, DrawingCommand);
+    if ( !current || !next )
+        return false;
+
+    const size_t memory = current->GetMemoryUsage();
+    if ( !current->Merge(*next) )
+        return false;
+
+    m_memoryUsage = m_memoryUsage - memory + current->GetMemoryUsage();
+
+    return true;
+}
+
+bool DrawingCommandProcessor::Undo()
+{
+    wxCommand * const command = GetCurrentCommand();
+    const size_t memory = GetCommandMemory(command);
+
+    if ( !wxCommandProcessor::Undo() )
+        return false;
+
+    m_canMerge = false;
+
+    // undoing the commands adding segments makes them store the segments
+    m_memoryUsage = m_memoryUsage - memory + GetCommandMemory(command);
+
+    return true;
+}
+
+bool DrawingCommandProcessor::Redo()
+{
+    wxList::compatibility_iterator node = m_currentCommand
+                                            ? m_currentCommand->GetNext()
+                                            : m_commands.GetFirst();
+    wxCommand * const command = node ? (wxCommand *)node->GetData() : NULL;
+    const size_t memory = GetCommandMemory(command);
+
+    if ( !wxCommandProcessor::Redo() )
+        return false;
+
+    m_canMerge = false;
+
+    m_memoryUsage = m_memoryUsage - memory + GetCommandMemory(command);
+
+    return true;
+}
+
+void DrawingCommandProcessor::ClearCommands()
+{
+    wxCommandProcessor::ClearCommands();
+
+    m_memoryUsage = 0;
+    m_canMerge = false;
+}
+
+void DrawingCommandProcessor::Trim()
+{
+    // the commands after the current one are needed to redo them, so only
+    // the ones before it can be forgotten, and it's always kept to allow
+    // undoing at least the last change
+    while ( m_memoryUsage > m_memoryBudget && m_currentCommand )
+    {
+        wxList::compatibility_iterator first = m_commands.GetFirst();
+        if ( first == m_currentCommand )
+            break;
+
+        wxCommand * const command = (wxCommand *)first->GetData();
+        m_memoryUsage -= GetCommandMemory(command);
+
+        if ( m_lastSavedCommand == first )
+            m_lastSavedCommand = wxList::compatibility_iterator();
+
+        delete command;
+        m_commands.Erase(first);
+    }
+}
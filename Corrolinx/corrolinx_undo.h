@@ -0,0 +1,78 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_undo.h
+// Purpose:     Undo history of drawing documents with limited memory use
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_UNDO_H_
+#define _CORROLINX_CORROLINX_UNDO_H_
+
+#include "wx/cmdproc.h"
+#include "wx/stopwatch.h"
+
+// ----------------------------------------------------------------------------
+// DrawingCommandProcessor: command processor for DrawingDocument
+// ----------------------------------------------------------------------------
+
+// The standard wxCommandProcessor keeps all commands forever, which makes the
+// memory used by a long editing session grow without limit. This one forgets
+// the oldest commands, which can't be undone any more, when the memory used
+// by all of them exceeds the budget, and merges the consecutive DrawingCommand
+// objects of the same kind stored in quick succession into a single one,
+// which is undone as a whole.
+class DrawingCommandProcessor : public wxCommandProcessor
+{
+public:
+    enum
+    {
+        DEFAULT_MEMORY_BUDGET = 32*1024*1024,
+        DEFAULT_COALESCE_INTERVAL = 500
+    };
+
+    DrawingCommandProcessor();
+
+    // the maximal amount of memory used by the commands, the last one is kept
+    // even if it uses more than that on its own
+    size_t GetMemoryBudget() const { return m_memoryBudget; }
+    void SetMemoryBudget(size_t budget);
+
+    // the approximate amount of memory used by all commands
+    size_t GetMemoryUsage() const { return m_memoryUsage; }
+
+    // the commands stored less than this number of milliseconds after the
+    // previous one are merged with it, 0 disables merging
+    long GetCoalesceInterval() const { return m_coalesceInterval; }
+    void SetCoalesceInterval(long ms) { m_coalesceInterval = ms; }
+
+    virtual void Store(wxCommand *command);
+    virtual bool Undo();
+    virtual bool Redo();
+    virtual void ClearCommands();
+
+private:
+    // the memory used by any command, including the non-drawing ones
+    static size_t GetCommandMemory(wxCommand *command);
+
+    // try to merge the command with the current one, return true if done
+    bool MergeWithCurrent(wxCommand *command);
+
+    // forget the oldest commands until the memory use is within the budget
+    void Trim();
+
+    size_t m_memoryBudget;
+    size_t m_memoryUsage;
+
+    long m_coalesceInterval;
+
+    // the time since the last command was stored and whether the next one
+    // can be merged with it, which is not the case after undoing or redoing
+    wxStopWatch m_sinceLastStore;
+    bool m_canMerge;
+
+    wxDECLARE_NO_COPY_CLASS(DrawingCommandProcessor);
+};
+
+#endif // _CORROLINX_CORROLINX_UNDO_H_
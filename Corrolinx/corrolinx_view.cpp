@@ -19,22 +19,58 @@
     #include "wx/wx.h"
 #endif
 
+#include "wx/stopwatch.h"
+#include "wx/config.h"
+#include "wx/math.h"
+#include "wx/dcbuffer.h"
+#include "wx/filename.h"
+
 #if !wxUSE_DOC_VIEW_ARCHITECTURE
     #error You must set wxUSE_DOC_VIEW_ARCHITECTURE to 1 in setup.h!
 #endif
 
 #include "corrolinx.h"
+#include "corrolinx_compare.h"
 #include "corrolinx_doc.h"
 #include "corrolinx_view.h"
+#include "corrolinx_export.h"
+#include "corrolinx_detail.h"
+#include "corrolinx_log.h"
+#include "corrolinx_workers.h"
 
 // ----------------------------------------------------------------------------
 // DrawingView implementation
 // ----------------------------------------------------------------------------
 
+namespace
+{
+
+// the drawings with at least this many lines, using 16MB for them and more
+// for their index, are compacted while they're not used
+const long COMPACT_INACTIVE_LINES = 1024*1024;
+
+// the time after which a drawing whose view was deactivated without
+// activating another document, e.g. to show a dialog or switch to another
+// application, is compacted if the view isn't activated again, in seconds
+const int COMPACT_INACTIVE_DELAY = 60;
+
+} // anonymous namespace
+
 IMPLEMENT_DYNAMIC_CLASS(DrawingView, wxView)
 
 wxBEGIN_EVENT_TABLE(DrawingView, wxView)
     EVT_MENU(wxID_CUT, DrawingView::OnCut)
+    EVT_MENU(wxID_DELETE, DrawingView::OnDelete)
+    EVT_MENU(ID_DRAWING_CONVERT, DrawingView::OnConvert)
+    EVT_MENU(ID_DRAWING_CANCEL_LOAD, DrawingView::OnCancelLoad)
+    EVT_UPDATE_UI(wxID_CUT, DrawingView::OnUpdateNotLoading)
+    EVT_UPDATE_UI(wxID_DELETE, DrawingView::OnUpdateDelete)
+    EVT_UPDATE_UI(ID_DRAWING_CONVERT, DrawingView::OnUpdateNotLoading)
+    EVT_UPDATE_UI(ID_DRAWING_CANCEL_LOAD, DrawingView::OnUpdateCancelLoad)
+    EVT_MENU(wxID_ZOOM_IN, DrawingView::OnZoomIn)
+    EVT_MENU(wxID_ZOOM_OUT, DrawingView::OnZoomOut)
+    EVT_MENU(wxID_ZOOM_100, DrawingView::OnZoomNormal)
+    EVT_MENU(wxID_ZOOM_FIT, DrawingView::OnZoomFit)
 wxEND_EVENT_TABLE()
 
 // What to do when a view is created. Creates actual
@@ -45,11 +81,15 @@ bool DrawingView::OnCreate(wxDocument *doc, long flags)
         return false;
 
     MyApp& app = wxGetApp();
-    wxFrame* frame = app.CreateChildFrame(this, true);
+    wxFrame* frame = app.CreateChildFrame(this, MyApp::ChildFrame_Drawing);
     wxASSERT(frame == GetFrame());
     m_canvas = new MyCanvas(this);
     frame->Show();
 
+    m_compactTimer.SetOwner(this);
+    Bind(wxEVT_TIMER, &DrawingView::OnCompactTimer, this,
+         m_compactTimer.GetId());
+
     return true;
 }
 
@@ -59,22 +99,170 @@ void DrawingView::OnDraw(wxDC *dc)
 {
     dc->SetPen(*wxBLACK_PEN);
 
-    // simply draw all lines of all segments
-    const DoodleSegments& segments = GetDocument()->GetSegments();
-    for ( DoodleSegments::const_iterator i = segments.begin();
-          i != segments.end();
-          ++i )
+    DrawingDocument * const doc = GetDocument();
+
+    // the compacted documents have neither the index nor the simplified
+    // segments, but can still be drawn directly from the packed segments
+    const DoodlePackedSegments * const packed = doc->GetCompactSegments();
+    if ( packed )
+    {
+        DrawPacked(dc, *packed);
+        return;
+    }
+
+    // when repainting only a part of the window, use the spatial index to
+    // find the lines which need to be redrawn, otherwise draw all of them
+    const DoodleLineIndices *indices = NULL;
+
+    wxRect clip;
+    dc->GetClippingBox(&clip.x, &clip.y, &clip.width, &clip.height);
+    if ( !clip.IsEmpty() && !clip.Contains(doc->GetBounds()) )
+    {
+        doc->GetLinesInRect(clip, m_visibleLines);
+        indices = &m_visibleLines;
+    }
+    else if ( doc->HasDeletedSegments() )
+    {
+        // the lines of the deleted segments are not in the index, but are
+        // still in the document until they're purged
+        const DoodleSegments segments = doc->GetSegments();
+
+        m_visibleLines.clear();
+        for ( size_t n = 0; n < segments.size(); n++ )
+        {
+            if ( doc->IsSegmentDeleted(n) )
+                continue;
+
+            for ( size_t line = segments.GetFirstLine(n);
+                  line < segments.GetFirstLine(n + 1);
+                  line++ )
+            {
+                m_visibleLines.push_back(line);
+            }
+        }
+
+        indices = &m_visibleLines;
+    }
+
+    // when the drawing is scaled down, e.g. in print preview, many lines are
+    // too small to be seen and it's faster to draw the simplified segments
+    double scaleX, scaleY;
+    dc->GetUserScale(&scaleX, &scaleY);
+
+    const int
+        level = DoodleDetailCache::GetLevelForScale(wxMax(scaleX, scaleY));
+    if ( level == -1 )
+        DrawPolylines(dc, doc->GetLines(), indices);
+    else
+        DrawSimplified(dc, level, indices);
+}
+
+void DrawingView::DrawSimplified(wxDC *dc,
+                                 int level,
+                                 const DoodleLineIndices *indices)
+{
+    DrawingDocument * const doc = GetDocument();
+    const DoodleSegments segments = doc->GetSegments();
+
+    size_t n = 0;
+    size_t k = 0;
+    while ( n < segments.size() )
+    {
+        if ( indices )
+        {
+            // skip directly to the segment containing the next visible line
+            if ( k == indices->size() )
+                break;
+
+            const size_t line = (*indices)[k];
+            if ( line >= segments.GetFirstLine(n + 1) )
+                n = doc->GetSegmentOfLine(line);
+
+            // and skip all the other visible lines of this segment
+            while ( k < indices->size() &&
+                        (*indices)[k] < segments.GetFirstLine(n + 1) )
+                k++;
+        }
+
+        const DoodleSimplified&
+            simplified = doc->GetSimplifiedSegment(n, level);
+
+        wxUint32 start = 0;
+        for ( wxVector<wxUint32>::const_iterator end = simplified.ends.begin();
+              end != simplified.ends.end();
+              start = *end++ )
+        {
+            if ( *end - start > 1 )
+                dc->DrawLines(*end - start, &simplified.points[start]);
+        }
+
+        n++;
+    }
+}
+
+void DrawingView::DrawPolylines(wxDC *dc,
+                                const DoodleLines& lines,
+                                const DoodleLineIndices *indices)
+{
+    // don't pass too many points to the DC at once, some platforms don't
+    // like this
+    static const size_t MAX_POLYLINE_POINTS = 8192;
+
+    const size_t count = indices ? indices->size() : lines.size();
+
+    m_points.clear();
+
+    size_t prev = 0;
+    for ( size_t k = 0; k < count; k++ )
     {
-        const DoodleLines& lines = i->GetLines();
-        for ( DoodleLines::const_iterator j = lines.begin();
-              j != lines.end();
-              ++j )
+        const size_t n = indices ? (*indices)[k] : k;
+        const DoodleLine& line = lines[n];
+
+        // strokes are built from successive mouse positions, so each line
+        // usually starts where the previous one ended and can be appended to
+        // the current polyline
+        const bool connected = !m_points.empty() &&
+                                    n == prev + 1 &&
+                                    line.x1 == lines[prev].x2 &&
+                                    line.y1 == lines[prev].y2;
+
+        if ( !connected || m_points.size() == MAX_POLYLINE_POINTS )
         {
-            const DoodleLine& line = *j;
+            if ( m_points.size() > 1 )
+                dc->DrawLines(m_points.size(), &m_points[0]);
+
+            m_points.clear();
+            m_points.push_back(wxPoint(line.x1, line.y1));
+        }
+
+        m_points.push_back(wxPoint(line.x2, line.y2));
+        prev = n;
+    }
+
+    if ( m_points.size() > 1 )
+        dc->DrawLines(m_points.size(), &m_points[0]);
+}
+
+void DrawingView::DrawPacked(wxDC *dc, const DoodlePackedSegments& segments)
+{
+    // decode the segments in batches small enough to stay in the cache,
+    // drawing each batch as soon as it's decoded
+    static const size_t BATCH_LINES = 4096;
+
+    DoodleLines lines;
+    lines.reserve(BATCH_LINES);
 
-            dc->DrawLine(line.x1, line.y1, line.x2, line.y2);
+    DoodlePackedReader reader(segments);
+    while ( reader.ReadSegment(lines) )
+    {
+        if ( lines.size() >= BATCH_LINES )
+        {
+            DrawPolylines(dc, lines, NULL);
+            lines.clear();
         }
     }
+
+    DrawPolylines(dc, lines, NULL);
 }
 
 DrawingDocument* DrawingView::GetDocument()
@@ -85,8 +273,73 @@ DrawingDocument* DrawingView::GetDocument()
 void DrawingView::OnUpdate(wxView* sender, wxObject* hint)
 {
     wxView::OnUpdate(sender, hint);
-    if ( m_canvas )
-        m_canvas->Refresh();
+    if ( !m_canvas )
+        return;
+
+    m_canvas->UpdateVirtualSize();
+
+    // only repaint the changed area if we know it
+    const DrawingUpdateHint * const
+        update = wxDynamicCast(hint, DrawingUpdateHint);
+    if ( update )
+        m_canvas->RefreshLogicalRect(update->GetRect());
+    else
+        m_canvas->RefreshDrawing();
+}
+
+void DrawingView::OnActivateView(bool activate,
+                                 wxView *activeView,
+                                 wxView *deactiveView)
+{
+    wxView::OnActivateView(activate, activeView, deactiveView);
+
+    DrawingDocument * const doc = GetDocument();
+    if ( activate )
+    {
+        m_compactTimer.Stop();
+        doc->Expand();
+        return;
+    }
+
+    // there is no point in compacting the document which is being closed
+    if ( m_closing )
+        return;
+
+    // the view is also deactivated when a dialog is shown or, except under
+    // MSW, when switching to another application, and is going to be used
+    // again soon, so only compact the document at once if a view of another
+    // one is activated and give this one some time to be activated otherwise
+    if ( activeView && activeView->GetDocument() != doc )
+        CompactDocument();
+    else
+        m_compactTimer.Start(COMPACT_INACTIVE_DELAY*1000, wxTIMER_ONE_SHOT);
+}
+
+void DrawingView::OnCompactTimer(wxTimerEvent& WXUNUSED(event))
+{
+    // another view of the same document may have been activated meanwhile
+    const wxView * const current = GetDocumentManager()->GetCurrentView();
+    if ( m_closing || (current && current->GetDocument() == GetDocument()) )
+        return;
+
+    CompactDocument();
+}
+
+void DrawingView::CompactDocument()
+{
+    // compact the big documents while they're not used, the minimal number
+    // of lines can be changed in the configuration, with 0 disabling this
+    long minLines = COMPACT_INACTIVE_LINES;
+#if wxUSE_CONFIG
+    wxConfigBase::Get()->Read("CompactInactiveLines", &minLines);
+#endif // wxUSE_CONFIG
+
+    DrawingDocument * const doc = GetDocument();
+    if ( minLines > 0 && !doc->IsLoading() && !doc->GetCompactSegments() &&
+            doc->GetLines().size() >= static_cast<size_t>(minLines) )
+    {
+        doc->Compact();
+    }
 }
 
 // Clean up windows used for displaying the view.
@@ -95,6 +348,9 @@ bool DrawingView::OnClose(bool deleteWindow)
     if ( !wxView::OnClose(deleteWindow) )
         return false;
 
+    m_closing = true;
+    m_compactTimer.Stop();
+
     Activate(false);
 
     if ( deleteWindow )
@@ -108,10 +364,94 @@ bool DrawingView::OnClose(bool deleteWindow)
 void DrawingView::OnCut(wxCommandEvent& WXUNUSED(event) )
 {
     DrawingDocument * const doc = GetDocument();
+    if ( doc->IsLoading() )
+        return;
 
     doc->GetCommandProcessor()->Submit(new DrawingRemoveSegmentCommand(doc));
 }
 
+void DrawingView::OnDelete(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->DeleteSelection();
+}
+
+void DrawingView::OnUpdateDelete(wxUpdateUIEvent& event)
+{
+    event.Enable(m_canvas && m_canvas->HasSelection() &&
+                    !GetDocument()->IsLoading());
+}
+
+void DrawingView::OnCancelLoad(wxCommandEvent& WXUNUSED(event))
+{
+    GetDocument()->CancelLoading();
+}
+
+void DrawingView::OnUpdateCancelLoad(wxUpdateUIEvent& event)
+{
+    event.Enable(GetDocument()->IsLoading());
+}
+
+void DrawingView::OnUpdateNotLoading(wxUpdateUIEvent& event)
+{
+    event.Enable(!GetDocument()->IsLoading());
+}
+
+void DrawingView::OnConvert(wxCommandEvent& WXUNUSED(event))
+{
+    // the order must match that of DrawingFileFormat enum elements
+    static const wxString formats[] = { "Text", "Binary", "Packed" };
+
+    const int format = wxGetSingleChoiceIndex
+                       (
+                            "Format of the converted drawing:",
+                            "Convert Drawing",
+                            WXSIZEOF(formats),
+                            formats,
+                            GetFrame()
+                       );
+    if ( format == -1 )
+        return;
+
+    const wxString filename = wxFileSelector
+                              (
+                                    "Save converted drawing as",
+                                    wxEmptyString,
+                                    wxEmptyString,
+                                    "drw",
+                                    "Drawing files (*.drw)|*.drw",
+                                    wxFD_SAVE | wxFD_OVERWRITE_PROMPT,
+                                    GetFrame()
+                              );
+    if ( filename.empty() )
+        return;
+
+    if ( !GetDocument()->SaveCopy(filename,
+                                  static_cast<DrawingFileFormat>(format)) )
+    {
+        wxLogError("Failed to save the drawing to \"%s\".", filename);
+    }
+}
+
+void DrawingView::OnZoomIn(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->ZoomIn();
+}
+
+void DrawingView::OnZoomOut(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->ZoomOut();
+}
+
+void DrawingView::OnZoomNormal(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->SetScale(1);
+}
+
+void DrawingView::OnZoomFit(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->ZoomToFit();
+}
+
 // ----------------------------------------------------------------------------
 // TextEditView implementation
 // ----------------------------------------------------------------------------
@@ -129,7 +469,8 @@ bool TextEditView::OnCreate(wxDocument *doc, long flags)
     if ( !wxView::OnCreate(doc, flags) )
         return false;
 
-    wxFrame* frame = wxGetApp().CreateChildFrame(this, false);
+    wxFrame* frame = wxGetApp().CreateChildFrame(this,
+                                                  MyApp::ChildFrame_Text);
     wxASSERT(frame == GetFrame());
     m_text = new wxTextCtrl(frame, wxID_ANY, "",
                             wxDefaultPosition, wxDefaultSize,
@@ -163,8 +504,45 @@ bool TextEditView::OnClose(bool deleteWindow)
 // MyCanvas implementation
 // ----------------------------------------------------------------------------
 
+namespace
+{
+
+// the scale limits and the factor by which each zoom step changes it
+const double MIN_SCALE = 1./64;
+const double MAX_SCALE = 32;
+const double ZOOM_FACTOR = 1.25;
+
+// the minimal size of the drawing area in logical units, the virtual size is
+// also rounded up to a multiple of it to leave some space for new segments
+const int DRAWING_AREA_STEP = 1000;
+
+// the maximal virtual size of the drawing area in pixels, well below INT_MAX
+// as the scroll positions and the window size are added to it
+const double MAX_DRAWING_VIRTUAL_SIZE = 1 << 30;
+
+// don't use more than 64MB for the backing bitmap, drawing directly is better
+// than using so much memory
+const double MAX_BACKING_PIXELS = 4096.*4096.;
+
+// the initial size of the stroke buffer, enough for a few seconds of drawing
+// with a 1000Hz mouse, it's doubled when a longer stroke doesn't fit in it
+const size_t STROKE_BUFFER_LINES = 4096;
+
+// how far from a segment, in pixels, Ctrl+click still selects it and the
+// width of the pen used to highlight the selected segments
+const int SELECTION_TOLERANCE = 3;
+const int SELECTION_PEN_WIDTH = 3;
+
+// the scale limits of the survey map, in pixels per reading
+const double MIN_SURVEY_SCALE = 1./256;
+const double MAX_SURVEY_SCALE = 64;
+const double SURVEY_DEFAULT_SCALE = 16;
+
+} // anonymous namespace
+
 wxBEGIN_EVENT_TABLE(MyCanvas, wxScrolledWindow)
     EVT_MOUSE_EVENTS(MyCanvas::OnMouseEvent)
+    EVT_CHAR(MyCanvas::OnChar)
 wxEND_EVENT_TABLE()
 
 // Define a constructor for my canvas
@@ -172,13 +550,18 @@ MyCanvas::MyCanvas(wxView *view, wxWindow *parent)
     : wxScrolledWindow(parent ? parent : view->GetFrame())
 {
     m_view = view;
-    m_currentSegment = NULL;
+    m_stroke.resize(STROKE_BUFFER_LINES);
+    m_strokeLength = 0;
+    m_strokeDrawn = 0;
     m_lastMousePos = wxDefaultPosition;
+    m_panPos = wxDefaultPosition;
+    m_useBacking = true;
+    m_scale = 1;
+    m_moveStart = wxDefaultPosition;
 
     SetCursor(wxCursor(wxCURSOR_PENCIL));
 
-    // this is completely arbitrary and is done just for illustration purposes
-    SetVirtualSize(1000, 1000);
+    SetVirtualSize(DRAWING_AREA_STEP, DRAWING_AREA_STEP);
     SetScrollRate(20, 20);
 
     SetBackgroundColour(*wxWHITE);
@@ -186,58 +569,1993 @@ MyCanvas::MyCanvas(wxView *view, wxWindow *parent)
 
 MyCanvas::~MyCanvas()
 {
-    delete m_currentSegment;
 }
 
-// Define the repainting behaviour
-void MyCanvas::OnDraw(wxDC& dc)
+wxRect MyCanvas::LogicalToDevice(const wxRect& rect) const
 {
-    if ( m_view )
-        m_view->OnDraw(& dc);
+    const int left = floor(rect.x*m_scale),
+              top = floor(rect.y*m_scale),
+              right = ceil((rect.x + rect.width)*m_scale),
+              bottom = ceil((rect.y + rect.height)*m_scale);
+
+    return wxRect(left, top, right - left, bottom - top);
 }
 
-// This implements a tiny doodling program. Drag the mouse using the left
-// button.
-void MyCanvas::OnMouseEvent(wxMouseEvent& event)
+wxRect MyCanvas::DeviceToLogical(const wxRect& rect) const
+{
+    const int left = floor(rect.x/m_scale),
+              top = floor(rect.y/m_scale),
+              right = ceil((rect.x + rect.width)/m_scale),
+              bottom = ceil((rect.y + rect.height)/m_scale);
+
+    return wxRect(left, top, right - left, bottom - top);
+}
+
+// Define the repainting behaviour
+void MyCanvas::OnDraw(wxDC& dc)
 {
     if ( !m_view )
         return;
 
-    wxClientDC dc(this);
-    PrepareDC(dc);
+    // find the part of the window being repainted
+    wxRect rect = GetUpdateRegion().GetBox();
+    if ( rect.IsEmpty() )
+        rect = wxRect(GetClientSize());
+    rect.SetPosition(CalcUnscrolledPosition(rect.GetPosition()));
+
+    if ( !UpdateBacking() )
+    {
+        DrawScaled(dc, rect);
+
+        // there is nowhere to keep the stroke being drawn, so all of it must
+        // be drawn again
+        DrawStroke(dc, 0, m_strokeLength);
+        DrawSelection(dc);
+        return;
+    }
+
+    // draw the lines added to the stroke since the last repaint on the
+    // backing bitmap, the areas covered by them were already invalidated
+    if ( m_strokeDrawn < m_strokeLength )
+    {
+        wxMemoryDC memDC(m_backing);
+        DrawStroke(memDC, m_strokeDrawn, m_strokeLength);
+        m_strokeDrawn = m_strokeLength;
+    }
+
+    // just copy it from the backing bitmap which uses the same coordinates as
+    // the DC prepared for scrolling
+    rect.Intersect(wxRect(m_backing.GetSize()));
+    if ( rect.IsEmpty() )
+        return;
+
+    wxMemoryDC memDC(m_backing);
+    dc.Blit(rect.x, rect.y, rect.width, rect.height, &memDC, rect.x, rect.y);
+
+    // the selection changes too often to be drawn on the backing bitmap
+    DrawSelection(dc);
+}
+
+void MyCanvas::DrawScaled(wxDC& dc, const wxRect& rect)
+{
+    // the clipping region must be set after changing the scale to be in the
+    // same logical coordinates the view uses
+    dc.SetUserScale(m_scale, m_scale);
+    dc.SetClippingRegion(DeviceToLogical(rect));
+
+    m_view->OnDraw(&dc);
+
+    dc.DestroyClippingRegion();
+    dc.SetUserScale(1, 1);
+}
+
+void MyCanvas::DrawStroke(wxDC& dc, size_t from, size_t to)
+{
+    if ( from == to )
+        return;
 
+    dc.SetUserScale(m_scale, m_scale);
     dc.SetPen(*wxBLACK_PEN);
 
-    const wxPoint pt(event.GetLogicalPosition(dc));
+    for ( size_t n = from; n < to; n++ )
+    {
+        const DoodleLine& line = m_stroke[n];
+        dc.DrawLine(line.x1, line.y1, line.x2, line.y2);
+    }
+
+    dc.SetUserScale(1, 1);
+}
 
-    // is this the end of the current segment?
-    if ( m_currentSegment && event.LeftUp() )
+bool MyCanvas::UpdateBacking()
+{
+    const wxSize size = GetVirtualSize();
+    if ( !m_useBacking ||
+            static_cast<double>(size.x)*size.y > MAX_BACKING_PIXELS )
     {
-        if ( !m_currentSegment->IsEmpty() )
-        {
-            // We've got a valid segment on mouse left up, so store it.
-            DrawingDocument * const
-                doc = wxStaticCast(m_view->GetDocument(), DrawingDocument);
+        m_backing = wxNullBitmap;
+        return false;
+    }
 
-            doc->GetCommandProcessor()->Submit(
-                new DrawingAddSegmentCommand(doc, *m_currentSegment));
+    if ( !m_backing.IsOk() || m_backing.GetSize() != size )
+    {
+        if ( !m_backing.Create(size.x, size.y) )
+            return false;
 
-            doc->Modify(true);
-        }
+        m_backingDirty = wxRegion(wxRect(size));
+    }
+
+    if ( m_backingDirty.IsEmpty() )
+        return true;
+
+    wxMemoryDC memDC(m_backing);
+    const wxBrush background(GetBackgroundColour());
+
+    for ( wxRegionIterator it(m_backingDirty); it; ++it )
+    {
+        const wxRect rect = it.GetRect();
+
+        memDC.SetPen(*wxTRANSPARENT_PEN);
+        memDC.SetBrush(background);
+        memDC.DrawRectangle(rect);
+
+        DrawScaled(memDC, rect);
+    }
+
+    m_backingDirty.Clear();
+
+    // the stroke being drawn could have been overwritten
+    m_strokeDrawn = 0;
+
+    return true;
+}
 
-        wxDELETE(m_currentSegment);
+wxPoint MyCanvas::MouseToLogical(const wxPoint& pt) const
+{
+    const wxPoint unscrolled = CalcUnscrolledPosition(pt);
+
+    return wxPoint(wxRound(unscrolled.x/m_scale),
+                   wxRound(unscrolled.y/m_scale));
+}
+
+void MyCanvas::AddStrokeLine(const wxPoint& pt1, const wxPoint& pt2)
+{
+    if ( m_strokeLength == m_stroke.size() )
+        m_stroke.resize(2*m_stroke.size());
+
+    m_stroke[m_strokeLength++] = DoodleLine(pt1, pt2);
+
+    // unlike RefreshLogicalRect() this doesn't render the backing bitmap
+    // again, the line is just drawn over it by OnDraw()
+    wxRect rect = LogicalToDevice(wxRect(pt1, pt2));
+    rect.Inflate(2, 2);
+
+    RefreshRect(wxRect(CalcScrolledPosition(rect.GetTopLeft()),
+                       rect.GetSize()));
+}
+
+void MyCanvas::EndStroke()
+{
+    if ( !m_strokeLength )
+        return;
+
+    DrawingDocument * const
+        doc = wxStaticCast(m_view->GetDocument(), DrawingDocument);
+
+    // the command copies the lines, so the buffer can be reused
+    doc->GetCommandProcessor()->Submit(
+        new DrawingAddSegmentCommand(doc,
+                                     DoodleSegmentSpan(&m_stroke[0],
+                                                       m_strokeLength)));
+
+    doc->Modify(true);
+
+    // the lines are drawn by the view from now on
+    m_strokeLength = 0;
+    m_strokeDrawn = 0;
+}
+
+void MyCanvas::SelectAt(const wxPoint& pt, bool toggle)
+{
+    DrawingDocument * const doc = GetDrawingDocument();
+    if ( doc->IsLoading() || doc->GetCompactSegments() )
+        return;
+
+    RefreshSelection();
+
+    // use the same tolerance in pixels at any scale
+    const int
+        n = doc->HitTest(pt, wxMax(1, wxRound(SELECTION_TOLERANCE/m_scale)));
+    if ( n == wxNOT_FOUND )
+    {
+        if ( !toggle )
+            m_selection.clear();
+        return;
     }
 
-    // is this the start of a new segment?
-    if ( m_lastMousePos != wxDefaultPosition && event.Dragging() )
+    const DoodleSegmentId id = doc->GetSegmentId(n);
+
+    size_t i = 0;
+    while ( i < m_selection.size() && m_selection[i] != id )
+        i++;
+
+    if ( i == m_selection.size() )
+    {
+        if ( !toggle )
+            m_selection.clear();
+
+        m_selection.push_back(id);
+    }
+    else if ( toggle )
     {
-        if ( !m_currentSegment )
-            m_currentSegment = new DoodleSegment;
+        m_selection.erase(m_selection.begin() + i);
+    }
+
+    RefreshSelection();
+}
 
-        m_currentSegment->AddLine(m_lastMousePos, pt);
+void MyCanvas::PruneSelection()
+{
+    DrawingDocument * const doc = GetDrawingDocument();
 
-        dc.DrawLine(m_lastMousePos, pt);
+    size_t kept = 0;
+    for ( size_t i = 0; i < m_selection.size(); i++ )
+    {
+        if ( doc->FindSegment(m_selection[i]) != wxNOT_FOUND )
+            m_selection[kept++] = m_selection[i];
     }
 
-    m_lastMousePos = pt;
+    m_selection.resize(kept);
+}
+
+void MyCanvas::ClearSelection()
+{
+    RefreshSelection();
+
+    m_selection.clear();
+    m_moveStart = wxDefaultPosition;
+    m_moveOffset = wxPoint();
+}
+
+void MyCanvas::DeleteSelection()
+{
+    DrawingDocument * const doc = GetDrawingDocument();
+    if ( doc->IsLoading() )
+        return;
+
+    PruneSelection();
+    if ( m_selection.empty() )
+        return;
+
+    // the document refreshes the area of the deleted segments itself
+    doc->GetCommandProcessor()->Submit(
+        new DrawingDeleteSegmentsCommand(doc, m_selection));
+
+    m_selection.clear();
+}
+
+void MyCanvas::RefreshSelection()
+{
+    if ( m_selection.empty() || GetDrawingDocument()->GetCompactSegments() )
+        return;
+
+    PruneSelection();
+
+    wxRect rect = GetDrawingDocument()->GetSegmentsBounds(m_selection);
+    if ( rect.IsEmpty() )
+        return;
+
+    rect.Offset(m_moveOffset);
+
+    // the highlight is wider than the lines
+    rect = LogicalToDevice(rect);
+    rect.Inflate(SELECTION_PEN_WIDTH + 2, SELECTION_PEN_WIDTH + 2);
+
+    RefreshRect(wxRect(CalcScrolledPosition(rect.GetTopLeft()),
+                       rect.GetSize()));
+}
+
+void MyCanvas::DrawSelection(wxDC& dc)
+{
+    if ( m_selection.empty() )
+        return;
+
+    DrawingDocument * const doc = GetDrawingDocument();
+    if ( doc->GetCompactSegments() )
+        return;
+
+    const DoodleSegments segments = doc->GetSegments();
+
+    // the pen width is in pixels, whatever the scale is
+    dc.SetPen(wxPen(*wxBLUE, SELECTION_PEN_WIDTH));
+
+    // while the selection is being moved, it's drawn at its new position
+    // over the segments still shown at the old one
+    for ( size_t i = 0; i < m_selection.size(); i++ )
+    {
+        const int n = doc->FindSegment(m_selection[i]);
+        if ( n == wxNOT_FOUND )
+            continue;
+
+        const DoodleSegmentSpan segment = segments[n];
+        for ( const DoodleLine *line = segment.begin();
+              line != segment.end();
+              ++line )
+        {
+            dc.DrawLine(wxRound((line->x1 + m_moveOffset.x)*m_scale),
+                        wxRound((line->y1 + m_moveOffset.y)*m_scale),
+                        wxRound((line->x2 + m_moveOffset.x)*m_scale),
+                        wxRound((line->y2 + m_moveOffset.y)*m_scale));
+        }
+    }
+}
+
+void MyCanvas::RefreshDrawing()
+{
+    m_backingDirty = wxRegion(wxRect(GetVirtualSize()));
+
+    Refresh();
+}
+
+void MyCanvas::UseBacking(bool use)
+{
+    m_useBacking = use;
+
+    RefreshDrawing();
+}
+
+void MyCanvas::CancelStroke()
+{
+    m_strokeLength = 0;
+    m_strokeDrawn = 0;
+    m_lastMousePos = wxDefaultPosition;
+
+    RefreshDrawing();
+}
+
+void MyCanvas::RefreshLogicalRect(const wxRect& rect)
+{
+    if ( rect.IsEmpty() )
+        return;
+
+    // account for the pen width and rounding at the line ends
+    wxRect deviceRect = LogicalToDevice(rect);
+    deviceRect.Inflate(2, 2);
+
+    m_backingDirty.Union(deviceRect);
+
+    RefreshRect(wxRect(CalcScrolledPosition(deviceRect.GetTopLeft()),
+                       deviceRect.GetSize()));
+}
+
+void MyCanvas::UpdateVirtualSize()
+{
+    if ( !m_view )
+        return;
+
+    const DrawingDocument * const
+        doc = wxStaticCast(m_view->GetDocument(), DrawingDocument);
+
+    // the logical origin is always shown, so only the right and bottom edges
+    // of the drawing matter
+    const wxRect bounds = doc->GetBounds();
+    const int step = DRAWING_AREA_STEP;
+    const double width = (bounds.GetRight()/step + 1.)*step,
+                 height = (bounds.GetBottom()/step + 1.)*step;
+
+    // the size must fit in an int even for the huge drawings at big scales
+    const wxSize size(wxRound(wxMin(wxMax(width, step)*m_scale,
+                                    MAX_DRAWING_VIRTUAL_SIZE)),
+                      wxRound(wxMin(wxMax(height, step)*m_scale,
+                                    MAX_DRAWING_VIRTUAL_SIZE)));
+    if ( size != GetVirtualSize() )
+        SetVirtualSize(size);
+}
+
+void MyCanvas::SetScale(double scale, const wxPoint& fixed)
+{
+    scale = wxMax(MIN_SCALE, wxMin(MAX_SCALE, scale));
+    if ( scale == m_scale )
+        return;
+
+    const wxPoint pt = fixed == wxDefaultPosition
+                        ? wxPoint(GetClientSize().x/2, GetClientSize().y/2)
+                        : fixed;
+
+    // the logical position which must remain at pt
+    const wxPoint unscrolled = CalcUnscrolledPosition(pt);
+    const double x = unscrolled.x/m_scale,
+                 y = unscrolled.y/m_scale;
+
+    m_scale = scale;
+    UpdateVirtualSize();
+
+    int xUnit, yUnit;
+    GetScrollPixelsPerUnit(&xUnit, &yUnit);
+    Scroll(wxRound((x*m_scale - pt.x)/xUnit),
+           wxRound((y*m_scale - pt.y)/yUnit));
+
+    RefreshDrawing();
+}
+
+void MyCanvas::ZoomIn()
+{
+    SetScale(m_scale*ZOOM_FACTOR);
+}
+
+void MyCanvas::ZoomOut()
+{
+    SetScale(m_scale/ZOOM_FACTOR);
+}
+
+void MyCanvas::ZoomToFit()
+{
+    if ( !m_view )
+        return;
+
+    const DrawingDocument * const
+        doc = wxStaticCast(m_view->GetDocument(), DrawingDocument);
+
+    const wxRect bounds = doc->GetBounds();
+    if ( bounds.IsEmpty() )
+    {
+        SetScale(1);
+        return;
+    }
+
+    const wxSize size = GetClientSize();
+    SetScale(wxMin(static_cast<double>(size.x)/(bounds.GetRight() + 1),
+                   static_cast<double>(size.y)/(bounds.GetBottom() + 1)));
+    Scroll(0, 0);
+}
+
+wxPoint MyCanvas::ScrollByPixels(const wxPoint& delta)
+{
+    int xUnit, yUnit;
+    GetScrollPixelsPerUnit(&xUnit, &yUnit);
+
+    const wxPoint start = GetViewStart();
+    Scroll(start.x + delta.x/xUnit, start.y + delta.y/yUnit);
+
+    const wxPoint moved = GetViewStart() - start;
+    return wxPoint(moved.x*xUnit, moved.y*yUnit);
+}
+
+void MyCanvas::OnChar(wxKeyEvent& event)
+{
+    switch ( event.GetKeyCode() )
+    {
+        case '+':
+        case '=':
+        case WXK_ADD:
+        case WXK_NUMPAD_ADD:
+            ZoomIn();
+            break;
+
+        case '-':
+        case WXK_SUBTRACT:
+        case WXK_NUMPAD_SUBTRACT:
+            ZoomOut();
+            break;
+
+        case '0':
+            SetScale(1);
+            break;
+
+        case '*':
+            ZoomToFit();
+            break;
+
+        case WXK_ESCAPE:
+            if ( m_view )
+            {
+                ClearSelection();
+
+                wxStaticCast(m_view->GetDocument(), DrawingDocument)
+                    ->CancelLoading();
+            }
+            break;
+
+        default:
+            // let wxScrolledWindow handle the cursor keys
+            event.Skip();
+    }
+}
+
+// This implements a tiny doodling program. Drag the mouse using the left
+// button, drag it with the middle button to pan and use the wheel with Ctrl
+// pressed to zoom. Ctrl+click selects the segments, with Shift to add them
+// to the selection, and Ctrl+drag moves the selected ones.
+//
+// High rate mice and tablets generate up to a thousand events per second, so
+// this doesn't draw anything itself but only records the lines in the stroke
+// buffer and invalidates the area covered by them, letting the next repaint
+// draw all the lines added since the previous one at once.
+void MyCanvas::OnMouseEvent(wxMouseEvent& event)
+{
+    if ( !m_view )
+        return;
+
+    // this is by far the most frequent event and there is nothing to do for
+    // it, just forget the position which is only needed while drawing
+    if ( event.Moving() )
+    {
+        m_lastMousePos = wxDefaultPosition;
+        return;
+    }
+
+    if ( event.GetEventType() == wxEVT_MOUSEWHEEL )
+    {
+        if ( !event.ControlDown() )
+        {
+            event.Skip();
+            return;
+        }
+
+        const double factor = event.GetWheelRotation() > 0 ? ZOOM_FACTOR
+                                                           : 1/ZOOM_FACTOR;
+        SetScale(m_scale*factor, event.GetPosition());
+        return;
+    }
+
+    if ( event.MiddleDown() )
+    {
+        m_panPos = event.GetPosition();
+        return;
+    }
+
+    if ( event.Dragging() && event.MiddleIsDown() )
+    {
+        if ( m_panPos != wxDefaultPosition )
+            m_panPos += ScrollByPixels(m_panPos - event.GetPosition());
+        return;
+    }
+
+    const wxPoint pt = MouseToLogical(event.GetPosition());
+
+    if ( event.LeftDown() && event.ControlDown() )
+    {
+        SelectAt(pt, event.ShiftDown());
+
+        m_moveStart = pt;
+        m_moveOffset = wxPoint();
+        m_lastMousePos = wxDefaultPosition;
+        return;
+    }
+
+    // the selection is only moved when the button is released, until then
+    // it's just drawn at its new position
+    if ( m_moveStart != wxDefaultPosition )
+    {
+        if ( event.Dragging() && event.LeftIsDown() )
+        {
+            RefreshSelection();
+            m_moveOffset = pt - m_moveStart;
+            RefreshSelection();
+        }
+        else if ( event.LeftUp() )
+        {
+            RefreshSelection();
+
+            const wxPoint offset = m_moveOffset;
+            m_moveStart = wxDefaultPosition;
+            m_moveOffset = wxPoint();
+
+            PruneSelection();
+            if ( offset != wxPoint() && !m_selection.empty() )
+            {
+                DrawingDocument * const doc = GetDrawingDocument();
+                doc->GetCommandProcessor()->Submit(
+                    new DrawingMoveSegmentsCommand(doc,
+                                                   m_selection,
+                                                   offset.x,
+                                                   offset.y));
+            }
+        }
+
+        return;
+    }
+
+    // is this the end of the current stroke?
+    if ( event.LeftUp() )
+        EndStroke();
+
+    // several events can map to the same logical position when the drawing
+    // is zoomed out and there is no need to add empty lines for them
+    if ( pt == m_lastMousePos )
+        return;
+
+    // is this the continuation of the stroke? the document can't be modified
+    // while it's still being loaded, so don't start a new one then
+    if ( m_lastMousePos != wxDefaultPosition && event.Dragging() &&
+            (m_strokeLength ||
+                !wxStaticCast(m_view->GetDocument(), DrawingDocument)
+                    ->IsLoading()) )
+    {
+        AddStrokeLine(m_lastMousePos, pt);
+    }
+
+    m_lastMousePos = pt;
+}
+
+// ----------------------------------------------------------------------------
+// SurveyView implementation
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// the maximal number of pixel rows rendered at once by SurveyView::OnDraw()
+const int SURVEY_STRIP_HEIGHT = 256;
+
+// the limits on the size of the interpolated grid shown instead of the
+// readings: the number of its values and of them per reading along each axis
+const size_t MAX_DISPLAYED_INTERPOLATED = 16*1024*1024;
+const int MAX_INTERPOLATION_FACTOR = 8;
+
+// the ISO 216 paper sizes, in mm, and the resolutions, in DPI, offered for
+// the images exported by SurveyView
+struct PaperSize
+{
+    const char *name;
+    double width;
+    double height;
+};
+
+const PaperSize EXPORT_PAPER_SIZES[] =
+{
+    { "A0", 841, 1189 },
+    { "A1", 594, 841 },
+    { "A2", 420, 594 },
+    { "A3", 297, 420 },
+    { "A4", 210, 297 },
+};
+
+const int EXPORT_RESOLUTIONS[] = { 150, 300, 600 };
+
+// find the cells of the readings to draw on the DC, which uses one logical
+// unit per reading, the device area showing them and the column and row of
+// the displayed grid, covering the same area as the readings but possibly
+// with more values, shown by each pixel of this area; return false if there
+// is nothing to draw
+bool MapSurveyPixels(wxDC *dc,
+                     const SurveyGrid& readings,
+                     const SurveyGrid& grid,
+                     wxRect& cells,
+                     wxRect& area,
+                     wxVector<size_t>& columns,
+                     wxVector<size_t>& rows)
+{
+    const int width = readings.GetWidth(),
+              height = readings.GetHeight();
+
+    cells = wxRect(0, 0, width, height);
+
+    wxRect clip;
+    dc->GetClippingBox(&clip.x, &clip.y, &clip.width, &clip.height);
+    if ( !clip.IsEmpty() )
+        cells.Intersect(clip);
+    if ( cells.IsEmpty() )
+        return false;
+
+    // the cells are rendered at the device resolution, so that the cost of
+    // drawing depends only on the size of the output and not on that of the
+    // grid, and each pixel is mapped to the cell containing its center in the
+    // same way whichever part of the grid is being drawn
+    const int gridLeft = dc->LogicalToDeviceX(0),
+              gridTop = dc->LogicalToDeviceY(0),
+              gridWidth = dc->LogicalToDeviceX(width) - gridLeft,
+              gridHeight = dc->LogicalToDeviceY(height) - gridTop;
+    if ( gridWidth <= 0 || gridHeight <= 0 )
+        return false;
+
+    const int left = dc->LogicalToDeviceX(cells.x),
+              top = dc->LogicalToDeviceY(cells.y);
+    area = wxRect(left, top,
+                  dc->LogicalToDeviceX(cells.x + cells.width) - left,
+                  dc->LogicalToDeviceY(cells.y + cells.height) - top);
+    if ( area.IsEmpty() )
+        return false;
+
+    columns.resize(area.width);
+    for ( int i = 0; i < area.width; i++ )
+    {
+        const double pos = (area.x + i - gridLeft + 0.5)*grid.GetWidth()/
+                                gridWidth;
+        columns[i] = wxMin(static_cast<size_t>(pos), grid.GetWidth() - 1);
+    }
+
+    rows.resize(area.height);
+    for ( int i = 0; i < area.height; i++ )
+    {
+        const double pos = (area.y + i - gridTop + 0.5)*grid.GetHeight()/
+                                gridHeight;
+        rows[i] = wxMin(static_cast<size_t>(pos), grid.GetHeight() - 1);
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+IMPLEMENT_DYNAMIC_CLASS(SurveyView, wxView)
+
+wxBEGIN_EVENT_TABLE(SurveyView, wxView)
+    EVT_MENU(wxID_ZOOM_IN, SurveyView::OnZoomIn)
+    EVT_MENU(wxID_ZOOM_OUT, SurveyView::OnZoomOut)
+    EVT_MENU(wxID_ZOOM_100, SurveyView::OnZoomNormal)
+    EVT_MENU(wxID_ZOOM_FIT, SurveyView::OnZoomFit)
+    EVT_MENU(ID_SURVEY_COLOURS_BANDS, SurveyView::OnColourScheme)
+    EVT_MENU(ID_SURVEY_COLOURS_CONTINUOUS, SurveyView::OnColourScheme)
+    EVT_UPDATE_UI(ID_SURVEY_COLOURS_BANDS, SurveyView::OnUpdateColourScheme)
+    EVT_UPDATE_UI(ID_SURVEY_COLOURS_CONTINUOUS,
+                  SurveyView::OnUpdateColourScheme)
+    EVT_MENU_RANGE(ID_SURVEY_INTERPOLATION_NONE, ID_SURVEY_INTERPOLATION_IDW,
+                   SurveyView::OnInterpolation)
+    EVT_UPDATE_UI_RANGE(ID_SURVEY_INTERPOLATION_NONE,
+                        ID_SURVEY_INTERPOLATION_IDW,
+                        SurveyView::OnUpdateInterpolation)
+    EVT_MENU(ID_SURVEY_SHOW_CONTOURS, SurveyView::OnShowContours)
+    EVT_UPDATE_UI(ID_SURVEY_SHOW_CONTOURS, SurveyView::OnUpdateShowContours)
+    EVT_MENU(ID_SURVEY_EXPORT_CONTOURS, SurveyView::OnExportContours)
+    EVT_MENU(ID_SURVEY_EXPORT_IMAGE, SurveyView::OnExportImage)
+wxEND_EVENT_TABLE()
+
+bool SurveyView::OnCreate(wxDocument *doc, long flags)
+{
+    if ( !wxView::OnCreate(doc, flags) )
+        return false;
+
+    wxFrame* frame = wxGetApp().CreateChildFrame(this,
+                                                  MyApp::ChildFrame_Survey);
+    wxASSERT(frame == GetFrame());
+    m_canvas = new SurveyCanvas(this);
+
+    m_statsPanel = new SurveyStatsPanel(frame, m_colourMap);
+    m_statsPanel->SetStatistics(&GetDocument()->GetStatistics());
+
+    wxBoxSizer * const sizer = new wxBoxSizer(wxHORIZONTAL);
+    sizer->Add(m_canvas, 1, wxEXPAND);
+    sizer->Add(m_statsPanel, 0, wxEXPAND);
+    frame->SetSizer(sizer);
+
+    frame->Show();
+
+    return true;
+}
+
+void SurveyView::OnDraw(wxDC *dc)
+{
+    // the logical coordinates are always those of the readings, even if we
+    // show the interpolated grid with more values covering the same area
+    const SurveyGrid& readings = GetDocument()->GetGrid();
+    if ( readings.IsEmpty() )
+        return;
+
+    const SurveyGrid& grid = GetDisplayedGrid();
+
+    wxRect cells, area;
+    if ( !MapSurveyPixels(dc, readings, grid, cells, area, m_columns, m_rows) )
+        return;
+
+    // the bitmaps are already at the device resolution and must not be scaled
+    double scaleX, scaleY;
+    dc->GetUserScale(&scaleX, &scaleY);
+    dc->SetUserScale(1, 1);
+
+    m_values.resize(area.width);
+
+    // render the area in strips to limit the memory used when printing
+    const size_t stride = 3*area.width;
+    wxImage image;
+    for ( int top = 0; top < area.height; top += SURVEY_STRIP_HEIGHT )
+    {
+        const int rows = wxMin(SURVEY_STRIP_HEIGHT, area.height - top);
+        if ( !image.IsOk() || image.GetHeight() != rows )
+            image.Create(area.width, rows, false /* don't clear */);
+
+        unsigned char *rgb = image.GetData();
+        for ( int y = 0; y < rows; y++, rgb += stride )
+        {
+            // when zoomed in, several pixel rows show the same cells
+            if ( y > 0 && m_rows[top + y] == m_rows[top + y - 1] )
+            {
+                memcpy(rgb, rgb - stride, stride);
+                continue;
+            }
+
+            const float * const values = grid.GetRow(m_rows[top + y]);
+            for ( int x = 0; x < area.width; x++ )
+                m_values[x] = values[m_columns[x]];
+
+            m_colourMap.Map(&m_values[0], area.width, rgb);
+        }
+
+        dc->DrawBitmap(wxBitmap(image),
+                       dc->DeviceToLogicalX(area.x),
+                       dc->DeviceToLogicalY(area.y + top));
+    }
+
+    dc->SetUserScale(scaleX, scaleY);
+
+    if ( m_showContours )
+        DrawContours(dc, cells);
+}
+
+void SurveyView::DrawContours(wxDC *dc, const wxRect& cells)
+{
+    // don't pass too many points to the DC at once, as in DrawingView
+    static const size_t MAX_POLYLINE_POINTS = 8192;
+
+    static const int UNITS = SurveyContours::CONTOUR_UNITS;
+
+    // the contours use finer coordinates than the readings
+    double scaleX, scaleY;
+    dc->GetUserScale(&scaleX, &scaleY);
+    dc->SetUserScale(scaleX/UNITS, scaleY/UNITS);
+
+    dc->SetPen(*wxBLACK_PEN);
+
+    const wxRect area(cells.x*UNITS, cells.y*UNITS,
+                      cells.width*UNITS, cells.height*UNITS);
+
+    const DoodleSegments segments = m_contours.GetSegments();
+    for ( size_t n = 0; n < segments.size(); n++ )
+    {
+        if ( !m_contours.GetBounds(n).Intersects(area) )
+            continue;
+
+        const DoodleSegmentSpan contour = segments[n];
+
+        m_points.clear();
+        m_points.push_back(wxPoint(contour[0].x1, contour[0].y1));
+        for ( size_t i = 0; i < contour.GetCount(); i++ )
+        {
+            if ( m_points.size() == MAX_POLYLINE_POINTS )
+            {
+                dc->DrawLines(m_points.size(), &m_points[0]);
+                m_points.erase(m_points.begin(), m_points.end() - 1);
+            }
+
+            m_points.push_back(wxPoint(contour[i].x2, contour[i].y2));
+        }
+
+        dc->DrawLines(m_points.size(), &m_points[0]);
+    }
+
+    dc->SetUserScale(scaleX, scaleY);
+}
+
+SurveyDocument* SurveyView::GetDocument()
+{
+    return wxStaticCast(wxView::GetDocument(), SurveyDocument);
+}
+
+const SurveyGrid& SurveyView::GetDisplayedGrid()
+{
+    if ( m_interpolation == Interpolation_None || m_interpolated.IsEmpty() )
+        return GetDocument()->GetGrid();
+
+    return m_interpolated;
+}
+
+void SurveyView::UpdateInterpolated()
+{
+    m_interpolated.Clear();
+
+    const SurveyGrid& readings = GetDocument()->GetGrid();
+    if ( m_interpolation == Interpolation_None || readings.IsEmpty() )
+        return;
+
+    // use as many values per reading as possible without making the grid
+    // too big, the interpolated values are not worth much more memory
+    const double maxFactor =
+        sqrt(static_cast<double>(MAX_DISPLAYED_INTERPOLATED)/
+                readings.GetCount());
+    const int factor = wxMax(1, wxMin(MAX_INTERPOLATION_FACTOR,
+                                      static_cast<int>(maxFactor)));
+
+    wxBusyCursor wait;
+
+    if ( !InterpolateSurvey(readings, m_interpolation, factor,
+                            m_interpolated, WorkerPool::Get()) )
+    {
+        wxLogError("The survey is too big to be interpolated.");
+        m_interpolated.Clear();
+    }
+}
+
+void SurveyView::ComputeContours()
+{
+    if ( m_contours.IsComputed() )
+        return;
+
+    wxBusyCursor wait;
+
+    m_contours.Compute(GetDocument()->GetGrid(), WorkerPool::Get());
+}
+
+void SurveyView::OnUpdate(wxView* sender, wxObject* hint)
+{
+    wxView::OnUpdate(sender, hint);
+    if ( !m_canvas )
+        return;
+
+    const SurveyGrid& readings = GetDocument()->GetGrid();
+
+    // only retrace the contours near the changed readings if we know them
+    const DrawingUpdateHint * const
+        update = wxDynamicCast(hint, DrawingUpdateHint);
+    if ( update )
+    {
+        if ( m_contours.IsComputed() )
+        {
+            m_contours.Update(readings, update->GetRect(),
+                              WorkerPool::Get());
+        }
+
+        UpdateInterpolated();
+        m_canvas->Refresh();
+        m_statsPanel->Refresh();
+        return;
+    }
+
+    // otherwise the document was loaded or reverted
+    m_contours.Clear();
+    if ( m_showContours )
+        ComputeContours();
+
+    UpdateInterpolated();
+
+    m_canvas->ZoomToFit();
+    m_canvas->Refresh();
+    m_statsPanel->Refresh();
+}
+
+bool SurveyView::OnClose(bool deleteWindow)
+{
+    if ( !wxView::OnClose(deleteWindow) )
+        return false;
+
+    Activate(false);
+
+    if ( deleteWindow )
+    {
+        GetFrame()->Destroy();
+        SetFrame(NULL);
+    }
+    return true;
+}
+
+void SurveyView::OnZoomIn(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->ZoomIn();
+}
+
+void SurveyView::OnZoomOut(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->ZoomOut();
+}
+
+void SurveyView::OnZoomNormal(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->SetScale(SURVEY_DEFAULT_SCALE);
+}
+
+void SurveyView::OnZoomFit(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->ZoomToFit();
+}
+
+void SurveyView::OnColourScheme(wxCommandEvent& event)
+{
+    m_colourMap.SetScheme(event.GetId() == ID_SURVEY_COLOURS_BANDS
+                            ? SurveyColours_Bands
+                            : SurveyColours_Continuous);
+    m_canvas->Refresh();
+    m_statsPanel->Refresh();
+}
+
+void SurveyView::OnUpdateColourScheme(wxUpdateUIEvent& event)
+{
+    const SurveyColourScheme scheme = event.GetId() == ID_SURVEY_COLOURS_BANDS
+                                        ? SurveyColours_Bands
+                                        : SurveyColours_Continuous;
+    event.Check(m_colourMap.GetScheme() == scheme);
+}
+
+void SurveyView::OnInterpolation(wxCommandEvent& event)
+{
+    m_interpolation = static_cast<SurveyInterpolation>(
+                        event.GetId() - ID_SURVEY_INTERPOLATION_NONE);
+
+    UpdateInterpolated();
+    m_canvas->Refresh();
+}
+
+void SurveyView::OnUpdateInterpolation(wxUpdateUIEvent& event)
+{
+    event.Check(event.GetId() - ID_SURVEY_INTERPOLATION_NONE ==
+                    m_interpolation);
+}
+
+void SurveyView::EditReading(int x, int y)
+{
+    SurveyDocument * const doc = GetDocument();
+    const float value = doc->GetGrid().GetValue(x, y);
+
+    wxTextEntryDialog dlg(GetFrame(),
+                          wxString::Format("Reading in column %d, row %d, "
+                                           "in mV (empty if missing):",
+                                           x + 1, y + 1),
+                          "Change Reading",
+                          SurveyGrid::IsMissing(value)
+                            ? wxString()
+                            : wxString::Format("%.2f", value));
+    if ( dlg.ShowModal() != wxID_OK )
+        return;
+
+    wxString text = dlg.GetValue();
+    text.Trim().Trim(false);
+
+    double reading = SurveyGrid::GetMissingValue();
+    if ( !text.empty() && !text.ToDouble(&reading) )
+    {
+        wxLogError("\"%s\" is not a valid reading.", text);
+        return;
+    }
+
+    doc->GetCommandProcessor()->Submit(
+            new SurveySetReadingCommand(doc, x, y, reading));
+}
+
+void SurveyView::OnShowContours(wxCommandEvent& event)
+{
+    m_showContours = event.IsChecked();
+    if ( m_showContours )
+        ComputeContours();
+
+    m_canvas->Refresh();
+}
+
+void SurveyView::OnUpdateShowContours(wxUpdateUIEvent& event)
+{
+    event.Check(m_showContours);
+}
+
+void SurveyView::OnExportContours(wxCommandEvent& WXUNUSED(event))
+{
+    ComputeContours();
+
+    const DoodleSegments contours = m_contours.GetSegments();
+    if ( contours.empty() )
+    {
+        wxLogMessage("The survey doesn't have any contours.");
+        return;
+    }
+
+    // create a new drawing directly from its template, as going through
+    // wxDocManager would ask the user to choose the kind of the document
+    wxDocTemplate *drawingTemplate = NULL;
+    const wxList& templates = GetDocumentManager()->GetTemplates();
+    for ( wxList::compatibility_iterator node = templates.GetFirst();
+          node;
+          node = node->GetNext() )
+    {
+        wxDocTemplate * const
+            temp = static_cast<wxDocTemplate *>(node->GetData());
+        if ( temp->GetDocClassInfo() == CLASSINFO(DrawingDocument) )
+        {
+            drawingTemplate = temp;
+            break;
+        }
+    }
+
+    wxCHECK_RET( drawingTemplate, "no template for drawings" );
+
+    wxDocument * const doc = drawingTemplate->CreateDocument(wxString(),
+                                                             wxDOC_NEW);
+    if ( !doc )
+        return;
+
+    doc->SetDocumentName(drawingTemplate->GetDocumentName());
+    if ( !doc->OnNewDocument() )
+    {
+        doc->DeleteAllViews();
+        return;
+    }
+
+    wxStaticCast(doc, DrawingDocument)->AddDoodleSegments(contours);
+}
+
+void SurveyView::OnExportImage(wxCommandEvent& WXUNUSED(event))
+{
+    const SurveyGrid& readings = GetDocument()->GetGrid();
+    if ( readings.IsEmpty() )
+    {
+        wxLogMessage("The survey doesn't have any readings to export.");
+        return;
+    }
+
+    wxArrayString sizes;
+    for ( size_t n = 0; n < WXSIZEOF(EXPORT_PAPER_SIZES); n++ )
+    {
+        for ( size_t i = 0; i < WXSIZEOF(EXPORT_RESOLUTIONS); i++ )
+        {
+            sizes.Add(wxString::Format("%s at %d DPI",
+                                       EXPORT_PAPER_SIZES[n].name,
+                                       EXPORT_RESOLUTIONS[i]));
+        }
+    }
+
+    const int choice = wxGetSingleChoiceIndex
+                       (
+                            "Paper size and resolution of the image:",
+                            "Export Image",
+                            sizes,
+                            GetFrame()
+                       );
+    if ( choice == -1 )
+        return;
+
+    const wxString filename = wxFileSelector
+                              (
+                                    "Export image as",
+                                    wxEmptyString,
+                                    wxEmptyString,
+                                    "png",
+                                    "PNG images (*.png)|*.png|"
+                                    "TIFF images (*.tif;*.tiff)|*.tif;*.tiff",
+                                    wxFD_SAVE | wxFD_OVERWRITE_PROMPT,
+                                    GetFrame()
+                              );
+    if ( filename.empty() )
+        return;
+
+    const wxString ext = wxFileName(filename).GetExt().Lower();
+    const SurveyImageFormat format = ext == "tif" || ext == "tiff"
+                                        ? SurveyImage_TIFF
+                                        : SurveyImage_PNG;
+
+    const PaperSize&
+        paper = EXPORT_PAPER_SIZES[choice / WXSIZEOF(EXPORT_RESOLUTIONS)];
+    const int dpi = EXPORT_RESOLUTIONS[choice % WXSIZEOF(EXPORT_RESOLUTIONS)];
+    const wxSize size = GetSurveyImageSize(readings,
+                                           paper.width, paper.height, dpi);
+
+    wxBusyCursor wait;
+
+    // the contours are not exported, only the colour map
+    wxStopWatch sw;
+    if ( !ExportSurveyImage(GetDisplayedGrid(), m_colourMap, size, dpi,
+                            format, filename, WorkerPool::Get()) )
+        return;
+
+    wxLogStatus("Exported %d*%d image in %ldms.", size.x, size.y, sw.Time());
+}
+
+// ----------------------------------------------------------------------------
+// SurveyStatsPanel implementation
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// the width of the statistics panel and the margins inside it, in pixels
+const int STATS_PANEL_WIDTH = 200;
+const int STATS_MARGIN = 8;
+
+// the height of the histogram in the statistics panel, in pixels
+const int STATS_HISTOGRAM_HEIGHT = 120;
+
+} // anonymous namespace
+
+wxBEGIN_EVENT_TABLE(SurveyStatsPanel, wxWindow)
+    EVT_PAINT(SurveyStatsPanel::OnPaint)
+wxEND_EVENT_TABLE()
+
+SurveyStatsPanel::SurveyStatsPanel(wxWindow *parent,
+                                   const SurveyColourMap& colourMap)
+    : wxWindow(parent, wxID_ANY),
+      m_colourMap(colourMap),
+      m_stats(NULL)
+{
+    SetMinSize(wxSize(STATS_PANEL_WIDTH, -1));
+    SetBackgroundColour(*wxWHITE);
+}
+
+void SurveyStatsPanel::SetStatistics(const SurveyStatistics *stats)
+{
+    m_stats = stats;
+    Refresh();
+}
+
+void SurveyStatsPanel::OnPaint(wxPaintEvent& WXUNUSED(event))
+{
+    wxPaintDC dc(this);
+
+    const int lineHeight = dc.GetCharHeight();
+    int y = STATS_MARGIN;
+
+    if ( !m_stats || !m_stats->GetCount() )
+    {
+        dc.DrawText("No readings", STATS_MARGIN, y);
+        return;
+    }
+
+    const wxString summary[] =
+    {
+        wxString::Format("Readings: %lu",
+                         static_cast<unsigned long>(m_stats->GetCount())),
+        wxString::Format("Missing: %lu",
+                         static_cast<unsigned long>(
+                            m_stats->GetMissingCount())),
+        wxString::Format("Mean: %.1f mV", m_stats->GetMean()),
+        wxString::Format("Std. deviation: %.1f mV", m_stats->GetStdDev()),
+        wxString::Format("Minimum: %.1f mV", m_stats->GetMin()),
+        wxString::Format("Maximum: %.1f mV", m_stats->GetMax()),
+    };
+
+    for ( size_t n = 0; n < WXSIZEOF(summary); n++, y += lineHeight )
+        dc.DrawText(summary[n], STATS_MARGIN, y);
+
+    y += lineHeight;
+    dc.DrawText("Corrosion probability:", STATS_MARGIN, y);
+    y += lineHeight;
+
+    // show the bands in the colours of a reading inside each of them
+    static const struct
+    {
+        SurveyRiskBand band;
+        const char *name;
+        float value;
+    } bands[] =
+    {
+        { RiskBand_Low,       "Low",       ASTM_C876_LOW_RISK + 50  },
+        { RiskBand_Uncertain, "Uncertain", (ASTM_C876_LOW_RISK +
+                                            ASTM_C876_HIGH_RISK)/2  },
+        { RiskBand_High,      "High",      ASTM_C876_HIGH_RISK - 50 },
+    };
+
+    dc.SetPen(*wxBLACK_PEN);
+    for ( size_t n = 0; n < WXSIZEOF(bands); n++, y += lineHeight )
+    {
+        unsigned char rgb[3];
+        m_colourMap.Map(&bands[n].value, 1, rgb);
+
+        dc.SetBrush(wxBrush(wxColour(rgb[0], rgb[1], rgb[2])));
+        dc.DrawRectangle(STATS_MARGIN, y + 2, lineHeight - 4, lineHeight - 4);
+
+        dc.DrawText(wxString::Format("%s: %.1f%%",
+                                     bands[n].name,
+                                     m_stats->GetBandPercentage(
+                                        bands[n].band)),
+                    STATS_MARGIN + lineHeight, y);
+    }
+
+    y += lineHeight;
+    dc.DrawText("Distribution:", STATS_MARGIN, y);
+    y += lineHeight;
+
+    const wxRect chart(STATS_MARGIN, y,
+                       GetClientSize().x - 2*STATS_MARGIN,
+                       STATS_HISTOGRAM_HEIGHT);
+    if ( chart.width > 0 )
+        DrawHistogram(dc, chart);
+
+    y += chart.height;
+
+    // label both ends of the histogram range
+    const int bins = SurveyStatistics::HISTOGRAM_BINS;
+    const wxString
+        first = wxString::Format("%d", SurveyStatistics::HISTOGRAM_MIN),
+        last = wxString::Format("%+d", SurveyStatistics::HISTOGRAM_MIN +
+                                        bins*SurveyStatistics::HISTOGRAM_STEP);
+    dc.DrawText(first, chart.x, y);
+    dc.DrawText(last, chart.GetRight() - dc.GetTextExtent(last).x, y);
+}
+
+void SurveyStatsPanel::DrawHistogram(wxDC& dc, const wxRect& rect)
+{
+    const int bins = SurveyStatistics::HISTOGRAM_BINS;
+
+    size_t maxCount = 0;
+    for ( int n = 0; n < bins; n++ )
+        maxCount = wxMax(maxCount, m_stats->GetHistogramCount(n));
+
+    // the bars use the colour of the reading in the middle of their bin
+    dc.SetPen(*wxTRANSPARENT_PEN);
+    for ( int n = 0; n < bins; n++ )
+    {
+        const size_t count = m_stats->GetHistogramCount(n);
+        if ( !count )
+            continue;
+
+        const float value = SurveyStatistics::HISTOGRAM_MIN +
+                                (n + 0.5f)*SurveyStatistics::HISTOGRAM_STEP;
+        unsigned char rgb[3];
+        m_colourMap.Map(&value, 1, rgb);
+        dc.SetBrush(wxBrush(wxColour(rgb[0], rgb[1], rgb[2])));
+
+        const int left = rect.x + n*rect.width/bins,
+                  right = rect.x + (n + 1)*rect.width/bins;
+        const int height = wxMax(1, static_cast<int>(
+                                        rect.height*count/maxCount));
+        dc.DrawRectangle(left, rect.GetBottom() + 1 - height,
+                         wxMax(1, right - left), height);
+    }
+
+    // the cumulative distribution goes from 0 to 100% of the height
+    wxPoint points[bins + 1];
+    points[0] = wxPoint(rect.x, rect.GetBottom());
+    for ( int n = 0; n < bins; n++ )
+    {
+        const double percentage = m_stats->GetCumulativePercentage(n);
+        points[n + 1] = wxPoint(rect.x + (n + 1)*rect.width/bins,
+                                rect.GetBottom() -
+                                    wxRound(percentage*(rect.height - 1)/100));
+    }
+
+    dc.SetPen(*wxBLUE_PEN);
+    dc.DrawLines(WXSIZEOF(points), points);
+
+    dc.SetPen(*wxBLACK_PEN);
+    dc.SetBrush(*wxTRANSPARENT_BRUSH);
+    dc.DrawRectangle(rect);
+}
+
+// ----------------------------------------------------------------------------
+// SurveyCanvas implementation
+// ----------------------------------------------------------------------------
+
+wxBEGIN_EVENT_TABLE(SurveyCanvas, wxScrolledWindow)
+    EVT_MOUSEWHEEL(SurveyCanvas::OnMouseWheel)
+    EVT_LEFT_DCLICK(SurveyCanvas::OnDoubleClick)
+wxEND_EVENT_TABLE()
+
+SurveyCanvas::SurveyCanvas(wxView *view, wxWindow *parent)
+    : wxScrolledWindow(parent ? parent : view->GetFrame())
+{
+    m_view = view;
+    m_scale = SURVEY_DEFAULT_SCALE;
+
+    SetScrollRate(20, 20);
+
+    SetBackgroundColour(*wxWHITE);
+}
+
+void SurveyCanvas::OnDraw(wxDC& dc)
+{
+    if ( !m_view )
+        return;
+
+    wxRect rect = GetUpdateRegion().GetBox();
+    if ( rect.IsEmpty() )
+        rect = wxRect(GetClientSize());
+    rect.SetPosition(CalcUnscrolledPosition(rect.GetPosition()));
+
+    // the clipping region must be set after changing the scale to be in the
+    // same logical coordinates the view uses
+    const int left = floor(rect.x/m_scale),
+              top = floor(rect.y/m_scale),
+              right = ceil((rect.x + rect.width)/m_scale),
+              bottom = ceil((rect.y + rect.height)/m_scale);
+
+    dc.SetUserScale(m_scale, m_scale);
+    dc.SetClippingRegion(left, top, right - left, bottom - top);
+
+    m_view->OnDraw(&dc);
+
+    dc.DestroyClippingRegion();
+    dc.SetUserScale(1, 1);
+}
+
+const SurveyGrid& SurveyCanvas::GetGrid() const
+{
+    wxDocument * const doc = m_view->GetDocument();
+
+    const ComparisonDocument * const
+        comparison = wxDynamicCast(doc, ComparisonDocument);
+    if ( comparison )
+        return comparison->GetBaseGrid();
+
+    return wxStaticCast(doc, SurveyDocument)->GetGrid();
+}
+
+void SurveyCanvas::UpdateVirtualSize()
+{
+    if ( !m_view )
+        return;
+
+    const SurveyGrid& grid = GetGrid();
+
+    const wxSize size(wxRound(grid.GetWidth()*m_scale),
+                      wxRound(grid.GetHeight()*m_scale));
+    if ( size != GetVirtualSize() )
+        SetVirtualSize(size);
+}
+
+void SurveyCanvas::SetScale(double scale, const wxPoint& fixed)
+{
+    scale = wxMax(MIN_SURVEY_SCALE, wxMin(MAX_SURVEY_SCALE, scale));
+    if ( scale == m_scale )
+        return;
+
+    const wxPoint pt = fixed == wxDefaultPosition
+                        ? wxPoint(GetClientSize().x/2, GetClientSize().y/2)
+                        : fixed;
+
+    // the position in the grid which must remain at pt
+    const wxPoint unscrolled = CalcUnscrolledPosition(pt);
+    const double x = unscrolled.x/m_scale,
+                 y = unscrolled.y/m_scale;
+
+    m_scale = scale;
+    UpdateVirtualSize();
+
+    int xUnit, yUnit;
+    GetScrollPixelsPerUnit(&xUnit, &yUnit);
+    Scroll(wxRound((x*m_scale - pt.x)/xUnit),
+           wxRound((y*m_scale - pt.y)/yUnit));
+
+    Refresh();
+}
+
+void SurveyCanvas::ZoomIn()
+{
+    SetScale(m_scale*ZOOM_FACTOR);
+}
+
+void SurveyCanvas::ZoomOut()
+{
+    SetScale(m_scale/ZOOM_FACTOR);
+}
+
+void SurveyCanvas::ZoomToFit()
+{
+    if ( !m_view )
+        return;
+
+    const SurveyGrid& grid = GetGrid();
+    if ( grid.IsEmpty() )
+        return;
+
+    const wxSize size = GetClientSize();
+    SetScale(wxMin(static_cast<double>(size.x)/grid.GetWidth(),
+                   static_cast<double>(size.y)/grid.GetHeight()));
+    UpdateVirtualSize();
+    Scroll(0, 0);
+}
+
+void SurveyCanvas::OnMouseWheel(wxMouseEvent& event)
+{
+    if ( !event.ControlDown() )
+    {
+        event.Skip();
+        return;
+    }
+
+    const double factor = event.GetWheelRotation() > 0 ? ZOOM_FACTOR
+                                                       : 1/ZOOM_FACTOR;
+    SetScale(m_scale*factor, event.GetPosition());
+}
+
+void SurveyCanvas::OnDoubleClick(wxMouseEvent& event)
+{
+    // only the readings of the surveys themselves can be edited
+    SurveyView * const view = wxDynamicCast(m_view, SurveyView);
+    if ( !view )
+        return;
+
+    const SurveyGrid& grid = GetGrid();
+
+    const wxPoint pos = CalcUnscrolledPosition(event.GetPosition());
+    const int x = floor(pos.x/m_scale),
+              y = floor(pos.y/m_scale);
+    if ( x < 0 || y < 0 ||
+            static_cast<size_t>(x) >= grid.GetWidth() ||
+                static_cast<size_t>(y) >= grid.GetHeight() )
+        return;
+
+    view->EditReading(x, y);
+}
+
+// ----------------------------------------------------------------------------
+// ComparisonView implementation
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// the changes are shown using the continuous colours centered on the middle
+// of the uncertain corrosion band, so that the decrease of the potential, i.e.
+// the increase of the corrosion risk, is shown in red and its increase, or
+// the decrease of the risk, in green
+const float CHANGE_CENTRE = (ASTM_C876_HIGH_RISK + ASTM_C876_LOW_RISK)/2;
+
+// the trends are shown as the change they would produce in this many years
+const float TREND_YEARS = 5;
+
+} // anonymous namespace
+
+IMPLEMENT_DYNAMIC_CLASS(ComparisonView, wxView)
+
+wxBEGIN_EVENT_TABLE(ComparisonView, wxView)
+    EVT_MENU(ID_COMPARISON_ADD_SURVEY, ComparisonView::OnAddSurvey)
+    EVT_MENU(ID_COMPARISON_PREVIOUS, ComparisonView::OnPreviousSurvey)
+    EVT_MENU(ID_COMPARISON_NEXT, ComparisonView::OnNextSurvey)
+    EVT_UPDATE_UI(ID_COMPARISON_PREVIOUS,
+                  ComparisonView::OnUpdatePreviousSurvey)
+    EVT_UPDATE_UI(ID_COMPARISON_NEXT, ComparisonView::OnUpdateNextSurvey)
+    EVT_MENU_RANGE(ID_COMPARISON_READINGS, ID_COMPARISON_TREND,
+                   ComparisonView::OnMode)
+    EVT_UPDATE_UI_RANGE(ID_COMPARISON_READINGS, ID_COMPARISON_TREND,
+                        ComparisonView::OnUpdateMode)
+    EVT_MENU(wxID_ZOOM_IN, ComparisonView::OnZoomIn)
+    EVT_MENU(wxID_ZOOM_OUT, ComparisonView::OnZoomOut)
+    EVT_MENU(wxID_ZOOM_100, ComparisonView::OnZoomNormal)
+    EVT_MENU(wxID_ZOOM_FIT, ComparisonView::OnZoomFit)
+wxEND_EVENT_TABLE()
+
+bool ComparisonView::OnCreate(wxDocument *doc, long flags)
+{
+    if ( !wxView::OnCreate(doc, flags) )
+        return false;
+
+    wxFrame* frame = wxGetApp().CreateChildFrame(this,
+                                                  MyApp::ChildFrame_Comparison);
+    wxASSERT(frame == GetFrame());
+    m_canvas = new SurveyCanvas(this);
+    frame->Show();
+
+    return true;
+}
+
+void ComparisonView::OnDraw(wxDC *dc)
+{
+    ComparisonDocument * const doc = GetDocument();
+    const SurveyGrid& base = doc->GetBaseGrid();
+    if ( base.IsEmpty() || m_survey >= doc->GetSurveyCount() )
+        return;
+
+    wxRect cells, area;
+    if ( !MapSurveyPixels(dc, base, base, cells, area, m_columns, m_rows) )
+        return;
+
+    const SurveyColourMap& colourMap = m_mode == Comparison_Readings
+                                        ? m_readingColours
+                                        : m_changeColours;
+    const float offset = m_mode == Comparison_Readings ? 0 : CHANGE_CENTRE;
+    const float scale = m_mode == Comparison_Trend ? TREND_YEARS : 1;
+
+    static const size_t TILE_SIZE = ComparisonDocument::TILE_SIZE;
+
+    double scaleX, scaleY;
+    dc->GetUserScale(&scaleX, &scaleY);
+    dc->SetUserScale(1, 1);
+
+    m_values.resize(area.width);
+
+    const size_t stride = 3*area.width;
+    wxImage image;
+    for ( int top = 0; top < area.height; top += SURVEY_STRIP_HEIGHT )
+    {
+        const int rows = wxMin(SURVEY_STRIP_HEIGHT, area.height - top);
+        if ( !image.IsOk() || image.GetHeight() != rows )
+            image.Create(area.width, rows, false /* don't clear */);
+
+        unsigned char *rgb = image.GetData();
+        for ( int y = 0; y < rows; y++, rgb += stride )
+        {
+            const size_t row = m_rows[top + y];
+            if ( y > 0 && row == m_rows[top + y - 1] )
+            {
+                memcpy(rgb, rgb - stride, stride);
+                continue;
+            }
+
+            // only get the tile from the document when the pixels cross into
+            // the next one, the pointer remains valid until then
+            const float *tile = NULL;
+            size_t tileX = static_cast<size_t>(-1);
+            for ( int x = 0; x < area.width; x++ )
+            {
+                const size_t column = m_columns[x];
+                if ( column/TILE_SIZE != tileX )
+                {
+                    tileX = column/TILE_SIZE;
+                    tile = doc->GetTile(m_mode, m_survey,
+                                        tileX, row/TILE_SIZE) +
+                                (row % TILE_SIZE)*TILE_SIZE;
+                }
+
+                m_values[x] = offset + scale*tile[column % TILE_SIZE];
+            }
+
+            colourMap.Map(&m_values[0], area.width, rgb);
+        }
+
+        dc->DrawBitmap(wxBitmap(image),
+                       dc->DeviceToLogicalX(area.x),
+                       dc->DeviceToLogicalY(area.y + top));
+    }
+
+    dc->SetUserScale(scaleX, scaleY);
+}
+
+void ComparisonView::OnUpdate(wxView* sender, wxObject* hint)
+{
+    wxView::OnUpdate(sender, hint);
+    if ( !m_canvas )
+        return;
+
+    ComparisonDocument * const doc = GetDocument();
+    const SurveyGrid& base = doc->GetBaseGrid();
+
+    // start by showing the changes in the latest survey
+    const wxSize size(base.GetWidth(), base.GetHeight());
+    if ( size != m_baseSize )
+    {
+        m_baseSize = size;
+        m_survey = doc->GetSurveyCount() ? doc->GetSurveyCount() - 1 : 0;
+        m_canvas->ZoomToFit();
+    }
+
+    if ( m_survey >= doc->GetSurveyCount() )
+        m_survey = doc->GetSurveyCount() ? doc->GetSurveyCount() - 1 : 0;
+
+    m_canvas->UpdateVirtualSize();
+    ShowSurvey(m_survey);
+}
+
+bool ComparisonView::OnClose(bool deleteWindow)
+{
+    if ( !wxView::OnClose(deleteWindow) )
+        return false;
+
+    Activate(false);
+
+    if ( deleteWindow )
+    {
+        GetFrame()->Destroy();
+        SetFrame(NULL);
+    }
+    return true;
+}
+
+ComparisonDocument* ComparisonView::GetDocument()
+{
+    return wxStaticCast(wxView::GetDocument(), ComparisonDocument);
+}
+
+void ComparisonView::ShowSurvey(size_t n)
+{
+    m_survey = n;
+    m_canvas->Refresh();
+
+    const ComparisonDocument * const doc = GetDocument();
+    const unsigned long count = doc->GetSurveyCount();
+    if ( !count )
+    {
+        wxLogStatus("No surveys to compare.");
+    }
+    else if ( m_mode == Comparison_Trend )
+    {
+        wxLogStatus("Trend of %lu surveys from %s to %s.",
+                    count,
+                    doc->GetSurveyDate(0).FormatISODate(),
+                    doc->GetSurveyDate(count - 1).FormatISODate());
+    }
+    else
+    {
+        wxLogStatus("Survey %lu of %lu, taken on %s.",
+                    static_cast<unsigned long>(m_survey + 1),
+                    count,
+                    doc->GetSurveyDate(m_survey).FormatISODate());
+    }
+}
+
+void ComparisonView::OnAddSurvey(wxCommandEvent& WXUNUSED(event))
+{
+    const wxString filename = wxFileSelector
+                              (
+                                    "Add survey",
+                                    wxEmptyString,
+                                    wxEmptyString,
+                                    "csv",
+                                    "Survey files (*.csv)|*.csv",
+                                    wxFD_OPEN | wxFD_FILE_MUST_EXIST,
+                                    GetFrame()
+                              );
+    if ( filename.empty() )
+        return;
+
+    // the file is usually exported on the day of the survey
+    wxTextEntryDialog dlg(GetFrame(),
+                          "Date of the survey (YYYY-MM-DD):",
+                          "Add Survey",
+                          wxFileName(filename).GetModificationTime()
+                                              .FormatISODate());
+    if ( dlg.ShowModal() != wxID_OK )
+        return;
+
+    wxString text = dlg.GetValue();
+    text.Trim().Trim(false);
+
+    wxDateTime date;
+    if ( !date.ParseISODate(text) )
+    {
+        wxLogError("\"%s\" is not a valid date.", text);
+        return;
+    }
+
+    GetDocument()->AddSurvey(filename, date);
+}
+
+void ComparisonView::OnPreviousSurvey(wxCommandEvent& WXUNUSED(event))
+{
+    if ( m_survey > 0 )
+        ShowSurvey(m_survey - 1);
+}
+
+void ComparisonView::OnNextSurvey(wxCommandEvent& WXUNUSED(event))
+{
+    if ( m_survey + 1 < GetDocument()->GetSurveyCount() )
+        ShowSurvey(m_survey + 1);
+}
+
+void ComparisonView::OnUpdatePreviousSurvey(wxUpdateUIEvent& event)
+{
+    event.Enable(m_mode != Comparison_Trend && m_survey > 0);
+}
+
+void ComparisonView::OnUpdateNextSurvey(wxUpdateUIEvent& event)
+{
+    event.Enable(m_mode != Comparison_Trend &&
+                    m_survey + 1 < GetDocument()->GetSurveyCount());
+}
+
+void ComparisonView::OnMode(wxCommandEvent& event)
+{
+    // the order of the menu items matches that of the enum elements
+    m_mode = static_cast<ComparisonMode>(event.GetId() -
+                                            ID_COMPARISON_READINGS);
+    ShowSurvey(m_survey);
+}
+
+void ComparisonView::OnUpdateMode(wxUpdateUIEvent& event)
+{
+    event.Check(event.GetId() - ID_COMPARISON_READINGS == m_mode);
+}
+
+void ComparisonView::OnZoomIn(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->ZoomIn();
+}
+
+void ComparisonView::OnZoomOut(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->ZoomOut();
+}
+
+void ComparisonView::OnZoomNormal(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->SetScale(SURVEY_DEFAULT_SCALE);
+}
+
+void ComparisonView::OnZoomFit(wxCommandEvent& WXUNUSED(event))
+{
+    m_canvas->ZoomToFit();
+}
+
+// ----------------------------------------------------------------------------
+// LogView implementation
+// ----------------------------------------------------------------------------
+
+IMPLEMENT_DYNAMIC_CLASS(LogView, wxView)
+
+wxBEGIN_EVENT_TABLE(LogView, wxView)
+    EVT_MENU(ID_LOG_GO_TO_LINE, LogView::OnGoToLine)
+wxEND_EVENT_TABLE()
+
+bool LogView::OnCreate(wxDocument *doc, long flags)
+{
+    if ( !wxView::OnCreate(doc, flags) )
+        return false;
+
+    wxFrame* frame = wxGetApp().CreateChildFrame(this, MyApp::ChildFrame_Log);
+    wxASSERT(frame == GetFrame());
+    m_canvas = new LogCanvas(this);
+    frame->Show();
+
+    return true;
+}
+
+void LogView::OnDraw(wxDC *WXUNUSED(dc))
+{
+    // nothing to do here, LogCanvas draws the lines itself
+}
+
+void LogView::OnUpdate(wxView* sender, wxObject* hint)
+{
+    wxView::OnUpdate(sender, hint);
+    if ( !m_canvas )
+        return;
+
+    m_canvas->UpdateLineCount();
+}
+
+bool LogView::OnClose(bool deleteWindow)
+{
+    if ( !wxView::OnClose(deleteWindow) )
+        return false;
+
+    Activate(false);
+
+    if ( deleteWindow )
+    {
+        GetFrame()->Destroy();
+        SetFrame(NULL);
+    }
+    return true;
+}
+
+LogDocument* LogView::GetDocument()
+{
+    return wxStaticCast(wxView::GetDocument(), LogDocument);
+}
+
+void LogView::OnGoToLine(wxCommandEvent& WXUNUSED(event))
+{
+    const LogDocument * const doc = GetDocument();
+    const unsigned long count = doc->GetLineCount();
+
+    wxTextEntryDialog dlg(GetFrame(),
+                          wxString::Format("Line number (1 to %lu%s):",
+                                           count,
+                                           doc->IsIndexing() ? " so far"
+                                                             : ""),
+                          "Go to Line");
+    if ( dlg.ShowModal() != wxID_OK )
+        return;
+
+    wxString text = dlg.GetValue();
+    text.Trim().Trim(false);
+
+    unsigned long line;
+    if ( !text.ToULong(&line) || !line || line > count )
+    {
+        wxLogError("\"%s\" is not a valid line number.", text);
+        return;
+    }
+
+    m_canvas->GoToLine(line - 1);
+}
+
+// ----------------------------------------------------------------------------
+// LogCanvas implementation
+// ----------------------------------------------------------------------------
+
+namespace
+{
+
+// the longer lines are truncated when they're shown
+const size_t MAX_LOG_LINE_LENGTH = 4096;
+
+// the TABs are expanded to the next multiple of this number of columns
+const size_t LOG_TAB_WIDTH = 8;
+
+// replace the TABs in the line with spaces
+wxString ExpandTabs(const wxString& line)
+{
+    if ( line.find('\t') == wxString::npos )
+        return line;
+
+    wxString expanded;
+    for ( wxString::const_iterator i = line.begin(); i != line.end(); ++i )
+    {
+        if ( *i == '\t' )
+            expanded.append(LOG_TAB_WIDTH - expanded.length() % LOG_TAB_WIDTH,
+                            ' ');
+        else
+            expanded += *i;
+    }
+
+    return expanded;
+}
+
+} // anonymous namespace
+
+wxBEGIN_EVENT_TABLE(LogCanvas, wxHVScrolledWindow)
+    EVT_PAINT(LogCanvas::OnPaint)
+wxEND_EVENT_TABLE()
+
+LogCanvas::LogCanvas(wxView *view, wxWindow *parent)
+    : wxHVScrolledWindow(parent ? parent : view->GetFrame())
+{
+    m_view = view;
+    m_maxLength = 0;
+
+    SetFont(wxFont(10, wxFONTFAMILY_TELETYPE,
+                   wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL));
+    m_charSize = wxSize(GetCharWidth(), GetCharHeight());
+
+    SetBackgroundStyle(wxBG_STYLE_PAINT);
+    SetBackgroundColour(*wxWHITE);
+
+    UpdateLineCount();
+}
+
+LogDocument *LogCanvas::GetDocument() const
+{
+    return wxStaticCast(m_view->GetDocument(), LogDocument);
+}
+
+void LogCanvas::UpdateLineCount()
+{
+    const size_t count = GetDocument()->GetLineCount();
+    if ( count == GetRowCount() )
+        return;
+
+    // the lines are only ever added, so only the new ones need repainting
+    const size_t old = GetRowCount();
+    SetRowCount(count);
+
+    if ( old < GetVisibleRowsEnd() )
+        RefreshRows(old, GetVisibleRowsEnd());
+}
+
+void LogCanvas::UpdateColumnCount()
+{
+    if ( m_maxLength > GetColumnCount() )
+        SetColumnCount(m_maxLength);
+}
+
+void LogCanvas::GoToLine(size_t line)
+{
+    ScrollToRow(line);
+}
+
+void LogCanvas::OnPaint(wxPaintEvent& WXUNUSED(event))
+{
+    wxAutoBufferedPaintDC dc(this);
+    dc.SetBackground(GetBackgroundColour());
+    dc.Clear();
+
+    if ( !m_view )
+        return;
+
+    const LogDocument * const doc = GetDocument();
+
+    // the window isn't scrolled in pixels, so the first visible row and
+    // column are always drawn at the origin
+    const size_t firstRow = GetVisibleRowsBegin(),
+                 firstColumn = GetVisibleColumnsBegin();
+
+    // only get the lines which need to be repainted from the document
+    const wxRect rect = GetUpdateRegion().GetBox();
+    const size_t from = firstRow + rect.y/m_charSize.y,
+                 to = wxMin(firstRow + (rect.GetBottom() + 1)/m_charSize.y + 1,
+                            doc->GetLineCount());
+
+    dc.SetFont(GetFont());
+    dc.SetTextForeground(*wxBLACK);
+
+    const size_t maxColumns = GetClientSize().x/m_charSize.x + 1;
+    for ( size_t row = from; row < to; row++ )
+    {
+        const wxString
+            line = ExpandTabs(doc->GetLine(row, MAX_LOG_LINE_LENGTH));
+        if ( line.length() > m_maxLength )
+            m_maxLength = line.length();
+
+        if ( line.length() <= firstColumn )
+            continue;
+
+        dc.DrawText(line.substr(firstColumn, maxColumns),
+                    0, (row - firstRow)*m_charSize.y);
+    }
+
+    // the scrollbars can't be changed while repainting the window
+    if ( m_maxLength > GetColumnCount() )
+        CallAfter(&LogCanvas::UpdateColumnCount);
 }
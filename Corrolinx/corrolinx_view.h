@@ -11,6 +11,13 @@
 #define _CORROLINX_CORROLINX_VIEW_H_
 
 #include "wx/docview.h"
+#include "wx/vscroll.h"
+#include "wx/timer.h"
+
+#include "corrolinx_colormap.h"
+#include "corrolinx_compare.h"
+#include "corrolinx_contour.h"
+#include "corrolinx_interp.h"
 
 // ----------------------------------------------------------------------------
 // Drawing view classes
@@ -27,11 +34,50 @@ public:
 
     virtual void OnDraw(wxDC& dc);
 
+    // refresh the part of the window showing the given rectangle in logical
+    // coordinates
+    void RefreshLogicalRect(const wxRect& rect);
+
+    // refresh the entire drawing
+    void RefreshDrawing();
+
+    // the backing bitmap is used by default when it fits in memory, but can
+    // be disabled, e.g. to compare the drawing speed without it
+    void UseBacking(bool use);
+    bool IsUsingBacking() const { return m_useBacking; }
+
+    // forget the stroke being drawn without adding it to the document
+    void CancelStroke();
+
+    // the number of device pixels per logical unit
+    double GetScale() const { return m_scale; }
+
+    // change the scale keeping the given point, in client coordinates, at the
+    // same place or keeping the center of the window if it's not specified
+    void SetScale(double scale, const wxPoint& fixed = wxDefaultPosition);
+
+    void ZoomIn();
+    void ZoomOut();
+    void ZoomToFit();
+
+    // update the virtual size to show the entire document at current scale
+    void UpdateVirtualSize();
+
+    // the segments are selected with Ctrl+click, adding to the selection if
+    // Shift is pressed too, and the selected ones are moved with Ctrl+drag
+    bool HasSelection() const { return !m_selection.empty(); }
+    void ClearSelection();
+
+    // delete the selected segments using an undoable command
+    void DeleteSelection();
+
     // in a normal multiple document application a canvas is associated with
     // one view from the beginning until the end, but to support the single
     // document mode in which all documents reuse the same MyApp::GetCanvas()
     // we need to allow switching the canvas from one view to another one
 
+    wxView *GetView() const { return m_view; }
+
     void SetView(wxView *view)
     {
         wxASSERT_MSG( !m_view, "shouldn't be already associated with a view" );
@@ -44,19 +90,106 @@ public:
         wxASSERT_MSG( m_view, "should be associated with a view" );
 
         m_view = NULL;
+
+        // the ids of the selected segments only make sense for its document
+        m_selection.clear();
     }
 
 private:
     void OnMouseEvent(wxMouseEvent& event);
+    void OnChar(wxKeyEvent& event);
+
+    // convert between logical and unscrolled device coordinates, rounding
+    // outwards so that the result always covers the entire input rectangle
+    wxRect LogicalToDevice(const wxRect& rect) const;
+    wxRect DeviceToLogical(const wxRect& rect) const;
+
+    // convert the mouse position in client coordinates to the logical ones
+    wxPoint MouseToLogical(const wxPoint& pt) const;
+
+    // add a line to the stroke being drawn and invalidate the window area
+    // covered by it, the line is only drawn when the window is repainted
+    void AddStrokeLine(const wxPoint& pt1, const wxPoint& pt2);
+
+    // draw the lines of the stroke in the given range on a DC with the
+    // origin at the unscrolled device origin
+    void DrawStroke(wxDC& dc, size_t from, size_t to);
+
+    // add the stroke being drawn to the document, if it's not empty, and
+    // start a new one
+    void EndStroke();
+
+    // scroll by the given amount of pixels, returning the amount by which the
+    // window was actually scrolled
+    wxPoint ScrollByPixels(const wxPoint& delta);
+
+    DrawingDocument *GetDrawingDocument() const
+        { return wxStaticCast(m_view->GetDocument(), DrawingDocument); }
+
+    // select the segment at the given logical position, or toggle its
+    // selection, or clear the selection if there is none
+    void SelectAt(const wxPoint& pt, bool toggle);
+
+    // forget the selected segments which don't exist any more, e.g. because
+    // deleting them was undone
+    void PruneSelection();
+
+    // invalidate the area covered by the selection, at its current offset
+    // while it's being moved, without rendering the backing bitmap again
+    void RefreshSelection();
+
+    // draw the selected segments over the drawing on a DC with the origin at
+    // the unscrolled device origin
+    void DrawSelection(wxDC& dc);
+
+    // return true if the backing bitmap can be used for the current virtual
+    // size and bring it up to date if it can
+    bool UpdateBacking();
+
+    // let the view draw the given rectangle, in unscrolled device coordinates,
+    // of the document on the DC at the current scale
+    void DrawScaled(wxDC& dc, const wxRect& rect);
 
     wxView *m_view;
 
-    // the segment being currently drawn or NULL if none
-    DoodleSegment *m_currentSegment;
+    // the current scale of the drawing
+    double m_scale;
+
+    // the last mouse position while panning with the middle button
+    wxPoint m_panPos;
+
+    // the rendered document contents covering the entire virtual area, so
+    // that exposed or scrolled parts of the window can simply be copied
+    wxBitmap m_backing;
 
-    // the last mouse press position
+    // the parts of m_backing which need to be rendered again, in unscrolled
+    // device coordinates
+    wxRegion m_backingDirty;
+
+    // false if m_backing shouldn't be used even if it could be
+    bool m_useBacking;
+
+    // the lines of the stroke being currently drawn: the buffer is allocated
+    // once and only grows, its first m_strokeLength elements are used
+    DoodleLines m_stroke;
+    size_t m_strokeLength;
+
+    // the number of lines of the stroke already drawn on m_backing
+    size_t m_strokeDrawn;
+
+    // the last mouse position in logical coordinates while drawing or
+    // wxDefaultPosition
     wxPoint m_lastMousePos;
 
+    // the ids of the selected segments
+    DoodleSegmentIds m_selection;
+
+    // the logical position at which moving the selection started, or
+    // wxDefaultPosition if it's not being moved, and the offset by which it
+    // was moved since then
+    wxPoint m_moveStart;
+    wxPoint m_moveOffset;
+
     wxDECLARE_EVENT_TABLE();
 };
 
@@ -64,24 +197,295 @@ private:
 class DrawingView : public wxView
 {
 public:
-    DrawingView() : wxView(), m_canvas(NULL) {}
+    DrawingView() : wxView(), m_canvas(NULL), m_closing(false) {}
 
     virtual bool OnCreate(wxDocument *doc, long flags);
     virtual void OnDraw(wxDC *dc);
     virtual void OnUpdate(wxView *sender, wxObject *hint = NULL);
     virtual bool OnClose(bool deleteWindow = true);
 
+    // compact the document when another one is used or when this view stays
+    // inactive for some time
+    virtual void OnActivateView(bool activate,
+                                wxView *activeView,
+                                wxView *deactiveView);
+
     DrawingDocument* GetDocument();
 
+    MyCanvas *GetCanvas() const { return m_canvas; }
+
 private:
+    // draw the lines with the given indices, or all of them if indices is
+    // NULL, joining the connected ones into polylines, the lines of the
+    // deleted segments must not be passed to it
+    void DrawPolylines(wxDC *dc,
+                       const DoodleLines& lines,
+                       const DoodleLineIndices *indices);
+
+    // draw the segments containing the lines with the given indices, or all
+    // of them if indices is NULL, simplified at the given level
+    void DrawSimplified(wxDC *dc,
+                        int level,
+                        const DoodleLineIndices *indices);
+
+    // draw the segments of a compacted document
+    void DrawPacked(wxDC *dc, const DoodlePackedSegments& segments);
+
+    // compact the document if it's big enough
+    void CompactDocument();
+
+    void OnCompactTimer(wxTimerEvent& event);
+
     void OnCut(wxCommandEvent& event);
+    void OnDelete(wxCommandEvent& event);
+    void OnUpdateDelete(wxUpdateUIEvent& event);
+    void OnConvert(wxCommandEvent& event);
+    void OnCancelLoad(wxCommandEvent& event);
+    void OnUpdateCancelLoad(wxUpdateUIEvent& event);
+    void OnUpdateNotLoading(wxUpdateUIEvent& event);
+    void OnZoomIn(wxCommandEvent& event);
+    void OnZoomOut(wxCommandEvent& event);
+    void OnZoomNormal(wxCommandEvent& event);
+    void OnZoomFit(wxCommandEvent& event);
 
     MyCanvas *m_canvas;
 
+    // started when the view is deactivated to compact the document later
+    wxTimer m_compactTimer;
+
+    // set once the view is being closed, when it mustn't compact the document
+    bool m_closing;
+
+    // the lines to redraw, only used by OnDraw() but kept here to avoid
+    // reallocating it on every repaint
+    DoodleLineIndices m_visibleLines;
+
+    // the buffer for the points of the polyline being drawn in OnDraw()
+    wxVector<wxPoint> m_points;
+
     wxDECLARE_EVENT_TABLE();
     wxDECLARE_DYNAMIC_CLASS(DrawingView);
 };
 
+// ----------------------------------------------------------------------------
+// Survey view classes
+// ----------------------------------------------------------------------------
+
+// The window showing the map of the survey readings, or of their changes for
+// the comparisons of several surveys
+class SurveyCanvas : public wxScrolledWindow
+{
+public:
+    SurveyCanvas(wxView *view, wxWindow *parent = NULL);
+
+    virtual void OnDraw(wxDC& dc);
+
+    // the size of a single reading in pixels
+    double GetScale() const { return m_scale; }
+
+    // change the scale keeping the given point, in client coordinates, at the
+    // same place or keeping the center of the window if it's not specified
+    void SetScale(double scale, const wxPoint& fixed = wxDefaultPosition);
+
+    void ZoomIn();
+    void ZoomOut();
+    void ZoomToFit();
+
+    // update the virtual size to show the entire grid at current scale
+    void UpdateVirtualSize();
+
+private:
+    // the grid of the readings defining the cells shown
+    const SurveyGrid& GetGrid() const;
+
+    void OnMouseWheel(wxMouseEvent& event);
+    void OnDoubleClick(wxMouseEvent& event);
+
+    wxView *m_view;
+
+    double m_scale;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+// The panel shown next to SurveyCanvas with the statistics of the readings
+class SurveyStatsPanel : public wxWindow
+{
+public:
+    // the colour map is used for the histogram and must outlive the panel
+    SurveyStatsPanel(wxWindow *parent, const SurveyColourMap& colourMap);
+
+    // set the statistics to show, the panel refers to them and doesn't copy
+    // them, so they must remain valid while it's shown
+    void SetStatistics(const SurveyStatistics *stats);
+
+private:
+    void OnPaint(wxPaintEvent& event);
+
+    // draw the histogram with the cumulative distribution over it
+    void DrawHistogram(wxDC& dc, const wxRect& rect);
+
+    const SurveyColourMap& m_colourMap;
+    const SurveyStatistics *m_stats;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+// The view showing the survey readings as a colour map, each reading is one
+// logical unit in its OnDraw()
+class SurveyView : public wxView
+{
+public:
+    SurveyView()
+        : wxView(),
+          m_canvas(NULL),
+          m_statsPanel(NULL),
+          m_interpolation(Interpolation_None),
+          m_showContours(false)
+    {
+    }
+
+    virtual bool OnCreate(wxDocument *doc, long flags);
+    virtual void OnDraw(wxDC *dc);
+    virtual void OnUpdate(wxView *sender, wxObject *hint = NULL);
+    virtual bool OnClose(bool deleteWindow = true);
+
+    SurveyDocument* GetDocument();
+
+    // ask the user for the new value of the given reading and change it
+    void EditReading(int x, int y);
+
+    // get the grid shown in the window, which is either the readings
+    // themselves or the interpolated ones
+    const SurveyGrid& GetDisplayedGrid();
+
+    const SurveyColourMap& GetColourMap() const { return m_colourMap; }
+    SurveyInterpolation GetInterpolation() const { return m_interpolation; }
+
+private:
+    // recompute m_interpolated after the readings or the method changed
+    void UpdateInterpolated();
+
+    // compute m_contours if they're not computed yet
+    void ComputeContours();
+
+    // draw the contours intersecting the given rectangle of the grid
+    void DrawContours(wxDC *dc, const wxRect& cells);
+
+    void OnZoomIn(wxCommandEvent& event);
+    void OnZoomOut(wxCommandEvent& event);
+    void OnZoomNormal(wxCommandEvent& event);
+    void OnZoomFit(wxCommandEvent& event);
+    void OnColourScheme(wxCommandEvent& event);
+    void OnUpdateColourScheme(wxUpdateUIEvent& event);
+    void OnInterpolation(wxCommandEvent& event);
+    void OnUpdateInterpolation(wxUpdateUIEvent& event);
+    void OnShowContours(wxCommandEvent& event);
+    void OnUpdateShowContours(wxUpdateUIEvent& event);
+    void OnExportContours(wxCommandEvent& event);
+    void OnExportImage(wxCommandEvent& event);
+
+    SurveyCanvas *m_canvas;
+    SurveyStatsPanel *m_statsPanel;
+
+    SurveyColourMap m_colourMap;
+
+    SurveyInterpolation m_interpolation;
+
+    // the readings interpolated using m_interpolation, empty if none
+    SurveyGrid m_interpolated;
+
+    // the contours of the readings, only computed when needed
+    SurveyContours m_contours;
+    bool m_showContours;
+
+    // the grid cell shown by each pixel of the area being drawn in OnDraw()
+    // and the readings of the current row of pixels, kept here to avoid
+    // reallocating them on every repaint
+    wxVector<size_t> m_columns;
+    wxVector<size_t> m_rows;
+    wxVector<float> m_values;
+
+    // the points of the contour being drawn
+    wxVector<wxPoint> m_points;
+
+    wxDECLARE_EVENT_TABLE();
+    wxDECLARE_DYNAMIC_CLASS(SurveyView);
+};
+
+// ----------------------------------------------------------------------------
+// Comparison view classes
+// ----------------------------------------------------------------------------
+
+// The view showing one of the surveys of a ComparisonDocument or a comparison
+// of them using SurveyCanvas, each cell of the first survey is one logical
+// unit in its OnDraw()
+class ComparisonView : public wxView
+{
+public:
+    ComparisonView()
+        : wxView(),
+          m_canvas(NULL),
+          m_mode(Comparison_SinceFirst),
+          m_survey(0),
+          m_readingColours(SurveyColours_Bands),
+          m_changeColours(SurveyColours_Continuous)
+    {
+    }
+
+    virtual bool OnCreate(wxDocument *doc, long flags);
+    virtual void OnDraw(wxDC *dc);
+    virtual void OnUpdate(wxView *sender, wxObject *hint = NULL);
+    virtual bool OnClose(bool deleteWindow = true);
+
+    ComparisonDocument* GetDocument();
+
+    SurveyCanvas *GetCanvas() const { return m_canvas; }
+    ComparisonMode GetMode() const { return m_mode; }
+
+    // the index of the survey shown and showing another one with its date
+    // in the status bar
+    size_t GetSurvey() const { return m_survey; }
+    void ShowSurvey(size_t n);
+
+private:
+    void OnAddSurvey(wxCommandEvent& event);
+    void OnPreviousSurvey(wxCommandEvent& event);
+    void OnNextSurvey(wxCommandEvent& event);
+    void OnUpdatePreviousSurvey(wxUpdateUIEvent& event);
+    void OnUpdateNextSurvey(wxUpdateUIEvent& event);
+    void OnMode(wxCommandEvent& event);
+    void OnUpdateMode(wxUpdateUIEvent& event);
+    void OnZoomIn(wxCommandEvent& event);
+    void OnZoomOut(wxCommandEvent& event);
+    void OnZoomNormal(wxCommandEvent& event);
+    void OnZoomFit(wxCommandEvent& event);
+
+    SurveyCanvas *m_canvas;
+
+    ComparisonMode m_mode;
+
+    // the index of the survey shown, not used for Comparison_Trend
+    size_t m_survey;
+
+    // the size of the first survey when it was last shown, used to zoom the
+    // canvas to fit it when it changes
+    wxSize m_baseSize;
+
+    // the readings are shown using the corrosion bands and the changes using
+    // the continuous colours, see OnDraw()
+    SurveyColourMap m_readingColours;
+    SurveyColourMap m_changeColours;
+
+    // the same as in SurveyView
+    wxVector<size_t> m_columns;
+    wxVector<size_t> m_rows;
+    wxVector<float> m_values;
+
+    wxDECLARE_EVENT_TABLE();
+    wxDECLARE_DYNAMIC_CLASS(ComparisonView);
+};
+
 // ----------------------------------------------------------------------------
 // Text view classes
 // ----------------------------------------------------------------------------
@@ -108,4 +512,71 @@ private:
     wxDECLARE_EVENT_TABLE();
     wxDECLARE_DYNAMIC_CLASS(TextEditView);
 };
+
+// ----------------------------------------------------------------------------
+// Log view classes
+// ----------------------------------------------------------------------------
+
+class LogDocument;
+
+// The window showing the lines of a LogDocument: only the visible ones are
+// ever read from it, so its cost doesn't depend on the size of the log
+class LogCanvas : public wxHVScrolledWindow
+{
+public:
+    LogCanvas(wxView *view, wxWindow *parent = NULL);
+
+    // update the number of rows after the number of lines changed
+    void UpdateLineCount();
+
+    // scroll to show the given line at the top of the window
+    void GoToLine(size_t line);
+
+protected:
+    virtual wxCoord OnGetRowHeight(size_t WXUNUSED(row)) const
+        { return m_charSize.y; }
+    virtual wxCoord OnGetColumnWidth(size_t WXUNUSED(column)) const
+        { return m_charSize.x; }
+
+private:
+    LogDocument *GetDocument() const;
+
+    void OnPaint(wxPaintEvent& event);
+
+    // update the number of columns to fit the longest line shown so far
+    void UpdateColumnCount();
+
+    wxView *m_view;
+
+    // the size of a character of the fixed width font used
+    wxSize m_charSize;
+
+    // the length of the longest line shown so far, in characters
+    size_t m_maxLength;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+// The read-only view of a big text file
+class LogView : public wxView
+{
+public:
+    LogView() : wxView(), m_canvas(NULL) {}
+
+    virtual bool OnCreate(wxDocument *doc, long flags);
+    virtual void OnDraw(wxDC *dc);
+    virtual void OnUpdate(wxView *sender, wxObject *hint = NULL);
+    virtual bool OnClose(bool deleteWindow = true);
+
+    LogDocument* GetDocument();
+
+private:
+    void OnGoToLine(wxCommandEvent& event);
+
+    LogCanvas *m_canvas;
+
+    wxDECLARE_EVENT_TABLE();
+    wxDECLARE_DYNAMIC_CLASS(LogView);
+};
+
 #endif // _CORROLINX_CORROLINX_VIEW_H_
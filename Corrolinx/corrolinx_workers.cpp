@@ -0,0 +1,204 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_workers.cpp
+// Purpose:     Implements the pool of worker threads
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include "wx/wxprec.h"
+
+#ifdef __BORLANDC__
+    #pragma hdrstop
+#endif
+
+#ifndef WX_PRECOMP
+    #include "wx/wx.h"
+#endif
+
+#include "corrolinx_workers.h"
+
+// ----------------------------------------------------------------------------
+// WorkerPool::Thread
+// ----------------------------------------------------------------------------
+
+class WorkerPool::Thread : public wxThread
+{
+public:
+    explicit Thread(WorkerPool& pool)
+        : wxThread(wxTHREAD_JOINABLE),
+          m_pool(pool)
+    {
+    }
+
+protected:
+    virtual ExitCode Entry()
+    {
+        m_pool.ThreadLoop();
+
+        return 0;
+    }
+
+private:
+    WorkerPool& m_pool;
+
+    wxDECLARE_NO_COPY_CLASS(Thread);
+};
+
+// ----------------------------------------------------------------------------
+// WorkerPool implementation
+// ----------------------------------------------------------------------------
+
+WorkerPool *WorkerPool::ms_pool = NULL;
+
+WorkerPool::WorkerPool(int threads)
+    : m_itemsAvailable(m_mutex),
+      m_taskDone(m_mutex)
+{
+    m_task = NULL;
+    m_count =
+    m_next =
+    m_remaining = 0;
+    m_stopping = false;
+
+    if ( threads == -1 )
+        threads = wxThread::GetCPUCount() - 1;
+
+    for ( int n = 0; n < threads; n++ )
+    {
+        Thread * const thread = new Thread(*this);
+        if ( thread->Run() != wxTHREAD_NO_ERROR )
+        {
+            // we can still work with fewer threads
+            wxLogDebug("Failed to start a worker thread.");
+            delete thread;
+            break;
+        }
+
+        m_threads.push_back(thread);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        wxMutexLocker lock(m_mutex);
+
+        m_stopping = true;
+        m_itemsAvailable.Broadcast();
+    }
+
+    for ( size_t n = 0; n < m_threads.size(); n++ )
+    {
+        m_threads[n]->Wait();
+        delete m_threads[n];
+    }
+}
+
+/* static */
+WorkerPool& WorkerPool::Get()
+{
+    if ( !ms_pool )
+        ms_pool = new WorkerPool;
+
+    return *ms_pool;
+}
+
+/* static */
+void WorkerPool::Cleanup()
+{
+    wxDELETE(ms_pool);
+}
+
+void WorkerPool::Run(ParallelTask& task, size_t count)
+{
+    if ( !count )
+        return;
+
+    bool useThreads = false;
+    if ( !m_threads.empty() )
+    {
+        wxMutexLocker lock(m_mutex);
+
+        if ( !m_task )
+        {
+            m_task = &task;
+            m_count =
+            m_remaining = count;
+            m_next = 0;
+
+            m_itemsAvailable.Broadcast();
+
+            useThreads = true;
+        }
+    }
+
+    if ( !useThreads )
+    {
+        for ( size_t n = 0; n < count; n++ )
+            task.Process(n);
+
+        return;
+    }
+
+    // help the worker threads instead of just waiting for them
+    size_t n;
+    while ( TakeNextItem(n) )
+    {
+        task.Process(n);
+        OnItemDone();
+    }
+
+    wxMutexLocker lock(m_mutex);
+
+    while ( m_remaining )
+        m_taskDone.Wait();
+
+    m_task = NULL;
+}
+
+bool WorkerPool::TakeNextItem(size_t& n)
+{
+    wxMutexLocker lock(m_mutex);
+
+    if ( !m_task || m_next == m_count )
+        return false;
+
+    n = m_next++;
+
+    return true;
+}
+
+void WorkerPool::OnItemDone()
+{
+    wxMutexLocker lock(m_mutex);
+
+    if ( !--m_remaining )
+        m_taskDone.Broadcast();
+}
+
+void WorkerPool::ThreadLoop()
+{
+    for ( ;; )
+    {
+        ParallelTask *task;
+        size_t n;
+        {
+            wxMutexLocker lock(m_mutex);
+
+            while ( !m_stopping && (!m_task || m_next == m_count) )
+                m_itemsAvailable.Wait();
+
+            if ( m_stopping )
+                break;
+
+            task = m_task;
+            n = m_next++;
+        }
+
+        task->Process(n);
+        OnItemDone();
+    }
+}
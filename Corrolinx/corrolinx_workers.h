@@ -0,0 +1,102 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        corrolinx_workers.h
+// Purpose:     Pool of worker threads for data parallel computations
+// Author:      Michael Hoag
+// Created:     10/17/2026
+// Copyright:   (c) 2026 Michael Hoag
+// Licence:     wxWindows licence
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _CORROLINX_CORROLINX_WORKERS_H_
+#define _CORROLINX_CORROLINX_WORKERS_H_
+
+#include "wx/thread.h"
+#include "wx/vector.h"
+
+// ----------------------------------------------------------------------------
+// ParallelTask: the work to be split between the threads of WorkerPool
+// ----------------------------------------------------------------------------
+
+// The task consists of a number of independent items, e.g. tiles of an
+// image, which are processed in an unspecified order and possibly
+// concurrently.
+class ParallelTask
+{
+public:
+    virtual ~ParallelTask() { }
+
+    // process the item with the given index, this is called from the worker
+    // threads and so must not use any GUI functions
+    virtual void Process(size_t n) = 0;
+};
+
+// ----------------------------------------------------------------------------
+// WorkerPool: threads executing ParallelTask items
+// ----------------------------------------------------------------------------
+
+// The items are distributed dynamically, with each thread taking the next
+// one as soon as it's done with the previous one, so that they remain busy
+// even if the items take different amounts of time to process.
+class WorkerPool
+{
+public:
+    // create the pool with the given number of threads or with one less than
+    // the number of processors, as the calling thread also works, if -1; a
+    // pool without any threads processes all items in the calling thread
+    explicit WorkerPool(int threads = -1);
+    ~WorkerPool();
+
+    // process all count items of the task and return when they're done
+    //
+    // only one task can be processed by the pool at any time, if it's busy,
+    // e.g. because this is called from inside another task, the items are
+    // just processed sequentially by the calling thread
+    void Run(ParallelTask& task, size_t count);
+
+    // the number of threads processing the items, including the calling one
+    int GetConcurrency() const { return m_threads.size() + 1; }
+
+    // the pool shared by the entire application, created on first use
+    static WorkerPool& Get();
+
+    // destroy the shared pool, must be called before the program exits
+    static void Cleanup();
+
+private:
+    class Thread;
+    friend class Thread;
+
+    // take the index of the next item of the current task, return false if
+    // there are no more items
+    bool TakeNextItem(size_t& n);
+
+    // called by the threads after processing each item
+    void OnItemDone();
+
+    // the body of the worker threads
+    void ThreadLoop();
+
+    // protects all the fields below
+    wxMutex m_mutex;
+
+    // signalled when there are new items to process or the pool is being
+    // destroyed
+    wxCondition m_itemsAvailable;
+
+    // signalled when the last item of the current task is done
+    wxCondition m_taskDone;
+
+    ParallelTask *m_task;
+    size_t m_count;
+    size_t m_next;
+    size_t m_remaining;
+    bool m_stopping;
+
+    wxVector<Thread *> m_threads;
+
+    static WorkerPool *ms_pool;
+
+    wxDECLARE_NO_COPY_CLASS(WorkerPool);
+};
+
+#endif // _CORROLINX_CORROLINX_WORKERS_H_